@@ -0,0 +1,690 @@
+#include "asio_http_server.h"
+#include "config.h"
+#include "http2_connection.h"
+#include "logger.h"
+#include "platform_interface.h"
+#include "websocket.h"
+#include <algorithm>
+#include <array>
+#include <boost/asio/ssl.hpp>
+#include <cctype>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace atem {
+namespace {
+
+    namespace net = boost::asio;
+    using tcp = net::ip::tcp;
+
+    // Upper bound for a request line plus headers. The buffer is released once
+    // a connection turns into an event stream.
+    constexpr std::size_t kMaxRequestBytes = 8192;
+
+    // Most queued items packed into one WebSocket message.
+    constexpr std::size_t kMaxWebSocketBatch = 64;
+
+    // What an HTTP/2 client sends first on a cleartext connection (RFC 9113, 3.4).
+    constexpr std::string_view kHttp2Preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+    // ALPN protocols offered on the TLS port, in order of preference.
+    constexpr std::array<unsigned char, 12> kAlpnProtocols { 2, 'h', '2', 8, 'h', 't', 't', 'p', '/', '1', '.', '1' };
+
+    int select_alpn(SSL* /*ssl*/, const unsigned char** out, unsigned char* out_length, const unsigned char* in, unsigned int in_length, void* /*arg*/)
+    {
+        unsigned char* selected = nullptr;
+        if (SSL_select_next_proto(&selected, out_length, kAlpnProtocols.data(), kAlpnProtocols.size(), in, in_length) != OPENSSL_NPN_NEGOTIATED) {
+            return SSL_TLSEXT_ERR_NOACK; // No ALPN; the client speaks HTTP/1.1
+        }
+        *out = selected;
+        return SSL_TLSEXT_ERR_OK;
+    }
+
+    // Queued to wake the writer when only a control frame is waiting.
+    const SharedPayload& empty_payload()
+    {
+        static const SharedPayload payload = std::make_shared<const PayloadBytes>();
+        return payload;
+    }
+
+    // Response headers for /events, shared by every stream with the same
+    // Content-Encoding.
+    const SharedPayload& event_stream_headers(std::string_view content_encoding)
+    {
+        const auto make = [](std::string_view encoding) {
+            std::string text = "HTTP/1.1 200 OK\r\n"
+                               "Content-Type: text/event-stream\r\n"
+                               "Cache-Control: no-cache\r\n"
+                               "Connection: keep-alive\r\n";
+            if (!encoding.empty()) {
+                text += "Content-Encoding: ";
+                text += encoding;
+                text += "\r\nVary: Accept-Encoding\r\n";
+            }
+            text += "\r\n";
+            return std::make_shared<const PayloadBytes>(text.begin(), text.end());
+        };
+        static const SharedPayload identity = make({});
+        static const SharedPayload gzip = make("gzip");
+        static const SharedPayload deflate = make("deflate");
+        if (content_encoding == "gzip") {
+            return gzip;
+        }
+        if (content_encoding == "deflate") {
+            return deflate;
+        }
+        return identity;
+    }
+
+    std::string_view trim(std::string_view s)
+    {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+            s.remove_prefix(1);
+        }
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+            s.remove_suffix(1);
+        }
+        return s;
+    }
+
+    std::string to_lower(std::string s)
+    {
+        std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return s;
+    }
+
+    // Parses the request line and headers in `head`, which excludes the final blank line.
+    bool parse_request(std::string_view head, HttpRequest& request, bool& keep_alive)
+    {
+        const auto line_end = head.find("\r\n");
+        const auto request_line = head.substr(0, line_end);
+        const auto sp1 = request_line.find(' ');
+        const auto sp2 = request_line.rfind(' ');
+        if (sp1 == std::string_view::npos || sp2 == sp1) {
+            return false;
+        }
+
+        request.method = request_line.substr(0, sp1);
+        const auto target = request_line.substr(sp1 + 1, sp2 - sp1 - 1);
+        const auto version = request_line.substr(sp2 + 1);
+        const auto question = target.find('?');
+        request.path = target.substr(0, question);
+        if (question != std::string_view::npos) {
+            parse_query_string(target.substr(question + 1), request.query);
+        }
+
+        auto rest = line_end == std::string_view::npos ? std::string_view {} : head.substr(line_end + 2);
+        while (!rest.empty()) {
+            const auto eol = rest.find("\r\n");
+            const auto line = rest.substr(0, eol);
+            rest = eol == std::string_view::npos ? std::string_view {} : rest.substr(eol + 2);
+            const auto colon = line.find(':');
+            if (colon == std::string_view::npos) {
+                continue;
+            }
+            request.headers.emplace_back(std::string(trim(line.substr(0, colon))), std::string(trim(line.substr(colon + 1))));
+        }
+
+        const auto connection = to_lower(request.get_header("Connection"));
+        keep_alive = version == "HTTP/1.1" ? connection.find("close") == std::string::npos
+                                           : connection.find("keep-alive") != std::string::npos;
+        return true;
+    }
+
+    // An HTTP/1.1 connection over a plain socket or a TLS stream.
+    template <typename Stream>
+    class HttpConnection final : public SseClient, public std::enable_shared_from_this<HttpConnection<Stream>> {
+    public:
+        HttpConnection(Stream socket, const Config& config, HttpHandler& handler, std::atomic<std::size_t>& connections,
+            Http2Counters& http2)
+            : socket_(std::move(socket))
+            , config_(config)
+            , handler_(handler)
+            , connections_(connections)
+            , http2_(http2)
+            , queue_(config.sse_queue_limit, std::chrono::milliseconds(config.sse_stall_timeout_ms))
+            , request_buffer_(std::make_unique<RequestBuffer>())
+        {
+            boost::system::error_code ignored;
+            remote_endpoint_ = socket_.lowest_layer().remote_endpoint(ignored);
+            connections_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        ~HttpConnection() override
+        {
+            connections_.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        HttpConnection(const HttpConnection&) = delete;
+        HttpConnection& operator=(const HttpConnection&) = delete;
+        HttpConnection(HttpConnection&&) = delete;
+        HttpConnection& operator=(HttpConnection&&) = delete;
+
+        void start()
+        {
+            read_request();
+        }
+
+        // SseClient implementation. Queueing happens on the caller's thread;
+        // only the write itself hops onto the connection's strand.
+        bool send(const SharedPayload& payload, int32_t coalesce_key, OutboundQueue::Clock::time_point now) override
+        {
+            if (!is_open()) {
+                return true; // Already closing; nothing to evict.
+            }
+            switch (queue_.push(payload, coalesce_key, now)) {
+            case OutboundQueue::PushResult::Started:
+                net::post(socket_.get_executor(), [self = this->shared_from_this(), payload]() {
+                    if (self->websocket_) {
+                        self->write_message({ payload });
+                    } else {
+                        self->write(payload);
+                    }
+                });
+                return true;
+            case OutboundQueue::PushResult::Queued:
+                return true;
+            case OutboundQueue::PushResult::Stalled:
+                return false;
+            }
+            return true;
+        }
+
+        void close() override
+        {
+            net::post(socket_.get_executor(), [self = this->shared_from_this()]() { self->shutdown(); });
+        }
+
+        bool is_open() const override
+        {
+            return open_.load(std::memory_order_acquire);
+        }
+
+        OutboundQueue::Stats queue_stats() const override
+        {
+            return queue_.stats();
+        }
+
+        std::string remote_address() const override
+        {
+            return remote_endpoint_.address().to_string() + ":" + std::to_string(remote_endpoint_.port());
+        }
+
+        bool copies_payload() const override
+        {
+            return false;
+        }
+
+    private:
+        using RequestBuffer = std::array<char, kMaxRequestBytes>;
+
+        void read_request()
+        {
+            socket_.async_read_some(net::buffer(request_buffer_->data() + buffered_, request_buffer_->size() - buffered_),
+                [self = this->shared_from_this()](const boost::system::error_code& ec, std::size_t length) {
+                    if (ec) {
+                        self->shutdown();
+                        return;
+                    }
+                    self->buffered_ += length;
+                    self->process_request();
+                });
+        }
+
+        void process_request()
+        {
+            const std::string_view data(request_buffer_->data(), buffered_);
+            const auto head_end = data.find("\r\n\r\n");
+            if (head_end == std::string_view::npos) {
+                if (buffered_ == request_buffer_->size()) {
+                    respond({ 431, {}, {} }, false);
+                } else {
+                    read_request();
+                }
+                return;
+            }
+
+            // An h2c client with prior knowledge opens with the HTTP/2
+            // preface instead of a request; hand the connection over.
+            if constexpr (std::is_same_v<Stream, tcp::socket>) {
+                if (config_.http2_enabled && !served_ && data.starts_with(kHttp2Preface.substr(0, head_end + 4))) {
+                    start_http2_connection(std::move(socket_), data, config_, handler_, connections_, http2_);
+                    open_ = false;
+                    return;
+                }
+            }
+
+            HttpRequest request;
+            bool keep_alive = false;
+            consumed_ = head_end + 4;
+            if (!parse_request(data.substr(0, head_end), request, keep_alive)) {
+                respond({ 400, {}, {} }, false);
+                return;
+            }
+            if (request.method != "GET") {
+                respond({ 405, { { "Allow", "GET" } }, {} }, false);
+                return;
+            }
+            if (handler_.is_event_stream(request)) {
+                start_event_stream(request);
+                return;
+            }
+            if (handler_.is_websocket(request)) {
+                start_websocket(std::move(request));
+                return;
+            }
+            if (handler_.is_deferred(request)) {
+                // Nothing is read until the answer is written, so the
+                // connection only holds its buffers meanwhile.
+                handler_.handle_deferred(request, [self = this->shared_from_this(), keep_alive](HttpResponse response) {
+                    net::post(self->socket_.get_executor(), [self, keep_alive, response = std::move(response)]() mutable {
+                        self->respond(std::move(response), keep_alive);
+                    });
+                });
+                return;
+            }
+            respond(handler_.handle_request(request), keep_alive);
+        }
+
+        void respond(HttpResponse response, bool keep_alive)
+        {
+            response_head_ = "HTTP/1.1 " + std::to_string(response.status) + " " + std::string(http_reason_phrase(response.status)) + "\r\n";
+            for (const auto& [name, value] : response.headers) {
+                if (name != "Content-Length" && name != "Connection") {
+                    response_head_ += name + ": " + value + "\r\n";
+                }
+            }
+            if (response.status != 204 && response.status != 304) {
+                response_head_ += "Content-Length: " + std::to_string(response.body.size()) + "\r\n";
+            }
+            response_head_ += keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+            response_body_ = std::move(response.body);
+            served_ = true;
+
+            const std::array<net::const_buffer, 2> buffers { net::buffer(response_head_), net::buffer(response_body_) };
+            net::async_write(socket_, buffers, [self = this->shared_from_this(), keep_alive](const boost::system::error_code& ec, std::size_t) {
+                self->response_head_.clear();
+                self->response_body_.clear();
+                if (ec || !keep_alive) {
+                    self->shutdown();
+                    return;
+                }
+                // Keep any pipelined bytes that followed the request we just answered.
+                std::memmove(self->request_buffer_->data(), self->request_buffer_->data() + self->consumed_, self->buffered_ - self->consumed_);
+                self->buffered_ -= self->consumed_;
+                self->consumed_ = 0;
+                self->process_request();
+            });
+        }
+
+        void start_event_stream(const HttpRequest& request)
+        {
+            streaming_ = true;
+            // The request has been parsed; an idle stream only needs its write queue.
+            request_buffer_.reset();
+            buffered_ = 0;
+            consumed_ = 0;
+
+            send(event_stream_headers(handler_.event_stream_encoding(request)), OutboundQueue::kNoCoalesceKey, OutboundQueue::Clock::now());
+            handler_.open_event_stream(this->shared_from_this(), request);
+            watch_for_close();
+        }
+
+        void start_websocket(HttpRequest request)
+        {
+            if (!is_websocket_upgrade(request)) {
+                respond({ 426, { { "Upgrade", "websocket" } }, {} }, false);
+                return;
+            }
+
+            response_head_ = "HTTP/1.1 101 Switching Protocols\r\n"
+                             "Upgrade: websocket\r\n"
+                             "Connection: Upgrade\r\n"
+                             "Sec-WebSocket-Accept: "
+                + websocket_accept_key(request.get_header("Sec-WebSocket-Key")) + "\r\n\r\n";
+            // Keep any frames the client sent right behind the handshake.
+            std::memmove(request_buffer_->data(), request_buffer_->data() + consumed_, buffered_ - consumed_);
+            buffered_ -= consumed_;
+            consumed_ = 0;
+
+            // Nothing is queued until the handler sees the client, so the
+            // handshake cannot interleave with a message.
+            net::async_write(socket_, net::buffer(response_head_),
+                [self = this->shared_from_this(), request = std::move(request)](const boost::system::error_code& ec, std::size_t) {
+                    self->response_head_.clear();
+                    if (ec) {
+                        self->shutdown();
+                        return;
+                    }
+                    self->websocket_ = true;
+                    self->streaming_ = true;
+                    self->handler_.open_websocket(self, request);
+                    self->process_frames();
+                });
+        }
+
+        // Clients only send control frames; data frames are read and dropped.
+        void process_frames()
+        {
+            std::size_t offset = 0;
+            while (offset < buffered_) {
+                WebSocketFrame frame;
+                const auto size = parse_websocket_frame(std::span<char>(request_buffer_->data() + offset, buffered_ - offset), frame);
+                if (!size) {
+                    shutdown();
+                    return;
+                }
+                if (*size == 0) {
+                    break;
+                }
+                offset += *size;
+
+                if (frame.opcode == WebSocketOpcode::Ping) {
+                    queue_control_frame(make_websocket_control_frame(WebSocketOpcode::Pong, { frame.payload.data(), frame.payload.size() }));
+                } else if (frame.opcode == WebSocketOpcode::Close) {
+                    // Echo the status code, then close once it is written.
+                    closing_ = true;
+                    queue_control_frame(make_websocket_control_frame(WebSocketOpcode::Close, { frame.payload.data(), std::min<std::size_t>(frame.payload.size(), 2) }));
+                    return;
+                }
+            }
+
+            std::memmove(request_buffer_->data(), request_buffer_->data() + offset, buffered_ - offset);
+            buffered_ -= offset;
+            if (buffered_ == request_buffer_->size()) {
+                shutdown(); // A frame larger than the whole buffer
+                return;
+            }
+            socket_.async_read_some(net::buffer(request_buffer_->data() + buffered_, request_buffer_->size() - buffered_),
+                [self = this->shared_from_this()](const boost::system::error_code& ec, std::size_t length) {
+                    if (ec) {
+                        self->shutdown();
+                        return;
+                    }
+                    self->buffered_ += length;
+                    self->process_frames();
+                });
+        }
+
+        // Control frames ride along with the next message write. An empty
+        // payload starts that write if the connection is idle.
+        void queue_control_frame(std::string frame)
+        {
+            pending_control_ = std::move(frame);
+            if (!send(empty_payload(), OutboundQueue::kNoCoalesceKey, OutboundQueue::Clock::now())) {
+                shutdown();
+            }
+        }
+
+        // Writes a batch of queued CBOR items as one binary message, behind
+        // any pending control frame. The items are written straight from the
+        // shared buffers.
+        void write_message(std::vector<SharedPayload> items)
+        {
+            if (!is_open()) {
+                return;
+            }
+            sending_control_ = std::move(pending_control_);
+            pending_control_.clear();
+            message_buffers_.clear();
+            if (!sending_control_.empty()) {
+                message_buffers_.push_back(net::buffer(sending_control_));
+            }
+            uint64_t size = 0;
+            for (const auto& item : items) {
+                size += item->size();
+            }
+            if (size > 0) {
+                const auto header_size = encode_websocket_header(WebSocketOpcode::Binary, size, message_header_);
+                message_buffers_.push_back(net::buffer(message_header_.data(), header_size));
+                for (const auto& item : items) {
+                    message_buffers_.push_back(net::buffer(item->data(), item->size()));
+                }
+            }
+            if (message_buffers_.empty()) {
+                complete_message();
+                return;
+            }
+            net::async_write(socket_, message_buffers_, [self = this->shared_from_this()](const boost::system::error_code& ec, std::size_t) {
+                if (ec) {
+                    self->shutdown();
+                    return;
+                }
+                self->complete_message();
+            });
+        }
+
+        void complete_message()
+        {
+            sending_control_.clear();
+            if (closing_) {
+                shutdown();
+                return;
+            }
+            std::vector<SharedPayload> next;
+            queue_.complete_batch(kMaxWebSocketBatch, next);
+            if (!next.empty()) {
+                write_message(std::move(next));
+            }
+        }
+
+        // SSE clients never send anything after the request, so a pending read
+        // only completes when the peer goes away.
+        void watch_for_close()
+        {
+            socket_.async_read_some(net::buffer(drain_), [self = this->shared_from_this()](const boost::system::error_code& ec, std::size_t) {
+                if (ec) {
+                    self->shutdown();
+                    return;
+                }
+                self->watch_for_close();
+            });
+        }
+
+        void write(const SharedPayload& payload)
+        {
+            if (!is_open()) {
+                return;
+            }
+            // Write straight from the shared buffer; the queue keeps it alive.
+            net::async_write(socket_, net::buffer(payload->data(), payload->size()),
+                [self = this->shared_from_this()](const boost::system::error_code& ec, std::size_t) {
+                    if (ec) {
+                        self->shutdown();
+                        return;
+                    }
+                    if (auto next = self->queue_.complete_write()) {
+                        self->write(next);
+                    }
+                });
+        }
+
+        void shutdown()
+        {
+            if (!open_.exchange(false, std::memory_order_acq_rel)) {
+                return;
+            }
+            boost::system::error_code ignored;
+            socket_.lowest_layer().shutdown(tcp::socket::shutdown_both, ignored);
+            socket_.lowest_layer().close(ignored);
+            queue_.clear();
+            if (streaming_) {
+                handler_.close_event_stream(this->shared_from_this());
+            }
+        }
+
+        Stream socket_;
+        const Config& config_;
+        HttpHandler& handler_;
+        std::atomic<std::size_t>& connections_;
+        Http2Counters& http2_;
+        std::atomic<bool> open_ { true };
+        tcp::endpoint remote_endpoint_;
+        OutboundQueue queue_;
+
+        // Request parsing state; released when the connection becomes an event stream.
+        std::unique_ptr<RequestBuffer> request_buffer_;
+        std::size_t buffered_ = 0;
+        std::size_t consumed_ = 0;
+        std::string response_head_;
+        std::string response_body_;
+        bool served_ = false; // A response has been written; no h2c preface may follow
+
+        // Event stream state.
+        bool streaming_ = false;
+        std::array<char, 16> drain_ {};
+
+        // WebSocket state; request_buffer_ is kept for reading client frames.
+        bool websocket_ = false;
+        bool closing_ = false;
+        std::string pending_control_;
+        std::string sending_control_;
+        std::array<uint8_t, kMaxWebSocketHeader> message_header_ {};
+        std::vector<net::const_buffer> message_buffers_;
+    };
+
+} // namespace
+
+AsioHttpServer::AsioHttpServer(const Config& config, HttpHandler& handler)
+    : config_(config)
+    , handler_(handler)
+    , acceptor_(ioc_)
+    , tls_acceptor_(ioc_)
+    , io_pool_("io", config.io_threads > 0 ? config.io_threads : std::max(1U, std::thread::hardware_concurrency()), config.io_cpus,
+          std::chrono::milliseconds(config.lag_probe_interval_ms))
+{
+}
+
+AsioHttpServer::~AsioHttpServer()
+{
+    stop();
+    io_pool_.join();
+}
+
+void AsioHttpServer::run()
+{
+    const tcp::endpoint endpoint(net::ip::make_address(config_.ws_address), config_.ws_port);
+    acceptor_.open(endpoint.protocol());
+    acceptor_.set_option(tcp::acceptor::reuse_address(true));
+    // Worker processes each bind the same port and the kernel spreads
+    // connections across them.
+    if (config_.worker_processes > 0 && !platform::set_reuse_port(static_cast<std::uintptr_t>(acceptor_.native_handle()))) {
+        throw std::runtime_error(platform::get_last_error());
+    }
+    acceptor_.bind(endpoint);
+    // Like restbed, the connection limit sizes the listen backlog.
+    acceptor_.listen(config_.ws_connection_limit);
+    do_accept();
+
+    if (config_.http2_enabled && config_.http2_tls_port != 0) {
+        namespace ssl = net::ssl;
+        tls_context_ = std::make_unique<ssl::context>(ssl::context::tls_server);
+        tls_context_->set_options(ssl::context::default_workarounds | ssl::context::no_sslv2 | ssl::context::no_sslv3
+            | ssl::context::no_tlsv1 | ssl::context::no_tlsv1_1 | ssl::context::single_dh_use);
+        tls_context_->use_certificate_chain_file(config_.http2_certificate);
+        tls_context_->use_private_key_file(config_.http2_private_key, ssl::context::pem);
+        SSL_CTX_set_alpn_select_cb(tls_context_->native_handle(), select_alpn, nullptr);
+
+        const tcp::endpoint tls_endpoint(endpoint.address(), config_.http2_tls_port);
+        tls_acceptor_.open(tls_endpoint.protocol());
+        tls_acceptor_.set_option(tcp::acceptor::reuse_address(true));
+        if (config_.worker_processes > 0 && !platform::set_reuse_port(static_cast<std::uintptr_t>(tls_acceptor_.native_handle()))) {
+            throw std::runtime_error(platform::get_last_error());
+        }
+        tls_acceptor_.bind(tls_endpoint);
+        tls_acceptor_.listen(config_.ws_connection_limit);
+        do_accept_tls();
+        log(LogLevel::Info) << "HTTPS (h2, http/1.1) listening on " << config_.ws_address << ":" << config_.http2_tls_port;
+    }
+
+    io_pool_.start(ioc_);
+    io_pool_.join();
+}
+
+void AsioHttpServer::stop()
+{
+    // Stopping the io_context unblocks run(); pending connections are released
+    // when the io_context is destroyed.
+    ioc_.stop();
+}
+
+ThreadPool::Stats AsioHttpServer::thread_stats() const
+{
+    return io_pool_.stats();
+}
+
+std::size_t AsioHttpServer::connection_count() const
+{
+    return connections_.load(std::memory_order_relaxed);
+}
+
+std::size_t AsioHttpServer::http2_connection_count() const
+{
+    return http2_.connections.load(std::memory_order_relaxed);
+}
+
+std::size_t AsioHttpServer::http2_stream_count() const
+{
+    return http2_.streams.load(std::memory_order_relaxed);
+}
+
+void AsioHttpServer::do_accept()
+{
+    acceptor_.async_accept(net::make_strand(ioc_), [this](const boost::system::error_code& ec, tcp::socket socket) {
+        if (!acceptor_.is_open()) {
+            return;
+        }
+        if (!ec) {
+            boost::system::error_code ignored;
+            socket.set_option(tcp::no_delay(true), ignored);
+            if (config_.sse_dead_peer_timeout_ms > 0) {
+                platform::set_tcp_dead_peer_timeout(static_cast<std::uintptr_t>(socket.native_handle()), config_.sse_dead_peer_timeout_ms);
+            }
+            std::make_shared<HttpConnection<tcp::socket>>(std::move(socket), config_, handler_, connections_, http2_)->start();
+        } else {
+            log(LogLevel::Error) << "Accept failed: " << ec.message();
+        }
+        do_accept();
+    });
+}
+
+void AsioHttpServer::do_accept_tls()
+{
+    tls_acceptor_.async_accept(net::make_strand(ioc_), [this](const boost::system::error_code& ec, tcp::socket socket) {
+        if (!tls_acceptor_.is_open()) {
+            return;
+        }
+        if (!ec) {
+            boost::system::error_code ignored;
+            socket.set_option(tcp::no_delay(true), ignored);
+            if (config_.sse_dead_peer_timeout_ms > 0) {
+                platform::set_tcp_dead_peer_timeout(static_cast<std::uintptr_t>(socket.native_handle()), config_.sse_dead_peer_timeout_ms);
+            }
+            using TlsStream = net::ssl::stream<tcp::socket>;
+            auto stream = std::make_shared<TlsStream>(std::move(socket), *tls_context_);
+            stream->async_handshake(net::ssl::stream_base::server, [this, stream](const boost::system::error_code& handshake_ec) {
+                if (handshake_ec) {
+                    return; // Dropping the stream closes the socket.
+                }
+                const unsigned char* protocol = nullptr;
+                unsigned int length = 0;
+                SSL_get0_alpn_selected(stream->native_handle(), &protocol, &length);
+                if (std::string_view(reinterpret_cast<const char*>(protocol), protocol ? length : 0) == "h2") {
+                    start_http2_connection(std::move(*stream), config_, handler_, connections_, http2_);
+                } else {
+                    std::make_shared<HttpConnection<TlsStream>>(std::move(*stream), config_, handler_, connections_, http2_)->start();
+                }
+            });
+        } else {
+            log(LogLevel::Warning) << "TLS accept failed: " << ec.message();
+        }
+        do_accept_tls();
+    });
+}
+
+} // namespace atem
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "http2_connection.h"
+#include "http_message.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <boost/asio.hpp>
+#include <cstddef>
+#include <memory>
+
+namespace boost::asio::ssl {
+class context;
+}
+
+namespace atem {
+
+struct Config;
+
+/**
+ * @class AsioHttpServer
+ * @brief A minimal HTTP/1.1 + SSE engine built directly on Boost.Asio.
+ *
+ * Every connection runs on its own strand, so reads and writes for one client
+ * never need a lock. Event streams write straight from the shared broadcast
+ * payload and keep only a small fixed amount of state once the request has
+ * been parsed. On Linux the Asio reactor registers sockets with epoll in
+ * edge-triggered mode.
+ *
+ * With HTTP/2 enabled, a cleartext client that opens with the HTTP/2 preface
+ * is served over h2c, and an optional TLS port negotiates h2 or http/1.1
+ * through ALPN. Every event stream of an HTTP/2 client shares one connection.
+ */
+class AsioHttpServer final {
+public:
+    AsioHttpServer(const Config& config, HttpHandler& handler);
+    ~AsioHttpServer();
+
+    // Non-copyable, non-movable
+    AsioHttpServer(const AsioHttpServer&) = delete;
+    AsioHttpServer& operator=(const AsioHttpServer&) = delete;
+    AsioHttpServer(AsioHttpServer&&) = delete;
+    AsioHttpServer& operator=(AsioHttpServer&&) = delete;
+
+    // Binds the listen socket and runs the I/O thread pool. Blocks until stop().
+    void run();
+    void stop();
+
+    [[nodiscard]] std::size_t connection_count() const;
+    [[nodiscard]] std::size_t http2_connection_count() const;
+    [[nodiscard]] std::size_t http2_stream_count() const;
+    [[nodiscard]] ThreadPool::Stats thread_stats() const;
+
+private:
+    void do_accept();
+    void do_accept_tls();
+
+    const Config& config_;
+    HttpHandler& handler_;
+    // Declared before the io_context: connections still queued in it decrement
+    // this counter when the io_context is destroyed.
+    std::atomic<std::size_t> connections_ { 0 };
+    Http2Counters http2_;
+    boost::asio::io_context ioc_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+    std::unique_ptr<boost::asio::ssl::context> tls_context_;
+    boost::asio::ip::tcp::acceptor tls_acceptor_;
+    ThreadPool io_pool_; // Destroyed before the io_context it runs
+};
+
+} // namespace atem
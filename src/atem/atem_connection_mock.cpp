@@ -1,10 +1,11 @@
 #include "atem_connection_mock.h"
-#include <iostream>
+#include "logger.h"
 
 namespace atem {
 
-ATEMConnectionMock::ATEMConnectionMock(boost::asio::io_context& ioc, uint16_t num_inputs)
-    : ioc_(ioc)
+ATEMConnectionMock::ATEMConnectionMock(boost::asio::io_context& ioc, uint16_t num_inputs, uint8_t switcher)
+    : switcher_(switcher)
+    , ioc_(ioc)
     , update_timer_(ioc)
     , random_generator_(std::random_device {}())
 {
@@ -13,17 +14,15 @@ ATEMConnectionMock::ATEMConnectionMock(boost::asio::io_context& ioc, uint16_t nu
     }
     for (uint16_t i = 1; i <= num_inputs; ++i) {
         mock_states_.push_back({ i, "Cam " + std::to_string(i), false, false, std::chrono::system_clock::now() });
+        mock_states_.back().switcher = switcher_;
     }
     // Start with input 1 on program so there's an initial state.
-    if (!mock_states_.empty()) {
-        mock_states_[0].program = true;
-        current_program_input_id_ = 1;
-    }
+    select({ 1, 0, false });
 }
 
 bool ATEMConnectionMock::connect(const std::string& /*ip_address*/)
 {
-    std::cout << "Mock ATEM connection enabled." << std::endl;
+    log(LogLevel::Info) << "Mock ATEM connection enabled.";
     schedule_next_action(Action::Ready, 3s);
     return true;
 }
@@ -34,18 +33,19 @@ void ATEMConnectionMock::disconnect()
     dissolve_timer_.reset();
 }
 
-void ATEMConnectionMock::poll()
+bool ATEMConnectionMock::poll()
 {
     // No-op for mock. Updates are timer-based and asynchronous.
+    return false;
 }
 
 void ATEMConnectionMock::on_tally_change(TallyCallback callback)
 {
     tally_callback_ = std::move(callback);
     // If we are already running, send the initial state
-    if (current_program_input_id_ > 0) {
+    if (tally_callback_) {
         for (const auto& state : mock_states_) {
-            send_tally_update(state.input_id);
+            tally_callback_(state.to_update(true));
         }
     }
 }
@@ -56,7 +56,7 @@ std::vector<InputInfo> ATEMConnectionMock::get_inputs() const
     inputs.reserve(mock_states_.size());
     for (const auto& state : mock_states_) {
         // For mock, long name is same as short name
-        inputs.push_back({ state.input_id, state.short_name, state.short_name });
+        inputs.push_back({ state.input_id, state.short_name, state.short_name, switcher_ });
     }
     return inputs;
 }
@@ -77,11 +77,12 @@ void ATEMConnectionMock::perform_action(Action action)
     if (mock_states_.empty())
         return;
 
+    const auto count = static_cast<uint16_t>(mock_states_.size());
     switch (action) {
     case Action::Ready: {
         // "Ready" command: put the next input in preview
-        uint16_t next_input_id = (current_program_input_id_ % mock_states_.size()) + 1;
-        set_preview(next_input_id);
+        const uint16_t next_input_id = static_cast<uint16_t>(selection_.program % count + 1);
+        select({ selection_.program, next_input_id, false });
 
         // Decide if the next transition is a cut or dissolve
         std::uniform_int_distribution<> dist(0, 1);
@@ -91,32 +92,22 @@ void ATEMConnectionMock::perform_action(Action action)
     }
     case Action::Cut: {
         // "Cut" command: swap program and preview
-        uint16_t old_program = current_program_input_id_;
-        uint16_t new_program = current_preview_input_id_;
-
-        set_program(new_program);
-        set_preview(old_program); // Old program becomes new preview
+        select({ selection_.preview, selection_.program, false });
         schedule_next_action(Action::Ready, 4s);
         break;
     }
     case Action::Dissolve: {
         // "Dissolve" command: both on program for a duration
-        uint16_t old_program = current_program_input_id_;
-        uint16_t new_program = current_preview_input_id_;
-
-        // Both inputs are on program during the dissolve
-        set_program(new_program, false); // Don't clear old program yet
+        select({ selection_.program, selection_.preview, true });
 
         // After 2 seconds, the dissolve completes
         dissolve_timer_ = std::make_unique<boost::asio::steady_timer>(ioc_);
         dissolve_timer_->expires_after(2s);
-        dissolve_timer_->async_wait([this, old_program](const boost::system::error_code& ec) {
+        dissolve_timer_->async_wait([this](const boost::system::error_code& ec) {
             if (ec)
                 return;
-            // Dissolve finished: old program is no longer on program, and becomes the new preview.
-            mock_states_[old_program - 1].program = false;
-            set_preview(old_program); // This also sends the update for the old program state change.
-            // The new program was already set before the timer started.
+            // Dissolve finished: the old program becomes the new preview.
+            select({ selection_.preview, selection_.program, false });
             schedule_next_action(Action::Ready, 4s);
         });
         break;
@@ -124,40 +115,22 @@ void ATEMConnectionMock::perform_action(Action action)
     }
 }
 
-void ATEMConnectionMock::set_program(uint16_t input_id, bool clear_old)
+void ATEMConnectionMock::select(const MixEffectState& selection)
 {
-    if (clear_old && current_program_input_id_ > 0) {
-        mock_states_[current_program_input_id_ - 1].program = false; // NOLINT
-        send_tally_update(current_program_input_id_);
-    }
-
-    current_program_input_id_ = input_id;
-    mock_states_[input_id - 1].program = true;
-    mock_states_[input_id - 1].preview = false; // An input can't be program and preview
-
-    if (input_id == current_preview_input_id_) {
-        current_preview_input_id_ = 0; // It's no longer just in preview
-    }
-
-    send_tally_update(input_id);
-}
-
-void ATEMConnectionMock::set_preview(uint16_t input_id)
-{
-    if (current_preview_input_id_ > 0) {
-        mock_states_[current_preview_input_id_ - 1].preview = false;
-        send_tally_update(current_preview_input_id_);
-    }
-    current_preview_input_id_ = input_id;
-    mock_states_[input_id - 1].preview = true;
-    send_tally_update(input_id);
-}
-
-void ATEMConnectionMock::send_tally_update(uint16_t input_id)
-{
-    if (tally_callback_ && input_id > 0 && input_id <= mock_states_.size()) {
-        const auto& state = mock_states_[input_id - 1];
-        tally_callback_(state.to_update(true));
+    selection_ = selection;
+    changes_.clear();
+    engine_.update(0, selection, changes_);
+    for (const auto& change : changes_) {
+        if (change.input_id == 0 || change.input_id > mock_states_.size()) {
+            continue;
+        }
+        auto& state = mock_states_[change.input_id - 1];
+        state.program = change.program;
+        state.preview = change.preview;
+        state.last_updated = std::chrono::system_clock::now();
+        if (tally_callback_) {
+            tally_callback_(state.to_update(true));
+        }
     }
 }
 
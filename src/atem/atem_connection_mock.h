@@ -2,6 +2,7 @@
 
 #include "config.h"
 #include "iatem_connection.h"
+#include "tally_engine.h"
 #include <boost/asio/steady_timer.hpp>
 #include <chrono>
 #include <cstdint>
@@ -14,11 +15,11 @@ namespace atem {
 
 class ATEMConnectionMock final : public IATEMConnection { // NOLINT(cppcoreguidelines-pro-type-member-init)
 public:
-    explicit ATEMConnectionMock(boost::asio::io_context& ioc, uint16_t num_inputs);
+    explicit ATEMConnectionMock(boost::asio::io_context& ioc, uint16_t num_inputs, uint8_t switcher = 0);
 
     bool connect(const std::string& ip_address) override;
     void disconnect() override;
-    void poll() override;
+    bool poll() override;
     void on_tally_change(TallyCallback callback) override;
     bool is_mock_mode() const override
     {
@@ -30,29 +31,28 @@ public:
     }
     std::vector<InputInfo> get_inputs() const override;
 
-private:
-    void send_tally_update(uint16_t input_id);
-
 private:
     enum class Action { Ready, Cut, Dissolve };
 
     void schedule_next_action(Action action, std::chrono::steady_clock::duration delay);
     void perform_action(Action action);
 
-    void set_program(uint16_t input_id, bool clear_old = true);
-    void set_preview(uint16_t input_id);
+    // Selects on the mock's one M/E, as an operator would, and sends the
+    // inputs whose tally that changed.
+    void select(const MixEffectState& selection);
 
+    const uint8_t switcher_;
     TallyCallback tally_callback_;
     std::vector<TallyState> mock_states_;
+    TallyEngine engine_;
+    MixEffectState selection_;
+    std::vector<TallyEngine::Change> changes_;
 
     boost::asio::io_context& ioc_;
     boost::asio::steady_timer update_timer_;
     std::unique_ptr<boost::asio::steady_timer> dissolve_timer_;
 
     std::mt19937 random_generator_;
-
-    uint16_t current_program_input_id_ { 0 };
-    uint16_t current_preview_input_id_ { 0 };
 };
 
 } // namespace atem
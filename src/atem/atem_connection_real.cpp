@@ -1,9 +1,10 @@
 #include "atem_connection_real.h"
-#include <iostream>
+#include "logger.h"
 
 namespace atem {
 
-ATEMConnectionReal::ATEMConnectionReal()
+ATEMConnectionReal::ATEMConnectionReal(uint8_t switcher)
+    : switcher_(switcher)
 {
     atem_discovery_ = ATEMDiscovery::create();
 }
@@ -18,41 +19,74 @@ bool ATEMConnectionReal::connect(const std::string& ip_address)
     if (connected_)
         return true;
 
-    atem_device_ = atem_discovery_->connect_to(ip_address);
+    auto device = atem_discovery_->connect_to(ip_address);
 
-    if (atem_device_) {
-        std::cout << "Successfully connected to ATEM: " << atem_device_->get_product_name() << std::endl;
+    if (device) {
+        log(LogLevel::Info) << "Successfully connected to ATEM: " << device->get_product_name();
+        {
+            const std::scoped_lock lock(engine_mutex_);
+            engine_.reset();
+            atem_device_ = std::move(device);
+        }
         atem_device_->set_callback(this);
         connected_ = true;
         return true;
     }
 
-    std::cerr << "Could not connect to ATEM switcher." << std::endl;
+    log(LogLevel::Error) << "Could not connect to ATEM switcher.";
     return false;
 }
 
 void ATEMConnectionReal::disconnect()
 {
     connected_ = false;
-    if (atem_device_) {
-        atem_device_->disconnect();
-        atem_device_.reset();
+    // Taken out under the engine lock, so an SDK callback either finishes
+    // with the device first or finds it gone. The device is closed outside
+    // the lock, in case closing waits for a callback that wants it.
+    auto device = std::unique_ptr<ATEMDevice>();
+    {
+        const std::scoped_lock lock(engine_mutex_);
+        device = std::move(atem_device_);
+    }
+    if (device) {
+        device->disconnect();
     }
 }
 
 void ATEMConnectionReal::on_tally_change(TallyCallback callback)
 {
+    const std::scoped_lock lock(engine_mutex_);
     tally_callback_ = std::move(callback);
+    if (!tally_callback_ || !atem_device_) {
+        return;
+    }
+    // The M/E blocks and inputs reported what they start with while
+    // connecting; pass on whatever that put on program or preview.
+    changes_ = engine_.lit();
+    deliver_changes();
 }
 
-void ATEMConnectionReal::poll()
+void ATEMConnectionReal::on_disconnect(DisconnectCallback callback)
 {
-    if (connected_ && atem_device_) {
-        // The SDK is callback-driven, but some operations might require polling.
-        // The BMDSwitcherAPIDispatch.cpp file needs to be called periodically
-        // to dispatch events on non-Windows platforms.
-        atem_device_->poll();
+    disconnect_callback_ = std::move(callback);
+}
+
+bool ATEMConnectionReal::poll()
+{
+    if (!connected_ || !atem_device_) {
+        return false;
     }
+    // The SDK is callback-driven, but a device may need to be polled to
+    // dispatch its events; anything it dispatches arrives through
+    // on_mix_effect_changed().
+    const auto before = delivered_.load(std::memory_order_relaxed);
+    atem_device_->poll();
+    return delivered_.load(std::memory_order_relaxed) != before;
+}
+
+bool ATEMConnectionReal::needs_polling() const
+{
+    return connected_ && atem_device_ && atem_device_->needs_polling();
 }
 
 bool ATEMConnectionReal::is_mock_mode() const
@@ -75,22 +109,52 @@ std::vector<InputInfo> ATEMConnectionReal::get_inputs() const
     // of input properties that it maintains.
 
     if (connected_ && atem_device_) {
-        return atem_device_->get_inputs();
+        auto inputs = atem_device_->get_inputs();
+        for (auto& input : inputs) {
+            input.switcher = switcher_;
+        }
+        return inputs;
     }
     return {};
 }
 
-void ATEMConnectionReal::on_tally_state_changed(const TallyUpdate& update)
+void ATEMConnectionReal::on_mix_effect_changed(std::size_t mix_effect, const MixEffectState& state)
 {
+    const std::scoped_lock lock(engine_mutex_);
+    changes_.clear();
+    engine_.update(mix_effect, state, changes_);
+    deliver_changes();
+}
+
+void ATEMConnectionReal::on_input_tally_changed(uint16_t input_id, bool program, bool preview)
+{
+    const std::scoped_lock lock(engine_mutex_);
+    changes_.clear();
+    engine_.set_input_tally(input_id, { program, preview }, changes_);
+    deliver_changes();
+}
+
+void ATEMConnectionReal::deliver_changes()
+{
+    if (changes_.empty() || !atem_device_) {
+        return;
+    }
+    delivered_.fetch_add(changes_.size(), std::memory_order_relaxed);
     if (tally_callback_) {
-        tally_callback_(update);
+        for (const auto& change : changes_) {
+            tally_callback_({ change.input_id, change.program, change.preview, false,
+                atem_device_->get_input_info(change.input_id).short_name, switcher_ });
+        }
     }
 }
 
 void ATEMConnectionReal::on_disconnected()
 {
-    std::cerr << "ATEM Connection Lost." << std::endl;
+    log(LogLevel::Error) << "ATEM Connection Lost.";
     disconnect();
+    if (disconnect_callback_) {
+        disconnect_callback_();
+    }
 }
 
 } // namespace atem
@@ -4,35 +4,52 @@
 #include "iatem_connection.h"
 #include <atomic>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace atem {
 
 class ATEMConnectionReal final : public IATEMConnection, private ATEMSwitcherCallback {
 public:
-    ATEMConnectionReal();
+    explicit ATEMConnectionReal(uint8_t switcher = 0);
     ~ATEMConnectionReal() noexcept override;
 
     // IATEMConnection implementation
     bool connect(const std::string& ip_address) override;
     void disconnect() override;
-    void poll() override;
+    bool poll() override;
+    bool needs_polling() const override;
     void on_tally_change(TallyCallback callback) override;
+    void on_disconnect(DisconnectCallback callback) override;
     bool is_mock_mode() const override;
     uint16_t get_input_count() const override;
     std::vector<InputInfo> get_inputs() const override;
 
 private:
     // ATEMSwitcherCallback implementation
-    void on_tally_state_changed(const TallyUpdate& update) override;
+    void on_mix_effect_changed(std::size_t mix_effect, const MixEffectState& state) override;
+    void on_input_tally_changed(uint16_t input_id, bool program, bool preview) override;
     void on_disconnected() override;
 
+    // Passes changes_ to the tally callback. The caller holds engine_mutex_.
+    void deliver_changes();
+
     std::atomic<bool> connected_ { false };
+    std::atomic<uint64_t> delivered_ { 0 }; // Tally changes passed on
 
+    const uint8_t switcher_;
     TallyCallback tally_callback_;
+    DisconnectCallback disconnect_callback_;
+
+    // Each M/E block and input calls back on its own; the engine sees one at a time,
+    // and its changes are delivered in the order they were made.
+    std::mutex engine_mutex_;
+    TallyEngine engine_;
+    std::vector<TallyEngine::Change> changes_;
 
     std::unique_ptr<ATEMDiscovery> atem_discovery_;
-    std::unique_ptr<ATEMDevice> atem_device_;
+    std::unique_ptr<ATEMDevice> atem_device_; // Set and cleared under engine_mutex_
 };
 
 } // namespace atem
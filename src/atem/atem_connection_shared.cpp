@@ -0,0 +1,152 @@
+#include "atem_connection_shared.h"
+#include "logger.h"
+
+namespace atem {
+
+namespace net = boost::asio;
+using net::ip::udp;
+
+ATEMConnectionShared::ATEMConnectionShared(net::io_context& ioc, SharedTallyRing& ring, std::size_t worker)
+    : ring_(ring)
+    , worker_(worker)
+    , doorbell_(ioc)
+{
+}
+
+bool ATEMConnectionShared::connect(const std::string& /*ip_address*/)
+{
+    position_ = ring_.read_state(inputs_, initial_states_, mock_);
+
+    boost::system::error_code ec;
+    doorbell_.open(udp::v4(), ec);
+    if (!ec) {
+        doorbell_.bind(udp::endpoint(net::ip::address_v4::loopback(), 0), ec);
+    }
+    if (ec) {
+        // Changes still arrive through poll(), just later.
+        log(LogLevel::Warning) << "Worker " << worker_ << " has no doorbell: " << ec.message();
+    } else {
+        ring_.set_doorbell(worker_, doorbell_.local_endpoint().port());
+        wait_for_doorbell();
+    }
+    return true;
+}
+
+void ATEMConnectionShared::disconnect()
+{
+    ring_.set_doorbell(worker_, 0);
+    boost::system::error_code ec;
+    doorbell_.close(ec);
+}
+
+bool ATEMConnectionShared::poll()
+{
+    return drain();
+}
+
+void ATEMConnectionShared::on_tally_change(TallyCallback callback)
+{
+    tally_callback_ = std::move(callback);
+}
+
+void ATEMConnectionShared::on_mode_change(ModeChangeCallback callback)
+{
+    mode_callback_ = std::move(callback);
+}
+
+void ATEMConnectionShared::on_inputs_change(InputsChangeCallback callback)
+{
+    inputs_callback_ = std::move(callback);
+}
+
+std::vector<InputInfo> ATEMConnectionShared::get_inputs() const
+{
+    return inputs_;
+}
+
+void ATEMConnectionShared::wait_for_doorbell()
+{
+    doorbell_.async_receive(net::buffer(doorbell_buffer_), [this](const boost::system::error_code& ec, std::size_t) {
+        if (ec == net::error::operation_aborted) {
+            return;
+        }
+        drain();
+        wait_for_doorbell();
+    });
+}
+
+bool ATEMConnectionShared::drain()
+{
+    if (!tally_callback_) {
+        return false; // The monitor hasn't started listening yet
+    }
+    bool delivered = false;
+    // The monitor pre-populates every input as off, so send the state the
+    // table held when the worker started.
+    for (const auto& state : initial_states_) {
+        if (state.program || state.preview) {
+            tally_callback_(state.to_update(mock_));
+            delivered = true;
+        }
+    }
+    initial_states_.clear();
+
+    SharedTallyRing::Record record;
+    for (;;) {
+        switch (ring_.read(position_, record)) {
+        case SharedTallyRing::ReadResult::Empty:
+            return delivered;
+        case SharedTallyRing::ReadResult::Overrun:
+            resync(false);
+            return true;
+        case SharedTallyRing::ReadResult::Ok:
+            break;
+        }
+        ++position_;
+        delivered = true;
+        if (record.kind == SharedTallyRing::Record::Kind::Inputs) {
+            resync(true);
+            return true;
+        }
+        if (record.kind == SharedTallyRing::Record::Kind::Mode) {
+            if (record.mock != mock_) {
+                mock_ = record.mock;
+                if (mode_callback_) {
+                    mode_callback_(mock_);
+                }
+            }
+            continue;
+        }
+        tally_callback_(TallyUpdate(record.input_id, record.program, record.preview, record.mock, record.short_name, record.switcher));
+    }
+}
+
+void ATEMConnectionShared::resync(bool inputs_changed)
+{
+    if (!inputs_changed) {
+        log(LogLevel::Warning) << "Worker " << worker_ << " fell behind the tally ring; resynchronizing";
+    }
+    std::vector<InputInfo> inputs;
+    std::vector<TallyState> states;
+    bool mock = false;
+    position_ = ring_.read_state(inputs, states, mock);
+    if (inputs_changed) {
+        inputs_ = std::move(inputs);
+        if (inputs_callback_) {
+            inputs_callback_();
+        }
+    }
+    if (mock != mock_) {
+        mock_ = mock;
+        if (mode_callback_) {
+            mode_callback_(mock_);
+        }
+    }
+    // Re-send every input, since any of them may have changed in the gap.
+    for (const auto& state : states) {
+        tally_callback_(state.to_update(mock_));
+    }
+    drain();
+}
+
+} // namespace atem
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "iatem_connection.h"
+#include "shared_tally_ring.h"
+#include <array>
+#include <boost/asio.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace atem {
+
+/**
+ * @class ATEMConnectionShared
+ * @brief A worker process's view of the supervisor's switchers, read from a SharedTallyRing.
+ *
+ * Reports the inputs and mode the supervisor published and replays its tally
+ * changes as if they came from one switcher; each input and change keeps the
+ * index of the switcher it came from. The supervisor wakes the worker
+ * with a datagram on a loopback port after each change; the monitor's poll,
+ * slowed to its idle rate while nothing arrives, also drains the ring in
+ * case a wake-up is lost.
+ */
+class ATEMConnectionShared final : public IATEMConnection {
+public:
+    ATEMConnectionShared(boost::asio::io_context& ioc, SharedTallyRing& ring, std::size_t worker);
+
+    bool connect(const std::string& ip_address) override;
+    void disconnect() override;
+    bool poll() override;
+    bool needs_polling() const override
+    {
+        return true; // Backstop for lost doorbells; backs off while idle
+    }
+    void on_tally_change(TallyCallback callback) override;
+    void on_mode_change(ModeChangeCallback callback) override;
+    void on_inputs_change(InputsChangeCallback callback) override;
+    bool is_mock_mode() const override
+    {
+        return mock_;
+    }
+    uint16_t get_input_count() const override
+    {
+        return static_cast<uint16_t>(inputs_.size());
+    }
+    std::vector<InputInfo> get_inputs() const override;
+
+private:
+    void wait_for_doorbell();
+    // Delivers every change published since the last call; returns whether
+    // there were any.
+    bool drain();
+    // Starts over from the supervisor's table after falling behind the ring,
+    // or when the supervisor's input list changed.
+    void resync(bool inputs_changed);
+
+    SharedTallyRing& ring_;
+    const std::size_t worker_;
+    boost::asio::ip::udp::socket doorbell_;
+    std::array<uint8_t, 16> doorbell_buffer_ {};
+    TallyCallback tally_callback_;
+    ModeChangeCallback mode_callback_;
+    InputsChangeCallback inputs_callback_;
+
+    std::vector<InputInfo> inputs_;
+    std::vector<TallyState> initial_states_; // Delivered on the first drain
+    uint64_t position_ = 0; // Next ring record to read
+    bool mock_ = false;
+};
+
+} // namespace atem
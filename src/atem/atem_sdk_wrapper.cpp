@@ -1,6 +1,7 @@
 #include "atem_sdk_wrapper.h"
-#include <iostream>
+#include "logger.h"
 #include <map>
+#include <utility>
 
 namespace atem {
 
@@ -17,6 +18,11 @@ public:
 
     ~ATEMDeviceImpl() override
     {
+        for (auto& [input, inputCallback] : m_inputCallbacks) {
+            input->RemoveCallback(inputCallback);
+            inputCallback->Release();
+            input->Release();
+        }
         if (m_switcher) {
             m_switcher->RemoveCallback(m_switcherCallback);
             m_switcher->Release();
@@ -42,6 +48,13 @@ public:
         // This could be used for periodic health checks if needed.
     }
 
+    bool needs_polling() const override
+    {
+        // The SDK calls the switcher and mix effect callbacks from its own
+        // threads.
+        return false;
+    }
+
     std::string get_product_name() const override
     {
         if (!m_switcher)
@@ -118,14 +131,33 @@ public:
         IBMDSwitcherMixEffectBlockIterator* meIterator = nullptr;
         if (m_switcher->CreateIterator(IID_IBMDSwitcherMixEffectBlockIterator, (void**)&meIterator) == S_OK) {
             IBMDSwitcherMixEffectBlock* meBlock = nullptr;
+            std::size_t index = 0;
             while (meIterator->Next(&meBlock) == S_OK) {
-                auto* meCallback = new MixEffectBlockCallback(callback, meBlock, this);
+                auto* meCallback = new MixEffectBlockCallback(callback, meBlock, index++);
                 meBlock->AddCallback(meCallback);
+                meCallback->report(); // The selection it starts with
                 meCallback->Release(); // ME Block holds a reference
                 meBlock->Release();
             }
             meIterator->Release();
         }
+
+        // And for every input, whose tally flags also light the inputs that
+        // keyers, downstream keyers and SuperSource put on air. Each input
+        // reports only its own changes.
+        IBMDSwitcherInputIterator* inputIterator = nullptr;
+        if (m_switcher->CreateIterator(IID_IBMDSwitcherInputIterator, (void**)&inputIterator) == S_OK) {
+            IBMDSwitcherInput* input = nullptr;
+            while (inputIterator->Next(&input) == S_OK) {
+                BMDSwitcherInputId inputId = 0;
+                input->GetInputId(&inputId);
+                auto* inputCallback = new InputCallback(callback, input, static_cast<uint16_t>(inputId));
+                input->AddCallback(inputCallback);
+                inputCallback->report(); // The flags it starts with
+                m_inputCallbacks.emplace_back(input, inputCallback); // Removed in the destructor
+            }
+            inputIterator->Release();
+        }
     }
 
 private:
@@ -185,6 +217,7 @@ private:
 
     IBMDSwitcher* m_switcher;
     SwitcherCallback* m_switcherCallback = nullptr;
+    std::vector<std::pair<IBMDSwitcherInput*, InputCallback*>> m_inputCallbacks;
     std::map<BMDSwitcherInputId, InputInfo> m_input_cache;
 };
 
@@ -198,12 +231,12 @@ public:
         HRESULT res = CoCreateInstance(CLSID_CBMDSwitcherDiscovery, NULL, CLSCTX_ALL, IID_IBMDSwitcherDiscovery, (void**)&m_discovery);
         if (FAILED(res)) {
             m_discovery = nullptr;
-            std::cerr << "Error: Could not create Switcher Discovery Instance.\n";
+            log(LogLevel::Error) << "Could not create Switcher Discovery Instance.";
         }
 #else
         m_discovery = CreateBMDSwitcherDiscoveryInstance();
         if (!m_discovery) {
-            std::cerr << "Error: Could not create Switcher Discovery Instance.\n";
+            log(LogLevel::Error) << "Could not create Switcher Discovery Instance.";
         }
 #endif
     }
@@ -237,7 +270,7 @@ public:
         if (res == S_OK) {
             return std::make_unique<ATEMDeviceImpl>(switcher);
         } else {
-            std::cerr << "Failed to connect to ATEM. Reason: " << failureReason << std::endl;
+            log(LogLevel::Error) << "Failed to connect to ATEM. Reason: " << failureReason;
             return nullptr;
         }
     }
@@ -335,10 +368,10 @@ HRESULT STDMETHODCALLTYPE SwitcherCallback::Notify(BMDSwitcherEventType eventTyp
     return S_OK;
 }
 
-MixEffectBlockCallback::MixEffectBlockCallback(atem::ATEMSwitcherCallback* owner, IBMDSwitcherMixEffectBlock* meBlock, atem::ATEMDevice* device)
+MixEffectBlockCallback::MixEffectBlockCallback(atem::ATEMSwitcherCallback* owner, IBMDSwitcherMixEffectBlock* meBlock, std::size_t index)
     : m_owner(owner)
     , m_meBlock(meBlock)
-    , m_device(device)
+    , m_index(index)
     , m_refCount(1) // atomic
 {
     m_meBlock->AddRef();
@@ -381,31 +414,100 @@ ULONG STDMETHODCALLTYPE MixEffectBlockCallback::Release()
 
 HRESULT STDMETHODCALLTYPE MixEffectBlockCallback::Notify(BMDSwitcherMixEffectBlockEventType eventType)
 {
-    if (eventType == bmdSwitcherMixEffectBlockEventTypeProgramInputChanged || eventType == bmdSwitcherMixEffectBlockEventTypePreviewInputChanged) {
-        if (!m_owner || !m_meBlock)
-            return S_OK;
-
-        BMDSwitcherInputId programId = 0;
-        BMDSwitcherInputId previewId = 0;
-
-        // Get the latest program and preview input IDs from our Mix Effect Block
-        m_meBlock->GetProgramInput(&programId);
-        m_meBlock->GetPreviewInput(&previewId);
-
-        // The SDK doesn't directly tell us which input *was* on air,
-        // so a full tally implementation requires iterating all inputs.
-        // However, for a simple update, we can send updates for the new sources.
-        // Note: A more robust solution would track the previous state.
-        atem::InputInfo info;
-        if (eventType == bmdSwitcherMixEffectBlockEventTypeProgramInputChanged && programId != 0) {
-            info = m_device->get_input_info(programId);
-            m_owner->on_tally_state_changed({ (uint16_t)programId, true, false, false, info.short_name });
-        }
+    if (eventType == bmdSwitcherMixEffectBlockEventTypeProgramInputChanged || eventType == bmdSwitcherMixEffectBlockEventTypePreviewInputChanged
+        || eventType == bmdSwitcherMixEffectBlockEventTypeInTransitionChanged) {
+        report();
+    }
+    return S_OK;
+}
 
-        if (eventType == bmdSwitcherMixEffectBlockEventTypePreviewInputChanged && previewId != 0) {
-            info = m_device->get_input_info(previewId);
-            m_owner->on_tally_state_changed({ (uint16_t)previewId, false, true, false, info.short_name });
-        }
+void MixEffectBlockCallback::report()
+{
+    if (!m_owner || !m_meBlock)
+        return;
+
+    // The event only says that something changed; the owner's TallyEngine
+    // works out which inputs went on or off from the whole selection.
+    BMDSwitcherInputId programId = 0;
+    BMDSwitcherInputId previewId = 0;
+#ifdef _WIN32
+    BOOL inTransition = FALSE;
+#else
+    bool inTransition = false;
+#endif
+    m_meBlock->GetProgramInput(&programId);
+    m_meBlock->GetPreviewInput(&previewId);
+    m_meBlock->GetInTransition(&inTransition);
+
+    m_owner->on_mix_effect_changed(m_index, { static_cast<uint16_t>(programId), static_cast<uint16_t>(previewId), inTransition != 0 });
+}
+
+InputCallback::InputCallback(atem::ATEMSwitcherCallback* owner, IBMDSwitcherInput* input, uint16_t inputId)
+    : m_owner(owner)
+    , m_input(input)
+    , m_inputId(inputId)
+    , m_refCount(1) // atomic
+{
+    m_input->AddRef();
+}
+InputCallback::~InputCallback()
+{
+    m_input->Release();
+}
+
+HRESULT STDMETHODCALLTYPE InputCallback::QueryInterface(REFIID iid, LPVOID* ppv)
+{
+    if (!ppv)
+        return E_POINTER;
+#ifdef _WIN32
+    if (IsEqualIID(iid, IID_IUnknown) || IsEqualIID(iid, IID_IBMDSwitcherInputCallback))
+#else
+    // On macOS, IIDs are CFUUIDRef types
+    if (CFEqual(CFUUIDRefWrapper(iid), CFUUIDRefWrapper(IID_IBMDSwitcherInputCallback)))
+#endif
+    {
+        *ppv = this;
+        AddRef();
+        return S_OK;
+    }
+    *ppv = NULL;
+    return E_NOINTERFACE;
+}
+
+ULONG STDMETHODCALLTYPE InputCallback::AddRef()
+{
+    return m_refCount.fetch_add(1) + 1;
+}
+ULONG STDMETHODCALLTYPE InputCallback::Release()
+{
+    ULONG new_ref = m_refCount.fetch_sub(1) - 1;
+    if (new_ref == 0)
+        delete this;
+    return new_ref;
+}
+
+HRESULT STDMETHODCALLTYPE InputCallback::Notify(BMDSwitcherInputEventType eventType)
+{
+    if (eventType == bmdSwitcherInputEventTypeIsProgramTalliedChanged || eventType == bmdSwitcherInputEventTypeIsPreviewTalliedChanged) {
+        report();
     }
     return S_OK;
 }
+
+void InputCallback::report()
+{
+    if (!m_owner || !m_input)
+        return;
+
+#ifdef _WIN32
+    BOOL programTallied = FALSE;
+    BOOL previewTallied = FALSE;
+#else
+    bool programTallied = false;
+    bool previewTallied = false;
+#endif
+    m_input->IsProgramTallied(&programTallied);
+    m_input->IsPreviewTallied(&previewTallied);
+
+    m_owner->on_input_tally_changed(m_inputId, programTallied != 0, previewTallied != 0);
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "iatem_connection.h"
+#include "tally_engine.h"
 #include "tally_state.h"
 #include <functional>
 #include <memory>
@@ -20,6 +21,7 @@ class IBMDSwitcherCallback;
 class IBMDSwitcherMixEffectBlockCallback;
 class IBMDSwitcherDiscovery;
 class IBMDSwitcherMixEffectBlock;
+class IBMDSwitcherInput;
 
 namespace atem {
 
@@ -32,7 +34,13 @@ namespace atem {
 class ATEMSwitcherCallback {
 public:
     virtual ~ATEMSwitcherCallback() noexcept = default;
-    virtual void on_tally_state_changed(const TallyUpdate& update) = 0;
+    // What M/E `mix_effect` has selected, after any of it changed; also
+    // called once per M/E when the callback is set. Called from SDK threads.
+    virtual void on_mix_effect_changed(std::size_t mix_effect, const MixEffectState& state) = 0;
+    // The switcher's own tally flags for one input, which also cover keyers,
+    // downstream keyers and SuperSource; after either changed, and once per
+    // input when the callback is set. Called from SDK threads.
+    virtual void on_input_tally_changed(uint16_t input_id, bool program, bool preview) = 0;
     virtual void on_disconnected() = 0;
 };
 
@@ -46,6 +54,8 @@ public:
     virtual bool connect() = 0;
     virtual void disconnect() = 0;
     virtual void poll() = 0;
+    // Whether events are only dispatched from poll().
+    virtual bool needs_polling() const = 0;
     virtual std::string get_product_name() const = 0;
     virtual uint16_t get_input_count() const = 0;
     virtual std::vector<InputInfo> get_inputs() const = 0;
@@ -97,7 +107,7 @@ private:
 
 class MixEffectBlockCallback : public IBMDSwitcherMixEffectBlockCallback {
 public:
-    MixEffectBlockCallback(atem::ATEMSwitcherCallback* owner, IBMDSwitcherMixEffectBlock* meBlock, atem::ATEMDevice* device);
+    MixEffectBlockCallback(atem::ATEMSwitcherCallback* owner, IBMDSwitcherMixEffectBlock* meBlock, std::size_t index);
     ~MixEffectBlockCallback() override; // NOLINT
 
     HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID* ppv) override;
@@ -106,9 +116,33 @@ public:
 
     HRESULT STDMETHODCALLTYPE Notify(BMDSwitcherMixEffectBlockEventType eventType) override;
 
+    // Passes the block's current selection to the owner.
+    void report();
+
 private:
     atem::ATEMSwitcherCallback* m_owner;
     IBMDSwitcherMixEffectBlock* m_meBlock;
-    atem::ATEMDevice* m_device; // Non-owning pointer to get input names
+    std::size_t m_index; // Position of the block in the switcher's M/E list
+    std::atomic<int32_t> m_refCount;
+};
+
+class InputCallback : public IBMDSwitcherInputCallback {
+public:
+    InputCallback(atem::ATEMSwitcherCallback* owner, IBMDSwitcherInput* input, uint16_t inputId);
+    ~InputCallback() override; // NOLINT
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID* ppv) override;
+    ULONG STDMETHODCALLTYPE AddRef() override;
+    ULONG STDMETHODCALLTYPE Release() override;
+
+    HRESULT STDMETHODCALLTYPE Notify(BMDSwitcherInputEventType eventType) override;
+
+    // Passes the input's current tally flags to the owner.
+    void report();
+
+private:
+    atem::ATEMSwitcherCallback* m_owner;
+    IBMDSwitcherInput* m_input;
+    uint16_t m_inputId;
     std::atomic<int32_t> m_refCount;
 };
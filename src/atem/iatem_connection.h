@@ -11,6 +11,7 @@ struct InputInfo {
     uint16_t id;
     std::string short_name;
     std::string long_name;
+    uint8_t switcher = 0; // Index of the switcher in the `atem` config array
 };
 
 struct TallyUpdate; // Forward declaration
@@ -18,13 +19,29 @@ struct TallyUpdate; // Forward declaration
 class IATEMConnection {
 public:
     using TallyCallback = std::function<void(const TallyUpdate&)>;
+    using ModeChangeCallback = std::function<void(bool is_mock)>;
+    using DisconnectCallback = std::function<void()>;
+    using InputsChangeCallback = std::function<void()>;
 
     virtual ~IATEMConnection() = default;
 
     virtual bool connect(const std::string& ip_address) = 0;
     virtual void disconnect() = 0;
-    virtual void poll() = 0;
+    // Delivers pending changes; returns whether it delivered any.
+    virtual bool poll() = 0;
+    // Whether changes only arrive through poll(). Connections that deliver
+    // them from their own timers, sockets or SDK threads are never polled.
+    [[nodiscard]] virtual bool needs_polling() const { return false; }
     virtual void on_tally_change(TallyCallback callback) = 0;
+    // For connections whose mode can change underneath them; the others
+    // never call it.
+    virtual void on_mode_change(ModeChangeCallback /*callback*/) { }
+    // For connections that can lose their switcher; called from whichever
+    // thread noticed, after the connection has disconnected itself.
+    virtual void on_disconnect(DisconnectCallback /*callback*/) { }
+    // For connections whose input list can change after connect(); called
+    // before the changes that follow it are delivered.
+    virtual void on_inputs_change(InputsChangeCallback /*callback*/) { }
     virtual bool is_mock_mode() const = 0;
     virtual uint16_t get_input_count() const = 0;
     [[nodiscard]] virtual std::vector<InputInfo> get_inputs() const = 0;
@@ -0,0 +1,106 @@
+#include "tally_engine.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
+namespace atem {
+
+std::size_t TallyEngine::update(std::size_t mix_effect, const MixEffectState& state, std::vector<Change>& changes)
+{
+    if (mix_effect >= mix_effects_.size()) {
+        mix_effects_.resize(mix_effect + 1);
+    }
+    auto& current = mix_effects_[mix_effect];
+    if (current == state) {
+        return 0; // A repeat, as when one change fires several events
+    }
+
+    // Only inputs this M/E selected before or selects now can change.
+    struct Affected {
+        uint16_t input_id;
+        Tally before;
+    };
+    std::array<Affected, 4> affected {};
+    std::size_t count = 0;
+    for (const uint16_t input_id : { current.program, current.preview, state.program, state.preview }) {
+        const auto end = affected.begin() + static_cast<std::ptrdiff_t>(count);
+        if (input_id != 0 && std::none_of(affected.begin(), end, [input_id](const Affected& a) { return a.input_id == input_id; })) {
+            affected[count++] = { input_id, tally(input_id) };
+        }
+    }
+
+    current = state;
+    const auto first = changes.size();
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto after = tally(affected[i].input_id);
+        if (after.program != affected[i].before.program || after.preview != affected[i].before.preview) {
+            changes.push_back({ affected[i].input_id, after.program, after.preview });
+        }
+    }
+
+    return changes.size() - first;
+}
+
+std::size_t TallyEngine::set_input_tally(uint16_t input_id, Tally flags, std::vector<Change>& changes)
+{
+    if (input_id == 0) {
+        return 0;
+    }
+    const auto before = tally(input_id);
+    if (flags.program || flags.preview) {
+        input_tallies_[input_id] = flags;
+    } else {
+        input_tallies_.erase(input_id);
+    }
+    const auto after = tally(input_id);
+    if (after.program == before.program && after.preview == before.preview) {
+        return 0;
+    }
+    changes.push_back({ input_id, after.program, after.preview });
+    return 1;
+}
+
+void TallyEngine::reset()
+{
+    mix_effects_.clear();
+    input_tallies_.clear();
+}
+
+TallyEngine::Tally TallyEngine::tally(uint16_t input_id) const
+{
+    Tally result;
+    if (input_id == 0) {
+        return result;
+    }
+    for (const auto& mix_effect : mix_effects_) {
+        result.program = result.program || mix_effect.program == input_id || (mix_effect.in_transition && mix_effect.preview == input_id);
+        result.preview = result.preview || mix_effect.preview == input_id;
+    }
+    if (const auto it = input_tallies_.find(input_id); it != input_tallies_.end()) {
+        result.program = result.program || it->second.program;
+        result.preview = result.preview || it->second.preview;
+    }
+    return result;
+}
+
+std::vector<TallyEngine::Change> TallyEngine::lit() const
+{
+    std::vector<Change> result;
+    const auto add = [this, &result](uint16_t input_id) {
+        if (input_id == 0 || std::any_of(result.begin(), result.end(), [input_id](const Change& c) { return c.input_id == input_id; })) {
+            return;
+        }
+        const auto state = tally(input_id);
+        result.push_back({ input_id, state.program, state.preview });
+    };
+    for (const auto& mix_effect : mix_effects_) {
+        add(mix_effect.program);
+        add(mix_effect.preview);
+    }
+    for (const auto& [input_id, flags] : input_tallies_) {
+        add(input_id);
+    }
+    return result;
+}
+
+} // namespace atem
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace atem {
+
+// What one mix effect block has selected. Input 0 is none.
+struct MixEffectState {
+    uint16_t program = 0;
+    uint16_t preview = 0;
+    // While a transition runs, the preview input is on air as well.
+    bool in_transition = false;
+
+    bool operator==(const MixEffectState&) const = default;
+};
+
+/**
+ * @class TallyEngine
+ * @brief Turns mix effect block events into per-input tally changes.
+ *
+ * The switcher reports what an M/E has selected, not which inputs stopped
+ * being on program or preview because of it, and an input's tally depends on
+ * every M/E: it is on program while any M/E has it on air, and on preview
+ * while any has it on preview. The engine keeps each M/E's selection and,
+ * for every event, reports exactly the inputs whose combined tally changed:
+ * the previous selection going off as well as the new one coming on, and
+ * nothing for an event that changes no input's tally.
+ *
+ * Keyers, downstream keyers and SuperSource boxes put inputs on air that no
+ * M/E has selected. The switcher flags those on the input itself; an input
+ * it flags is on program or preview whatever the M/Es say.
+ *
+ * Not thread-safe; the owner serializes updates.
+ */
+class TallyEngine final {
+public:
+    struct Change {
+        uint16_t input_id;
+        bool program;
+        bool preview;
+
+        bool operator==(const Change&) const = default;
+    };
+
+    struct Tally {
+        bool program = false;
+        bool preview = false;
+    };
+
+    // Records M/E `mix_effect`'s new selection and appends each input whose
+    // tally it changed to `changes`. Returns how many it appended.
+    std::size_t update(std::size_t mix_effect, const MixEffectState& state, std::vector<Change>& changes);
+
+    // Records the switcher's own tally flags for one input, and appends the
+    // input to `changes` if its tally changed. Returns how many it appended.
+    std::size_t set_input_tally(uint16_t input_id, Tally flags, std::vector<Change>& changes);
+
+    // Forgets every selection without reporting changes, as on reconnecting.
+    void reset();
+
+    [[nodiscard]] Tally tally(uint16_t input_id) const;
+    // Every input on program or preview.
+    [[nodiscard]] std::vector<Change> lit() const;
+    [[nodiscard]] const std::vector<MixEffectState>& mix_effects() const { return mix_effects_; }
+
+private:
+    std::vector<MixEffectState> mix_effects_;
+    std::unordered_map<uint16_t, Tally> input_tallies_; // Flagged inputs only
+};
+
+} // namespace atem
@@ -6,6 +6,7 @@ namespace atem {
 void tag_invoke(boost::json::value_from_tag, boost::json::value& jv, const TallyState& ts)
 {
     jv = {
+        { "switcher", ts.switcher },
         { "input", ts.input_id },
         { "short_name", ts.short_name },
         { "program", ts.program },
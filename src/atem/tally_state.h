@@ -2,6 +2,7 @@
 
 #include <boost/json.hpp>
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <mutex>
 #include <string>
@@ -10,19 +11,43 @@
 namespace atem {
 struct InputInfo; // Forward declaration
 
+// The most switchers one server monitors.
+constexpr std::size_t kMaxSwitchers = 8;
+
+// Inputs are namespaced by switcher: the index of its switcher in the `atem`
+// config array, and its input id on that switcher. Events are coalesced and
+// subscribed to by a key holding the switcher index above the 16-bit input
+// id, so the first switcher's keys are its plain input ids.
+constexpr int32_t tally_key(uint8_t switcher, uint16_t input_id)
+{
+    return static_cast<int32_t>(switcher) << 16 | input_id;
+}
+
+constexpr uint8_t tally_key_switcher(int32_t key)
+{
+    return static_cast<uint8_t>(key >> 16);
+}
+
+constexpr uint16_t tally_key_input(int32_t key)
+{
+    return static_cast<uint16_t>(key & 0xFFFF);
+}
+
 struct TallyUpdate {
     uint16_t input_id;
     bool program;
     bool preview;
     bool mock = false;
+    uint8_t switcher = 0;
 
     std::string short_name;
     TallyUpdate() = default;
-    TallyUpdate(uint16_t id, bool prog, bool prev, bool is_mock = false, std::string name = "")
+    TallyUpdate(uint16_t id, bool prog, bool prev, bool is_mock = false, std::string name = "", uint8_t switcher_index = 0)
         : input_id(id)
         , program(prog)
         , preview(prev)
         , mock(is_mock)
+        , switcher(switcher_index)
         , short_name(std::move(name))
     {
     }
@@ -36,13 +61,19 @@ struct TallyUpdate {
 
     bool operator==(const TallyUpdate& other) const noexcept
     {
-        return input_id == other.input_id && program == other.program && preview == other.preview && mock == other.mock;
+        return input_id == other.input_id && switcher == other.switcher && program == other.program && preview == other.preview
+            && mock == other.mock;
     }
 
     bool operator!=(const TallyUpdate& other) const
     {
         return !(*this == other);
     }
+
+    [[nodiscard]] int32_t key() const
+    {
+        return tally_key(switcher, input_id);
+    }
 };
 
 // Provide a serialization mapping for TallyUpdate to Boost.JSON
@@ -50,6 +81,7 @@ inline void tag_invoke(const boost::json::value_from_tag&, boost::json::value& j
 {
     jv = {
         { "type", "tally_update" },
+        { "switcher", update.switcher },
         { "input", update.input_id },
         { "short_name", update.short_name },
         { "program", update.program },
@@ -67,6 +99,8 @@ struct TallyState {
     bool program;
     bool preview;
     std::chrono::system_clock::time_point last_updated;
+    uint64_t version = 0; // State version of the last change to this input
+    uint8_t switcher = 0;
 
     TallyState() = default;
     TallyState(uint16_t id, bool prog, bool prev, std::chrono::system_clock::time_point updated)
@@ -95,7 +129,7 @@ struct TallyState {
 
     bool operator==(const TallyState& other) const noexcept
     {
-        return input_id == other.input_id && program == other.program && preview == other.preview;
+        return input_id == other.input_id && switcher == other.switcher && program == other.program && preview == other.preview;
     }
 
     bool operator!=(const TallyState& other) const
@@ -103,10 +137,15 @@ struct TallyState {
         return !(*this == other);
     }
 
+    [[nodiscard]] int32_t key() const
+    {
+        return tally_key(switcher, input_id);
+    }
+
     // Convert to TallyUpdate for broadcasting
     TallyUpdate to_update(bool is_mock = false) const
     {
-        return TallyUpdate { input_id, program, preview, is_mock, short_name };
+        return TallyUpdate { input_id, program, preview, is_mock, short_name, switcher };
     }
 };
 
@@ -0,0 +1,114 @@
+#include "cbor.h"
+#include <bit>
+#include <memory>
+
+namespace atem {
+namespace {
+
+    enum MajorType : uint8_t {
+        kUnsigned = 0,
+        kNegative = 1,
+        kTextString = 3,
+        kArray = 4,
+        kMap = 5,
+        kSimple = 7,
+    };
+
+    void append_head(MajorType type, uint64_t argument, PayloadBytes& out)
+    {
+        const auto initial = static_cast<uint8_t>(type << 5);
+        if (argument < 24) {
+            out.push_back(static_cast<uint8_t>(initial | argument));
+            return;
+        }
+        std::size_t bytes = 8;
+        uint8_t info = 27;
+        if (argument <= 0xff) {
+            bytes = 1;
+            info = 24;
+        } else if (argument <= 0xffff) {
+            bytes = 2;
+            info = 25;
+        } else if (argument <= 0xffffffff) {
+            bytes = 4;
+            info = 26;
+        }
+        out.push_back(static_cast<uint8_t>(initial | info));
+        for (std::size_t i = bytes; i > 0; --i) {
+            out.push_back(static_cast<uint8_t>(argument >> ((i - 1) * 8)));
+        }
+    }
+
+    void append_text(std::string_view text, PayloadBytes& out)
+    {
+        append_head(kTextString, text.size(), out);
+        out.insert(out.end(), text.begin(), text.end());
+    }
+
+} // namespace
+
+void append_cbor(const boost::json::value& value, PayloadBytes& out)
+{
+    switch (value.kind()) {
+    case boost::json::kind::null:
+        out.push_back(0xf6);
+        break;
+    case boost::json::kind::bool_:
+        out.push_back(value.get_bool() ? 0xf5 : 0xf4);
+        break;
+    case boost::json::kind::int64: {
+        const auto number = value.get_int64();
+        if (number >= 0) {
+            append_head(kUnsigned, static_cast<uint64_t>(number), out);
+        } else {
+            append_head(kNegative, static_cast<uint64_t>(-(number + 1)), out);
+        }
+        break;
+    }
+    case boost::json::kind::uint64:
+        append_head(kUnsigned, value.get_uint64(), out);
+        break;
+    case boost::json::kind::double_: {
+        out.push_back(static_cast<uint8_t>(kSimple << 5 | 27));
+        const auto bits = std::bit_cast<uint64_t>(value.get_double());
+        for (int i = 7; i >= 0; --i) {
+            out.push_back(static_cast<uint8_t>(bits >> (i * 8)));
+        }
+        break;
+    }
+    case boost::json::kind::string:
+        append_text(value.get_string(), out);
+        break;
+    case boost::json::kind::array:
+        append_head(kArray, value.get_array().size(), out);
+        for (const auto& item : value.get_array()) {
+            append_cbor(item, out);
+        }
+        break;
+    case boost::json::kind::object:
+        append_head(kMap, value.get_object().size(), out);
+        for (const auto& item : value.get_object()) {
+            append_text(item.key(), out);
+            append_cbor(item.value(), out);
+        }
+        break;
+    }
+}
+
+SharedPayload make_cbor_event(std::string_view event, const boost::json::value& data, uint64_t version)
+{
+    PayloadBytes out;
+    out.reserve(64);
+    append_head(kMap, version > 0 ? 3 : 2, out);
+    append_text("event", out);
+    append_text(event, out);
+    if (version > 0) {
+        append_text("id", out);
+        append_head(kUnsigned, version, out);
+    }
+    append_text("data", out);
+    append_cbor(data, out);
+    return std::make_shared<const PayloadBytes>(std::move(out));
+}
+
+} // namespace atem
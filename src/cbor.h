@@ -0,0 +1,19 @@
+#pragma once
+
+#include "sse_payload.h"
+#include <boost/json.hpp>
+#include <cstdint>
+#include <string_view>
+
+namespace atem {
+
+// Appends `value` to `out` as CBOR (RFC 8949). Objects become maps with text
+// keys, integers use the shortest encoding, doubles stay 64-bit.
+void append_cbor(const boost::json::value& value, PayloadBytes& out);
+
+// One /ws event as a CBOR map: {"event": <name>, "id": <version>, "data": <data>}.
+// The same names and fields as the SSE events; a zero version omits "id".
+// Several of these may be packed back to back into one WebSocket message.
+SharedPayload make_cbor_event(std::string_view event, const boost::json::value& data, uint64_t version = 0);
+
+} // namespace atem
@@ -1,10 +1,31 @@
 #include "config.h"
+#include "tally_state.h"
 #include <boost/json.hpp>
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <thread>
 
 namespace atem {
 
+namespace {
+
+    std::string default_switcher_id(std::size_t index)
+    {
+        return "atem" + std::to_string(index + 1);
+    }
+
+    // Ids appear in URLs and subscriptions ("atem2:3"), so they are kept to
+    // characters that need no escaping.
+    bool valid_switcher_id(const std::string& id)
+    {
+        return std::all_of(id.begin(), id.end(), [](char c) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '.' || c == '-' || c == '_';
+        });
+    }
+
+}
+
 void Config::load_from_file(gsl::czstring filename)
 {
     std::ifstream file(filename);
@@ -36,13 +57,199 @@ void Config::load_from_file(gsl::czstring filename)
             if (ws.contains("max_connections")) {
                 ws_connection_limit = static_cast<int>(ws.at("max_connections").as_int64());
             }
+            if (ws.contains("engine")) {
+                server_engine = boost::json::value_to<std::string>(ws.at("engine"));
+            }
+            if (ws.contains("io_threads")) {
+                io_threads = static_cast<unsigned int>(ws.at("io_threads").as_int64());
+            }
+            if (ws.contains("worker_processes")) {
+                worker_processes = static_cast<unsigned int>(ws.at("worker_processes").as_int64());
+            }
         }
 
-        if (root.if_contains("atem") && jv.at("atem").is_object()) {
+        if (root.if_contains("sse") && jv.at("sse").is_object()) {
+            const auto& sse = jv.at("sse").as_object();
+            if (sse.contains("queue_limit")) {
+                sse_queue_limit = static_cast<unsigned int>(sse.at("queue_limit").as_int64());
+            }
+            if (sse.contains("stall_timeout_ms")) {
+                sse_stall_timeout_ms = static_cast<unsigned int>(sse.at("stall_timeout_ms").as_int64());
+            }
+            if (sse.contains("replay_events")) {
+                sse_replay_events = static_cast<unsigned int>(sse.at("replay_events").as_int64());
+            }
+            if (sse.contains("batch_window_ms")) {
+                sse_batch_window_ms = static_cast<unsigned int>(sse.at("batch_window_ms").as_int64());
+            }
+            if (sse.contains("heartbeat_interval_ms")) {
+                sse_heartbeat_interval_ms = static_cast<unsigned int>(sse.at("heartbeat_interval_ms").as_int64());
+            }
+            if (sse.contains("dead_peer_timeout_ms")) {
+                sse_dead_peer_timeout_ms = static_cast<unsigned int>(sse.at("dead_peer_timeout_ms").as_int64());
+            }
+            if (sse.contains("compression")) {
+                sse_compression = sse.at("compression").as_bool();
+            }
+        }
+
+        if (root.if_contains("http2") && jv.at("http2").is_object()) {
+            const auto& h2 = jv.at("http2").as_object();
+            if (h2.contains("enabled")) {
+                http2_enabled = h2.at("enabled").as_bool();
+            }
+            if (h2.contains("tls_port")) {
+                http2_tls_port = static_cast<unsigned short>(h2.at("tls_port").as_int64());
+            }
+            if (h2.contains("certificate")) {
+                http2_certificate = boost::json::value_to<std::string>(h2.at("certificate"));
+            }
+            if (h2.contains("private_key")) {
+                http2_private_key = boost::json::value_to<std::string>(h2.at("private_key"));
+            }
+            if (h2.contains("max_concurrent_streams")) {
+                http2_max_concurrent_streams = static_cast<unsigned int>(h2.at("max_concurrent_streams").as_int64());
+            }
+        }
+
+        if (root.if_contains("api") && jv.at("api").is_object()) {
+            const auto& api = jv.at("api").as_object();
+            if (api.contains("long_poll_timeout_ms")) {
+                api_long_poll_timeout_ms = static_cast<unsigned int>(api.at("long_poll_timeout_ms").as_int64());
+            }
+            if (api.contains("max_long_polls")) {
+                api_max_long_polls = static_cast<unsigned int>(api.at("max_long_polls").as_int64());
+            }
+        }
+
+        if (root.if_contains("multicast") && jv.at("multicast").is_object()) {
+            const auto& mc = jv.at("multicast").as_object();
+            if (mc.contains("enabled")) {
+                multicast_enabled = mc.at("enabled").as_bool();
+            }
+            if (mc.contains("group")) {
+                multicast_group = boost::json::value_to<std::string>(mc.at("group"));
+            }
+            if (mc.contains("port")) {
+                multicast_port = static_cast<unsigned short>(mc.at("port").as_int64());
+            }
+            if (mc.contains("interface")) {
+                multicast_interface = boost::json::value_to<std::string>(mc.at("interface"));
+            }
+            if (mc.contains("ttl")) {
+                multicast_ttl = static_cast<unsigned int>(mc.at("ttl").as_int64());
+            }
+            if (mc.contains("keyframe_interval_ms")) {
+                multicast_keyframe_interval_ms = static_cast<unsigned int>(mc.at("keyframe_interval_ms").as_int64());
+            }
+            if (mc.contains("repair_history")) {
+                multicast_repair_history = static_cast<unsigned int>(mc.at("repair_history").as_int64());
+            }
+        }
+
+        if (root.if_contains("tsl") && jv.at("tsl").is_object()) {
+            const auto& tsl = jv.at("tsl").as_object();
+            if (tsl.contains("enabled")) {
+                tsl_enabled = tsl.at("enabled").as_bool();
+            }
+            if (tsl.contains("udp_destinations")) {
+                tsl_udp_destinations = boost::json::value_to<std::vector<std::string>>(tsl.at("udp_destinations"));
+            }
+            if (tsl.contains("tcp_destinations")) {
+                tsl_tcp_destinations = boost::json::value_to<std::vector<std::string>>(tsl.at("tcp_destinations"));
+            }
+            if (tsl.contains("screen")) {
+                tsl_screen = static_cast<uint16_t>(tsl.at("screen").as_int64());
+            }
+            if (tsl.contains("index_offset")) {
+                tsl_index_offset = static_cast<int>(tsl.at("index_offset").as_int64());
+            }
+            if (tsl.contains("brightness")) {
+                tsl_brightness = static_cast<unsigned int>(tsl.at("brightness").as_int64());
+            }
+            if (tsl.contains("queue_limit")) {
+                tsl_queue_limit = static_cast<unsigned int>(tsl.at("queue_limit").as_int64());
+            }
+            if (tsl.contains("refresh_interval_ms")) {
+                tsl_refresh_interval_ms = static_cast<unsigned int>(tsl.at("refresh_interval_ms").as_int64());
+            }
+        }
+
+        if (root.if_contains("atem") && jv.at("atem").is_array()) {
+            for (const auto& entry : jv.at("atem").as_array()) {
+                const auto& a = entry.as_object();
+                SwitcherConfig switcher;
+                switcher.poll_rate_ms = atem_poll_rate_ms;
+                switcher.poll_max_interval_ms = atem_poll_max_interval_ms;
+                if (a.contains("id")) {
+                    switcher.id = boost::json::value_to<std::string>(a.at("id"));
+                }
+                if (a.contains("ip_address")) {
+                    switcher.ip_address = boost::json::value_to<std::string>(a.at("ip_address"));
+                }
+                if (a.contains("poll_rate_ms")) {
+                    switcher.poll_rate_ms = static_cast<unsigned int>(a.at("poll_rate_ms").as_int64());
+                }
+                if (a.contains("poll_max_interval_ms")) {
+                    switcher.poll_max_interval_ms = static_cast<unsigned int>(a.at("poll_max_interval_ms").as_int64());
+                }
+                if (a.contains("mock")) {
+                    switcher.mock = a.at("mock").as_bool();
+                }
+                atem_switchers.push_back(std::move(switcher));
+            }
+            if (!atem_switchers.empty()) {
+                atem_ip = atem_switchers.front().ip_address;
+            }
+        } else if (root.if_contains("atem") && jv.at("atem").is_object()) {
             const auto& a = jv.at("atem").as_object();
             if (a.contains("ip_address")) {
                 atem_ip = boost::json::value_to<std::string>(a.at("ip_address"));
             }
+            if (a.contains("poll_rate_ms")) {
+                atem_poll_rate_ms = static_cast<unsigned int>(a.at("poll_rate_ms").as_int64());
+            }
+            if (a.contains("poll_max_interval_ms")) {
+                atem_poll_max_interval_ms = static_cast<unsigned int>(a.at("poll_max_interval_ms").as_int64());
+            }
+        }
+
+        if (root.if_contains("logging") && jv.at("logging").is_object()) {
+            const auto& lg = jv.at("logging").as_object();
+            if (lg.contains("level")) {
+                log_level = boost::json::value_to<std::string>(lg.at("level"));
+            }
+            if (lg.contains("console_output")) {
+                log_console = lg.at("console_output").as_bool();
+            }
+            if (lg.contains("file_output")) {
+                log_file_output = lg.at("file_output").as_bool();
+            }
+            if (lg.contains("log_file")) {
+                log_file = boost::json::value_to<std::string>(lg.at("log_file"));
+            }
+            if (lg.contains("format")) {
+                log_format = boost::json::value_to<std::string>(lg.at("format"));
+            }
+            if (lg.contains("queue_size")) {
+                log_queue_size = static_cast<unsigned int>(lg.at("queue_size").as_int64());
+            }
+        }
+
+        if (root.if_contains("threads") && jv.at("threads").is_object()) {
+            const auto& th = jv.at("threads").as_object();
+            if (th.contains("io_threads")) {
+                io_threads = static_cast<unsigned int>(th.at("io_threads").as_int64());
+            }
+            if (th.contains("io_cpus")) {
+                io_cpus = boost::json::value_to<std::vector<int>>(th.at("io_cpus"));
+            }
+            if (th.contains("event_cpu")) {
+                event_cpu = static_cast<int>(th.at("event_cpu").as_int64());
+            }
+            if (th.contains("lag_probe_interval_ms")) {
+                lag_probe_interval_ms = static_cast<unsigned int>(th.at("lag_probe_interval_ms").as_int64());
+            }
         }
 
         if (root.if_contains("mock_mode") && jv.at("mock_mode").is_object()) {
@@ -65,6 +272,130 @@ void Config::load_from_file(gsl::czstring filename)
         std::cerr << "Warning: Error reading values from config file: " << e.what() << "\n";
     }
 
+    if (!is_known_engine(server_engine)) {
+        std::cerr << "Warning: unknown websocket.engine '" << server_engine << "'; defaulting to restbed\n";
+        server_engine = "restbed";
+    }
+
+    if (worker_processes > 64) {
+        std::cerr << "Warning: websocket.worker_processes " << worker_processes << " is above the limit of 64; using 64\n";
+        worker_processes = 64;
+    }
+    resolve_engine();
+    if (http2_enabled && http2_tls_port != 0 && (http2_certificate.empty() || http2_private_key.empty())) {
+        std::cerr << "Warning: http2.tls_port needs http2.certificate and http2.private_key; serving h2c only\n";
+        http2_tls_port = 0;
+    }
+    if (http2_max_concurrent_streams == 0) {
+        std::cerr << "Warning: http2.max_concurrent_streams is 0; defaulting to 100\n";
+        http2_max_concurrent_streams = 100;
+    }
+
+    if (sse_queue_limit == 0) {
+        std::cerr << "Warning: sse.queue_limit is 0; defaulting to 256\n";
+        sse_queue_limit = 256;
+    }
+    if (sse_stall_timeout_ms == 0) {
+        std::cerr << "Warning: sse.stall_timeout_ms is 0; defaulting to 10000\n";
+        sse_stall_timeout_ms = 10000;
+    }
+    if (sse_batch_window_ms > 5) {
+        std::cerr << "Warning: sse.batch_window_ms " << sse_batch_window_ms << " is above the 5 ms limit; using 5\n";
+        sse_batch_window_ms = 5;
+    }
+
+    if (api_long_poll_timeout_ms == 0) {
+        std::cerr << "Warning: api.long_poll_timeout_ms is 0; defaulting to 30000\n";
+        api_long_poll_timeout_ms = 30000;
+    }
+
+    if (atem_poll_rate_ms == 0) {
+        std::cerr << "Warning: atem.poll_rate_ms is 0; defaulting to 16\n";
+        atem_poll_rate_ms = 16;
+    }
+    if (atem_poll_max_interval_ms < atem_poll_rate_ms) {
+        std::cerr << "Warning: atem.poll_max_interval_ms is below atem.poll_rate_ms; using " << atem_poll_rate_ms << "\n";
+        atem_poll_max_interval_ms = atem_poll_rate_ms;
+    }
+
+    if (log_level != "debug" && log_level != "info" && log_level != "warning" && log_level != "error") {
+        std::cerr << "Warning: unknown logging.level '" << log_level << "'; defaulting to info\n";
+        log_level = "info";
+    }
+    if (log_format != "text" && log_format != "json") {
+        std::cerr << "Warning: unknown logging.format '" << log_format << "'; defaulting to text\n";
+        log_format = "text";
+    }
+    if (log_file_output && log_file.empty()) {
+        std::cerr << "Warning: logging.file_output needs logging.log_file; logging to the console only\n";
+        log_file_output = false;
+    }
+    if (log_queue_size < 64) {
+        std::cerr << "Warning: logging.queue_size " << log_queue_size << " is below 64; using 64\n";
+        log_queue_size = 64;
+    }
+
+    const auto cpu_count = static_cast<int>(std::thread::hardware_concurrency());
+    const auto valid_cpu = [cpu_count](int cpu) { return cpu >= 0 && (cpu_count == 0 || cpu < cpu_count); };
+    if (std::any_of(io_cpus.begin(), io_cpus.end(), [&valid_cpu](int cpu) { return !valid_cpu(cpu); })) {
+        std::cerr << "Warning: threads.io_cpus lists CPUs this machine does not have; ignoring them\n";
+        io_cpus.erase(std::remove_if(io_cpus.begin(), io_cpus.end(), [&valid_cpu](int cpu) { return !valid_cpu(cpu); }), io_cpus.end());
+    }
+    if (event_cpu != -1 && !valid_cpu(event_cpu)) {
+        std::cerr << "Warning: threads.event_cpu " << event_cpu << " does not exist; not pinning the event thread\n";
+        event_cpu = -1;
+    }
+    if (event_cpu != -1 && std::find(io_cpus.begin(), io_cpus.end(), event_cpu) != io_cpus.end()) {
+        std::cerr << "Warning: threads.io_cpus includes threads.event_cpu; the event thread shares its CPU\n";
+    }
+
+    if (atem_switchers.size() > kMaxSwitchers) {
+        std::cerr << "Warning: atem lists " << atem_switchers.size() << " switchers; only the first " << kMaxSwitchers
+                  << " are monitored\n";
+        atem_switchers.resize(kMaxSwitchers);
+    }
+    // The ids the config names are checked first, so a default never takes
+    // one of them: [{"id":"atem2"},{}] becomes atem2 and atem3.
+    std::vector<std::string> rejected(atem_switchers.size());
+    for (std::size_t i = 0; i < atem_switchers.size(); ++i) {
+        auto& switcher = atem_switchers[i];
+        const auto duplicate = std::any_of(atem_switchers.begin(), atem_switchers.begin() + static_cast<std::ptrdiff_t>(i),
+            [&switcher](const SwitcherConfig& other) { return other.id == switcher.id; });
+        if (!switcher.id.empty() && (duplicate || !valid_switcher_id(switcher.id))) {
+            rejected[i] = std::move(switcher.id);
+            switcher.id.clear();
+        }
+    }
+    const auto taken = [this](const std::string& id) {
+        return std::any_of(atem_switchers.begin(), atem_switchers.end(), [&id](const SwitcherConfig& other) { return other.id == id; });
+    };
+    for (std::size_t i = 0; i < atem_switchers.size(); ++i) {
+        auto& switcher = atem_switchers[i];
+        if (switcher.id.empty()) {
+            auto n = i;
+            while (taken(default_switcher_id(n))) {
+                ++n;
+            }
+            switcher.id = default_switcher_id(n);
+        }
+        if (!rejected[i].empty()) {
+            std::cerr << "Warning: atem[" << i << "].id '" << rejected[i] << "' is a duplicate or not made of letters, digits, '.', '-' and '_'; using "
+                      << switcher.id << "\n";
+        }
+    }
+    for (std::size_t i = 0; i < atem_switchers.size(); ++i) {
+        auto& switcher = atem_switchers[i];
+        if (switcher.poll_rate_ms == 0) {
+            std::cerr << "Warning: atem[" << i << "].poll_rate_ms is 0; defaulting to 16\n";
+            switcher.poll_rate_ms = 16;
+        }
+        if (switcher.poll_max_interval_ms < switcher.poll_rate_ms) {
+            std::cerr << "Warning: atem[" << i << "].poll_max_interval_ms is below its poll_rate_ms; using " << switcher.poll_rate_ms
+                      << "\n";
+            switcher.poll_max_interval_ms = switcher.poll_rate_ms;
+        }
+    }
+
     // Validate mock inputs
     if (mock_inputs == 0) {
         std::cerr << "Warning: mock_mode.num_inputs is 0; defaulting to 8\n";
@@ -72,4 +403,32 @@ void Config::load_from_file(gsl::czstring filename)
     }
 }
 
+bool Config::is_known_engine(std::string_view engine)
+{
+    return engine == "restbed" || engine == "asio";
+}
+
+void Config::resolve_engine()
+{
+    if (worker_processes > 0 && server_engine != "asio") {
+        // Only the Asio engine can bind its port with SO_REUSEPORT.
+        std::cerr << "Warning: websocket.worker_processes needs the asio engine; switching to it\n";
+        server_engine = "asio";
+    }
+    if (http2_enabled && server_engine != "asio") {
+        std::cerr << "Warning: http2.enabled needs the asio engine; switching to it\n";
+        server_engine = "asio";
+    }
+}
+
+std::vector<SwitcherConfig> Config::switchers() const
+{
+    if (atem_switchers.empty()) {
+        return { SwitcherConfig { default_switcher_id(0), atem_ip, atem_poll_rate_ms, atem_poll_max_interval_ms, false } };
+    }
+    auto switchers = atem_switchers;
+    switchers.front().ip_address = atem_ip;
+    return switchers;
+}
+
 } // namespace atem
@@ -3,17 +3,86 @@
 #include <cstdint>
 #include <gsl/gsl>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace atem {
 
+// One entry of the `atem` array.
+struct SwitcherConfig {
+    std::string id; // Names the switcher in events and subscriptions; defaults to "atem1", "atem2", ...
+    std::string ip_address;
+    unsigned int poll_rate_ms = 16;
+    unsigned int poll_max_interval_ms = 1000;
+    bool mock = false; // Always a mock switcher, whatever mock_mode.enabled says
+};
+
 struct Config {
     // WebSocket settings
     std::string ws_address = "0.0.0.0";
     unsigned short ws_port = 8080;
     int ws_connection_limit = 100;
+    std::string server_engine = "restbed"; // "restbed" or "asio"
+    unsigned int io_threads = 0; // HTTP I/O threads (either engine); 0 = one per hardware thread
+    unsigned int worker_processes = 0; // Serve HTTP from this many forked processes (asio engine); 0 = off
+
+    // SSE stream settings
+    unsigned int sse_queue_limit = 256; // Pending events per client before coalescing
+    unsigned int sse_stall_timeout_ms = 10000; // Evict clients whose writes stall this long
+    unsigned int sse_replay_events = 1024; // Recent events kept for Last-Event-ID resume
+    unsigned int sse_batch_window_ms = 0; // Merge tally changes within this window (0-5 ms); 0 = off
+    unsigned int sse_heartbeat_interval_ms = 15000; // Comment sent to idle streams; 0 = off
+    unsigned int sse_dead_peer_timeout_ms = 30000; // Reap streams whose peer stops acknowledging
+    bool sse_compression = false; // gzip/deflate event streams for clients that accept them
+
+    // HTTP/2 (asio engine)
+    bool http2_enabled = false; // h2c with prior knowledge on the main port, h2 on the TLS port
+    unsigned short http2_tls_port = 8443; // HTTPS listener offering h2 and http/1.1; 0 = off
+    std::string http2_certificate; // PEM certificate chain for the TLS port
+    std::string http2_private_key; // PEM private key for the TLS port
+    unsigned int http2_max_concurrent_streams = 100; // Open streams per HTTP/2 connection
+
+    // /api/tally polling API
+    unsigned int api_long_poll_timeout_ms = 30000; // Longest a ?since= request is held open
+    unsigned int api_max_long_polls = 1024; // Parked ?since= requests before new ones get a 503
+
+    // Multicast tally output for hardware receivers
+    bool multicast_enabled = false;
+    std::string multicast_group = "239.255.84.1";
+    unsigned short multicast_port = 9920;
+    std::string multicast_interface; // Local address to send from; empty = the default route
+    unsigned int multicast_ttl = 1; // Stays on the local subnet by default
+    unsigned int multicast_keyframe_interval_ms = 1000; // Full state sent this often; 0 = only on mode changes
+    unsigned int multicast_repair_history = 1024; // Recent deltas kept for NACK repair
+
+    // TSL UMD v5.0 output to tally controllers and multiviewers
+    bool tsl_enabled = false;
+    std::vector<std::string> tsl_udp_destinations; // "host:port"
+    std::vector<std::string> tsl_tcp_destinations; // "host:port"; connected to and kept open
+    uint16_t tsl_screen = 0;
+    int tsl_index_offset = 0; // Display index = input id + offset
+    unsigned int tsl_brightness = 3; // 0-3
+    unsigned int tsl_queue_limit = 256; // Queued changes, and packets per TCP connection
+    unsigned int tsl_refresh_interval_ms = 1000; // Full state resent this often; 0 = off
 
     // ATEM settings
     std::string atem_ip = "192.168.1.100";
+    unsigned int atem_poll_rate_ms = 16; // Poll interval while changes arrive, for connections that need polling
+    unsigned int atem_poll_max_interval_ms = 1000; // Idle polls back off to this
+    std::vector<SwitcherConfig> atem_switchers; // From an `atem` array; empty = the single switcher above
+
+    // Logging
+    std::string log_level = "info"; // "debug", "info", "warning" or "error"
+    bool log_console = true; // Debug and info to stdout, warnings and errors to stderr
+    bool log_file_output = false;
+    std::string log_file = "logs/atem_tally_server.log"; // Appended to
+    std::string log_format = "text"; // "text" or "json" (one object per line)
+    unsigned int log_queue_size = 4096; // Lines buffered for the writer; more are dropped and counted
+
+    // Threads
+    std::vector<int> io_cpus; // Pin the Asio engine's I/O threads to these CPUs, round robin; empty = not pinned
+    int event_cpu = -1; // Pin the event thread (monitor, tally path, sinks) to this CPU; -1 = not pinned
+    unsigned int lag_probe_interval_ms = 0; // How often each thread pool measures its event loop lag; 0 = off
 
     // Mock mode settings
     bool mock_enabled = false;
@@ -23,6 +92,17 @@ struct Config {
 
     // Load configuration from a JSON file
     void load_from_file(gsl::czstring filename);
+
+    // Whether `engine` names an HTTP/SSE engine ("restbed" or "asio")
+    [[nodiscard]] static bool is_known_engine(std::string_view engine);
+
+    // Switch to the Asio engine when a setting needs it. Run again after
+    // --engine overrides the file.
+    void resolve_engine();
+
+    // The switchers to monitor, in index order. The first one's address is
+    // atem_ip, so --atem-ip overrides it.
+    [[nodiscard]] std::vector<SwitcherConfig> switchers() const;
 };
 
 } // namespace atem
@@ -0,0 +1,41 @@
+#include "event_ring.h"
+#include <utility>
+
+namespace atem {
+
+EventRing::EventRing(std::size_t capacity)
+    : capacity_(capacity)
+{
+}
+
+void EventRing::push(int32_t coalesce_key, SharedPayload payload)
+{
+    const std::scoped_lock lock(mutex_);
+    ++pushed_;
+    if (capacity_ == 0) {
+        return;
+    }
+    if (entries_.size() == capacity_) {
+        entries_.pop_front();
+    }
+    entries_.push_back({ coalesce_key, std::move(payload) });
+}
+
+std::optional<uint64_t> EventRing::events_after(uint64_t position, std::vector<Entry>& out) const
+{
+    const std::scoped_lock lock(mutex_);
+    const auto first = pushed_ - entries_.size(); // Position before the oldest entry
+    if (position < first || position > pushed_) {
+        return std::nullopt;
+    }
+    out.insert(out.end(), entries_.begin() + static_cast<std::ptrdiff_t>(position - first), entries_.end());
+    return pushed_;
+}
+
+uint64_t EventRing::pushed() const
+{
+    const std::scoped_lock lock(mutex_);
+    return pushed_;
+}
+
+} // namespace atem
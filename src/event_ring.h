@@ -0,0 +1,58 @@
+#pragma once
+
+#include "sse_payload.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace atem {
+
+/**
+ * @class EventRing
+ * @brief A bounded history of recently broadcast events, for Last-Event-ID resume.
+ *
+ * Events are stored already framed, in the order they were pushed, and are
+ * identified by their position in that order: the nth event pushed is at
+ * position n. Changes from different switchers can be pushed out of version
+ * order, so positions, not versions, tell what a client has seen. A
+ * reconnecting client that last saw position P is sent every stored event
+ * after P, as long as none of them has been evicted yet.
+ *
+ * A new client is likewise sent the state as of some position, catches up on
+ * the events pushed after it, and is registered for live events once nothing
+ * more has been pushed.
+ */
+class EventRing final {
+public:
+    struct Entry {
+        int32_t coalesce_key; // Input id of a tally update, or OutboundQueue::kNoCoalesceKey
+        SharedPayload payload;
+    };
+
+    explicit EventRing(std::size_t capacity);
+
+    // Stores an event at position pushed() + 1. Callers that frame the
+    // position into the event must read pushed() under the same lock.
+    void push(int32_t coalesce_key, SharedPayload payload);
+
+    // Appends the events pushed after position `position` to `out` and
+    // returns the position of the newest. Returns nothing when some of them
+    // have already been evicted, or `position` is unknown, in which case the
+    // client needs a full snapshot instead.
+    std::optional<uint64_t> events_after(uint64_t position, std::vector<Entry>& out) const;
+
+    // Position of the newest event; 0 before the first.
+    [[nodiscard]] uint64_t pushed() const;
+
+private:
+    const std::size_t capacity_;
+
+    mutable std::mutex mutex_;
+    std::deque<Entry> entries_;
+    uint64_t pushed_ = 0;
+};
+
+} // namespace atem
@@ -0,0 +1,523 @@
+#include "http2_connection.h"
+#include "config.h"
+#include <algorithm>
+#include <array>
+#include <boost/asio/ssl.hpp>
+#include <cctype>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <nghttp2/nghttp2.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace atem {
+namespace {
+
+    namespace net = boost::asio;
+    using tcp = net::ip::tcp;
+
+    // Most bytes of frames gathered into one socket write.
+    constexpr std::size_t kMaxWriteBytes = 64 * 1024;
+
+    // Headers that only mean something on an HTTP/1.1 connection; HTTP/2
+    // forbids them. Content-Length is recomputed from the body.
+    bool is_connection_header(std::string_view name)
+    {
+        return name == "connection" || name == "keep-alive" || name == "proxy-connection" || name == "transfer-encoding"
+            || name == "upgrade" || name == "content-length";
+    }
+
+    std::string to_lower(std::string_view s)
+    {
+        std::string out(s);
+        std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return out;
+    }
+
+    /**
+     * One HTTP/2 connection. Every request is a stream on it; an /events
+     * stream stays open and is handed to the HttpHandler as an SseClient, so
+     * any number of them share the connection. All nghttp2 calls happen on
+     * the connection's strand.
+     */
+    template <typename Stream>
+    class Http2Connection final : public std::enable_shared_from_this<Http2Connection<Stream>> {
+    public:
+        Http2Connection(Stream stream, const Config& config, HttpHandler& handler, std::atomic<std::size_t>& connections,
+            Http2Counters& counters)
+            : stream_(std::move(stream))
+            , config_(config)
+            , handler_(handler)
+            , connections_(connections)
+            , counters_(counters)
+        {
+            boost::system::error_code ec;
+            const auto remote = stream_.lowest_layer().remote_endpoint(ec);
+            remote_address_ = remote.address().to_string() + ":" + std::to_string(remote.port());
+            connections_.fetch_add(1, std::memory_order_relaxed);
+            counters_.connections.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        ~Http2Connection()
+        {
+            if (session_) {
+                nghttp2_session_del(session_);
+            }
+            counters_.connections.fetch_sub(1, std::memory_order_relaxed);
+            connections_.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        Http2Connection(const Http2Connection&) = delete;
+        Http2Connection& operator=(const Http2Connection&) = delete;
+        Http2Connection(Http2Connection&&) = delete;
+        Http2Connection& operator=(Http2Connection&&) = delete;
+
+        void start(std::string_view received)
+        {
+            nghttp2_session_callbacks* callbacks = nullptr;
+            if (nghttp2_session_callbacks_new(&callbacks) != 0) {
+                shutdown();
+                return;
+            }
+            nghttp2_session_callbacks_set_on_begin_headers_callback(callbacks, &Http2Connection::on_begin_headers);
+            nghttp2_session_callbacks_set_on_header_callback(callbacks, &Http2Connection::on_header);
+            nghttp2_session_callbacks_set_on_frame_recv_callback(callbacks, &Http2Connection::on_frame_recv);
+            nghttp2_session_callbacks_set_on_stream_close_callback(callbacks, &Http2Connection::on_stream_close);
+            const int rv = nghttp2_session_server_new(&session_, callbacks, this);
+            nghttp2_session_callbacks_del(callbacks);
+            if (rv != 0) {
+                session_ = nullptr;
+                shutdown();
+                return;
+            }
+
+            const std::array<nghttp2_settings_entry, 1> settings { {
+                { NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS, config_.http2_max_concurrent_streams },
+            } };
+            nghttp2_submit_settings(session_, NGHTTP2_FLAG_NONE, settings.data(), settings.size());
+            if (!received.empty() && !receive(received.data(), received.size())) {
+                return;
+            }
+            flush();
+            read();
+        }
+
+    private:
+        /**
+         * One request. Its response body, or the events of an event stream,
+         * are queued as shared payloads and copied into DATA frames as the
+         * peer's flow-control window allows.
+         */
+        class H2Stream final : public SseClient, public std::enable_shared_from_this<H2Stream> {
+        public:
+            H2Stream(int32_t id, std::weak_ptr<Http2Connection> connection, std::string remote, const Config& config)
+                : id_(id)
+                , connection_(std::move(connection))
+                , remote_(std::move(remote))
+                , queue_(config.sse_queue_limit, std::chrono::milliseconds(config.sse_stall_timeout_ms))
+            {
+            }
+
+            bool send(const SharedPayload& payload, int32_t coalesce_key, OutboundQueue::Clock::time_point now) override
+            {
+                if (!is_open()) {
+                    return true; // Already closing; nothing to evict.
+                }
+                switch (queue_.push(payload, coalesce_key, now)) {
+                case OutboundQueue::PushResult::Started:
+                    if (const auto connection = connection_.lock()) {
+                        net::post(connection->stream_.get_executor(), [connection, self = this->shared_from_this(), payload]() {
+                            connection->start_data(self, payload);
+                        });
+                    }
+                    return true;
+                case OutboundQueue::PushResult::Queued:
+                    return true;
+                case OutboundQueue::PushResult::Stalled:
+                    return false;
+                }
+                return true;
+            }
+
+            void close() override
+            {
+                if (const auto connection = connection_.lock()) {
+                    net::post(connection->stream_.get_executor(), [connection, self = this->shared_from_this()]() {
+                        connection->reset_stream(*self);
+                    });
+                }
+            }
+
+            bool is_open() const override
+            {
+                return open_.load(std::memory_order_acquire);
+            }
+
+            OutboundQueue::Stats queue_stats() const override
+            {
+                return queue_.stats();
+            }
+
+            std::string remote_address() const override
+            {
+                return remote_;
+            }
+
+            // Payload bytes are copied into the connection's DATA frames.
+            bool copies_payload() const override
+            {
+                return true;
+            }
+
+        private:
+            friend class Http2Connection;
+
+            // Fills a DATA frame from the payload being sent, moving on to the
+            // next queued one when it is used up.
+            static nghttp2_ssize read_data(nghttp2_session* /*session*/, int32_t /*stream_id*/, uint8_t* buf, std::size_t length,
+                uint32_t* data_flags, nghttp2_data_source* source, void* /*user_data*/)
+            {
+                auto& stream = *static_cast<H2Stream*>(source->ptr);
+                std::size_t copied = 0;
+                while (stream.current_ && copied < length) {
+                    const auto n = std::min(length - copied, stream.current_->size() - stream.offset_);
+                    std::memcpy(buf + copied, stream.current_->data() + stream.offset_, n);
+                    copied += n;
+                    stream.offset_ += n;
+                    if (stream.offset_ == stream.current_->size()) {
+                        stream.offset_ = 0;
+                        if (stream.streaming_) {
+                            stream.current_ = stream.queue_.complete_write();
+                        } else {
+                            stream.current_.reset();
+                            *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+                        }
+                    }
+                }
+                if (copied == 0 && (*data_flags & NGHTTP2_DATA_FLAG_EOF) == 0) {
+                    return NGHTTP2_ERR_DEFERRED; // Resumed by start_data()
+                }
+                return static_cast<nghttp2_ssize>(copied);
+            }
+
+            const int32_t id_;
+            const std::weak_ptr<Http2Connection> connection_;
+            const std::string remote_;
+            OutboundQueue queue_;
+            std::atomic<bool> open_ { true };
+
+            // Strand-only state.
+            HttpRequest request_;
+            bool streaming_ = false;
+            SharedPayload current_;
+            std::size_t offset_ = 0;
+        };
+
+        void read()
+        {
+            stream_.async_read_some(net::buffer(read_buffer_), [self = this->shared_from_this()](const boost::system::error_code& ec, std::size_t length) {
+                if (ec) {
+                    self->shutdown();
+                    return;
+                }
+                if (self->receive(self->read_buffer_.data(), length)) {
+                    self->read();
+                }
+            });
+        }
+
+        bool receive(const char* data, std::size_t length)
+        {
+            if (nghttp2_session_mem_recv2(session_, reinterpret_cast<const uint8_t*>(data), length) < 0) {
+                shutdown();
+                return false;
+            }
+            flush();
+            return open_;
+        }
+
+        // Writes whatever frames nghttp2 has ready. One write is in flight at
+        // a time; its completion picks up anything queued meanwhile.
+        void flush()
+        {
+            if (writing_ || !open_) {
+                return;
+            }
+            write_buffer_.clear();
+            while (write_buffer_.size() < kMaxWriteBytes) {
+                const uint8_t* data = nullptr;
+                const auto length = nghttp2_session_mem_send2(session_, &data);
+                if (length < 0) {
+                    shutdown();
+                    return;
+                }
+                if (length == 0) {
+                    break;
+                }
+                write_buffer_.insert(write_buffer_.end(), data, data + length);
+            }
+            if (write_buffer_.empty()) {
+                if (nghttp2_session_want_read(session_) == 0 && nghttp2_session_want_write(session_) == 0) {
+                    shutdown(); // GOAWAY exchanged and every stream finished
+                }
+                return;
+            }
+            writing_ = true;
+            net::async_write(stream_, net::buffer(write_buffer_), [self = this->shared_from_this()](const boost::system::error_code& ec, std::size_t) {
+                self->writing_ = false;
+                if (ec) {
+                    self->shutdown();
+                    return;
+                }
+                self->flush();
+            });
+        }
+
+        void dispatch(const std::shared_ptr<H2Stream>& stream)
+        {
+            const auto& request = stream->request_;
+            if (request.method != "GET") {
+                respond(*stream, { 405, { { "Allow", "GET" } }, {} });
+                return;
+            }
+            if (handler_.is_event_stream(request)) {
+                open_event_stream(stream);
+                return;
+            }
+            if (handler_.is_websocket(request)) {
+                // No extended CONNECT; browsers fall back to an HTTP/1.1 connection.
+                respond(*stream, { 426, { { "Content-Type", "text/plain" } }, "WebSockets are served over HTTP/1.1" });
+                return;
+            }
+            if (handler_.is_deferred(request)) {
+                handler_.handle_deferred(request, [weak = this->weak_from_this(), stream](HttpResponse response) {
+                    if (const auto self = weak.lock()) {
+                        net::post(self->stream_.get_executor(), [self, stream, response = std::move(response)]() mutable {
+                            if (stream->is_open()) {
+                                self->respond(*stream, std::move(response));
+                                self->flush();
+                            }
+                        });
+                    }
+                });
+                return;
+            }
+            respond(*stream, handler_.handle_request(request));
+        }
+
+        void open_event_stream(const std::shared_ptr<H2Stream>& stream)
+        {
+            std::vector<std::pair<std::string, std::string>> headers {
+                { ":status", "200" },
+                { "content-type", "text/event-stream" },
+                { "cache-control", "no-cache" },
+            };
+            if (const auto encoding = handler_.event_stream_encoding(stream->request_); !encoding.empty()) {
+                headers.emplace_back("content-encoding", encoding);
+                headers.emplace_back("vary", "Accept-Encoding");
+            }
+            stream->streaming_ = true;
+            if (!submit(*stream, headers, true)) {
+                return;
+            }
+            handler_.open_event_stream(stream, stream->request_);
+        }
+
+        void respond(H2Stream& stream, HttpResponse response)
+        {
+            std::vector<std::pair<std::string, std::string>> headers { { ":status", std::to_string(response.status) } };
+            for (const auto& [name, value] : response.headers) {
+                auto lower = to_lower(name);
+                if (!is_connection_header(lower)) {
+                    headers.emplace_back(std::move(lower), value);
+                }
+            }
+            const bool has_body = response.status != 204 && response.status != 304;
+            if (has_body) {
+                headers.emplace_back("content-length", std::to_string(response.body.size()));
+            }
+            if (has_body && !response.body.empty()) {
+                stream.current_ = std::make_shared<const PayloadBytes>(response.body.begin(), response.body.end());
+                stream.offset_ = 0;
+            }
+            submit(stream, headers, stream.current_ != nullptr);
+        }
+
+        bool submit(H2Stream& stream, const std::vector<std::pair<std::string, std::string>>& headers, bool with_data)
+        {
+            std::vector<nghttp2_nv> nva;
+            nva.reserve(headers.size());
+            for (const auto& [name, value] : headers) {
+                // nghttp2 copies the names and values.
+                nva.push_back({ reinterpret_cast<uint8_t*>(const_cast<char*>(name.data())), // NOLINT(cppcoreguidelines-pro-type-const-cast)
+                    reinterpret_cast<uint8_t*>(const_cast<char*>(value.data())), // NOLINT(cppcoreguidelines-pro-type-const-cast)
+                    name.size(), value.size(), NGHTTP2_NV_FLAG_NONE });
+            }
+            nghttp2_data_provider2 provider {};
+            provider.source.ptr = &stream;
+            provider.read_callback = &H2Stream::read_data;
+            if (nghttp2_submit_response2(session_, stream.id_, nva.data(), nva.size(), with_data ? &provider : nullptr) != 0) {
+                nghttp2_submit_rst_stream(session_, NGHTTP2_FLAG_NONE, stream.id_, NGHTTP2_INTERNAL_ERROR);
+                return false;
+            }
+            return true;
+        }
+
+        // The first payload queued on an idle event stream.
+        void start_data(const std::shared_ptr<H2Stream>& stream, const SharedPayload& payload)
+        {
+            if (!stream->is_open()) {
+                return;
+            }
+            stream->current_ = payload;
+            stream->offset_ = 0;
+            nghttp2_session_resume_data(session_, stream->id_);
+            flush();
+        }
+
+        void reset_stream(const H2Stream& stream)
+        {
+            if (!open_ || !stream.is_open()) {
+                return;
+            }
+            nghttp2_submit_rst_stream(session_, NGHTTP2_FLAG_NONE, stream.id_, NGHTTP2_CANCEL);
+            flush();
+        }
+
+        void close_stream(H2Stream& stream)
+        {
+            stream.open_.store(false, std::memory_order_release);
+            stream.queue_.clear();
+            stream.current_.reset();
+        }
+
+        void shutdown()
+        {
+            if (!open_.exchange(false, std::memory_order_acq_rel)) {
+                return;
+            }
+            boost::system::error_code ignored;
+            stream_.lowest_layer().shutdown(tcp::socket::shutdown_both, ignored);
+            stream_.lowest_layer().close(ignored);
+            const auto streams = std::exchange(streams_, {});
+            counters_.streams.fetch_sub(streams.size(), std::memory_order_relaxed);
+            for (const auto& [id, stream] : streams) {
+                close_stream(*stream);
+                if (stream->streaming_) {
+                    handler_.close_event_stream(stream);
+                }
+            }
+        }
+
+        static Http2Connection& self_of(void* user_data)
+        {
+            return *static_cast<Http2Connection*>(user_data);
+        }
+
+        static int on_begin_headers(nghttp2_session* session, const nghttp2_frame* frame, void* user_data)
+        {
+            if (frame->hd.type != NGHTTP2_HEADERS || frame->headers.cat != NGHTTP2_HCAT_REQUEST) {
+                return 0;
+            }
+            auto& self = self_of(user_data);
+            auto stream = std::make_shared<H2Stream>(frame->hd.stream_id, self.weak_from_this(), self.remote_address_, self.config_);
+            nghttp2_session_set_stream_user_data(session, frame->hd.stream_id, stream.get());
+            self.streams_.emplace(frame->hd.stream_id, std::move(stream));
+            self.counters_.streams.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+        }
+
+        static int on_header(nghttp2_session* session, const nghttp2_frame* frame, const uint8_t* name, std::size_t name_length,
+            const uint8_t* value, std::size_t value_length, uint8_t /*flags*/, void* /*user_data*/)
+        {
+            if (frame->hd.type != NGHTTP2_HEADERS || frame->headers.cat != NGHTTP2_HCAT_REQUEST) {
+                return 0;
+            }
+            auto* stream = static_cast<H2Stream*>(nghttp2_session_get_stream_user_data(session, frame->hd.stream_id));
+            if (!stream) {
+                return 0;
+            }
+            const std::string_view key(reinterpret_cast<const char*>(name), name_length);
+            const std::string_view text(reinterpret_cast<const char*>(value), value_length);
+            auto& request = stream->request_;
+            if (key == ":method") {
+                request.method = text;
+            } else if (key == ":path") {
+                const auto question = text.find('?');
+                request.path = text.substr(0, question);
+                if (question != std::string_view::npos) {
+                    parse_query_string(text.substr(question + 1), request.query);
+                }
+            } else if (key == ":authority") {
+                request.headers.emplace_back("Host", text);
+            } else if (!key.starts_with(':')) {
+                request.headers.emplace_back(key, text);
+            }
+            return 0;
+        }
+
+        static int on_frame_recv(nghttp2_session* session, const nghttp2_frame* frame, void* user_data)
+        {
+            if ((frame->hd.type != NGHTTP2_HEADERS && frame->hd.type != NGHTTP2_DATA) || (frame->hd.flags & NGHTTP2_FLAG_END_STREAM) == 0) {
+                return 0;
+            }
+            if (nghttp2_session_get_stream_user_data(session, frame->hd.stream_id) == nullptr) {
+                return 0;
+            }
+            auto& self = self_of(user_data);
+            if (const auto it = self.streams_.find(frame->hd.stream_id); it != self.streams_.end()) {
+                self.dispatch(it->second);
+            }
+            return 0;
+        }
+
+        static int on_stream_close(nghttp2_session* /*session*/, int32_t stream_id, uint32_t /*error_code*/, void* user_data)
+        {
+            auto& self = self_of(user_data);
+            const auto it = self.streams_.find(stream_id);
+            if (it == self.streams_.end()) {
+                return 0;
+            }
+            const auto stream = std::move(it->second);
+            self.streams_.erase(it);
+            self.counters_.streams.fetch_sub(1, std::memory_order_relaxed);
+            self.close_stream(*stream);
+            if (stream->streaming_) {
+                self.handler_.close_event_stream(stream);
+            }
+            return 0;
+        }
+
+        Stream stream_;
+        const Config& config_;
+        HttpHandler& handler_;
+        std::atomic<std::size_t>& connections_;
+        Http2Counters& counters_;
+        std::string remote_address_;
+        std::atomic<bool> open_ { true };
+
+        nghttp2_session* session_ = nullptr;
+        std::map<int32_t, std::shared_ptr<H2Stream>> streams_;
+        std::array<char, 16384> read_buffer_ {};
+        std::vector<uint8_t> write_buffer_;
+        bool writing_ = false;
+    };
+
+} // namespace
+
+void start_http2_connection(net::ip::tcp::socket socket, std::string_view received, const Config& config,
+    HttpHandler& handler, std::atomic<std::size_t>& connections, Http2Counters& counters)
+{
+    std::make_shared<Http2Connection<tcp::socket>>(std::move(socket), config, handler, connections, counters)->start(received);
+}
+
+void start_http2_connection(net::ssl::stream<net::ip::tcp::socket> stream, const Config& config,
+    HttpHandler& handler, std::atomic<std::size_t>& connections, Http2Counters& counters)
+{
+    using TlsStream = net::ssl::stream<tcp::socket>;
+    std::make_shared<Http2Connection<TlsStream>>(std::move(stream), config, handler, connections, counters)->start({});
+}
+
+} // namespace atem
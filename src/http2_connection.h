@@ -0,0 +1,36 @@
+#pragma once
+
+#include "http_message.h"
+#include <atomic>
+#include <boost/asio.hpp>
+#include <cstddef>
+#include <string_view>
+
+// Declared here so the OpenSSL headers stay out of the server's interface.
+namespace boost::asio::ssl {
+template <typename Stream>
+class stream;
+}
+
+namespace atem {
+
+struct Config;
+
+// Gauges shared by every HTTP/2 connection of one server.
+struct Http2Counters {
+    std::atomic<std::size_t> connections { 0 };
+    std::atomic<std::size_t> streams { 0 };
+};
+
+// Serves HTTP/2 on a cleartext connection whose client opened with the
+// HTTP/2 preface (h2c with prior knowledge). `received` holds the bytes
+// already read from the socket, starting with the preface. The socket's
+// executor must be a strand. `connections` counts every open connection.
+void start_http2_connection(boost::asio::ip::tcp::socket socket, std::string_view received, const Config& config,
+    HttpHandler& handler, std::atomic<std::size_t>& connections, Http2Counters& counters);
+
+// Serves HTTP/2 on a TLS connection that negotiated "h2" through ALPN.
+void start_http2_connection(boost::asio::ssl::stream<boost::asio::ip::tcp::socket> stream, const Config& config,
+    HttpHandler& handler, std::atomic<std::size_t>& connections, Http2Counters& counters);
+
+} // namespace atem
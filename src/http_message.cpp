@@ -0,0 +1,158 @@
+#include "http_message.h"
+#include <algorithm>
+#include <cctype>
+
+namespace atem {
+namespace {
+
+    bool iequals(std::string_view a, std::string_view b)
+    {
+        return a.size() == b.size()
+            && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+                   return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+               });
+    }
+
+    int hex_value(char c)
+    {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        }
+        if (c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+
+    std::string percent_decode(std::string_view in)
+    {
+        std::string out;
+        out.reserve(in.size());
+        for (std::size_t i = 0; i < in.size(); ++i) {
+            if (in[i] == '+') {
+                out += ' ';
+            } else if (in[i] == '%' && i + 2 < in.size()) {
+                const int hi = hex_value(in[i + 1]);
+                const int lo = hex_value(in[i + 2]);
+                if (hi < 0 || lo < 0) {
+                    out += in[i];
+                    continue;
+                }
+                out += static_cast<char>((hi << 4) | lo);
+                i += 2;
+            } else {
+                out += in[i];
+            }
+        }
+        return out;
+    }
+
+} // namespace
+
+std::string HttpRequest::get_header(std::string_view name, std::string_view default_value) const
+{
+    for (const auto& [key, value] : headers) {
+        if (iequals(key, name)) {
+            return value;
+        }
+    }
+    return std::string(default_value);
+}
+
+std::string HttpRequest::get_query(std::string_view name, std::string_view default_value) const
+{
+    const auto it = query.find(std::string(name));
+    return it != query.end() ? it->second : std::string(default_value);
+}
+
+void parse_query_string(std::string_view query, std::multimap<std::string, std::string>& out)
+{
+    while (!query.empty()) {
+        const auto amp = query.find('&');
+        const auto pair = query.substr(0, amp);
+        query = amp == std::string_view::npos ? std::string_view {} : query.substr(amp + 1);
+        if (pair.empty()) {
+            continue;
+        }
+        const auto eq = pair.find('=');
+        if (eq == std::string_view::npos) {
+            out.emplace(percent_decode(pair), std::string {});
+        } else {
+            out.emplace(percent_decode(pair.substr(0, eq)), percent_decode(pair.substr(eq + 1)));
+        }
+    }
+}
+
+std::string_view http_reason_phrase(int status)
+{
+    switch (status) {
+    case 101:
+        return "Switching Protocols";
+    case 200:
+        return "OK";
+    case 204:
+        return "No Content";
+    case 304:
+        return "Not Modified";
+    case 400:
+        return "Bad Request";
+    case 404:
+        return "Not Found";
+    case 405:
+        return "Method Not Allowed";
+    case 426:
+        return "Upgrade Required";
+    case 431:
+        return "Request Header Fields Too Large";
+    case 503:
+        return "Service Unavailable";
+    default:
+        return "Unknown";
+    }
+}
+
+bool etag_matches(std::string_view if_none_match, std::string_view etag)
+{
+    while (!if_none_match.empty()) {
+        const auto comma = if_none_match.find(',');
+        auto token = if_none_match.substr(0, comma);
+        if_none_match = comma == std::string_view::npos ? std::string_view {} : if_none_match.substr(comma + 1);
+        while (!token.empty() && (token.front() == ' ' || token.front() == '\t')) {
+            token.remove_prefix(1);
+        }
+        while (!token.empty() && (token.back() == ' ' || token.back() == '\t')) {
+            token.remove_suffix(1);
+        }
+        // If-None-Match uses weak comparison.
+        if (token.starts_with("W/")) {
+            token.remove_prefix(2);
+        }
+        if (token == "*" || token == etag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string base64_encode(std::span<const uint8_t> bytes)
+{
+    constexpr std::string_view alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((bytes.size() + 2) / 3 * 4);
+    for (std::size_t i = 0; i < bytes.size(); i += 3) {
+        const auto remaining = bytes.size() - i;
+        const uint32_t chunk = (uint32_t { bytes[i] } << 16)
+            | (remaining > 1 ? uint32_t { bytes[i + 1] } << 8 : 0)
+            | (remaining > 2 ? uint32_t { bytes[i + 2] } : 0);
+        out += alphabet[(chunk >> 18) & 0x3f];
+        out += alphabet[(chunk >> 12) & 0x3f];
+        out += remaining > 1 ? alphabet[(chunk >> 6) & 0x3f] : '=';
+        out += remaining > 2 ? alphabet[chunk & 0x3f] : '=';
+    }
+    return out;
+}
+
+} // namespace atem
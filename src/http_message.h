@@ -0,0 +1,99 @@
+#pragma once
+
+#include "outbound_queue.h"
+#include "sse_payload.h"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace atem {
+
+// Transport-neutral view of an HTTP request, filled in by whichever engine accepted it.
+struct HttpRequest {
+    std::string method;
+    std::string path;
+    std::multimap<std::string, std::string> query;
+    std::vector<std::pair<std::string, std::string>> headers;
+
+    // Case-insensitive header lookup.
+    [[nodiscard]] std::string get_header(std::string_view name, std::string_view default_value = "") const;
+    [[nodiscard]] std::string get_query(std::string_view name, std::string_view default_value = "") const;
+};
+
+struct HttpResponse {
+    int status = 200;
+    std::multimap<std::string, std::string> headers;
+    std::string body;
+};
+
+// Parses "a=1&b=2" into `out`, percent-decoding keys and values.
+void parse_query_string(std::string_view query, std::multimap<std::string, std::string>& out);
+
+// Returns the standard reason phrase for the status codes this server emits.
+std::string_view http_reason_phrase(int status);
+
+// True when an If-None-Match value names `etag` (weak comparison) or is "*".
+bool etag_matches(std::string_view if_none_match, std::string_view etag);
+
+// Standard base64 with padding.
+std::string base64_encode(std::span<const uint8_t> bytes);
+
+/**
+ * @class SseClient
+ * @brief One open /events or /ws stream, independent of the transport that carries it.
+ *
+ * An /events client is sent framed SSE events. A /ws client is sent CBOR
+ * items, which the transport wraps in WebSocket binary messages.
+ */
+class SseClient {
+public:
+    virtual ~SseClient() = default;
+
+    // Queues an already framed event behind the client's bounded outbound
+    // queue. The payload is shared with other clients and must not be modified.
+    // Returns false when the client has stalled and should be evicted.
+    virtual bool send(const SharedPayload& payload, int32_t coalesce_key, OutboundQueue::Clock::time_point now) = 0;
+    virtual void close() = 0;
+    [[nodiscard]] virtual bool is_open() const = 0;
+    [[nodiscard]] virtual OutboundQueue::Stats queue_stats() const = 0;
+    [[nodiscard]] virtual std::string remote_address() const = 0;
+
+    // True when the transport duplicates payload bytes into its own write queue.
+    [[nodiscard]] virtual bool copies_payload() const = 0;
+};
+
+/**
+ * @class HttpHandler
+ * @brief Application side of the HTTP engines: renders pages and owns event streams.
+ */
+class HttpHandler {
+public:
+    // Completes a deferred request. Called once, from any thread.
+    using Responder = std::function<void(HttpResponse)>;
+
+    virtual ~HttpHandler() = default;
+
+    virtual HttpResponse handle_request(const HttpRequest& request) = 0;
+    // A deferred request is answered later through a Responder instead of by
+    // handle_request(). The transport holds the connection open meanwhile.
+    [[nodiscard]] virtual bool is_deferred(const HttpRequest& request) const = 0;
+    virtual void handle_deferred(const HttpRequest& request, Responder respond) = 0;
+    [[nodiscard]] virtual bool is_event_stream(const HttpRequest& request) const = 0;
+    // Content-Encoding for an event stream's response headers; empty for none.
+    [[nodiscard]] virtual std::string_view event_stream_encoding(const HttpRequest& request) const = 0;
+    // Called once the transport has sent the event-stream response headers.
+    virtual void open_event_stream(const std::shared_ptr<SseClient>& client, const HttpRequest& request) = 0;
+    [[nodiscard]] virtual bool is_websocket(const HttpRequest& request) const = 0;
+    // Called once the transport has completed the WebSocket handshake.
+    virtual void open_websocket(const std::shared_ptr<SseClient>& client, const HttpRequest& request) = 0;
+    // Called when either kind of stream closes.
+    virtual void close_event_stream(const std::shared_ptr<SseClient>& client) = 0;
+};
+
+} // namespace atem
@@ -0,0 +1,367 @@
+#include "logger.h"
+#include "config.h"
+#include <algorithm>
+#include <bit>
+#include <boost/json.hpp>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+namespace atem {
+
+namespace {
+
+    // Written out at least this often; a producer only wakes the writer early
+    // for warnings and errors, or when the ring is filling up.
+    constexpr auto kWriteInterval = std::chrono::milliseconds(20);
+
+    std::atomic<Logger*> g_logger { nullptr };
+    std::unique_ptr<Logger> g_owned_logger;
+
+    const char* level_name(LogLevel level)
+    {
+        switch (level) {
+        case LogLevel::Debug:
+            return "debug";
+        case LogLevel::Info:
+            return "info";
+        case LogLevel::Warning:
+            return "warning";
+        case LogLevel::Error:
+            return "error";
+        }
+        return "info";
+    }
+
+    LogLevel parse_level(const std::string& name)
+    {
+        if (name == "debug") {
+            return LogLevel::Debug;
+        }
+        if (name == "warning") {
+            return LogLevel::Warning;
+        }
+        if (name == "error") {
+            return LogLevel::Error;
+        }
+        return LogLevel::Info;
+    }
+
+    // ISO 8601 in UTC with milliseconds: 2024-01-01T12:00:00.000Z
+    void append_time(std::string& out, std::chrono::system_clock::time_point time)
+    {
+        const auto ms = std::chrono::floor<std::chrono::milliseconds>(time);
+        const auto days = std::chrono::floor<std::chrono::days>(ms);
+        const std::chrono::year_month_day date(days);
+        const std::chrono::hh_mm_ss clock(ms - days);
+        char buffer[32]; // NOLINT(cppcoreguidelines-avoid-c-arrays)
+        const int length = std::snprintf(buffer, sizeof(buffer), "%04d-%02u-%02uT%02d:%02d:%02d.%03dZ", static_cast<int>(date.year()),
+            static_cast<unsigned int>(date.month()), static_cast<unsigned int>(date.day()), static_cast<int>(clock.hours().count()),
+            static_cast<int>(clock.minutes().count()), static_cast<int>(clock.seconds().count()),
+            static_cast<int>(clock.subseconds().count()));
+        out.append(buffer, static_cast<std::size_t>(std::max(length, 0)));
+    }
+
+    // Debug and info to stdout, warnings and errors to stderr.
+    class ConsoleSink final : public LogSink {
+    public:
+        void write(LogLevel level, std::string_view line) override
+        {
+            std::FILE* stream = level >= LogLevel::Warning ? stderr : stdout;
+            std::fwrite(line.data(), 1, line.size(), stream);
+        }
+
+        void flush() override
+        {
+            std::fflush(stdout);
+            std::fflush(stderr);
+        }
+    };
+
+    // Appends to a file. Each batch goes out in one write, so the lines of
+    // worker processes sharing the file don't interleave mid-line.
+    class FileSink final : public LogSink {
+    public:
+        explicit FileSink(std::FILE* file)
+            : file_(file)
+        {
+        }
+
+        ~FileSink() override
+        {
+            flush();
+            std::fclose(file_);
+        }
+
+        FileSink(const FileSink&) = delete;
+        FileSink& operator=(const FileSink&) = delete;
+        FileSink(FileSink&&) = delete;
+        FileSink& operator=(FileSink&&) = delete;
+
+        static std::unique_ptr<FileSink> open(const std::string& path)
+        {
+            const auto parent = std::filesystem::path(path).parent_path();
+            if (!parent.empty()) {
+                std::error_code ec;
+                std::filesystem::create_directories(parent, ec);
+            }
+            std::FILE* file = std::fopen(path.c_str(), "ab");
+            return file != nullptr ? std::make_unique<FileSink>(file) : nullptr;
+        }
+
+        void write(LogLevel /*level*/, std::string_view line) override
+        {
+            pending_.append(line);
+        }
+
+        void flush() override
+        {
+            if (!pending_.empty()) {
+                std::fwrite(pending_.data(), 1, pending_.size(), file_);
+                std::fflush(file_);
+                pending_.clear();
+            }
+        }
+
+    private:
+        std::FILE* file_;
+        std::string pending_;
+    };
+
+    // Used before start_logging() and after stop_logging().
+    void write_direct(LogLevel level, std::string_view message)
+    {
+        auto& stream = level >= LogLevel::Warning ? std::cerr : std::cout;
+        stream << message << '\n';
+    }
+
+}
+
+Logger::Logger(LogLevel level, LogFormat format, std::vector<std::unique_ptr<LogSink>> sinks, std::size_t capacity)
+    : level_(level)
+    , format_(format)
+    , sinks_(std::move(sinks))
+    , mask_(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1)
+    , cells_(std::make_unique<Cell[]>(mask_ + 1)) // NOLINT(cppcoreguidelines-avoid-c-arrays)
+{
+    for (std::size_t i = 0; i <= mask_; ++i) {
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    writer_ = std::thread([this]() { run(); });
+}
+
+Logger::~Logger()
+{
+    {
+        const std::scoped_lock lock(wake_mutex_);
+        running_ = false;
+    }
+    wake_.notify_one();
+    writer_.join();
+}
+
+bool Logger::log(LogLevel level, std::string_view message)
+{
+    if (!enabled(level)) {
+        return true;
+    }
+
+    // Claim a cell. A cell is free for position `pos` when its sequence
+    // equals `pos`; the writer sets it to `pos + capacity` once it has read it.
+    auto position = enqueue_position_.load(std::memory_order_relaxed);
+    Cell* cell = nullptr;
+    for (;;) {
+        cell = &cells_[position & mask_];
+        const auto sequence = cell->sequence.load(std::memory_order_acquire);
+        const auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+        if (difference == 0) {
+            if (enqueue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            dropped_.fetch_add(1, std::memory_order_relaxed); // Full; the writer is behind
+            return false;
+        } else {
+            position = enqueue_position_.load(std::memory_order_relaxed);
+        }
+    }
+
+    auto& record = cell->record;
+    record.time = std::chrono::system_clock::now();
+    record.level = level;
+    record.length = static_cast<uint16_t>(std::min(message.size(), kMaxMessageLength));
+    std::memcpy(record.text.data(), message.data(), record.length);
+    cell->sequence.store(position + 1, std::memory_order_release);
+    logged_.fetch_add(1, std::memory_order_relaxed);
+
+    if (level >= LogLevel::Warning || (position & (mask_ >> 1)) == 0) {
+        wake_.notify_one();
+    }
+    return true;
+}
+
+Logger::Stats Logger::stats() const
+{
+    return { logged_.load(std::memory_order_relaxed), dropped_.load(std::memory_order_relaxed), written_.load(std::memory_order_relaxed),
+        batches_.load(std::memory_order_relaxed) };
+}
+
+void Logger::run()
+{
+    std::string line;
+    for (;;) {
+        if (drain(line) > mask_) {
+            continue; // A full batch; there is probably more
+        }
+        std::unique_lock lock(wake_mutex_);
+        if (!running_) {
+            break;
+        }
+        wake_.wait_for(lock, kWriteInterval);
+    }
+    while (drain(line) > 0) {
+        // Whatever was queued before the destructor ran
+    }
+}
+
+std::size_t Logger::drain(std::string& line)
+{
+    // At most one ring's worth per batch, so the sinks are flushed even
+    // while producers keep up with the writer.
+    std::size_t count = 0;
+    while (count <= mask_) {
+        auto& cell = cells_[dequeue_position_ & mask_];
+        if (cell.sequence.load(std::memory_order_acquire) != dequeue_position_ + 1) {
+            break; // Empty, or the producer that claimed it is still copying
+        }
+        const auto& record = cell.record;
+        write_line(line, record.time, record.level, std::string_view(record.text.data(), record.length));
+        cell.sequence.store(dequeue_position_ + mask_ + 1, std::memory_order_release);
+        ++dequeue_position_;
+        ++count;
+    }
+
+    const auto dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped != reported_drops_) {
+        const auto message = "Logger dropped " + std::to_string(dropped - reported_drops_) + " lines; the log queue was full";
+        reported_drops_ = dropped;
+        write_line(line, std::chrono::system_clock::now(), LogLevel::Warning, message);
+        ++count;
+    }
+
+    if (count > 0) {
+        for (const auto& sink : sinks_) {
+            sink->flush();
+        }
+        written_.fetch_add(count, std::memory_order_relaxed);
+        batches_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return count;
+}
+
+void Logger::write_line(std::string& line, std::chrono::system_clock::time_point time, LogLevel level, std::string_view message)
+{
+    line.clear();
+    if (format_ == LogFormat::Json) {
+        std::string time_text;
+        append_time(time_text, time);
+        boost::json::object object;
+        object["time"] = time_text;
+        object["level"] = level_name(level);
+        object["message"] = std::string(message);
+        line = boost::json::serialize(object);
+    } else {
+        append_time(line, time);
+        line += " [";
+        line += level_name(level);
+        line += "] ";
+        line += message;
+    }
+    line += '\n';
+    for (const auto& sink : sinks_) {
+        sink->write(level, line);
+    }
+}
+
+LogLine::Buffer::Buffer()
+{
+    setp(data_.data(), data_.data() + data_.size());
+}
+
+std::string_view LogLine::Buffer::view() const
+{
+    auto text = std::string_view(pbase(), static_cast<std::size_t>(pptr() - pbase()));
+    while (!text.empty() && (text.back() == '\n' || text.back() == '\r')) {
+        text.remove_suffix(1); // Lines are terminated by the logger
+    }
+    return text;
+}
+
+LogLine::LogLine(LogLevel level)
+    : level_(level)
+{
+    const auto* current = logger();
+    // Without a logger, only debug lines are left out.
+    if (current != nullptr ? current->enabled(level) : level >= LogLevel::Info) {
+        buffer_.emplace();
+        stream_.emplace(&*buffer_);
+    }
+}
+
+LogLine::~LogLine()
+{
+    if (!stream_) {
+        return;
+    }
+    if (auto* current = logger(); current != nullptr) {
+        current->log(level_, buffer_->view());
+    } else {
+        write_direct(level_, buffer_->view());
+    }
+}
+
+void tag_invoke(const boost::json::value_from_tag&, boost::json::value& jv, const Logger::Stats& stats)
+{
+    jv = {
+        { "logged", stats.logged },
+        { "dropped", stats.dropped },
+        { "written", stats.written },
+        { "batches", stats.batches },
+    };
+}
+
+void start_logging(const Config& config)
+{
+    std::vector<std::unique_ptr<LogSink>> sinks;
+    if (config.log_console) {
+        sinks.push_back(std::make_unique<ConsoleSink>());
+    }
+    if (config.log_file_output) {
+        if (auto file = FileSink::open(config.log_file)) {
+            sinks.push_back(std::move(file));
+        } else {
+            std::cerr << "Warning: cannot open log file '" << config.log_file << "': " << std::strerror(errno) << "\n";
+        }
+    }
+
+    stop_logging();
+    g_owned_logger = std::make_unique<Logger>(parse_level(config.log_level),
+        config.log_format == "json" ? LogFormat::Json : LogFormat::Text, std::move(sinks), config.log_queue_size);
+    g_logger.store(g_owned_logger.get(), std::memory_order_release);
+}
+
+void stop_logging()
+{
+    g_logger.store(nullptr, std::memory_order_release);
+    g_owned_logger.reset();
+}
+
+Logger* logger()
+{
+    return g_logger.load(std::memory_order_acquire);
+}
+
+} // namespace atem
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <array>
+#include <boost/json.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace atem {
+
+struct Config;
+
+enum class LogLevel : uint8_t { Debug, Info, Warning, Error };
+
+enum class LogFormat : uint8_t {
+    Text, // "2024-01-01T12:00:00.000Z [info] message"
+    Json, // One {"time", "level", "message"} object per line
+};
+
+// Where the background writer sends formatted lines.
+class LogSink {
+public:
+    virtual ~LogSink() = default;
+    virtual void write(LogLevel level, std::string_view line) = 0; // `line` ends with '\n'
+    virtual void flush() = 0; // Called after each batch
+};
+
+/**
+ * @class Logger
+ * @brief Log lines queued from any thread and written out by one background thread.
+ *
+ * log() copies the message into a slot of a fixed ring and returns; it never
+ * waits for a sink, a lock or another producer's write, so a slow terminal,
+ * pipe or journal can't hold up the thread that logs. Producers claim slots
+ * with a compare-and-swap on the ring position. When the ring is full the
+ * line is dropped and counted, and the writer reports the count.
+ */
+class Logger final {
+public:
+    static constexpr std::size_t kMaxMessageLength = 480; // Longer messages are truncated
+
+    struct Stats {
+        uint64_t logged = 0; // Lines queued
+        uint64_t dropped = 0; // Lines lost to a full ring
+        uint64_t written = 0; // Lines handed to the sinks
+        uint64_t batches = 0; // Writer wake-ups that found lines
+    };
+
+    // `capacity` is rounded up to a power of two.
+    Logger(LogLevel level, LogFormat format, std::vector<std::unique_ptr<LogSink>> sinks, std::size_t capacity = 4096);
+    // Writes out everything queued.
+    ~Logger();
+
+    // Non-copyable, non-movable
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+    Logger(Logger&&) = delete;
+    Logger& operator=(Logger&&) = delete;
+
+    [[nodiscard]] bool enabled(LogLevel level) const
+    {
+        return level >= level_;
+    }
+
+    // Returns false if the line was dropped.
+    bool log(LogLevel level, std::string_view message);
+
+    [[nodiscard]] Stats stats() const;
+
+private:
+    struct Record {
+        std::chrono::system_clock::time_point time;
+        LogLevel level = LogLevel::Info;
+        uint16_t length = 0;
+        std::array<char, kMaxMessageLength> text;
+    };
+
+    struct Cell {
+        std::atomic<std::size_t> sequence { 0 }; // Ring position the cell is ready for
+        Record record;
+    };
+
+    void run();
+    // Hands every queued line to the sinks; returns how many there were.
+    std::size_t drain(std::string& line);
+    void write_line(std::string& line, std::chrono::system_clock::time_point time, LogLevel level, std::string_view message);
+
+    const LogLevel level_;
+    const LogFormat format_;
+    const std::vector<std::unique_ptr<LogSink>> sinks_;
+    const std::size_t mask_;
+    const std::unique_ptr<Cell[]> cells_; // NOLINT(cppcoreguidelines-avoid-c-arrays)
+
+    alignas(64) std::atomic<std::size_t> enqueue_position_ { 0 };
+    alignas(64) std::size_t dequeue_position_ = 0; // Writer thread only
+
+    std::atomic<uint64_t> logged_ { 0 };
+    std::atomic<uint64_t> dropped_ { 0 };
+    std::atomic<uint64_t> written_ { 0 };
+    std::atomic<uint64_t> batches_ { 0 };
+    uint64_t reported_drops_ = 0; // Writer thread only
+
+    std::atomic<bool> running_ { true };
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    std::thread writer_;
+};
+
+// Builds one log line with operator<< and queues it when it goes out of
+// scope. Nothing is formatted if the level is disabled. Messages longer than
+// Logger::kMaxMessageLength are truncated.
+class LogLine final {
+public:
+    explicit LogLine(LogLevel level);
+    ~LogLine();
+
+    LogLine(const LogLine&) = delete;
+    LogLine& operator=(const LogLine&) = delete;
+    LogLine(LogLine&&) = delete;
+    LogLine& operator=(LogLine&&) = delete;
+
+    template <typename T>
+    LogLine& operator<<(const T& value)
+    {
+        if (stream_) {
+            *stream_ << value;
+        }
+        return *this;
+    }
+
+    LogLine& operator<<(std::ostream& (*manipulator)(std::ostream&))
+    {
+        if (stream_) {
+            *stream_ << manipulator;
+        }
+        return *this;
+    }
+
+private:
+    // Formats into a fixed buffer, so building a line never allocates.
+    class Buffer final : public std::streambuf {
+    public:
+        Buffer();
+        [[nodiscard]] std::string_view view() const;
+
+    private:
+        std::array<char, Logger::kMaxMessageLength> data_ {};
+    };
+
+    const LogLevel level_;
+    std::optional<Buffer> buffer_;
+    std::optional<std::ostream> stream_;
+};
+
+inline LogLine log(LogLevel level)
+{
+    return LogLine(level);
+}
+
+void tag_invoke(const boost::json::value_from_tag&, boost::json::value& jv, const Logger::Stats& stats);
+
+// Installs the process-wide logger the `logging` section describes. Until
+// then, and after stop_logging(), lines are written straight to std::cout
+// (debug, info) or std::cerr (warning, error).
+void start_logging(const Config& config);
+// Writes out everything queued and removes the process-wide logger. Call
+// once no other thread logs any more.
+void stop_logging();
+// The process-wide logger, or null.
+Logger* logger();
+
+} // namespace atem
@@ -0,0 +1,107 @@
+#include "long_poll.h"
+#include <algorithm>
+#include <iterator>
+#include <optional>
+#include <vector>
+
+namespace atem {
+
+LongPollRegistry::LongPollRegistry(TimerWheel& wheel, std::size_t limit, Answer changed, Answer timed_out)
+    : wheel_(wheel)
+    , limit_(limit)
+    , changed_(std::move(changed))
+    , timed_out_(std::move(timed_out))
+{
+}
+
+LongPollRegistry::~LongPollRegistry()
+{
+    clear();
+}
+
+LongPollRegistry::WaitResult LongPollRegistry::wait(uint64_t since, uint64_t current, std::chrono::milliseconds timeout,
+    HttpHandler::Responder respond)
+{
+    const std::scoped_lock lock(mutex_);
+    version_ = std::max(version_, current);
+    if (since < version_) {
+        return WaitResult::Ready;
+    }
+    if (waiters_.size() >= limit_) {
+        ++stats_.rejected;
+        return WaitResult::Full;
+    }
+
+    const Key key { since, next_id_++ };
+    // The wheel runs the timeout on the io_context, outside its own lock.
+    const auto timer = wheel_.schedule(timeout, [this, key]() { expire(key); });
+    waiters_.emplace(key, Waiter { std::move(respond), timer });
+    ++stats_.parked;
+    return WaitResult::Parked;
+}
+
+void LongPollRegistry::wake(uint64_t version)
+{
+    std::vector<std::pair<Key, Waiter>> due;
+    {
+        const std::scoped_lock lock(mutex_);
+        version_ = std::max(version_, version);
+        const auto end = waiters_.lower_bound(Key { version_, 0 });
+        due.reserve(static_cast<std::size_t>(std::distance(waiters_.begin(), end)));
+        for (auto it = waiters_.begin(); it != end;) {
+            auto node = waiters_.extract(it++);
+            due.emplace_back(node.key(), std::move(node.mapped()));
+        }
+        stats_.answered += due.size();
+    }
+
+    // Waiters are ordered by version, so each distinct one is answered once.
+    std::optional<uint64_t> since;
+    HttpResponse response;
+    for (auto& [key, waiter] : due) {
+        wheel_.cancel(waiter.timer);
+        if (key.first != since) {
+            since = key.first;
+            response = changed_(key.first);
+        }
+        waiter.respond(response);
+    }
+}
+
+void LongPollRegistry::expire(Key key)
+{
+    HttpHandler::Responder respond;
+    {
+        const std::scoped_lock lock(mutex_);
+        const auto it = waiters_.find(key);
+        if (it == waiters_.end()) {
+            return; // Already answered by wake()
+        }
+        respond = std::move(it->second.respond);
+        waiters_.erase(it);
+        ++stats_.timed_out;
+    }
+    respond(timed_out_(key.first));
+}
+
+void LongPollRegistry::clear()
+{
+    std::map<Key, Waiter> dropped;
+    {
+        const std::scoped_lock lock(mutex_);
+        dropped.swap(waiters_);
+    }
+    for (const auto& [key, waiter] : dropped) {
+        wheel_.cancel(waiter.timer);
+    }
+}
+
+LongPollRegistry::Stats LongPollRegistry::stats() const
+{
+    const std::scoped_lock lock(mutex_);
+    Stats stats = stats_;
+    stats.waiting = waiters_.size();
+    return stats;
+}
+
+} // namespace atem
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "http_message.h"
+#include "timer_wheel.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace atem {
+
+/**
+ * @class LongPollRegistry
+ * @brief Requests parked until the tally state moves past the version they last saw.
+ *
+ * A parked request is a map entry and a timer wheel entry; it costs nothing
+ * until the state changes or its timeout fires. A change answers every
+ * request that is behind it, and builds one response per distinct version
+ * the waiters last saw, so pollers that are in step share one answer.
+ */
+class LongPollRegistry final {
+public:
+    // Builds the response for a request that last saw version `since`.
+    using Answer = std::function<HttpResponse(uint64_t since)>;
+
+    enum class WaitResult : uint8_t {
+        Parked, // `respond` is called later
+        Ready, // The state has already moved past `since`; answer now
+        Full, // Too many requests are parked
+    };
+
+    struct Stats {
+        std::size_t waiting = 0;
+        uint64_t parked = 0;
+        uint64_t answered = 0;
+        uint64_t timed_out = 0;
+        uint64_t rejected = 0;
+    };
+
+    // `changed` answers a request once the state has moved on, `timed_out`
+    // one whose timeout passed first. Both run outside the registry's lock.
+    LongPollRegistry(TimerWheel& wheel, std::size_t limit, Answer changed, Answer timed_out);
+    ~LongPollRegistry();
+
+    // Non-copyable, non-movable
+    LongPollRegistry(const LongPollRegistry&) = delete;
+    LongPollRegistry& operator=(const LongPollRegistry&) = delete;
+    LongPollRegistry(LongPollRegistry&&) = delete;
+    LongPollRegistry& operator=(LongPollRegistry&&) = delete;
+
+    // Parks a request until the state passes `since`. `current` is the state
+    // version read by the caller; a wake() that raced with it is not missed.
+    WaitResult wait(uint64_t since, uint64_t current, std::chrono::milliseconds timeout, HttpHandler::Responder respond);
+
+    // Answers every request parked at a version below `version`.
+    void wake(uint64_t version);
+
+    // Drops every parked request without answering it.
+    void clear();
+
+    [[nodiscard]] Stats stats() const;
+
+private:
+    struct Waiter {
+        HttpHandler::Responder respond;
+        TimerWheel::TimerId timer = 0;
+    };
+    // Ordered by the version the request last saw, then arrival.
+    using Key = std::pair<uint64_t, uint64_t>;
+
+    void expire(Key key);
+
+    TimerWheel& wheel_;
+    const std::size_t limit_;
+    const Answer changed_;
+    const Answer timed_out_;
+
+    mutable std::mutex mutex_;
+    std::map<Key, Waiter> waiters_;
+    uint64_t version_ = 0; // Newest version seen by wait() or wake()
+    uint64_t next_id_ = 0;
+    Stats stats_;
+};
+
+} // namespace atem
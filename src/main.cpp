@@ -1,20 +1,126 @@
+#include "atem/atem_connection_shared.h"
 #include "config.h"
+#include "logger.h"
+#include "multicast_sink.h"
 #include "platform_interface.h"
+#include "shared_tally_ring.h"
 #include "sse_server.h"
 #include "tally_monitor.h"
+#include "thread_pool.h"
+#include "tsl_sink.h"
 #include "version.h" // Generated by CMake
+#include "worker_pool.h"
+#include <atomic>
 #include <boost/asio.hpp>
 #include <boost/program_options.hpp>
+#include <chrono>
+#include <cstddef>
 #include <future> // Required for promise and future
 #include <gsl/gsl>
 #include <iostream>
 #include <memory>
+#include <stdexcept>
 #include <string>
 #include <thread>
 #include <vector>
 
 namespace po = boost::program_options;
 
+namespace {
+
+// Tally changes a worker can fall behind by before it has to resynchronize.
+constexpr std::size_t kWorkerRingCapacity = 4096;
+// How long a worker waits for the supervisor to connect to the switcher.
+constexpr auto kWorkerStartTimeout = std::chrono::seconds(60);
+
+// The thread that runs the io_context of the monitor, the sinks and the tally
+// path.
+std::unique_ptr<atem::ThreadPool> make_event_pool(const atem::Config& config)
+{
+    auto cpus = std::vector<int>();
+    if (config.event_cpu >= 0) {
+        cpus.push_back(config.event_cpu);
+    }
+    return std::make_unique<atem::ThreadPool>("event", 1, std::move(cpus), std::chrono::milliseconds(config.lag_probe_interval_ms));
+}
+
+// Entry point of a worker process: serves HTTP for the tally state that the
+// supervisor publishes into `ring`.
+int run_worker(const atem::Config& supervisor_config, atem::SharedTallyRing& ring, std::size_t worker)
+{
+    // The workers already spread the load over the cores; by default each
+    // runs a single I/O thread.
+    auto config = supervisor_config;
+    if (config.io_threads == 0) {
+        config.io_threads = 1;
+    }
+    // Each worker keeps to one of the I/O CPUs, its event thread included;
+    // the supervisor's event CPU stays its own.
+    config.event_cpu = -1;
+    if (!config.io_cpus.empty()) {
+        config.event_cpu = config.io_cpus[worker % config.io_cpus.size()];
+        config.io_cpus = { config.event_cpu };
+    }
+
+    // The supervisor's log writer thread did not survive the fork.
+    atem::start_logging(config);
+    auto stop_logging = gsl::finally([] { atem::stop_logging(); });
+
+    auto io_context = boost::asio::io_context();
+    auto monitor = std::make_unique<atem::TallyMonitor>(
+        io_context, config, std::make_unique<atem::ATEMConnectionShared>(io_context, ring, worker));
+    auto web_server = std::make_unique<atem::SseServer>(io_context, config, gsl::make_not_null(monitor.get()));
+    web_server->add_metrics("monitor", [&monitor]() { return boost::json::value_from(monitor->stats()); });
+    web_server->add_metrics("logging", []() { return boost::json::value_from(atem::logger()->stats()); });
+    auto event_pool = make_event_pool(config);
+    web_server->add_metrics("event_thread", [&event_pool]() { return boost::json::value_from(event_pool->stats()); });
+
+    monitor->on_tally_change([&web_server](const atem::TallyUpdate& update, uint64_t version) {
+        web_server->broadcast_tally_update(update, version);
+    });
+    monitor->on_mode_change([&web_server](bool is_mock, uint64_t version) {
+        web_server->broadcast_mode_change(is_mock, version);
+    });
+    monitor->on_inputs_change([&web_server](uint64_t version) {
+        web_server->broadcast_inputs_change(version);
+    });
+
+    auto work_guard = boost::asio::make_work_guard(io_context);
+    event_pool->start(io_context);
+
+    auto stopping = std::atomic<bool>(false);
+    auto signals = boost::asio::signal_set(io_context, SIGINT, SIGTERM);
+    signals.async_wait([&web_server, &stopping](const boost::system::error_code&, int) {
+        stopping = true;
+        web_server->stop();
+    });
+
+    const auto deadline = std::chrono::steady_clock::now() + kWorkerStartTimeout;
+    while (!ring.is_ready() && !stopping && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    const bool ready = ring.is_ready() && !stopping;
+    if (ready) {
+        // The shared connection has the supervisor's inputs once it has connected.
+        auto monitor_ready = std::promise<void>();
+        monitor->on_ready([&monitor_ready]() { monitor_ready.set_value(); });
+        monitor->start();
+        monitor_ready.get_future().wait();
+        web_server->start();
+    } else if (!stopping) {
+        atem::log(atem::LogLevel::Error) << "Worker " << worker << " gave up waiting for the supervisor";
+    }
+
+    io_context.stop();
+    work_guard.reset();
+    event_pool->join();
+    // Only once no strand handler can be running.
+    monitor->stop();
+    return ready || stopping ? 0 : 1;
+}
+
+}
+
 int main(int argc, char** argv)
 {
     // Display application and SDK version info at startup
@@ -50,6 +156,8 @@ int main(int argc, char** argv)
             "WebSocket server listen address")(
             "listen-port", po::value<unsigned short>(&config.ws_port),
             "WebSocket server listen port")(
+            "engine", po::value<std::string>(&config.server_engine),
+            "HTTP/SSE engine: restbed or asio")(
             "atem-ip", po::value<std::string>(&config.atem_ip),
             "ATEM switcher IP address")(
             "mock", po::bool_switch(&config.mock_enabled)->default_value(config.mock_enabled), "Enable mock mode")(
@@ -73,6 +181,30 @@ int main(int argc, char** argv)
             po::store(po::command_line_parser(argc, argv).options(desc).run(), vm);
             po::notify(vm);
         }
+        if (vm.count("engine")) {
+            if (!atem::Config::is_known_engine(config.server_engine)) {
+                throw std::invalid_argument("unknown --engine '" + config.server_engine + "'; expected restbed or asio");
+            }
+            config.resolve_engine();
+        }
+
+        // --- Worker Processes ---
+        // Started first, while this is still the only thread. Each worker
+        // serves HTTP from its own process; this one becomes the supervisor.
+        auto ring = std::unique_ptr<atem::SharedTallyRing>();
+        auto workers = std::unique_ptr<atem::WorkerPool>();
+        if (config.worker_processes > 0) {
+            ring = std::make_unique<atem::SharedTallyRing>(kWorkerRingCapacity);
+            workers = std::make_unique<atem::WorkerPool>(config.worker_processes, *ring);
+            workers->start([&config, &ring](std::size_t worker) { return run_worker(config, *ring, worker); });
+        }
+
+        // --- Logging ---
+        // Started after the fork, since a child would not inherit the writer
+        // thread. Stopped once the services below are gone, writing out
+        // everything they logged.
+        atem::start_logging(config);
+        auto stop_logging = gsl::finally([] { atem::stop_logging(); });
 
         // --- Service Setup ---
         auto io_context = boost::asio::io_context();
@@ -80,65 +212,150 @@ int main(int argc, char** argv)
         // Create tally monitor
         auto monitor = std::make_unique<atem::TallyMonitor>(io_context, config);
 
-        // Create server
-        auto web_server = std::make_unique<atem::SseServer>(config, gsl::make_not_null(monitor.get()));
+        // Create server, unless the workers serve HTTP
+        auto web_server = std::unique_ptr<atem::SseServer>();
+        if (!workers) {
+            web_server = std::make_unique<atem::SseServer>(io_context, config, gsl::make_not_null(monitor.get()));
+            web_server->add_metrics("monitor", [&monitor]() { return boost::json::value_from(monitor->stats()); });
+            web_server->add_metrics("logging", []() { return boost::json::value_from(atem::logger()->stats()); });
+        }
+        auto event_pool = make_event_pool(config);
+        if (web_server) {
+            web_server->add_metrics("event_thread", [&event_pool]() { return boost::json::value_from(event_pool->stats()); });
+        }
+
+        // Optional multicast output for hardware tally receivers
+        auto multicast = std::unique_ptr<atem::MulticastSink>();
+        if (config.multicast_enabled) {
+            multicast = std::make_unique<atem::MulticastSink>(io_context, config, gsl::make_not_null(monitor.get()));
+            if (web_server) {
+                web_server->add_metrics("multicast", [&multicast]() { return boost::json::value_from(multicast->stats()); });
+            }
+        }
+
+        // Optional TSL UMD output for tally controllers and multiviewers
+        auto tsl = std::unique_ptr<atem::TslSink>();
+        if (config.tsl_enabled) {
+            tsl = std::make_unique<atem::TslSink>(config, gsl::make_not_null(monitor.get()));
+            if (web_server) {
+                web_server->add_metrics("tsl", [&tsl]() { return boost::json::value_from(tsl->stats()); });
+            }
+        }
 
         // Connect tally updates to websocket broadcasts and TUI
-        monitor->on_tally_change([&web_server](const atem::TallyUpdate& update) {
-            web_server->broadcast_tally_update(update);
+        monitor->on_tally_change([&web_server, &ring, &workers, &multicast, &tsl](const atem::TallyUpdate& update, uint64_t version) {
+            if (web_server) {
+                web_server->broadcast_tally_update(update, version);
+            }
+            if (ring) {
+                ring->publish_tally(update);
+                workers->notify();
+            }
+            if (multicast) {
+                multicast->publish(update);
+            }
+            if (tsl) {
+                tsl->publish(update);
+            }
         });
 
         // Connect mode changes to websocket broadcasts
-        monitor->on_mode_change([&web_server](bool is_mock) {
-            web_server->broadcast_mode_change(is_mock);
+        monitor->on_mode_change([&web_server, &ring, &workers, &multicast, &tsl](bool is_mock, uint64_t version) {
+            if (web_server) {
+                web_server->broadcast_mode_change(is_mock, version);
+            }
+            if (ring) {
+                ring->publish_mode(is_mock);
+                workers->notify();
+            }
+            if (multicast) {
+                multicast->publish_keyframe();
+            }
+            if (tsl) {
+                tsl->publish_all();
+            }
         });
 
         // Keep the io_context running until it's explicitly stopped.
         auto work_guard = boost::asio::make_work_guard(io_context);
 
-        // Run the io_context in its own thread for the TallyMonitor's timer
-        auto monitor_thread = std::thread([&io_context]() {
-            io_context.run();
-            std::cout << "I/O context thread finished." << std::endl;
-        });
+        // Run the io_context on the event thread for the TallyMonitor's timer
+        event_pool->start(io_context);
 
         auto server_ready_promise = std::promise<void>();
         auto server_ready_future = server_ready_promise.get_future();
         monitor->on_ready([&server_ready_promise]() {
             server_ready_promise.set_value();
         });
+        // A switcher that connects or reconnects after startup may bring a
+        // different input list; the workers re-read it.
+        monitor->on_inputs_change([&web_server, &ring, &workers, &monitor](uint64_t version) {
+            if (web_server) {
+                web_server->broadcast_inputs_change(version);
+            }
+            if (ring) {
+                ring->publish_inputs(monitor->get_inputs(), [&monitor]() { return monitor->get_all_tally_states(); }, monitor->is_mock_mode());
+                workers->notify();
+            }
+        });
         // Start the monitor first and wait for it to be ready.
 
         // Setup signal handling for graceful shutdown
         auto signals = boost::asio::signal_set(io_context, SIGINT, SIGTERM);
-        signals.async_wait([&web_server](const boost::system::error_code&, int) {
-            std::cout << "\nSignal received, initiating shutdown...\n";
-            // Stop the restbed server. This will unblock the main thread.
-            web_server->stop();
+        signals.async_wait([&web_server, &workers](const boost::system::error_code&, int) {
+            atem::log(atem::LogLevel::Info) << "Signal received, initiating shutdown...";
+            // Stop the restbed server or the workers. This will unblock the main thread.
+            if (web_server) {
+                web_server->stop();
+            }
+            if (workers) {
+                workers->stop();
+            }
         });
 
         monitor->start();
         server_ready_future.wait();
+        if (ring) {
+            // Lets the workers start serving.
+            ring->publish_inputs(monitor->get_inputs(), [&monitor]() { return monitor->get_all_tally_states(); }, monitor->is_mock_mode());
+        }
+        if (multicast) {
+            multicast->start();
+        }
+        if (tsl) {
+            tsl->start();
+        }
 
-        // Start the server (this will block in the main thread)
-        web_server->start();
+        // Start the server, or wait for the workers (this will block in the main thread)
+        if (web_server) {
+            web_server->start();
+        } else {
+            workers->wait();
+        }
 
         // --- Shutdown ---
-        std::cout << "Shutting down server..." << std::endl;
+        atem::log(atem::LogLevel::Info) << "Shutting down server...";
         // The web_server->start() call blocks, so code here is reached after server is stopped.
         // The signal handler calls web_server->stop(), which unblocks the main thread.
         // We stop the io_context here to terminate the monitor_thread.
         io_context.stop();
-        if (monitor)
-            monitor->stop();
+        if (multicast) {
+            multicast->stop();
+        }
+        if (tsl) {
+            tsl->stop();
+        }
 
         // Allow the io_context to stop by resetting the work guard.
         work_guard.reset();
-        if (monitor_thread.joinable()) {
-            monitor_thread.join();
-        }
+        event_pool->join();
+        atem::log(atem::LogLevel::Info) << "I/O context thread finished.";
+        // The monitor's timers and connections belong to its strands, so it
+        // is stopped only once no handler can be running on them.
+        if (monitor)
+            monitor->stop();
 
-        std::cout << "Application stopped." << std::endl;
+        atem::log(atem::LogLevel::Info) << "Application stopped.";
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
         return 1;
@@ -0,0 +1,240 @@
+#include "multicast_sink.h"
+#include "config.h"
+#include "logger.h"
+#include "tally_monitor.h"
+#include <algorithm>
+#include <chrono>
+#include <span>
+#include <stdexcept>
+
+namespace atem {
+
+namespace net = boost::asio;
+using net::ip::udp;
+
+namespace {
+
+    // A single NACK can ask for at most this many deltas; the rest of a larger
+    // gap is left to the receiver's next NACK or the next keyframe.
+    constexpr uint32_t kMaxRepairsPerNack = 64;
+
+    uint32_t make_stream_id()
+    {
+        // Low bits of the start time: enough for receivers to tell a restart.
+        const auto now = std::chrono::system_clock::now().time_since_epoch();
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+    }
+
+}
+
+MulticastSink::MulticastSink(net::io_context& ioc, const Config& config, gsl::not_null<TallyMonitor*> monitor)
+    : config_(config)
+    , monitor_(*monitor)
+    , stream_id_(make_stream_id())
+    , socket_(ioc)
+    , keyframe_timer_(ioc)
+{
+}
+
+MulticastSink::~MulticastSink()
+{
+    stop();
+}
+
+void MulticastSink::start()
+{
+    const std::scoped_lock lock(mutex_);
+    group_ = udp::endpoint(net::ip::make_address(config_.multicast_group), config_.multicast_port);
+    if (!group_.address().is_multicast()) {
+        throw std::invalid_argument("multicast.group " + config_.multicast_group + " is not a multicast address");
+    }
+
+    socket_.open(group_.protocol());
+    // NACKs come back to the port the stream is sent from.
+    if (!config_.multicast_interface.empty()) {
+        const auto interface_address = net::ip::make_address(config_.multicast_interface);
+        socket_.bind(udp::endpoint(interface_address, 0));
+        if (interface_address.is_v4()) {
+            socket_.set_option(net::ip::multicast::outbound_interface(interface_address.to_v4()));
+        }
+    } else {
+        socket_.bind(udp::endpoint(group_.protocol(), 0));
+    }
+    socket_.set_option(net::ip::multicast::hops(static_cast<int>(config_.multicast_ttl)));
+    // Lets a receiver on the same host, such as tools/multicast_receiver, listen.
+    socket_.set_option(net::ip::multicast::enable_loopback(true));
+    // Tally changes must never wait on the network; a dropped datagram is
+    // repaired through the NACK path.
+    socket_.non_blocking(true);
+
+    running_.store(true, std::memory_order_release);
+    log(LogLevel::Info) << "Multicast tally stream " << stream_id_ << " to " << group_ << " from port " << socket_.local_endpoint().port();
+    send_keyframe(group_, 0);
+    schedule_keyframe();
+    receive_nack();
+}
+
+void MulticastSink::stop()
+{
+    if (!running_.exchange(false, std::memory_order_acq_rel)) {
+        return;
+    }
+    const std::scoped_lock lock(mutex_);
+    keyframe_timer_.cancel();
+    boost::system::error_code ec;
+    socket_.close(ec);
+}
+
+void MulticastSink::publish(const TallyUpdate& update)
+{
+    if (!running_.load(std::memory_order_acquire)) {
+        return;
+    }
+    const std::scoped_lock lock(mutex_);
+    TallyFrame frame;
+    frame.type = TallyFrameType::Delta;
+    frame.flags = update.mock ? kTallyFrameMock : 0;
+    frame.stream_id = stream_id_;
+    frame.sequence = ++sequence_;
+    frame.entries.push_back({ update.input_id, update.program, update.preview, update.switcher });
+
+    std::vector<uint8_t> datagram;
+    encode_tally_frame(frame, datagram);
+    send(datagram, group_);
+    ++stats_.deltas;
+
+    history_.push_back(std::move(datagram));
+    while (history_.size() > std::max(1U, config_.multicast_repair_history)) {
+        history_.pop_front();
+    }
+}
+
+void MulticastSink::publish_keyframe()
+{
+    if (!running_.load(std::memory_order_acquire)) {
+        return;
+    }
+    const std::scoped_lock lock(mutex_);
+    send_keyframe(group_, 0);
+}
+
+void MulticastSink::schedule_keyframe()
+{
+    if (config_.multicast_keyframe_interval_ms == 0) {
+        return;
+    }
+    keyframe_timer_.expires_after(std::chrono::milliseconds(config_.multicast_keyframe_interval_ms));
+    keyframe_timer_.async_wait([this](const boost::system::error_code& ec) {
+        if (ec || !running_.load(std::memory_order_acquire)) {
+            return;
+        }
+        const std::scoped_lock lock(mutex_);
+        send_keyframe(group_, 0);
+        schedule_keyframe();
+    });
+}
+
+void MulticastSink::receive_nack()
+{
+    socket_.async_receive_from(net::buffer(nack_buffer_), nack_sender_, [this](const boost::system::error_code& ec, std::size_t size) {
+        if (ec == net::error::operation_aborted || !running_.load(std::memory_order_acquire)) {
+            return;
+        }
+        const std::scoped_lock lock(mutex_);
+        TallyFrame frame;
+        if (!ec && decode_tally_frame(std::span<const uint8_t>(nack_buffer_.data(), size), frame) && frame.type == TallyFrameType::Nack) {
+            handle_nack(frame, nack_sender_);
+        }
+        // Errors such as ICMP port unreachable from a departed receiver don't
+        // stop the listener.
+        receive_nack();
+    });
+}
+
+void MulticastSink::handle_nack(const TallyFrame& nack, const udp::endpoint& from)
+{
+    ++stats_.nacks;
+    // Sequence numbers wrap, so positions in the history are taken modulo 2^32.
+    const auto oldest = static_cast<uint32_t>(sequence_ - history_.size() + 1);
+    const auto offset = static_cast<uint32_t>(nack.sequence - oldest);
+    if (nack.stream_id != stream_id_ || nack.count == 0 || offset >= history_.size()) {
+        // From before a restart or older than the history: only the full state helps.
+        send_keyframe(from, kTallyFrameRepair);
+        ++stats_.repair_keyframes;
+        return;
+    }
+    const auto count = std::min<std::size_t>({ nack.count, kMaxRepairsPerNack, history_.size() - offset });
+    for (std::size_t i = 0; i < count; ++i) {
+        auto datagram = history_[offset + i];
+        datagram[4] |= kTallyFrameRepair;
+        send(datagram, from);
+        ++stats_.repairs;
+    }
+}
+
+void MulticastSink::send_keyframe(const udp::endpoint& to, uint8_t flags)
+{
+    // Deltas are sent after the monitor has stored the change, so under
+    // mutex_ the state read here includes every delta up to `sequence_`.
+    auto states = monitor_.get_all_tally_states();
+    std::sort(states.begin(), states.end(), [](const TallyState& a, const TallyState& b) { return a.key() < b.key(); });
+
+    TallyFrame frame;
+    frame.type = TallyFrameType::Keyframe;
+    frame.stream_id = stream_id_;
+    frame.sequence = sequence_;
+    const uint8_t mode = monitor_.is_mock_mode() ? kTallyFrameMock : 0;
+    std::vector<uint8_t> datagram;
+    std::size_t next = 0;
+    do {
+        const auto end = std::min(states.size(), next + kMaxTallyFrameEntries);
+        frame.entries.clear();
+        for (; next < end; ++next) {
+            frame.entries.push_back({ states[next].input_id, states[next].program, states[next].preview, states[next].switcher });
+        }
+        frame.flags = static_cast<uint8_t>(flags | mode | (next < states.size() ? kTallyFrameMore : 0));
+        datagram.clear();
+        encode_tally_frame(frame, datagram);
+        send(datagram, to);
+    } while (next < states.size());
+    ++stats_.keyframes;
+}
+
+void MulticastSink::send(const std::vector<uint8_t>& datagram, const udp::endpoint& to)
+{
+    boost::system::error_code ec;
+    socket_.send_to(net::buffer(datagram), to, 0, ec);
+    if (ec) {
+        ++stats_.send_errors;
+        return;
+    }
+    ++stats_.datagrams;
+    stats_.bytes += datagram.size();
+}
+
+MulticastSink::Stats MulticastSink::stats() const
+{
+    const std::scoped_lock lock(mutex_);
+    auto stats = stats_;
+    stats.stream_id = stream_id_;
+    stats.sequence = sequence_;
+    return stats;
+}
+
+void tag_invoke(const boost::json::value_from_tag&, boost::json::value& jv, const MulticastSink::Stats& stats)
+{
+    jv = {
+        { "stream_id", stats.stream_id },
+        { "sequence", stats.sequence },
+        { "deltas", stats.deltas },
+        { "keyframes", stats.keyframes },
+        { "datagrams", stats.datagrams },
+        { "bytes", stats.bytes },
+        { "nacks", stats.nacks },
+        { "repairs", stats.repairs },
+        { "repair_keyframes", stats.repair_keyframes },
+        { "send_errors", stats.send_errors },
+    };
+}
+
+} // namespace atem
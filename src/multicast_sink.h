@@ -0,0 +1,96 @@
+#pragma once
+
+#include "tally_frame.h"
+#include "tally_state.h"
+#include <array>
+#include <atomic>
+#include <boost/asio.hpp>
+#include <boost/json.hpp>
+#include <cstdint>
+#include <deque>
+#include <gsl/gsl>
+#include <mutex>
+#include <vector>
+
+namespace atem {
+
+struct Config;
+class TallyMonitor;
+
+/**
+ * @class MulticastSink
+ * @brief Sends tally changes to a UDP multicast group for hardware receivers.
+ *
+ * Every change is sent once as a sequence-numbered Delta datagram, however
+ * many receivers listen. A Keyframe with the full state follows at a fixed
+ * interval and after every mode change, so a receiver that joins late or
+ * loses track recovers on its own. Receivers that notice a gap send a NACK to
+ * the sink's source address; recent deltas are resent to them unicast, and
+ * older gaps are answered with a unicast keyframe. See tally_frame.h for the
+ * wire format.
+ */
+class MulticastSink final {
+public:
+    struct Stats {
+        uint32_t stream_id = 0;
+        uint32_t sequence = 0; // Last Delta sent
+        uint64_t deltas = 0;
+        uint64_t keyframes = 0;
+        uint64_t datagrams = 0;
+        uint64_t bytes = 0;
+        uint64_t nacks = 0;
+        uint64_t repairs = 0; // Deltas resent in answer to NACKs
+        uint64_t repair_keyframes = 0; // NACKs answered with a keyframe
+        uint64_t send_errors = 0; // Datagrams the socket refused; receivers repair them
+    };
+
+    // Runs on `ioc`, the monitor's io_context.
+    MulticastSink(boost::asio::io_context& ioc, const Config& config, gsl::not_null<TallyMonitor*> monitor);
+    ~MulticastSink();
+
+    // Non-copyable, non-movable
+    MulticastSink(const MulticastSink&) = delete;
+    MulticastSink& operator=(const MulticastSink&) = delete;
+    MulticastSink(MulticastSink&&) = delete;
+    MulticastSink& operator=(MulticastSink&&) = delete;
+
+    // Opens the socket, then starts the keyframe timer and the NACK listener.
+    // Throws if the socket can't be set up.
+    void start();
+    void stop();
+
+    void publish(const TallyUpdate& update);
+    // Sends a keyframe now, e.g. after a mode change.
+    void publish_keyframe();
+
+    [[nodiscard]] Stats stats() const;
+
+private:
+    void schedule_keyframe();
+    void receive_nack();
+    void handle_nack(const TallyFrame& nack, const boost::asio::ip::udp::endpoint& from);
+    // The caller holds mutex_.
+    void send_keyframe(const boost::asio::ip::udp::endpoint& to, uint8_t flags);
+    void send(const std::vector<uint8_t>& datagram, const boost::asio::ip::udp::endpoint& to);
+
+    const Config& config_;
+    TallyMonitor& monitor_;
+    const uint32_t stream_id_;
+    boost::asio::ip::udp::endpoint group_;
+    boost::asio::ip::udp::socket socket_;
+    boost::asio::steady_timer keyframe_timer_;
+    std::array<uint8_t, kMaxTallyFrameSize> nack_buffer_ {};
+    boost::asio::ip::udp::endpoint nack_sender_;
+    std::atomic<bool> running_ { false };
+
+    // Guards the socket, the sequence and the history; held while sending so
+    // datagrams leave in sequence order.
+    mutable std::mutex mutex_;
+    uint32_t sequence_ = 0;
+    std::deque<std::vector<uint8_t>> history_; // Recent deltas; the last one is `sequence_`
+    Stats stats_; // stream_id and sequence are filled in by stats()
+};
+
+void tag_invoke(const boost::json::value_from_tag&, boost::json::value& jv, const MulticastSink::Stats& stats);
+
+} // namespace atem
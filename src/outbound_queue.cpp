@@ -0,0 +1,118 @@
+#include "outbound_queue.h"
+#include <algorithm>
+#include <unordered_set>
+#include <utility>
+
+namespace atem {
+
+OutboundQueue::OutboundQueue(std::size_t limit, std::chrono::milliseconds stall_timeout)
+    : limit_(std::max<std::size_t>(limit, 1))
+    , stall_timeout_(stall_timeout)
+{
+}
+
+OutboundQueue::PushResult OutboundQueue::push(SharedPayload payload, int32_t coalesce_key, Clock::time_point now)
+{
+    const std::scoped_lock lock(mutex_);
+
+    if (!writing_) {
+        entries_.push_back({ std::move(payload), coalesce_key });
+        writing_ = true;
+        in_flight_ = 1;
+        last_progress_ = now;
+        stats_.depth = entries_.size();
+        stats_.max_depth = std::max(stats_.max_depth, stats_.depth);
+        return PushResult::Started;
+    }
+
+    if (now - last_progress_ > stall_timeout_) {
+        return PushResult::Stalled;
+    }
+
+    if (entries_.size() >= limit_) {
+        ++stats_.overflows;
+        coalesce();
+        if (entries_.size() >= limit_) {
+            // Everything left is distinct state; the client cannot catch up.
+            return PushResult::Stalled;
+        }
+    }
+
+    entries_.push_back({ std::move(payload), coalesce_key });
+    stats_.depth = entries_.size();
+    stats_.max_depth = std::max(stats_.max_depth, stats_.depth);
+    return PushResult::Queued;
+}
+
+SharedPayload OutboundQueue::complete_write()
+{
+    const std::scoped_lock lock(mutex_);
+    if (!entries_.empty()) {
+        entries_.pop_front();
+        ++stats_.written;
+    }
+    last_progress_ = Clock::now();
+    stats_.depth = entries_.size();
+    if (entries_.empty()) {
+        writing_ = false;
+        in_flight_ = 0;
+        return nullptr;
+    }
+    in_flight_ = 1;
+    return entries_.front().payload;
+}
+
+void OutboundQueue::complete_batch(std::size_t max, std::vector<SharedPayload>& next)
+{
+    next.clear();
+    const std::scoped_lock lock(mutex_);
+    const auto written = std::min(in_flight_, entries_.size());
+    entries_.erase(entries_.begin(), entries_.begin() + static_cast<std::ptrdiff_t>(written));
+    stats_.written += written;
+    last_progress_ = Clock::now();
+    stats_.depth = entries_.size();
+
+    in_flight_ = std::min(std::max<std::size_t>(max, 1), entries_.size());
+    writing_ = in_flight_ > 0;
+    next.reserve(in_flight_);
+    for (std::size_t i = 0; i < in_flight_; ++i) {
+        next.push_back(entries_[i].payload);
+    }
+}
+
+void OutboundQueue::clear()
+{
+    const std::scoped_lock lock(mutex_);
+    entries_.clear();
+    writing_ = false;
+    in_flight_ = 0;
+    stats_.depth = 0;
+}
+
+OutboundQueue::Stats OutboundQueue::stats() const
+{
+    const std::scoped_lock lock(mutex_);
+    Stats stats = stats_;
+    stats.writing = writing_;
+    stats.last_progress = last_progress_;
+    return stats;
+}
+
+void OutboundQueue::coalesce()
+{
+    // Walk from newest to oldest and keep only the first entry seen per key.
+    // The in-flight entries at the front are already being written and stay.
+    std::unordered_set<int32_t> seen;
+    std::deque<Entry> kept;
+    for (auto it = entries_.rbegin(); it != entries_.rend(); ++it) {
+        const bool in_flight = static_cast<std::size_t>(std::distance(it, entries_.rend())) <= in_flight_;
+        if (!in_flight && it->coalesce_key != kNoCoalesceKey && !seen.insert(it->coalesce_key).second) {
+            ++stats_.coalesced;
+            continue;
+        }
+        kept.push_front(std::move(*it));
+    }
+    entries_ = std::move(kept);
+}
+
+} // namespace atem
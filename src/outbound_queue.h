@@ -0,0 +1,79 @@
+#pragma once
+
+#include "sse_payload.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace atem {
+
+/**
+ * @class OutboundQueue
+ * @brief A bounded queue of framed events waiting to be written to one client.
+ *
+ * Entries may carry a coalescing key (the input id of a tally update). When the
+ * queue is full, older entries that share a key with a newer one are dropped so
+ * the client only receives the latest state of each input. A client whose
+ * writes make no progress for longer than the stall timeout is reported as
+ * stalled so the server can evict it.
+ */
+class OutboundQueue final {
+public:
+    static constexpr int32_t kNoCoalesceKey = -1;
+
+    using Clock = std::chrono::steady_clock;
+
+    enum class PushResult {
+        Started, // The queue was idle; the caller must start writing the payload.
+        Queued, // A write is in progress; the payload will follow it.
+        Stalled, // The client is stuck; nothing was queued.
+    };
+
+    struct Stats {
+        std::size_t depth = 0;
+        std::size_t max_depth = 0;
+        uint64_t written = 0;
+        uint64_t coalesced = 0; // Entries dropped because a newer state superseded them
+        uint64_t overflows = 0; // Times the queue reached its limit
+        bool writing = false; // A write is in flight
+        Clock::time_point last_progress {}; // Last time a write started or completed
+    };
+
+    OutboundQueue(std::size_t limit, std::chrono::milliseconds stall_timeout);
+
+    PushResult push(SharedPayload payload, int32_t coalesce_key, Clock::time_point now);
+    // Marks the in-flight write as finished. Returns the next payload to write,
+    // or nullptr when the queue has gone idle.
+    SharedPayload complete_write();
+    // For transports that write several payloads at once: marks the in-flight
+    // payloads as written and moves up to `max` of the waiting ones into
+    // `next`, which stays empty when the queue has gone idle. The first batch
+    // is the single payload push() reported as Started.
+    void complete_batch(std::size_t max, std::vector<SharedPayload>& next);
+    void clear();
+
+    [[nodiscard]] Stats stats() const;
+
+private:
+    struct Entry {
+        SharedPayload payload;
+        int32_t coalesce_key;
+    };
+
+    void coalesce();
+
+    const std::size_t limit_;
+    const std::chrono::milliseconds stall_timeout_;
+
+    mutable std::mutex mutex_;
+    std::deque<Entry> entries_; // The first in_flight_ entries are being written
+    std::size_t in_flight_ = 0;
+    bool writing_ = false;
+    Clock::time_point last_progress_ {};
+    Stats stats_; // writing and last_progress are filled in by stats()
+};
+
+} // namespace atem
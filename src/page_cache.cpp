@@ -0,0 +1,185 @@
+#include "page_cache.h"
+#include <array>
+#include <cstdio>
+#include <optional>
+#include <utility>
+#include <zlib.h>
+
+namespace atem {
+namespace {
+
+    // FNV-1a; only needs to change when the page does.
+    uint64_t fnv1a(std::string_view data)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (const unsigned char c : data) {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    std::string make_etag(std::string_view body)
+    {
+        std::array<char, 24> buffer {};
+        std::snprintf(buffer.data(), buffer.size(), "\"%016llx\"", static_cast<unsigned long long>(fnv1a(body)));
+        return buffer.data();
+    }
+
+    // One-shot gzip at the best compression level; pages are compressed once.
+    std::string gzip_compress(std::string_view input)
+    {
+        z_stream stream {};
+        // 15 window bits + 16 selects the gzip wrapper.
+        if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return {};
+        }
+        std::string output(deflateBound(&stream, static_cast<uLong>(input.size())), '\0');
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data())); // NOLINT(cppcoreguidelines-pro-type-const-cast)
+        stream.avail_in = static_cast<uInt>(input.size());
+        stream.next_out = reinterpret_cast<Bytef*>(output.data());
+        stream.avail_out = static_cast<uInt>(output.size());
+        const int result = deflate(&stream, Z_FINISH);
+        output.resize(stream.total_out);
+        deflateEnd(&stream);
+        return result == Z_STREAM_END ? output : std::string {};
+    }
+
+    std::string_view trim(std::string_view s)
+    {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+            s.remove_prefix(1);
+        }
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+            s.remove_suffix(1);
+        }
+        return s;
+    }
+
+    // Calls `fn` for each trimmed element of a comma-separated header value.
+    template <typename Fn>
+    void for_each_token(std::string_view list, Fn&& fn)
+    {
+        while (!list.empty()) {
+            const auto comma = list.find(',');
+            fn(trim(list.substr(0, comma)));
+            list = comma == std::string_view::npos ? std::string_view {} : list.substr(comma + 1);
+        }
+    }
+
+    // Whether a token's parameters leave it acceptable; "gzip;q=0" refuses it.
+    bool nonzero_quality(std::string_view params)
+    {
+        const auto q = params.find("q=");
+        return q == std::string_view::npos || trim(params.substr(q + 2)).find_first_not_of("0.") != std::string_view::npos;
+    }
+
+    // An explicit "gzip" token decides; "*" only applies when gzip is not
+    // named, so "gzip, *;q=0" still accepts it.
+    bool accepts_gzip(std::string_view accept_encoding)
+    {
+        std::optional<bool> gzip;
+        std::optional<bool> wildcard;
+        for_each_token(accept_encoding, [&gzip, &wildcard](std::string_view token) {
+            const auto semicolon = token.find(';');
+            const auto coding = trim(token.substr(0, semicolon));
+            const auto params = semicolon == std::string_view::npos ? std::string_view {} : token.substr(semicolon + 1);
+            if (coding == "gzip") {
+                gzip = nonzero_quality(params);
+            } else if (coding == "*") {
+                wildcard = nonzero_quality(params);
+            }
+        });
+        return gzip.value_or(wildcard.value_or(false));
+    }
+
+} // namespace
+
+PageCache::PageCache(std::size_t capacity)
+    : capacity_(capacity > 0 ? capacity : 1)
+{
+}
+
+std::shared_ptr<const PageCache::Page> PageCache::lookup(const Key& key, std::string_view content_type, const Renderer& render)
+{
+    // Rendering happens under the lock, so a burst of reloads after a mode
+    // change renders each page once and everyone else gets a hit.
+    const std::scoped_lock lock(mutex_);
+
+    if (key.mock != mock_ || key.names_version != names_version_) {
+        if (!pages_.empty()) {
+            ++stats_.invalidations;
+        }
+        pages_.clear();
+        mock_ = key.mock;
+        names_version_ = key.names_version;
+    }
+
+    if (const auto it = pages_.find(key); it != pages_.end()) {
+        ++stats_.hits;
+        return it->second;
+    }
+
+    ++stats_.misses;
+    auto page = std::make_shared<Page>();
+    page->body = render();
+    page->etag = make_etag(page->body);
+    page->content_type = content_type;
+    page->gzip_body = gzip_compress(page->body);
+    if (page->gzip_body.size() >= page->body.size()) {
+        page->gzip_body.clear();
+    }
+    // The gzip body is a different representation, so it needs its own
+    // strong validator: the identity ETag with "-gz" inside the quotes.
+    page->gzip_etag = page->etag;
+    page->gzip_etag.insert(page->gzip_etag.size() - 1, "-gz");
+
+    // The Host header is client supplied; keep the cache bounded.
+    if (pages_.size() >= capacity_) {
+        pages_.erase(pages_.begin());
+    }
+    return pages_.emplace(key, std::move(page)).first->second;
+}
+
+HttpResponse PageCache::respond(const Key& key, const HttpRequest& request, std::string_view content_type, const Renderer& render)
+{
+    const auto page = lookup(key, content_type, render);
+
+    const bool gzip = !page->gzip_body.empty() && accepts_gzip(request.get_header("Accept-Encoding"));
+    const auto& etag = gzip ? page->gzip_etag : page->etag;
+
+    HttpResponse response;
+    response.headers.emplace("ETag", etag);
+    // Always revalidate; a matching ETag costs a 304 with no body.
+    response.headers.emplace("Cache-Control", "no-cache");
+    response.headers.emplace("Vary", "Accept-Encoding");
+
+    if (etag_matches(request.get_header("If-None-Match"), etag)) {
+        response.status = 304;
+        const std::scoped_lock lock(mutex_);
+        ++stats_.not_modified;
+        stats_.bytes_saved += gzip ? page->gzip_body.size() : page->body.size();
+        return response;
+    }
+
+    response.headers.emplace("Content-Type", page->content_type);
+    if (gzip) {
+        response.headers.emplace("Content-Encoding", "gzip");
+        response.body = page->gzip_body;
+        const std::scoped_lock lock(mutex_);
+        stats_.bytes_saved += page->body.size() - page->gzip_body.size();
+    } else {
+        response.body = page->body;
+    }
+    return response;
+}
+
+PageCache::Stats PageCache::stats() const
+{
+    const std::scoped_lock lock(mutex_);
+    Stats stats = stats_;
+    stats.entries = pages_.size();
+    return stats;
+}
+
+} // namespace atem
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "http_message.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace atem {
+
+/**
+ * @class PageCache
+ * @brief Rendered HTML pages, kept with a gzip copy and an ETag.
+ *
+ * A page is rendered and compressed once per key and then served from memory.
+ * Clients that already hold the current version get a 304 with no body.
+ * Entries carry the mock mode and input-name version they were rendered
+ * with; the first lookup after either changes drops the whole cache.
+ */
+class PageCache final {
+public:
+    struct Key {
+        std::string route;
+        int id = 0;
+        bool mock = false;
+        uint64_t names_version = 0;
+        std::string host; // Pages embed the address the client used
+
+        auto operator<=>(const Key&) const = default;
+    };
+
+    struct Page {
+        std::string etag; // Quoted strong validator of the identity body
+        std::string content_type;
+        std::string body;
+        std::string gzip_body; // Empty if compression did not help
+        std::string gzip_etag; // Validator of gzip_body
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t not_modified = 0;
+        uint64_t invalidations = 0;
+        std::size_t entries = 0;
+        uint64_t bytes_saved = 0; // Body bytes not sent thanks to gzip or 304s
+    };
+
+    using Renderer = std::function<std::string()>;
+
+    explicit PageCache(std::size_t capacity);
+
+    // Returns the response for `key`, rendering the page with `render` on a
+    // miss. Honours If-None-Match and Accept-Encoding from `request`.
+    HttpResponse respond(const Key& key, const HttpRequest& request, std::string_view content_type, const Renderer& render);
+
+    [[nodiscard]] Stats stats() const;
+
+private:
+    std::shared_ptr<const Page> lookup(const Key& key, std::string_view content_type, const Renderer& render);
+
+    const std::size_t capacity_;
+
+    mutable std::mutex mutex_;
+    std::map<Key, std::shared_ptr<const Page>> pages_;
+    bool mock_ = false;
+    uint64_t names_version_ = 0;
+    Stats stats_;
+};
+
+} // namespace atem
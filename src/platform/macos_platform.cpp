@@ -1,10 +1,22 @@
 #ifdef __APPLE__
 
 #include "platform_interface.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
 #include <cstring>
 #include <fcntl.h>
 #include <iostream>
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/utsname.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 namespace platform {
 
@@ -71,6 +83,142 @@ void cleanup_network()
     std::cout << "Network cleanup complete\n";
 }
 
+bool set_tcp_dead_peer_timeout(std::uintptr_t socket, unsigned int timeout_ms)
+{
+    const int fd = static_cast<int>(socket);
+    const int seconds = std::max(1, static_cast<int>(timeout_ms / 1000));
+    // Idle for half the budget, then three probes spread over the other half.
+    const int on = 1;
+    const int idle = std::max(1, seconds / 2);
+    const int interval = std::max(1, seconds / 6);
+    const int count = 3;
+
+    if (setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on)) != 0
+        || setsockopt(fd, IPPROTO_TCP, TCP_KEEPALIVE, &idle, sizeof(idle)) != 0
+        || setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval)) != 0
+        || setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count)) != 0
+        // Give up on unacknowledged data after the same budget.
+        || setsockopt(fd, IPPROTO_TCP, TCP_RXT_CONNDROPTIME, &seconds, sizeof(seconds)) != 0) {
+        set_last_error("Failed to set TCP dead peer timeout");
+        return false;
+    }
+    return true;
+}
+
+bool set_reuse_port(std::uintptr_t socket)
+{
+    const int fd = static_cast<int>(socket);
+    const int on = 1;
+#ifdef SO_REUSEPORT_LB
+    // Load-balancing variant where the kernel provides one.
+    const int option = SO_REUSEPORT_LB;
+#else
+    const int option = SO_REUSEPORT;
+#endif
+    if (setsockopt(fd, SOL_SOCKET, option, &on, sizeof(on)) != 0) {
+        set_last_error("Failed to set SO_REUSEPORT");
+        return false;
+    }
+    return true;
+}
+
+void* map_shared_memory(std::size_t size)
+{
+    // Anonymous shared mappings are inherited across fork().
+    void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
+    if (address == MAP_FAILED) {
+        set_last_error("Failed to map shared memory");
+        return nullptr;
+    }
+    return address;
+}
+
+void unmap_shared_memory(void* address, std::size_t size)
+{
+    if (address != nullptr) {
+        munmap(address, size);
+    }
+}
+
+long start_worker_process(const std::function<int()>& worker)
+{
+    std::cout.flush();
+    std::cerr.flush();
+    const pid_t pid = fork();
+    if (pid < 0) {
+        set_last_error("Failed to fork worker process");
+        return -1;
+    }
+    if (pid > 0) {
+        return pid;
+    }
+
+    int code = 1;
+    try {
+        code = worker();
+    } catch (const std::exception& e) {
+        std::cerr << "Worker " << getpid() << " failed: " << e.what() << "\n";
+    }
+    std::cout.flush();
+    std::cerr.flush();
+    // Skip the parent's static destructors and atexit handlers.
+    _exit(code);
+}
+
+bool stop_worker_process(long pid)
+{
+    if (kill(static_cast<pid_t>(pid), SIGTERM) != 0) {
+        set_last_error("Failed to signal worker process");
+        return false;
+    }
+    return true;
+}
+
+int wait_worker_process(long pid)
+{
+    int status = 0;
+    while (waitpid(static_cast<pid_t>(pid), &status, 0) < 0) {
+        if (errno != EINTR) {
+            set_last_error("Failed to wait for worker process");
+            return -1;
+        }
+    }
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    }
+    return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : -1;
+}
+
+std::size_t get_resident_memory()
+{
+    mach_task_basic_info_data_t info {};
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return static_cast<std::size_t>(info.resident_size);
+}
+
+bool set_current_thread_name(const std::string& name)
+{
+    // macOS only names the calling thread, up to 63 bytes.
+    return pthread_setname_np(name.c_str()) == 0;
+}
+
+bool pin_current_thread(int cpu)
+{
+    if (cpu < 0) {
+        return false;
+    }
+    // There is no hard affinity on macOS. Threads with different affinity
+    // tags are kept on different cores where the scheduler can, on Intel;
+    // Apple silicon does not support the policy.
+    thread_affinity_policy_data_t policy { cpu + 1 };
+    const auto thread = pthread_mach_thread_np(pthread_self());
+    return thread_policy_set(thread, THREAD_AFFINITY_POLICY, reinterpret_cast<thread_policy_t>(&policy), THREAD_AFFINITY_POLICY_COUNT)
+        == KERN_SUCCESS;
+}
+
 std::string get_last_error()
 {
     return last_error_message;
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <string>
 
 namespace platform {
@@ -32,6 +35,82 @@ bool initialize_network();
  */
 void cleanup_network();
 
+/**
+ * Have the kernel drop a TCP connection whose peer has gone away
+ * Enables keepalive probes and bounds how long sent data may stay unacknowledged.
+ * @param socket native socket handle
+ * @param timeout_ms time after which a silent peer is considered dead
+ * @return true if the socket options were applied
+ */
+bool set_tcp_dead_peer_timeout(std::uintptr_t socket, unsigned int timeout_ms);
+
+/**
+ * Let several processes bind the same listen port, with the kernel spreading
+ * new connections across them
+ * @param socket native socket handle, not yet bound
+ * @return true if the socket option was applied
+ */
+bool set_reuse_port(std::uintptr_t socket);
+
+/**
+ * Map zeroed memory that stays shared with worker processes started afterwards
+ * @param size size of the mapping in bytes
+ * @return the mapping, or nullptr if shared memory is unavailable
+ */
+void* map_shared_memory(std::size_t size);
+
+/**
+ * Release memory returned by map_shared_memory
+ * @param address start of the mapping
+ * @param size size passed to map_shared_memory
+ */
+void unmap_shared_memory(void* address, std::size_t size);
+
+/**
+ * Start a worker process that runs `worker` and exits with its result
+ * The worker starts as a copy of the calling process, so call this before
+ * starting any threads.
+ * @param worker entry point of the worker process
+ * @return process id of the worker, or -1 if worker processes are unsupported
+ */
+long start_worker_process(const std::function<int()>& worker);
+
+/**
+ * Ask a worker process to shut down
+ * @param pid process id returned by start_worker_process
+ * @return true if the request was delivered
+ */
+bool stop_worker_process(long pid);
+
+/**
+ * Wait for a worker process to exit
+ * @param pid process id returned by start_worker_process
+ * @return the worker's exit code
+ */
+int wait_worker_process(long pid);
+
+/**
+ * Get the physical memory currently used by this process
+ * @return resident set size in bytes, or 0 if unavailable
+ */
+std::size_t get_resident_memory();
+
+/**
+ * Name the calling thread, for debuggers, profilers and process listings
+ * @param name thread name; may be truncated (15 characters on some systems)
+ * @return true if the name was applied
+ */
+bool set_current_thread_name(const std::string& name);
+
+/**
+ * Keep the calling thread on one CPU
+ * On macOS this is only an affinity hint, which Apple silicon ignores.
+ * Does not set the last error, so threads may call it concurrently.
+ * @param cpu zero-based logical CPU number
+ * @return true if the scheduler accepted it
+ */
+bool pin_current_thread(int cpu);
+
 /**
  * Get the last platform-specific error message
  * @return error message string
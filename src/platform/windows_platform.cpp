@@ -3,11 +3,15 @@
 #include "platform_interface.h"
 #include <iostream>
 #include <sstream>
+#include <string>
 #include <windows.h>
 #include <winsock2.h>
+#include <mstcpip.h>
+#include <psapi.h>
 #include <ws2tcpip.h>
 
 #pragma comment(lib, "ws2_32.lib")
+#pragma comment(lib, "psapi.lib")
 
 namespace platform {
 
@@ -125,6 +129,88 @@ void cleanup_network()
     }
 }
 
+bool set_tcp_dead_peer_timeout(std::uintptr_t socket, unsigned int timeout_ms)
+{
+    const auto s = static_cast<SOCKET>(socket);
+    // Idle for half the budget, then probe; Windows sends ten probes.
+    tcp_keepalive keepalive {};
+    keepalive.onoff = 1;
+    keepalive.keepalivetime = timeout_ms >= 2000 ? timeout_ms / 2 : 1000;
+    keepalive.keepaliveinterval = timeout_ms >= 2000 ? timeout_ms / 20 : 100;
+    DWORD returned = 0;
+    if (WSAIoctl(s, SIO_KEEPALIVE_VALS, &keepalive, sizeof(keepalive), nullptr, 0, &returned, nullptr, nullptr) != 0) {
+        set_winsock_error("Failed to enable TCP keepalive");
+        return false;
+    }
+
+    // Give up on unacknowledged data after the same budget.
+    const DWORD seconds = timeout_ms >= 1000 ? timeout_ms / 1000 : 1;
+    if (setsockopt(s, IPPROTO_TCP, TCP_MAXRT, reinterpret_cast<const char*>(&seconds), sizeof(seconds)) != 0) {
+        set_winsock_error("Failed to set TCP retransmission timeout");
+        return false;
+    }
+    return true;
+}
+
+bool set_reuse_port(std::uintptr_t /*socket*/)
+{
+    // SO_REUSEADDR on Windows lets sockets steal a port rather than share it.
+    last_error_message = "SO_REUSEPORT is not supported on Windows";
+    return false;
+}
+
+void* map_shared_memory(std::size_t /*size*/)
+{
+    last_error_message = "Shared memory for worker processes is not supported on Windows";
+    return nullptr;
+}
+
+void unmap_shared_memory(void* /*address*/, std::size_t /*size*/)
+{
+}
+
+long start_worker_process(const std::function<int()>& /*worker*/)
+{
+    // There is no fork(); worker processes would have to re-run the program.
+    last_error_message = "Worker processes are not supported on Windows";
+    return -1;
+}
+
+bool stop_worker_process(long /*pid*/)
+{
+    return false;
+}
+
+int wait_worker_process(long /*pid*/)
+{
+    return -1;
+}
+
+std::size_t get_resident_memory()
+{
+    PROCESS_MEMORY_COUNTERS counters {};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return counters.WorkingSetSize;
+}
+
+bool set_current_thread_name(const std::string& name)
+{
+    // Thread names are UTF-16; ours are ASCII.
+    const std::wstring wide(name.begin(), name.end());
+    return SUCCEEDED(SetThreadDescription(GetCurrentThread(), wide.c_str()));
+}
+
+bool pin_current_thread(int cpu)
+{
+    // Without processor groups, a thread runs on one of the first 64 CPUs.
+    if (cpu < 0 || cpu >= static_cast<int>(sizeof(DWORD_PTR) * 8)) {
+        return false;
+    }
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR { 1 } << cpu) != 0;
+}
+
 std::string get_last_error()
 {
     return last_error_message;
@@ -0,0 +1,168 @@
+#include "session_registry.h"
+#include <algorithm>
+#include <utility>
+
+namespace atem {
+namespace {
+
+    // Removes `client` from `clients` without preserving order.
+    void erase_client(SessionRegistry::ClientList& clients, const std::shared_ptr<SseClient>& client)
+    {
+        const auto it = std::find(clients.begin(), clients.end(), client);
+        if (it != clients.end()) {
+            *it = std::move(clients.back());
+            clients.pop_back();
+        }
+    }
+
+    void unindex(SessionRegistry::Snapshot& snapshot, const SessionRegistry::Entry& entry)
+    {
+        if (entry.encoding != StreamEncoding::Identity) {
+            const auto it = snapshot.channels.find({ entry.encoding, entry.format, entry.inputs });
+            if (it != snapshot.channels.end()) {
+                erase_client(it->second, entry.client);
+                if (it->second.empty()) {
+                    snapshot.channels.erase(it);
+                }
+            }
+            return;
+        }
+        if (entry.format == StreamFormat::Bitmap) {
+            erase_client(snapshot.bitmap, entry.client);
+            return;
+        }
+        if (entry.format == StreamFormat::Cbor) {
+            std::erase_if(snapshot.binary, [&entry](const SessionRegistry::Entry& other) { return other.client == entry.client; });
+            return;
+        }
+        if (entry.inputs.empty()) {
+            erase_client(snapshot.unfiltered, entry.client);
+            return;
+        }
+        for (const auto key : entry.inputs) {
+            const auto it = snapshot.by_input.find(key);
+            if (it == snapshot.by_input.end()) {
+                continue;
+            }
+            erase_client(it->second, entry.client);
+            if (it->second.empty()) {
+                snapshot.by_input.erase(it);
+            }
+        }
+    }
+
+} // namespace
+
+SessionRegistry::SessionRegistry()
+    : current_(std::make_shared<const Snapshot>())
+{
+}
+
+template <typename Mutator>
+bool SessionRegistry::update(Mutator&& mutate)
+{
+    const std::scoped_lock write_lock(write_mutex_);
+    // Writers are serialized, so `current_` only changes under this lock and
+    // can be read without the publish lock.
+    auto next = std::make_shared<Snapshot>(*current_);
+    if (!mutate(*next)) {
+        return false; // Nothing changed; keep the existing snapshot.
+    }
+    std::shared_ptr<const Snapshot> published = std::move(next);
+    {
+        const std::scoped_lock publish_lock(publish_mutex_);
+        current_.swap(published);
+    }
+    // The previous snapshot is released here, outside the publish lock.
+    return true;
+}
+
+void SessionRegistry::add(const std::shared_ptr<SseClient>& client, std::vector<int32_t> inputs, StreamEncoding encoding, StreamFormat format)
+{
+    std::sort(inputs.begin(), inputs.end());
+    inputs.erase(std::unique(inputs.begin(), inputs.end()), inputs.end());
+
+    update([&client, &inputs, encoding, format](Snapshot& snapshot) {
+        if (encoding != StreamEncoding::Identity) {
+            snapshot.channels[{ encoding, format, inputs }].push_back(client);
+            snapshot.entries.push_back({ client, std::move(inputs), encoding, format });
+            return true;
+        }
+        if (format == StreamFormat::Bitmap) {
+            snapshot.bitmap.push_back(client);
+            snapshot.entries.push_back({ client, std::move(inputs), encoding, format });
+            return true;
+        }
+        if (format == StreamFormat::Cbor) {
+            snapshot.binary.push_back({ client, inputs, encoding, format });
+            snapshot.entries.push_back({ client, std::move(inputs), encoding, format });
+            return true;
+        }
+        if (inputs.empty()) {
+            snapshot.unfiltered.push_back(client);
+        }
+        for (const auto key : inputs) {
+            snapshot.by_input[key].push_back(client);
+        }
+        snapshot.entries.push_back({ client, std::move(inputs), encoding, format });
+        return true;
+    });
+}
+
+bool SessionRegistry::remove(const std::shared_ptr<SseClient>& client)
+{
+    return update([&client](Snapshot& snapshot) {
+        const auto it = std::find_if(snapshot.entries.begin(), snapshot.entries.end(),
+            [&client](const Entry& entry) { return entry.client == client; });
+        if (it == snapshot.entries.end()) {
+            return false;
+        }
+        unindex(snapshot, *it);
+        // Order does not matter; swap-and-pop keeps removal cheap.
+        *it = std::move(snapshot.entries.back());
+        snapshot.entries.pop_back();
+        return true;
+    });
+}
+
+void SessionRegistry::remove_closed()
+{
+    update([](Snapshot& snapshot) {
+        // A client can close at any moment, so ask each one once: the
+        // entries that are unindexed are exactly the ones erased.
+        const auto closed = std::stable_partition(snapshot.entries.begin(), snapshot.entries.end(),
+            [](const Entry& entry) { return entry.client->is_open(); });
+        if (closed == snapshot.entries.end()) {
+            return false;
+        }
+        for (auto it = closed; it != snapshot.entries.end(); ++it) {
+            unindex(snapshot, *it);
+        }
+        snapshot.entries.erase(closed, snapshot.entries.end());
+        return true;
+    });
+}
+
+std::shared_ptr<const SessionRegistry::Snapshot> SessionRegistry::clear()
+{
+    const std::scoped_lock write_lock(write_mutex_);
+    std::shared_ptr<const Snapshot> previous = std::make_shared<const Snapshot>();
+    {
+        const std::scoped_lock publish_lock(publish_mutex_);
+        current_.swap(previous);
+    }
+    return previous;
+}
+
+std::shared_ptr<const SessionRegistry::Snapshot> SessionRegistry::snapshot() const
+{
+    const std::scoped_lock publish_lock(publish_mutex_);
+    return current_;
+}
+
+std::size_t SessionRegistry::size() const
+{
+    return snapshot()->size();
+}
+
+} // namespace atem
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "http_message.h"
+#include "sse_compression.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace atem {
+
+// What an event stream carries for tally changes.
+enum class StreamFormat : uint8_t {
+    Events, // tally_update / tally_batch for the inputs that changed
+    Bitmap, // tally_bitmap with the state of every input
+    Cbor, // /ws: the per-input events as CBOR items
+};
+
+/**
+ * @class SessionRegistry
+ * @brief The set of open event streams, published as immutable snapshots.
+ *
+ * Connects and disconnects build a new snapshot and swap it in. Broadcasters
+ * only copy the current snapshot pointer, so they never wait for a connect or
+ * disconnect, and a slow broadcast never delays a new client.
+ *
+ * Each snapshot also indexes clients by the inputs they subscribed to, so a
+ * tally update only visits the clients that asked for that input. Compressed
+ * streams are indexed by channel instead: every client in a channel receives
+ * the same bytes, so one compressor serves all of them.
+ */
+class SessionRegistry final {
+public:
+    using ClientList = std::vector<std::shared_ptr<SseClient>>;
+
+    // Compressed streams with the same encoding, format and subscription.
+    struct ChannelKey {
+        StreamEncoding encoding = StreamEncoding::Identity;
+        StreamFormat format = StreamFormat::Events;
+        std::vector<int32_t> inputs; // Sorted tally keys; empty means every input
+
+        [[nodiscard]] bool receives(int32_t coalesce_key) const
+        {
+            return inputs.empty() || coalesce_key == OutboundQueue::kNoCoalesceKey
+                || std::binary_search(inputs.begin(), inputs.end(), coalesce_key);
+        }
+
+        auto operator<=>(const ChannelKey&) const = default;
+    };
+
+    struct Entry {
+        std::shared_ptr<SseClient> client;
+        std::vector<int32_t> inputs; // Tally keys; empty means every input
+        StreamEncoding encoding = StreamEncoding::Identity;
+        StreamFormat format = StreamFormat::Events;
+    };
+
+    struct Snapshot {
+        std::vector<Entry> entries;
+        // Uncompressed clients only; compressed ones are in `channels`.
+        ClientList unfiltered; // Clients subscribed to every input
+        std::unordered_map<int32_t, ClientList> by_input; // By tally key
+        ClientList bitmap; // Clients that take tally_bitmap instead
+        std::vector<Entry> binary; // /ws clients, with their subscriptions
+        std::map<ChannelKey, ClientList> channels;
+
+        [[nodiscard]] bool empty() const
+        {
+            return entries.empty();
+        }
+
+        [[nodiscard]] std::size_t size() const
+        {
+            return entries.size();
+        }
+
+        template <typename Fn>
+        void for_each(Fn&& fn) const
+        {
+            for (const auto& entry : entries) {
+                fn(entry.client);
+            }
+        }
+
+        [[nodiscard]] bool has_bitmap_clients() const
+        {
+            return !bitmap.empty()
+                || std::any_of(channels.begin(), channels.end(), [](const auto& item) { return item.first.format == StreamFormat::Bitmap; });
+        }
+
+        // Visits every client that takes uncompressed per-input events.
+        template <typename Fn>
+        void for_each_uncompressed(Fn&& fn) const
+        {
+            for (const auto& entry : entries) {
+                if (entry.encoding == StreamEncoding::Identity && entry.format == StreamFormat::Events) {
+                    fn(entry.client);
+                }
+            }
+        }
+
+        // Visits every uncompressed client that should receive updates for
+        // the input with tally key `key`.
+        template <typename Fn>
+        void for_each_subscriber(int32_t key, Fn&& fn) const
+        {
+            for (const auto& client : unfiltered) {
+                fn(client);
+            }
+            if (const auto it = by_input.find(key); it != by_input.end()) {
+                for (const auto& client : it->second) {
+                    fn(client);
+                }
+            }
+        }
+    };
+
+    SessionRegistry();
+
+    // `inputs` lists the tally keys of the inputs the client subscribed to;
+    // empty means all.
+    void add(const std::shared_ptr<SseClient>& client, std::vector<int32_t> inputs = {},
+        StreamEncoding encoding = StreamEncoding::Identity, StreamFormat format = StreamFormat::Events);
+    // Returns false if the client was not registered.
+    bool remove(const std::shared_ptr<SseClient>& client);
+    void remove_closed();
+    // Empties the registry and returns the snapshot that was current.
+    std::shared_ptr<const Snapshot> clear();
+
+    [[nodiscard]] std::shared_ptr<const Snapshot> snapshot() const;
+    [[nodiscard]] std::size_t size() const;
+
+private:
+    // Returns whether a new snapshot was published.
+    template <typename Mutator>
+    bool update(Mutator&& mutate);
+
+    // Serializes writers. Never taken on the broadcast path.
+    std::mutex write_mutex_;
+    // Guards only the pointer copy and swap of `current_`.
+    mutable std::mutex publish_mutex_;
+    std::shared_ptr<const Snapshot> current_;
+};
+
+} // namespace atem
@@ -0,0 +1,249 @@
+#include "shared_tally_ring.h"
+#include "platform_interface.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+namespace atem {
+
+// Everything below is placed in shared memory, so it holds no pointers and
+// only lock-free (address-free) atomics.
+struct SharedTallyRing::Layout {
+    std::atomic<uint32_t> ready;
+    std::atomic<uint64_t> head; // Position of the last record appended; records start at 1
+    std::atomic<uint64_t> table_sequence; // Odd while the table is being written
+    uint32_t input_count;
+    bool mock;
+    std::atomic<uint16_t> doorbells[kMaxWorkers]; // NOLINT(cppcoreguidelines-avoid-c-arrays)
+};
+
+struct SharedTallyRing::TableEntry {
+    uint16_t input_id;
+    uint8_t switcher;
+    bool program;
+    bool preview;
+    char short_name[kMaxNameLength + 1]; // NOLINT(cppcoreguidelines-avoid-c-arrays)
+    char long_name[2 * (kMaxNameLength + 1)]; // NOLINT(cppcoreguidelines-avoid-c-arrays)
+};
+
+struct SharedTallyRing::Slot {
+    std::atomic<uint64_t> sequence; // 2 * position once written; odd while being written
+    Record record;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free
+        && std::atomic<uint16_t>::is_always_lock_free,
+    "shared memory atomics must be lock-free");
+
+namespace {
+
+    constexpr std::size_t align_up(std::size_t size, std::size_t alignment)
+    {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    void copy_name(char* out, std::size_t out_size, const std::string& name)
+    {
+        const auto length = std::min(name.size(), out_size - 1);
+        std::memcpy(out, name.data(), length);
+        out[length] = '\0';
+    }
+
+    // Copies shared bytes whose sequence counter the caller re-checks
+    // afterwards; a torn copy is discarded.
+    template <typename T>
+    T copy_shared(const T& shared)
+    {
+        T copy;
+        std::memcpy(static_cast<void*>(&copy), static_cast<const void*>(&shared), sizeof(T));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return copy;
+    }
+
+}
+
+SharedTallyRing::SharedTallyRing(std::size_t capacity)
+    : capacity_(std::max<std::size_t>(capacity, 16))
+{
+    const auto table_offset = align_up(sizeof(Layout), alignof(TableEntry));
+    const auto slots_offset = align_up(table_offset + kMaxInputs * sizeof(TableEntry), alignof(Slot));
+    size_ = slots_offset + capacity_ * sizeof(Slot);
+
+    auto* memory = static_cast<std::byte*>(platform::map_shared_memory(size_));
+    if (memory == nullptr) {
+        throw std::runtime_error("Cannot create the shared tally ring: " + platform::get_last_error());
+    }
+    // The mapping is zeroed, which is a valid initial state for every field.
+    layout_ = new (memory) Layout {};
+    table_ = new (memory + table_offset) TableEntry[kMaxInputs] {};
+    slots_ = new (memory + slots_offset) Slot[capacity_] {};
+}
+
+SharedTallyRing::~SharedTallyRing()
+{
+    platform::unmap_shared_memory(layout_, size_);
+}
+
+void SharedTallyRing::publish_inputs(const std::vector<InputInfo>& inputs, const std::function<std::vector<TallyState>()>& current_states, bool is_mock)
+{
+    const std::scoped_lock lock(write_mutex_);
+    const auto states = current_states();
+    const auto sequence = layout_->table_sequence.load(std::memory_order_relaxed);
+    layout_->table_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    table_index_.clear();
+    const auto count = std::min(inputs.size(), kMaxInputs);
+    for (std::size_t i = 0; i < count; ++i) {
+        auto& entry = table_[i];
+        entry.input_id = inputs[i].id;
+        entry.switcher = inputs[i].switcher;
+        entry.program = false;
+        entry.preview = false;
+        copy_name(entry.short_name, sizeof(entry.short_name), inputs[i].short_name);
+        copy_name(entry.long_name, sizeof(entry.long_name), inputs[i].long_name);
+        table_index_[tally_key(entry.switcher, entry.input_id)] = i;
+    }
+    for (const auto& state : states) {
+        if (const auto it = table_index_.find(state.key()); it != table_index_.end()) {
+            table_[it->second].program = state.program;
+            table_[it->second].preview = state.preview;
+        }
+    }
+    layout_->input_count = static_cast<uint32_t>(count);
+    layout_->mock = is_mock;
+
+    // Workers that started before this table reload it when they reach the
+    // record; later ones start after it.
+    Record record;
+    record.kind = Record::Kind::Inputs;
+    record.mock = is_mock;
+    append(record);
+
+    layout_->table_sequence.store(sequence + 2, std::memory_order_release);
+    layout_->ready.store(1, std::memory_order_release);
+}
+
+void SharedTallyRing::publish_tally(const TallyUpdate& update)
+{
+    Record record;
+    record.kind = Record::Kind::Tally;
+    record.switcher = update.switcher;
+    record.input_id = update.input_id;
+    record.program = update.program;
+    record.preview = update.preview;
+    record.mock = update.mock;
+    copy_name(record.short_name, sizeof(record.short_name), update.short_name);
+
+    const std::scoped_lock lock(write_mutex_);
+    // The table and the ring change together, so a reader's copy of the table
+    // matches the ring position it resumes from.
+    const auto sequence = layout_->table_sequence.load(std::memory_order_relaxed);
+    layout_->table_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    if (const auto it = table_index_.find(update.key()); it != table_index_.end()) {
+        auto& entry = table_[it->second];
+        entry.program = update.program;
+        entry.preview = update.preview;
+        std::memcpy(entry.short_name, record.short_name, sizeof(entry.short_name));
+    }
+    append(record);
+    layout_->table_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void SharedTallyRing::publish_mode(bool is_mock)
+{
+    Record record;
+    record.kind = Record::Kind::Mode;
+    record.mock = is_mock;
+
+    const std::scoped_lock lock(write_mutex_);
+    const auto sequence = layout_->table_sequence.load(std::memory_order_relaxed);
+    layout_->table_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    layout_->mock = is_mock;
+    append(record);
+    layout_->table_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void SharedTallyRing::append(const Record& record)
+{
+    const auto position = layout_->head.load(std::memory_order_relaxed) + 1;
+    auto& slot = slots_[position % capacity_];
+    slot.sequence.store(2 * position - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.record = record;
+    slot.sequence.store(2 * position, std::memory_order_release);
+    layout_->head.store(position, std::memory_order_release);
+}
+
+bool SharedTallyRing::is_ready() const
+{
+    return layout_->ready.load(std::memory_order_acquire) != 0;
+}
+
+uint64_t SharedTallyRing::read_state(std::vector<InputInfo>& inputs, std::vector<TallyState>& states, bool& is_mock) const
+{
+    for (;;) {
+        const auto before = layout_->table_sequence.load(std::memory_order_acquire);
+        if ((before & 1) != 0) {
+            continue; // The supervisor is mid-update
+        }
+        const auto count = std::min<std::size_t>(layout_->input_count, kMaxInputs);
+        inputs.clear();
+        states.clear();
+        inputs.reserve(count);
+        states.reserve(count);
+        const auto now = std::chrono::system_clock::now();
+        for (std::size_t i = 0; i < count; ++i) {
+            const auto entry = copy_shared(table_[i]);
+            // The names are only trusted once the sequence check passes, so
+            // never read past their buffers.
+            const std::string short_name(entry.short_name, strnlen(entry.short_name, sizeof(entry.short_name)));
+            const std::string long_name(entry.long_name, strnlen(entry.long_name, sizeof(entry.long_name)));
+            inputs.push_back({ entry.input_id, short_name, long_name, entry.switcher });
+            states.emplace_back(entry.input_id, short_name, entry.program, entry.preview, now).switcher = entry.switcher;
+        }
+        is_mock = layout_->mock;
+        const auto head = layout_->head.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (layout_->table_sequence.load(std::memory_order_relaxed) == before) {
+            return head + 1;
+        }
+    }
+}
+
+SharedTallyRing::ReadResult SharedTallyRing::read(uint64_t position, Record& record) const
+{
+    if (position > layout_->head.load(std::memory_order_acquire)) {
+        return ReadResult::Empty;
+    }
+    const auto& slot = slots_[position % capacity_];
+    const auto before = slot.sequence.load(std::memory_order_acquire);
+    if (before != 2 * position) {
+        return ReadResult::Overrun;
+    }
+    record = copy_shared(slot.record);
+    if (slot.sequence.load(std::memory_order_relaxed) != before) {
+        return ReadResult::Overrun;
+    }
+    record.short_name[kMaxNameLength] = '\0';
+    return ReadResult::Ok;
+}
+
+void SharedTallyRing::set_doorbell(std::size_t worker, uint16_t port)
+{
+    if (worker < kMaxWorkers) {
+        layout_->doorbells[worker].store(port, std::memory_order_release);
+    }
+}
+
+uint16_t SharedTallyRing::doorbell(std::size_t worker) const
+{
+    return worker < kMaxWorkers ? layout_->doorbells[worker].load(std::memory_order_acquire) : 0;
+}
+
+} // namespace atem
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "atem/iatem_connection.h"
+#include "tally_state.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace atem {
+
+/**
+ * @class SharedTallyRing
+ * @brief Tally state and changes, published by one process and read by many.
+ *
+ * Lives in memory shared with the worker processes. The supervisor writes
+ * every input's current state to a table and appends each change to a ring;
+ * workers copy the table once and then follow the ring. There is only one
+ * writer, so nothing is locked across processes: the table and every ring
+ * slot carry a sequence counter that is odd while being written, and a reader
+ * that sees it change under it copies again. A worker that falls a whole ring
+ * behind notices that its next slot has been overwritten and re-reads the
+ * table.
+ */
+class SharedTallyRing final {
+public:
+    static constexpr std::size_t kMaxInputs = 4096;
+    static constexpr std::size_t kMaxWorkers = 64;
+    static constexpr std::size_t kMaxNameLength = 31;
+
+    struct Record {
+        enum class Kind : uint8_t {
+            Tally,
+            Mode,
+            Inputs, // The input list changed; re-read the table
+        };
+
+        Kind kind = Kind::Tally;
+        bool program = false;
+        bool preview = false;
+        bool mock = false;
+        uint8_t switcher = 0;
+        uint16_t input_id = 0;
+        char short_name[kMaxNameLength + 1] {}; // NOLINT(cppcoreguidelines-avoid-c-arrays)
+    };
+
+    enum class ReadResult {
+        Ok,
+        Empty, // Nothing new yet
+        Overrun, // The record was overwritten before it was read
+    };
+
+    // Maps the shared memory; call before starting the worker processes.
+    // Throws if shared memory is unavailable.
+    explicit SharedTallyRing(std::size_t capacity);
+    ~SharedTallyRing();
+
+    // Non-copyable, non-movable
+    SharedTallyRing(const SharedTallyRing&) = delete;
+    SharedTallyRing& operator=(const SharedTallyRing&) = delete;
+    SharedTallyRing(SharedTallyRing&&) = delete;
+    SharedTallyRing& operator=(SharedTallyRing&&) = delete;
+
+    // Writer side, used by the supervisor. Safe to call from several threads.
+    // publish_inputs fills the table and marks the ring ready for workers;
+    // called again when a switcher's inputs change, it tells the workers to
+    // re-read the table. `current_states` is called with the writer lock
+    // held, so a change that it misses is published to the ring after the
+    // table.
+    void publish_inputs(const std::vector<InputInfo>& inputs, const std::function<std::vector<TallyState>()>& current_states, bool is_mock);
+    void publish_tally(const TallyUpdate& update);
+    void publish_mode(bool is_mock);
+
+    // Reader side, used by the workers.
+    [[nodiscard]] bool is_ready() const;
+    // Copies the table. Returns the ring position of the first change it
+    // does not include.
+    uint64_t read_state(std::vector<InputInfo>& inputs, std::vector<TallyState>& states, bool& is_mock) const;
+    ReadResult read(uint64_t position, Record& record) const;
+
+    // Each worker publishes the loopback UDP port it wants to be woken on;
+    // 0 for none.
+    void set_doorbell(std::size_t worker, uint16_t port);
+    [[nodiscard]] uint16_t doorbell(std::size_t worker) const;
+
+private:
+    struct Layout;
+    struct Slot;
+    struct TableEntry;
+
+    // The caller holds write_mutex_.
+    void append(const Record& record);
+
+    const std::size_t capacity_;
+    std::size_t size_ = 0;
+    Layout* layout_ = nullptr;
+    TableEntry* table_ = nullptr;
+    Slot* slots_ = nullptr;
+
+    // Writer-process state only.
+    std::mutex write_mutex_;
+    std::unordered_map<int32_t, std::size_t> table_index_; // By tally_key()
+};
+
+} // namespace atem
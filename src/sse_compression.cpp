@@ -0,0 +1,151 @@
+#include "sse_compression.h"
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <zlib.h>
+
+namespace atem {
+namespace {
+
+    std::string_view trim(std::string_view s)
+    {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+            s.remove_prefix(1);
+        }
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+            s.remove_suffix(1);
+        }
+        return s;
+    }
+
+    // Returns the q-value the client gave `coding`, or -1 if it did not list it.
+    double coding_quality(std::string_view accept_encoding, std::string_view coding)
+    {
+        double quality = -1.0;
+        while (!accept_encoding.empty()) {
+            const auto comma = accept_encoding.find(',');
+            const auto token = trim(accept_encoding.substr(0, comma));
+            accept_encoding = comma == std::string_view::npos ? std::string_view {} : accept_encoding.substr(comma + 1);
+
+            const auto semicolon = token.find(';');
+            if (trim(token.substr(0, semicolon)) != coding) {
+                continue;
+            }
+            quality = 1.0;
+            if (semicolon != std::string_view::npos) {
+                const auto params = token.substr(semicolon + 1);
+                if (const auto q = params.find("q="); q != std::string_view::npos) {
+                    try {
+                        quality = std::stod(std::string(trim(params.substr(q + 2))));
+                    } catch (const std::exception&) {
+                        quality = 0.0;
+                    }
+                }
+            }
+        }
+        return quality;
+    }
+
+    // Memory per compressor: 2^15 window plus 2^(8+9) of hash and buffers.
+    constexpr int kWindowBits = 15;
+    constexpr int kMemLevel = 8;
+
+} // namespace
+
+StreamEncoding negotiate_stream_encoding(std::string_view accept_encoding)
+{
+    if (coding_quality(accept_encoding, "gzip") > 0.0) {
+        return StreamEncoding::Gzip;
+    }
+    if (coding_quality(accept_encoding, "deflate") > 0.0) {
+        return StreamEncoding::Deflate;
+    }
+    return StreamEncoding::Identity;
+}
+
+std::string_view content_encoding_name(StreamEncoding encoding)
+{
+    switch (encoding) {
+    case StreamEncoding::Gzip:
+        return "gzip";
+    case StreamEncoding::Deflate:
+        return "deflate";
+    case StreamEncoding::Identity:
+        break;
+    }
+    return {};
+}
+
+const SharedPayload& compressed_heartbeat()
+{
+    // BFINAL=0, BTYPE=00 (stored), LEN=0, NLEN=0xffff.
+    static const SharedPayload payload = std::make_shared<const PayloadBytes>(PayloadBytes { 0x00, 0x00, 0x00, 0xff, 0xff });
+    return payload;
+}
+
+StreamCompressor::StreamCompressor(StreamEncoding encoding)
+    : encoding_(encoding)
+    , stream_(std::make_unique<z_stream_s>())
+{
+    // Raw deflate; header() supplies the gzip or zlib wrapper by hand, and
+    // the never-ending stream has no trailer.
+    if (deflateInit2(stream_.get(), Z_DEFAULT_COMPRESSION, Z_DEFLATED, -kWindowBits, kMemLevel, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw std::runtime_error("deflateInit2 failed");
+    }
+}
+
+StreamCompressor::~StreamCompressor()
+{
+    deflateEnd(stream_.get());
+}
+
+SharedPayload StreamCompressor::header() const
+{
+    if (encoding_ == StreamEncoding::Gzip) {
+        // ID1 ID2, CM=deflate, no flags, no mtime, no extra flags, OS unknown.
+        return std::make_shared<const PayloadBytes>(PayloadBytes { 0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff });
+    }
+    // CMF: deflate with a 32 KB window. FLG: default level, check bits.
+    return std::make_shared<const PayloadBytes>(PayloadBytes { 0x78, 0x9c });
+}
+
+void StreamCompressor::write(const PayloadBytes& data)
+{
+    stream_->next_in = const_cast<Bytef*>(data.data()); // NOLINT(cppcoreguidelines-pro-type-const-cast)
+    stream_->avail_in = static_cast<uInt>(data.size());
+    deflate_into(Z_NO_FLUSH);
+    bytes_in_ += data.size();
+}
+
+SharedPayload StreamCompressor::sync_flush()
+{
+    deflate_into(Z_SYNC_FLUSH);
+    bytes_out_ += pending_.size();
+    auto out = std::make_shared<const PayloadBytes>(std::move(pending_));
+    pending_ = {};
+    return out;
+}
+
+SharedPayload StreamCompressor::full_flush()
+{
+    deflate_into(Z_FULL_FLUSH);
+    bytes_out_ += pending_.size();
+    auto out = std::make_shared<const PayloadBytes>(std::move(pending_));
+    pending_ = {};
+    return out;
+}
+
+void StreamCompressor::deflate_into(int flush)
+{
+    std::array<Bytef, 4096> chunk {};
+    do {
+        stream_->next_out = chunk.data();
+        stream_->avail_out = static_cast<uInt>(chunk.size());
+        deflate(stream_.get(), flush);
+        pending_.insert(pending_.end(), chunk.data(), chunk.data() + (chunk.size() - stream_->avail_out));
+        // A full output chunk means deflate may have more to give.
+    } while (stream_->avail_out == 0 || stream_->avail_in > 0);
+}
+
+} // namespace atem
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "sse_payload.h"
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+struct z_stream_s;
+
+namespace atem {
+
+enum class StreamEncoding : uint8_t {
+    Identity,
+    Gzip,
+    Deflate,
+};
+
+// Picks the Content-Encoding for an event stream, preferring gzip.
+StreamEncoding negotiate_stream_encoding(std::string_view accept_encoding);
+
+// The Content-Encoding header value; empty for Identity.
+std::string_view content_encoding_name(StreamEncoding encoding);
+
+// An empty stored deflate block. It decodes to nothing, so it can be written
+// between any two flushed events of a compressed stream as a heartbeat.
+const SharedPayload& compressed_heartbeat();
+
+/**
+ * @class StreamCompressor
+ * @brief One long-lived deflate stream for an endless event stream.
+ *
+ * Events are written and then sync-flushed, so every flush ends on a byte
+ * boundary and the client can decode each event as soon as it arrives. The
+ * stream never finishes, so no gzip or zlib trailer is ever written.
+ *
+ * Several clients can share one compressor as long as they receive exactly
+ * the same bytes. A client can join at a full flush, because nothing after it
+ * refers back to earlier data.
+ */
+class StreamCompressor final {
+public:
+    explicit StreamCompressor(StreamEncoding encoding);
+    ~StreamCompressor();
+
+    // Non-copyable, non-movable
+    StreamCompressor(const StreamCompressor&) = delete;
+    StreamCompressor& operator=(const StreamCompressor&) = delete;
+    StreamCompressor(StreamCompressor&&) = delete;
+    StreamCompressor& operator=(StreamCompressor&&) = delete;
+
+    // The gzip or zlib header that starts every stream.
+    [[nodiscard]] SharedPayload header() const;
+
+    // Compresses `data` into the stream without flushing it yet.
+    void write(const PayloadBytes& data);
+    // Returns everything written since the last flush, decodable on its own
+    // by a client that has seen the earlier output.
+    SharedPayload sync_flush();
+    // Like sync_flush(), but later output no longer refers to anything before
+    // this point, so a new client can start decoding right after it.
+    SharedPayload full_flush();
+
+    [[nodiscard]] uint64_t bytes_in() const
+    {
+        return bytes_in_;
+    }
+
+    [[nodiscard]] uint64_t bytes_out() const
+    {
+        return bytes_out_;
+    }
+
+private:
+    void deflate_into(int flush);
+
+    const StreamEncoding encoding_;
+    std::unique_ptr<z_stream_s> stream_;
+    PayloadBytes pending_;
+    uint64_t bytes_in_ = 0;
+    uint64_t bytes_out_ = 0;
+};
+
+} // namespace atem
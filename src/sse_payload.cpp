@@ -0,0 +1,47 @@
+#include "sse_payload.h"
+#include <algorithm>
+#include <iterator>
+
+namespace atem {
+
+SharedPayload make_sse_payload(std::string_view event, std::string_view data, std::string_view id)
+{
+    constexpr std::string_view id_prefix = "id: ";
+    constexpr std::string_view event_prefix = "event: ";
+    constexpr std::string_view data_prefix = "\ndata: ";
+    constexpr std::string_view terminator = "\n\n";
+
+    auto bytes = std::make_shared<PayloadBytes>();
+    const std::size_t id_size = id.empty() ? 0 : id_prefix.size() + id.size() + 1;
+    bytes->reserve(id_size + event_prefix.size() + event.size() + data_prefix.size() + data.size() + terminator.size());
+
+    const auto append = [&bytes](std::string_view part) {
+        std::copy(part.begin(), part.end(), std::back_inserter(*bytes));
+    };
+    if (!id.empty()) {
+        append(id_prefix);
+        append(id);
+        bytes->push_back('\n');
+    }
+    append(event_prefix);
+    append(event);
+    append(data_prefix);
+    append(data);
+    append(terminator);
+
+    return bytes;
+}
+
+SharedPayload make_sse_id(std::string_view id)
+{
+    constexpr std::string_view id_prefix = "id: ";
+
+    auto bytes = std::make_shared<PayloadBytes>();
+    bytes->reserve(id_prefix.size() + id.size() + 1);
+    std::copy(id_prefix.begin(), id_prefix.end(), std::back_inserter(*bytes));
+    std::copy(id.begin(), id.end(), std::back_inserter(*bytes));
+    bytes->push_back('\n');
+    return bytes;
+}
+
+} // namespace atem
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace atem {
+
+// Raw bytes of a fully framed SSE event. The layout matches restbed::Bytes so a
+// payload can be handed to restbed without conversion.
+using PayloadBytes = std::vector<std::uint8_t>;
+
+// An immutable, reference-counted event frame. A broadcast builds one of these
+// and every session's write path refers to the same bytes.
+using SharedPayload = std::shared_ptr<const PayloadBytes>;
+
+// Builds "event: <event>\ndata: <data>\n\n" in a single allocation. A non-empty
+// `id` adds an "id: <id>" line, which browsers echo back as Last-Event-ID.
+SharedPayload make_sse_payload(std::string_view event, std::string_view data, std::string_view id = {});
+
+// Builds a lone "id: <id>\n" line. Queued right before an event framed without
+// an id, it gives one client its own id for an event shared by many.
+SharedPayload make_sse_id(std::string_view id);
+
+} // namespace atem
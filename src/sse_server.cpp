@@ -1,12 +1,19 @@
 #include "sse_server.h"
+#include "asio_http_server.h"
+#include "cbor.h"
 #include "config.h"
 #include "atem/iatem_connection.h"
+#include "logger.h"
+#include "platform_interface.h"
+#include "sse_payload.h"
 #include "tally_monitor.h"
 #include "tally_state.h"
 #include "version.h"
+#include "websocket.h"
+#include <algorithm>
 #include <boost/json.hpp>
+#include <charconv>
 #include <chrono>
-#include <iostream>
 #include <memory>
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wdeprecated-declarations"
@@ -14,12 +21,15 @@
 #pragma clang diagnostic pop
 #include <string>
 #include <string_view>
+#include <vector>
 
 namespace atem {
 namespace {
 
-    // Generates a dashboard page showing the status of all inputs.
-    std::string generate_status_page(const std::vector<InputInfo>& inputs, const std::string_view server_ip, const std::string_view sdk_version)
+    // Generates a dashboard page showing the status of all inputs. With more
+    // than one switcher, each switcher's inputs get a heading of their own.
+    std::string generate_status_page(const std::vector<InputInfo>& inputs, const std::vector<std::string>& switcher_ids,
+        const std::string_view server_ip, const std::string_view sdk_version)
     {
         std::string html = R"(
 <!DOCTYPE html>
@@ -54,20 +64,34 @@ namespace {
         .input-name { font-size: 0.5em; margin-top: 5px; opacity: 0.8; }
         .input-id { font-size: 1.2em; }
         .status-line { font-size: 14px; }
+        h2 { color: #ecf0f1; margin-bottom: 0; }
     </style>
 </head>
 <body>
     <h1>Tally Status Overview</h1>
-    <div class="grid">
 )";
+        const bool several = switcher_ids.size() > 1;
+        std::optional<uint8_t> current;
         for (const auto& input : inputs) {
-            html += "<div id=\"input-" + std::to_string(input.id) + R"(" class="tally-cell off">)"
+            if (input.switcher != current) {
+                if (current) {
+                    html += "    </div>\n";
+                }
+                current = input.switcher;
+                if (several && input.switcher < switcher_ids.size()) {
+                    html += "    <h2>" + switcher_ids[input.switcher] + "</h2>\n";
+                }
+                html += "    <div class=\"grid\">\n";
+            }
+            html += "<div id=\"input-" + std::to_string(input.switcher) + "-" + std::to_string(input.id) + R"(" class="tally-cell off">)"
                 + R"(<span class="input-id">)" + std::to_string(input.id) + R"(</span>)"
                 + R"(<span class="input-name">)" + input.short_name + R"(</span>)"
                 + "</div>\n";
         }
+        if (current) {
+            html += "    </div>\n";
+        }
         html += R"(
-    </div>
     <div class="footer">
         <div class="nav-link"><a href="/">Switch to Single Input View</a></div>
         <div class="status-line">
@@ -82,23 +106,40 @@ namespace {
 
         let isConnected = false;
         let currentMockStatus = false;
+        let lastEventId = '';
+        const tallies = {};
 
         function connect() {
             console.log('Attempting to connect to SSE endpoint...');
-            const eventSource = new EventSource('/events');
+            // Resume from the last event we saw; the server only sends what we missed.
+            const eventSource = new EventSource(lastEventId ? '/events?last_event_id=' + encodeURIComponent(lastEventId) : '/events');
 
             eventSource.onopen = () => {
                 console.log('SSE connection opened.');
+                if (lastEventId) {
+                    markConnected();
+                    Object.values(tallies).forEach(applyTally);
+                }
             };
 
-            eventSource.addEventListener('tally_update', (event) => {
+            function track(event) {
+                if (event.lastEventId) {
+                    lastEventId = event.lastEventId;
+                }
+            }
+
+            function markConnected() {
                 if (!isConnected) {
                     isConnected = true;
                     document.getElementById('connection-status').textContent = 'Connected';
                     console.log('Client is now marked as connected.');
                 }
-                const data = JSON.parse(event.data);
-                const cell = document.getElementById('input-' + data.input);
+            }
+
+            function applyTally(data) {
+                const key = (data.switcher || 0) + '-' + data.input;
+                tallies[key] = data;
+                const cell = document.getElementById('input-' + key);
                 if (cell) {
                     if (data.program) {
                         cell.className = 'tally-cell program';
@@ -112,9 +153,32 @@ namespace {
                         nameSpan.textContent = data.short_name;
                     }
                 }
+            }
+
+            // The full state of every input, sent once when the stream opens.
+            eventSource.addEventListener('tally_snapshot', (event) => {
+                track(event);
+                markConnected();
+                const data = JSON.parse(event.data);
+                currentMockStatus = data.mock;
+                data.inputs.forEach(applyTally);
+            });
+
+            eventSource.addEventListener('tally_update', (event) => {
+                track(event);
+                markConnected();
+                applyTally(JSON.parse(event.data));
+            });
+
+            // Several inputs that changed together, e.g. both sides of a cut.
+            eventSource.addEventListener('tally_batch', (event) => {
+                track(event);
+                markConnected();
+                JSON.parse(event.data).updates.forEach(applyTally);
             });
 
             eventSource.addEventListener('mode_change', (event) => {
+                track(event);
                 const data = JSON.parse(event.data);
                 if (data.mock !== currentMockStatus) {
                     console.log('Mock status changed, reloading page.');
@@ -149,14 +213,6 @@ namespace {
             + std::string(server_ip) + R"(`;
         document.getElementById('server-details').textContent = serverDetails;
 
-        // Initial state from initial tally updates
-        document.addEventListener('DOMContentLoaded', () => {
-            // We can infer initial mock status from the first tally update
-            eventSource.addEventListener('tally_update', (e) => {
-                currentMockStatus = JSON.parse(e.data).mock;
-            }, { once: true });
-        });
-
         connect();
     </script>
 </body>
@@ -165,8 +221,10 @@ namespace {
         return html;
     }
 
-    // Generates an HTML page listing all tally inputs based on config.
-    std::string generate_index_page(const uint16_t num_inputs)
+    // Generates an HTML page listing all tally inputs based on config. The
+    // first switcher's pages are /tally/{input}, the others' are
+    // /tally/{switcher}:{input}.
+    std::string generate_index_page(const uint16_t num_inputs, const std::vector<std::string>& switcher_ids)
     {
         std::string html = R"(
 <!DOCTYPE html>
@@ -183,17 +241,25 @@ namespace {
         .footer { margin-top: 40px; }
         .footer a { display: inline-block; padding: 10px 20px; font-size: 1em; background-color: #3498db; }
         .footer a:hover { background-color: #2980b9; }
+        h2 { margin-bottom: 0; }
     </style>
 </head>
 <body>
     <h1>Select an Input for Tally View</h1>
-    <div class="grid">
 )";
-        for (uint16_t i = 1; i <= num_inputs; ++i) {
-            html += "<a href=\"/tally/" + std::to_string(i) + "\">Input " + std::to_string(i) + "</a>\n";
+        const bool several = switcher_ids.size() > 1;
+        for (std::size_t switcher = 0; switcher < switcher_ids.size(); ++switcher) {
+            const auto prefix = switcher == 0 ? std::string() : switcher_ids[switcher] + ":";
+            if (several) {
+                html += "    <h2>" + switcher_ids[switcher] + "</h2>\n";
+            }
+            html += "    <div class=\"grid\">\n";
+            for (uint16_t i = 1; i <= num_inputs; ++i) {
+                html += "<a href=\"/tally/" + prefix + std::to_string(i) + "\">Input " + std::to_string(i) + "</a>\n";
+            }
+            html += "    </div>\n";
         }
         html += R"(
-    </div>
     <div class="footer">
         <a href="/status">Show All Inputs (Status Overview)</a>
     </div>
@@ -204,15 +270,19 @@ namespace {
     }
 
     // Generates a full-screen tally client page for a specific input.
-    std::string generate_tally_page(const int input_id, const bool is_mock, const std::string_view server_ip, const std::string_view sdk_version)
+    // `subscription` is how the page names the input, "{input}" or
+    // "{switcher}:{input}".
+    std::string generate_tally_page(const int32_t key, const std::string_view subscription, const bool is_mock,
+        const std::string_view server_ip, const std::string_view sdk_version)
     {
+        const auto input_id = tally_key_input(key);
         return R"(
 <!DOCTYPE html>
 <html lang="en">
 <head>
     <meta charset="UTF-8">
     <title>Tally - Input )"
-            + std::to_string(input_id) + R"(</title>
+            + std::string(subscription) + R"(</title>
     <style> /* NOLINT(bugprone-suspicious-string-integer-assignment) */
         html, body { margin: 0; padding: 0; width: 100%; height: 100%; overflow: hidden; font-family: sans-serif; }
         body { transition: background-color 0.3s ease; display: flex; justify-content: center; align-items: center; }
@@ -236,6 +306,10 @@ namespace {
     <script>
     const inputId = )"
             + std::to_string(input_id) + R"(;
+    const switcherIndex = )"
+            + std::to_string(tally_key_switcher(key)) + R"(;
+    const subscription = ')"
+            + std::string(subscription) + R"(';
     const isMock = )"
             + (is_mock ? "true" : "false") + R"(;
     const serverVersion = ")"
@@ -244,34 +318,51 @@ namespace {
             + std::string(sdk_version) + R"(";
 
     let isConnected = false;
+    let lastEventId = '';
+    let tallyClass = 'off';
+
+    function markConnected() {
+        if (!isConnected) {
+            isConnected = true;
+            document.body.className = tallyClass;
+            document.getElementById('connection-status').textContent = 'Connected';
+            console.log('Client is now marked as connected.');
+        }
+    }
 
     function connect() {
         console.log('Attempting to connect to SSE endpoint...');
-        const eventSource = new EventSource('/events');
+        // Subscribe to this input only; the server filters the other inputs out.
+        // After a drop, resume from the last event we saw.
+        const eventSource = new EventSource('/events/' + subscription
+            + (lastEventId ? '?last_event_id=' + encodeURIComponent(lastEventId) : ''));
 
         eventSource.onopen = () => {
             console.log('SSE connection opened.');
-            // We will wait for the first message to set the status to "Connected"
+            // A fresh stream waits for the first message to set the status to
+            // "Connected"; a resumed one only receives what changed meanwhile.
+            if (lastEventId) {
+                markConnected();
+            }
         };
 
         eventSource.addEventListener('tally_update', (event) => {
             // console.log('Received tally_update event:', event.data);
-            if (!isConnected) {
-                isConnected = true;
-                document.body.classList.remove('disconnected');
-                document.getElementById('connection-status').textContent = 'Connected';
-                console.log('Client is now marked as connected.');
+            if (event.lastEventId) {
+                lastEventId = event.lastEventId;
             }
             const data = JSON.parse(event.data);
-            if (data.input === inputId) {
+            if (data.input === inputId && (data.switcher || 0) === switcherIndex) {
                 if (data.program) {
-                    document.body.className = 'program';
+                    tallyClass = 'program';
                 } else if (data.preview) {
-                    document.body.className = 'preview';
+                    tallyClass = 'preview';
                 } else {
-                    document.body.className = 'off';
+                    tallyClass = 'off';
                 }
+                document.body.className = tallyClass;
             }
+            markConnected();
         });
 
         eventSource.addEventListener('server_info', (event) => {
@@ -285,6 +376,9 @@ namespace {
 
         eventSource.addEventListener('mode_change', (event) => {
             console.log('Received mode_change event:', event.data);
+            if (event.lastEventId) {
+                lastEventId = event.lastEventId;
+            }
             const data = JSON.parse(event.data);
             const mockIndicator = document.querySelector('.mock-indicator');
 
@@ -324,19 +418,313 @@ namespace {
 )";
     }
 
+    // Adapts a restbed session to the transport-neutral SseClient interface.
+    // Only one yield is outstanding at a time; the rest wait in the bounded
+    // outbound queue instead of piling up inside restbed.
+    class RestbedSseClient final : public SseClient, public std::enable_shared_from_this<RestbedSseClient> {
+    public:
+        RestbedSseClient(std::shared_ptr<restbed::Session> session, const Config& config)
+            : session_(std::move(session))
+            , queue_(config.sse_queue_limit, std::chrono::milliseconds(config.sse_stall_timeout_ms))
+        {
+        }
+
+        bool send(const SharedPayload& payload, int32_t coalesce_key, OutboundQueue::Clock::time_point now) override
+        {
+            if (!session_->is_open()) {
+                return true; // Already closing; the error handler removes it.
+            }
+            switch (queue_.push(payload, coalesce_key, now)) {
+            case OutboundQueue::PushResult::Started:
+                write(payload);
+                return true;
+            case OutboundQueue::PushResult::Queued:
+                return true;
+            case OutboundQueue::PushResult::Stalled:
+                return false;
+            }
+            return true;
+        }
+
+        void close() override
+        {
+            queue_.clear();
+            session_->close();
+        }
+
+        bool is_open() const override
+        {
+            return session_->is_open();
+        }
+
+        OutboundQueue::Stats queue_stats() const override
+        {
+            return queue_.stats();
+        }
+
+        std::string remote_address() const override
+        {
+            return session_->get_origin();
+        }
+
+        // restbed queues its own copy of the bytes on the socket strand.
+        bool copies_payload() const override
+        {
+            return true;
+        }
+
+    private:
+        void write(const SharedPayload& payload)
+        {
+            session_->yield(*payload, [self = shared_from_this()](const std::shared_ptr<restbed::Session> session) {
+                if (auto next = self->queue_.complete_write(); next && session->is_open()) {
+                    self->write(next);
+                }
+            });
+        }
+
+        std::shared_ptr<restbed::Session> session_;
+        OutboundQueue queue_;
+    };
+
+    // Most queued items packed into one WebSocket message.
+    constexpr std::size_t kMaxWebSocketBatch = 64;
+
+    // Adapts a restbed WebSocket to SseClient. Whatever queued up while the
+    // previous message was being sent goes out as the next single message.
+    class RestbedWebSocketClient final : public SseClient, public std::enable_shared_from_this<RestbedWebSocketClient> {
+    public:
+        RestbedWebSocketClient(std::shared_ptr<restbed::WebSocket> socket, std::string remote, const Config& config)
+            : socket_(std::move(socket))
+            , remote_(std::move(remote))
+            , queue_(config.sse_queue_limit, std::chrono::milliseconds(config.sse_stall_timeout_ms))
+        {
+        }
+
+        bool send(const SharedPayload& payload, int32_t coalesce_key, OutboundQueue::Clock::time_point now) override
+        {
+            if (!socket_->is_open()) {
+                return true; // Already closing; the close handler removes it.
+            }
+            switch (queue_.push(payload, coalesce_key, now)) {
+            case OutboundQueue::PushResult::Started:
+                write({ payload });
+                return true;
+            case OutboundQueue::PushResult::Queued:
+                return true;
+            case OutboundQueue::PushResult::Stalled:
+                return false;
+            }
+            return true;
+        }
+
+        void close() override
+        {
+            queue_.clear();
+            socket_->close();
+        }
+
+        bool is_open() const override
+        {
+            return socket_->is_open();
+        }
+
+        OutboundQueue::Stats queue_stats() const override
+        {
+            return queue_.stats();
+        }
+
+        std::string remote_address() const override
+        {
+            return remote_;
+        }
+
+        // restbed frames and queues its own copy of each message.
+        bool copies_payload() const override
+        {
+            return true;
+        }
+
+    private:
+        void write(const std::vector<SharedPayload>& items)
+        {
+            restbed::Bytes message;
+            for (const auto& item : items) {
+                message.insert(message.end(), item->begin(), item->end());
+            }
+            socket_->send(message, [self = shared_from_this()](const std::shared_ptr<restbed::WebSocket>) {
+                std::vector<SharedPayload> next;
+                self->queue_.complete_batch(kMaxWebSocketBatch, next);
+                if (!next.empty() && self->socket_->is_open()) {
+                    self->write(next);
+                }
+            });
+        }
+
+        std::shared_ptr<restbed::WebSocket> socket_;
+        std::string remote_;
+        OutboundQueue queue_;
+    };
+
+    HttpRequest to_http_request(const restbed::Request& request)
+    {
+        HttpRequest result;
+        result.method = request.get_method();
+        result.path = request.get_path();
+        result.query = request.get_query_parameters();
+        for (const auto& header : request.get_headers()) {
+            result.headers.emplace_back(header);
+        }
+        return result;
+    }
+
+    void send_response(const std::shared_ptr<restbed::Session>& session, const HttpResponse& response)
+    {
+        auto headers = response.headers;
+        if (response.status != restbed::NOT_MODIFIED) {
+            headers.emplace("Content-Length", std::to_string(response.body.length()));
+        }
+        session->close(response.status, response.body, headers);
+    }
+
+    // Distinct hosts a page is cached for; the Host header is client supplied.
+    constexpr std::size_t kPageCacheEntries = 64;
+
+    constexpr std::string_view kEventsPath = "/events";
+    constexpr std::string_view kWebSocketPath = "/ws";
+    constexpr std::string_view kTallyApiPath = "/api/tally";
+
+    // Coalescing key for tally_bitmap events. Each one carries the whole rig,
+    // so a backed-up client only needs the newest. Outside the tally key range.
+    constexpr int32_t kTallyBitmapKey = static_cast<int32_t>(kMaxSwitchers) << 16;
+
+    // Resolution of the liveness timers; heartbeats and reaping are coarse.
+    constexpr std::chrono::milliseconds kTimerWheelTick { 100 };
+
+    // An SSE comment line. Clients ignore it, but it keeps intermediaries from
+    // timing out an idle stream and lets TCP notice a peer that has vanished.
+    const SharedPayload& heartbeat_payload()
+    {
+        static const SharedPayload payload = [] {
+            constexpr std::string_view text = ":\n\n";
+            return std::make_shared<const PayloadBytes>(text.begin(), text.end());
+        }();
+        return payload;
+    }
+
+    // The /ws equivalent: a CBOR item clients skip, {"event":"heartbeat","data":null}.
+    const SharedPayload& websocket_heartbeat_payload()
+    {
+        static const SharedPayload payload = make_cbor_event("heartbeat", nullptr);
+        return payload;
+    }
+
+    bool parse_input_id(std::string_view text, uint16_t& id)
+    {
+        const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), id);
+        return !text.empty() && ec == std::errc() && end == text.data() + text.size();
+    }
+
+    // Parses "{input}" (on the first switcher) or "{switcher id}:{input}"
+    // into a tally key.
+    std::optional<int32_t> parse_input_key(std::string_view text, const TallyMonitor& monitor)
+    {
+        uint8_t switcher = 0;
+        if (const auto colon = text.find(':'); colon != std::string_view::npos) {
+            const auto index = monitor.find_switcher(text.substr(0, colon));
+            if (!index) {
+                return std::nullopt;
+            }
+            switcher = *index;
+            text.remove_prefix(colon + 1);
+        }
+        uint16_t id = 0;
+        if (!parse_input_id(text, id)) {
+            return std::nullopt;
+        }
+        return tally_key(switcher, id);
+    }
+
+    // Returns the tally keys of the inputs an event stream subscribed to,
+    // from either /events/{input} or /events?inputs=3,7,atem2:3, sorted.
+    // Empty means every input.
+    std::vector<int32_t> parse_subscription(const HttpRequest& request, const TallyMonitor& monitor)
+    {
+        std::vector<int32_t> inputs;
+        if (request.path.size() > kEventsPath.size()) {
+            if (const auto key = parse_input_key(std::string_view(request.path).substr(kEventsPath.size() + 1), monitor)) {
+                inputs.push_back(*key);
+            }
+        }
+
+        const auto list = request.get_query("inputs");
+        std::string_view rest = list;
+        while (!rest.empty()) {
+            const auto comma = rest.find(',');
+            if (const auto key = parse_input_key(rest.substr(0, comma), monitor)) {
+                inputs.push_back(*key);
+            }
+            rest = comma == std::string_view::npos ? std::string_view {} : rest.substr(comma + 1);
+        }
+        std::sort(inputs.begin(), inputs.end());
+        inputs.erase(std::unique(inputs.begin(), inputs.end()), inputs.end());
+        return inputs;
+    }
+
+    // /events?format=bitmap asks for tally_bitmap events instead of per-input ones.
+    StreamFormat parse_format(const HttpRequest& request)
+    {
+        return request.get_query("format") == "bitmap" ? StreamFormat::Bitmap : StreamFormat::Events;
+    }
+
+    // /api/tally ETags are the quoted event id of the state version.
+    std::string quote_etag(const std::string& id)
+    {
+        return "\"" + id + "\"";
+    }
+
+    std::string_view unquote_etag(std::string_view etag)
+    {
+        if (etag.starts_with("W/")) {
+            etag.remove_prefix(2);
+        }
+        if (etag.size() >= 2 && etag.front() == '"' && etag.back() == '"') {
+            etag = etag.substr(1, etag.size() - 2);
+        }
+        return etag;
+    }
+
 } // namespace
 
-SseServer::SseServer(const Config& config, gsl::not_null<TallyMonitor*> monitor)
+SseServer::SseServer(boost::asio::io_context& ioc, const Config& config, gsl::not_null<TallyMonitor*> monitor)
     : config_(config)
     , monitor_(*monitor)
     , service_(std::make_shared<restbed::Service>())
+    , wheel_(ioc, kTimerWheelTick)
+    , replay_ring_(config.sse_replay_events)
+    , page_cache_(kPageCacheEntries)
+    , long_poll_(
+          wheel_, config.api_max_long_polls, [this](uint64_t since) { return tally_response(since); },
+          [this](uint64_t since) {
+              // Nothing changed within the timeout; the client polls again with the same version.
+              return HttpResponse { 304, { { "ETag", quote_etag(monitor_.format_event_id(since)) }, { "Cache-Control", "no-cache" } }, {} };
+          })
 {
+    if (config_.sse_batch_window_ms > 0) {
+        batcher_ = std::make_unique<TallyBatcher>(ioc, std::chrono::milliseconds(config_.sse_batch_window_ms),
+            [this](const std::vector<TallyBatcher::Entry>& batch) { broadcast_tally_batch(batch); });
+    }
+
+    if (use_asio_engine()) {
+        asio_server_ = std::make_unique<AsioHttpServer>(config_, static_cast<HttpHandler&>(*this));
+        return;
+    }
+
     // Set a service-wide error handler to catch session closures.
     // This is the correct way to manage cleanup for persistent connections like SSE.
     service_->set_error_handler([this](const int, const std::exception&, const std::shared_ptr<restbed::Session> session) {
         if (session and session->is_open() == false) {
-            const std::scoped_lock lock(sessions_mutex_);
-            sse_sessions_.erase(session);
+            sse_sessions_.remove_closed();
         }
     });
     setup_endpoints();
@@ -349,131 +737,1135 @@ SseServer::~SseServer()
 
 void SseServer::start()
 {
+    running_ = true;
+    wheel_.start();
+    log(LogLevel::Info) << "SSE Server starting on " << config_.ws_address << ":" << config_.ws_port
+                        << " (" << (use_asio_engine() ? "asio" : "restbed") << " engine)";
+
+    if (asio_server_) {
+        asio_server_->run();
+        return;
+    }
+
     auto settings = std::make_shared<restbed::Settings>();
     settings->set_port(config_.ws_port);
     settings->set_bind_address(config_.ws_address);
-    settings->set_worker_limit(std::thread::hardware_concurrency());
+    // restbed starts and schedules its own workers; they are sized from
+    // threads.io_threads, but neither named nor pinned.
+    settings->set_worker_limit(config_.io_threads > 0 ? config_.io_threads : std::thread::hardware_concurrency());
     settings->set_connection_limit(config_.ws_connection_limit);
-
-    std::cout << "SSE Server starting on " << config_.ws_address << ":" << config_.ws_port << std::endl;
+    if (config_.sse_dead_peer_timeout_ms > 0) {
+        // Let the kernel probe idle peers; the reaper handles stalled writes.
+        const uint32_t seconds = std::max(1U, config_.sse_dead_peer_timeout_ms / 1000);
+        settings->set_keep_alive(true);
+        settings->set_keep_alive_start(std::max(1U, seconds / 2));
+        settings->set_keep_alive_interval(std::max(1U, seconds / 6));
+        settings->set_keep_alive_cnt(3);
+    }
     service_->start(settings);
 }
 
 void SseServer::stop()
 {
-    if (service_ && service_->is_up()) {
-        std::cout << "Stopping SSE Server..." << std::endl;
-        {
-            // Close all SSE sessions before stopping the service
-            std::scoped_lock lock(sessions_mutex_);
-            for (const auto& session : sse_sessions_) {
-                session->close();
-            }
-            sse_sessions_.clear();
-        }
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    log(LogLevel::Info) << "Stopping SSE Server...";
+    wheel_.stop();
+    long_poll_.clear();
+    // Close all SSE sessions before stopping the engine
+    sse_sessions_.clear()->for_each([](const auto& session) { session->close(); });
+
+    if (asio_server_) {
+        asio_server_->stop();
+    } else if (service_->is_up()) {
         service_->stop();
     }
 }
 
-void SseServer::broadcast_tally_update(const TallyUpdate& update)
+void SseServer::broadcast_tally_update(const TallyUpdate& update, uint64_t version)
 {
-    broadcast("tally_update", boost::json::serialize(boost::json::value_from(update))); // NOLINT(performance-move-const-arg)
+    long_poll_.wake(version);
+    if (batcher_) {
+        batcher_->add(update, version);
+        return;
+    }
+    broadcast("tally_update", boost::json::value_from(update), update.key(), version);
 }
 
-void SseServer::broadcast_mode_change(bool is_mock)
+void SseServer::broadcast_mode_change(bool is_mock, uint64_t version)
 {
+    // Pending tally changes are older than this event; send them first.
+    if (batcher_) {
+        batcher_->flush();
+    }
+    long_poll_.wake(version);
     boost::json::object msg;
     msg["mock"] = is_mock;
-    broadcast("mode_change", boost::json::serialize(boost::json::value_from(msg)));
+    broadcast("mode_change", msg, OutboundQueue::kNoCoalesceKey, version);
 }
 
-void SseServer::setup_endpoints()
+void SseServer::broadcast_inputs_change(uint64_t version)
+{
+    // Pending tally changes are older than the new list; send them first.
+    if (batcher_) {
+        batcher_->flush();
+    }
+    long_poll_.wake(version);
+
+    // Inputs may have come, gone or been renamed, so every event client gets
+    // the whole state again as a tally_snapshot. Bitmap clients get the new
+    // index with the bitmap that follows it.
+    auto states = monitor_.get_all_tally_states();
+    std::sort(states.begin(), states.end(), [](const TallyState& a, const TallyState& b) { return a.key() < b.key(); });
+    const bool is_mock = monitor_.is_mock_mode();
+    boost::json::array list;
+    list.reserve(states.size());
+    for (const auto& state : states) {
+        list.emplace_back(boost::json::value_from(state.to_update(is_mock)));
+    }
+    boost::json::object msg;
+    msg["type"] = "tally_snapshot";
+    msg["version"] = version;
+    msg["mock"] = is_mock;
+    msg["inputs"] = std::move(list);
+    broadcast("tally_snapshot", msg, OutboundQueue::kNoCoalesceKey, version);
+}
+
+void SseServer::add_metrics(std::string name, MetricsSource source)
+{
+    metrics_sources_.emplace_back(std::move(name), std::move(source));
+}
+
+SseServer::BroadcastStats SseServer::get_broadcast_stats() const
 {
+    return BroadcastStats {
+        broadcasts_.load(std::memory_order_relaxed),
+        payload_bytes_.load(std::memory_order_relaxed),
+        bytes_copied_.load(std::memory_order_relaxed),
+        last_bytes_copied_.load(std::memory_order_relaxed),
+        last_latency_us_.load(std::memory_order_relaxed),
+        max_latency_us_.load(std::memory_order_relaxed),
+        total_latency_us_.load(std::memory_order_relaxed),
+    };
+}
+
+std::optional<TallyBatcher::Stats> SseServer::get_batch_stats() const
+{
+    if (!batcher_) {
+        return std::nullopt;
+    }
+    return batcher_->stats();
+}
+
+bool SseServer::use_asio_engine() const
+{
+    return config_.server_engine == "asio";
+}
+
+HttpResponse SseServer::handle_request(const HttpRequest& request)
+{
+    const auto server_ip = request.get_header("Host", "localhost");
+
     // --- Index Page ---
-    auto index_resource = std::make_shared<restbed::Resource>();
-    index_resource->set_path("/");
-    index_resource->set_method_handler("GET", [&](const std::shared_ptr<restbed::Session> session) {
-        const auto body = generate_index_page(config_.mock_inputs);
-        session->close(restbed::OK, body, { { "Content-Type", "text/html" }, { "Content-Length", std::to_string(body.length()) } }); });
-    service_->publish(index_resource);
+    if (request.path == "/") {
+        return page_response(request, "index", 0, [this]() { return generate_index_page(config_.mock_inputs, monitor_.get_switcher_ids()); });
+    }
 
     // --- Status Page (All Inputs) ---
-    auto status_resource = std::make_shared<restbed::Resource>();
-    status_resource->set_path("/status");
-    status_resource->set_method_handler("GET", [&](const std::shared_ptr<restbed::Session> session) {
-        const auto request = session->get_request();
-        const auto server_ip = request->get_header("Host", "localhost");
-        const auto body = generate_status_page(monitor_.get_inputs(), server_ip, ATEM_SDK_VERSION);
-        session->close(restbed::OK, body, { { "Content-Type", "text/html" }, { "Content-Length", std::to_string(body.length()) } });
-    });
-    service_->publish(status_resource);
+    if (request.path == "/status") {
+        return page_response(request, "status", 0, [this, &server_ip]() {
+            return generate_status_page(monitor_.get_inputs(), monitor_.get_switcher_ids(), server_ip, ATEM_SDK_VERSION);
+        });
+    }
 
     // --- Tally Page ---
-    auto tally_resource = std::make_shared<restbed::Resource>();
-    tally_resource->set_path("/tally/{id: \\d+}");
-    tally_resource->set_method_handler("GET", [&](const std::shared_ptr<restbed::Session> session) {
-        const auto request = session->get_request();
-        const auto id = request->get_path_parameter("id", 0);
-        const auto server_ip = request->get_header("Host", "localhost");
-
-        const auto body = generate_tally_page(id, monitor_.is_mock_mode(), server_ip, ATEM_SDK_VERSION);
-        session->close(restbed::OK, body, { { "Content-Type", "text/html" }, { "Content-Length", std::to_string(body.length()) } });
+    constexpr std::string_view tally_prefix = "/tally/";
+    if (request.path.starts_with(tally_prefix)) {
+        const std::string_view id_text = std::string_view(request.path).substr(tally_prefix.size());
+        if (const auto key = parse_input_key(id_text, monitor_)) {
+            return page_response(request, "tally", *key, [this, key = *key, id_text, &server_ip]() {
+                return generate_tally_page(key, id_text, monitor_.is_mock_mode(), server_ip, ATEM_SDK_VERSION);
+            });
+        }
+    }
+
+    // --- Metrics ---
+    if (request.path == "/metrics") {
+        return metrics_response(request);
+    }
+
+    // --- Tally State API ---
+    if (request.path == kTallyApiPath) {
+        const auto etag = quote_etag(monitor_.format_event_id(monitor_.get_state_version()));
+        if (etag_matches(request.get_header("If-None-Match"), etag)) {
+            return { 304, { { "ETag", etag }, { "Cache-Control", "no-cache" } }, {} };
+        }
+        return tally_response(0);
+    }
+
+    return { restbed::NOT_FOUND, { { "Content-Type", "text/plain" } }, "Not Found" };
+}
+
+bool SseServer::is_deferred(const HttpRequest& request) const
+{
+    return request.path == kTallyApiPath && request.query.contains("since");
+}
+
+void SseServer::handle_deferred(const HttpRequest& request, Responder respond)
+{
+    // A version from another run, or one this process has not reached, gets
+    // the full state straight away.
+    const auto since = monitor_.parse_event_id(unquote_etag(request.get_query("since")));
+    const auto current = monitor_.get_state_version();
+    if (!since || *since > current) {
+        respond(tally_response(0));
+        return;
+    }
+
+    switch (long_poll_.wait(*since, current, std::chrono::milliseconds(config_.api_long_poll_timeout_ms), respond)) {
+    case LongPollRegistry::WaitResult::Parked:
+        break;
+    case LongPollRegistry::WaitResult::Ready:
+        respond(tally_response(*since));
+        break;
+    case LongPollRegistry::WaitResult::Full:
+        respond({ 503, { { "Content-Type", "text/plain" }, { "Retry-After", "1" } }, "Too many waiting requests" });
+        break;
+    }
+}
+
+HttpResponse SseServer::tally_response(uint64_t since) const
+{
+    const auto delta = monitor_.get_changes_since(since);
+    boost::json::array inputs;
+    inputs.reserve(delta.changed.size());
+    for (const auto& state : delta.changed) {
+        inputs.emplace_back(boost::json::value_from(state.to_update(delta.mock)));
+    }
+    const auto id = monitor_.format_event_id(delta.version);
+    boost::json::object msg;
+    msg["version"] = id;
+    msg["full"] = since == 0;
+    msg["mock"] = delta.mock;
+    msg["inputs"] = std::move(inputs);
+    return {
+        restbed::OK,
+        { { "Content-Type", "application/json" }, { "Cache-Control", "no-cache" }, { "ETag", quote_etag(id) } },
+        boost::json::serialize(msg),
+    };
+}
+
+HttpResponse SseServer::page_response(const HttpRequest& request, std::string_view route, int id, const PageCache::Renderer& render)
+{
+    // Read the versions before rendering, so a change that lands mid-render
+    // invalidates the entry on the next request.
+    const PageCache::Key key {
+        std::string(route),
+        id,
+        monitor_.is_mock_mode(),
+        monitor_.get_names_version(),
+        request.get_header("Host", "localhost"),
+    };
+    return page_cache_.respond(key, request, "text/html", render);
+}
+
+bool SseServer::is_event_stream(const HttpRequest& request) const
+{
+    const std::string_view path = request.path;
+    return path == kEventsPath || (path.starts_with(kEventsPath) && path[kEventsPath.size()] == '/');
+}
+
+std::string_view SseServer::event_stream_encoding(const HttpRequest& request) const
+{
+    return content_encoding_name(stream_encoding(request));
+}
+
+StreamEncoding SseServer::stream_encoding(const HttpRequest& request) const
+{
+    if (!config_.sse_compression) {
+        return StreamEncoding::Identity;
+    }
+    return negotiate_stream_encoding(request.get_header("Accept-Encoding"));
+}
+
+template <typename CollectAfter, typename Send, typename Register>
+void SseServer::join(uint64_t covered, CollectAfter&& collect_after, Send&& send, Register&& register_client)
+{
+    // Broadcasts push to the replay ring and take the session snapshot under
+    // sequence_mutex_, so once the ring holds nothing the client has not been
+    // sent, every later event reaches it live, after what it was sent here.
+    // Otherwise catch up outside the lock and check again.
+    for (;;) {
+        {
+            const std::scoped_lock lock(sequence_mutex_);
+            if (replay_ring_.pushed() == covered) {
+                register_client();
+                return;
+            }
+        }
+        std::vector<StreamEvent> missed;
+        covered = collect_after(covered, missed);
+        if (!send(missed)) {
+            return;
+        }
+    }
+}
+
+void SseServer::open_event_stream(const std::shared_ptr<SseClient>& client, const HttpRequest& request)
+{
+    const auto format = parse_format(request);
+    // A bitmap always covers every input.
+    auto inputs = format == StreamFormat::Bitmap ? std::vector<int32_t> {} : parse_subscription(request, monitor_);
+    const auto encoding = stream_encoding(request);
+    // Compressed streams get an empty deflate block, which fits between any
+    // two flushed events without touching the shared compressor.
+    schedule_liveness_check(client, encoding == StreamEncoding::Identity ? heartbeat_payload() : compressed_heartbeat());
+    if (encoding != StreamEncoding::Identity) {
+        open_compressed_stream(client, request, { encoding, format, std::move(inputs) });
+        return;
+    }
+
+    std::vector<StreamEvent> events;
+    const auto covered = collect_initial_events(request, inputs, format, events);
+    if (!deliver_all(client, events)) {
+        return;
+    }
+    join(
+        covered,
+        [this, &inputs, format](uint64_t since, std::vector<StreamEvent>& missed) { return collect_events_after(since, inputs, format, missed); },
+        [this, &client](const std::vector<StreamEvent>& missed) { return deliver_all(client, missed); },
+        // Add session to our list, indexed by the inputs it subscribed to
+        [this, &client, &inputs, encoding, format]() { sse_sessions_.add(client, inputs, encoding, format); });
+}
+
+void SseServer::open_compressed_stream(const std::shared_ptr<SseClient>& client, const HttpRequest& request, SessionRegistry::ChannelKey channel)
+{
+    // The header, initial events and any catch-up are this client's alone,
+    // so they get a short-lived compressor of their own. The header goes out
+    // in the same write as the initial events.
+    StreamCompressor own(channel.encoding);
+    auto header = own.header();
+    const auto send = [this, &client, &own, &header](const std::vector<StreamEvent>& events) {
+        if (events.empty() && !header) {
+            return true;
+        }
+        std::vector<SharedPayload> payloads;
+        payloads.reserve(events.size());
+        for (const auto& event : events) {
+            payloads.push_back(event.payload);
+        }
+        const auto block = compress(own, payloads);
+        PayloadBytes bytes;
+        if (header) {
+            bytes.reserve(header->size() + block->size());
+            bytes.insert(bytes.end(), header->begin(), header->end());
+            header.reset();
+        }
+        bytes.insert(bytes.end(), block->begin(), block->end());
+        return deliver(client, std::make_shared<const PayloadBytes>(std::move(bytes)), OutboundQueue::kNoCoalesceKey);
+    };
+
+    std::vector<StreamEvent> events;
+    const auto covered = collect_initial_events(request, channel.inputs, channel.format, events);
+    if (!send(events)) {
+        return;
+    }
+    join(
+        covered,
+        [this, &channel](uint64_t since, std::vector<StreamEvent>& missed) {
+            return collect_events_after(since, channel.inputs, channel.format, missed);
+        },
+        send,
+        [this, &client, &channel]() {
+            // Waits for broadcasts pushed before this to finish compressing.
+            const std::scoped_lock lock(channel_mutex_);
+            // Drop the compressors of channels whose clients have all gone.
+            const auto sessions = sse_sessions_.snapshot();
+            std::erase_if(compressors_, [&sessions](const auto& item) { return !sessions->channels.contains(item.first); });
+
+            // Join the shared stream at a full flush, so nothing the client
+            // receives from it refers back to bytes it never saw. The flush
+            // output is part of the members' stream and goes to them as well.
+            auto& compressor = compressors_[channel];
+            if (!compressor) {
+                compressor = std::make_unique<StreamCompressor>(channel.encoding);
+            } else if (const auto it = sessions->channels.find(channel); it != sessions->channels.end()) {
+                const auto restart = compressor->full_flush();
+                const auto now = OutboundQueue::Clock::now();
+                for (const auto& member : it->second) {
+                    deliver(member, restart, OutboundQueue::kNoCoalesceKey, now);
+                }
+            }
+            sse_sessions_.add(client, channel.inputs, channel.encoding, channel.format);
+        });
+}
+
+uint64_t SseServer::collect_initial_events(const HttpRequest& request, const std::vector<int32_t>& inputs, StreamFormat format,
+    std::vector<StreamEvent>& out)
+{
+    // One bitmap is the whole state, so a bitmap client never needs a replay.
+    if (format == StreamFormat::Events) {
+        if (const auto covered = collect_missed_events(request, inputs, out)) {
+            return *covered;
+        }
+    }
+
+    // Send server info to the newly connected client for version checking
+    {
+        boost::json::object msg;
+        msg["server_version"] = version::GIT_VERSION;
+        msg["switchers"] = boost::json::value_from(monitor_.get_switcher_ids());
+        out.push_back({ make_sse_payload("server_info", boost::json::serialize(boost::json::value_from(msg))), OutboundQueue::kNoCoalesceKey });
+    }
+    return collect_state(inputs, format, out);
+}
+
+uint64_t SseServer::collect_state(const std::vector<int32_t>& inputs, StreamFormat format, std::vector<StreamEvent>& out)
+{
+    // A broadcast is pushed after the monitor applied its change, so the
+    // state read below includes every event pushed before this.
+    const auto covered = replay_ring_.pushed();
+
+    // The state is tagged with that position, so a client resuming from it
+    // gets exactly the events pushed since. Bitmap clients never resume.
+    const auto event_id = monitor_.format_event_id(covered);
+
+    // Send initial state to the newly connected client. A client that follows
+    // every input gets the monitor's cached snapshot, which has no id of its
+    // own.
+    if (format == StreamFormat::Bitmap) {
+        const auto bitmap = monitor_.get_tally_bitmap();
+        out.push_back({ bitmap.index, OutboundQueue::kNoCoalesceKey });
+        out.push_back({ bitmap.event, kTallyBitmapKey });
+        return covered;
+    }
+    if (inputs.empty()) {
+        out.push_back({ make_sse_id(event_id), OutboundQueue::kNoCoalesceKey });
+        out.push_back({ monitor_.get_tally_snapshot().event, OutboundQueue::kNoCoalesceKey });
+        return covered;
+    }
+    const bool is_mock = monitor_.is_mock_mode();
+    for (const auto key : inputs) {
+        const TallyUpdate update = monitor_.get_tally_state(tally_key_switcher(key), tally_key_input(key)).to_update(is_mock);
+        out.push_back({ make_sse_payload("tally_update", boost::json::serialize(boost::json::value_from(update)), event_id), key });
+    }
+    return covered;
+}
+
+uint64_t SseServer::collect_events_after(uint64_t covered, const std::vector<int32_t>& inputs, StreamFormat format,
+    std::vector<StreamEvent>& out)
+{
+    // A bitmap client gets the whole state again, as it would from a broadcast.
+    std::vector<EventRing::Entry> missed;
+    const auto pushed = format == StreamFormat::Events ? replay_ring_.events_after(covered, missed) : std::nullopt;
+    if (!pushed) {
+        return collect_state(inputs, format, out);
+    }
+    collect_subscribed(missed, inputs, out);
+    return *pushed;
+}
+
+std::optional<uint64_t> SseServer::collect_missed_events(const HttpRequest& request, const std::vector<int32_t>& inputs,
+    std::vector<StreamEvent>& out)
+{
+    // Browsers send Last-Event-ID when EventSource reconnects by itself; the
+    // pages pass it as a query parameter when they open a new EventSource.
+    auto last_event_id = request.get_header("Last-Event-ID");
+    if (last_event_id.empty()) {
+        last_event_id = request.get_query("last_event_id");
+    }
+    if (last_event_id.empty()) {
+        return std::nullopt;
+    }
+
+    // The id is the position of the last event the client saw, so what it
+    // missed is everything pushed after it, whatever the versions.
+    std::vector<EventRing::Entry> missed;
+    const auto position = monitor_.parse_event_id(last_event_id);
+    const auto covered = position ? replay_ring_.events_after(*position, missed) : std::nullopt;
+    if (!covered) {
+        resume_fallbacks_.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+
+    resumes_.fetch_add(1, std::memory_order_relaxed);
+    collect_subscribed(missed, inputs, out);
+    return covered;
+}
+
+void SseServer::collect_subscribed(std::vector<EventRing::Entry>& entries, const std::vector<int32_t>& inputs, std::vector<StreamEvent>& out)
+{
+    for (auto& entry : entries) {
+        const bool subscribed = inputs.empty() || entry.coalesce_key == OutboundQueue::kNoCoalesceKey
+            || std::binary_search(inputs.begin(), inputs.end(), entry.coalesce_key);
+        if (subscribed) {
+            out.push_back({ std::move(entry.payload), entry.coalesce_key });
+        }
+    }
+}
+
+SharedPayload SseServer::compress(StreamCompressor& compressor, const std::vector<SharedPayload>& events)
+{
+    const auto started = std::chrono::steady_clock::now();
+    const auto bytes_in = compressor.bytes_in();
+    const auto bytes_out = compressor.bytes_out();
+    for (const auto& event : events) {
+        compressor.write(*event);
+    }
+    auto block = compressor.sync_flush();
+    const auto elapsed_ns = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count());
+
+    compressions_.fetch_add(1, std::memory_order_relaxed);
+    compressed_events_.fetch_add(events.size(), std::memory_order_relaxed);
+    compressed_bytes_in_.fetch_add(compressor.bytes_in() - bytes_in, std::memory_order_relaxed);
+    compressed_bytes_out_.fetch_add(compressor.bytes_out() - bytes_out, std::memory_order_relaxed);
+    compress_ns_.fetch_add(elapsed_ns, std::memory_order_relaxed);
+    return block;
+}
+
+template <typename EventsFor>
+void SseServer::send_to_channels(const SessionRegistry::Snapshot& sessions, EventsFor&& events_for,
+    std::chrono::steady_clock::time_point now, uint64_t& copied)
+{
+    std::vector<SharedPayload> events;
+    for (const auto& [channel, members] : sessions.channels) {
+        if (channel.format != StreamFormat::Events) {
+            continue; // send_bitmaps() serves these
+        }
+        events.clear();
+        events_for(channel, events);
+        const auto it = compressors_.find(channel);
+        if (events.empty() || it == compressors_.end()) {
+            continue;
+        }
+        const auto block = compress(*it->second, events);
+        // Each block depends on the ones before it, so compressed clients are
+        // never coalesced; one that falls behind is evicted instead.
+        for (const auto& member : members) {
+            if (member->is_open() && deliver(member, block, OutboundQueue::kNoCoalesceKey, now) && member->copies_payload()) {
+                copied += block->size();
+            }
+        }
+    }
+}
+
+void SseServer::send_bitmaps(const SessionRegistry::Snapshot& sessions, std::chrono::steady_clock::time_point now, uint64_t& copied)
+{
+    if (!sessions.has_bitmap_clients()) {
+        return;
+    }
+
+    // The bitmap is the monitor's current state, which already includes the
+    // change being broadcast. A new input list goes out first.
+    const auto bitmap = monitor_.get_tally_bitmap();
+    std::vector<StreamEvent> events;
+    if (bitmap.index_version != bitmap_index_version_) {
+        bitmap_index_version_ = bitmap.index_version;
+        events.push_back({ bitmap.index, OutboundQueue::kNoCoalesceKey });
+    }
+    events.push_back({ bitmap.event, kTallyBitmapKey });
+
+    for (const auto& session : sessions.bitmap) {
+        for (const auto& event : events) {
+            if (!session->is_open() || !deliver(session, event.payload, event.coalesce_key, now)) {
+                break;
+            }
+            if (session->copies_payload()) {
+                copied += event.payload->size();
+            }
+        }
+    }
+
+    std::vector<SharedPayload> payloads;
+    for (const auto& event : events) {
+        payloads.push_back(event.payload);
+    }
+    for (const auto& [channel, members] : sessions.channels) {
+        if (channel.format != StreamFormat::Bitmap) {
+            continue;
+        }
+        const auto it = compressors_.find(channel);
+        if (it == compressors_.end()) {
+            continue;
+        }
+        const auto block = compress(*it->second, payloads);
+        for (const auto& member : members) {
+            if (member->is_open() && deliver(member, block, OutboundQueue::kNoCoalesceKey, now) && member->copies_payload()) {
+                copied += block->size();
+            }
+        }
+    }
+}
+
+bool SseServer::is_websocket(const HttpRequest& request) const
+{
+    return request.path == kWebSocketPath;
+}
+
+void SseServer::open_websocket(const std::shared_ptr<SseClient>& client, const HttpRequest& request)
+{
+    // Same subscription syntax as /events: /ws?inputs=3,7,atem2:3
+    const auto inputs = parse_subscription(request, monitor_);
+    schedule_liveness_check(client, websocket_heartbeat_payload());
+
+    std::vector<StreamEvent> events;
+    {
+        boost::json::object msg;
+        msg["server_version"] = version::GIT_VERSION;
+        msg["switchers"] = boost::json::value_from(monitor_.get_switcher_ids());
+        events.push_back({ make_cbor_event("server_info", msg), OutboundQueue::kNoCoalesceKey });
+    }
+    const auto covered = collect_websocket_state(inputs, events);
+    if (!deliver_all(client, events)) {
+        return;
+    }
+    // The replay ring holds SSE frames, so a client that missed a broadcast
+    // is sent the state again instead.
+    join(
+        covered,
+        [this, &inputs](uint64_t /*since*/, std::vector<StreamEvent>& missed) { return collect_websocket_state(inputs, missed); },
+        [this, &client](const std::vector<StreamEvent>& missed) { return deliver_all(client, missed); },
+        [this, &client, &inputs]() { sse_sessions_.add(client, inputs, StreamEncoding::Identity, StreamFormat::Cbor); });
+}
+
+uint64_t SseServer::collect_websocket_state(const std::vector<int32_t>& inputs, std::vector<StreamEvent>& out)
+{
+    // Read the counts first, as for /events: the states are at least this new.
+    const auto covered = replay_ring_.pushed();
+    const auto version = monitor_.get_state_version();
+    const bool is_mock = monitor_.is_mock_mode();
+    if (!inputs.empty()) {
+        for (const auto key : inputs) {
+            const TallyUpdate update = monitor_.get_tally_state(tally_key_switcher(key), tally_key_input(key)).to_update(is_mock);
+            out.push_back({ make_cbor_event("tally_update", boost::json::value_from(update), version), key });
+        }
+        return covered;
+    }
+
+    auto states = monitor_.get_all_tally_states();
+    std::sort(states.begin(), states.end(), [](const TallyState& a, const TallyState& b) { return a.key() < b.key(); });
+    boost::json::array list;
+    list.reserve(states.size());
+    for (const auto& state : states) {
+        list.emplace_back(boost::json::value_from(state.to_update(is_mock)));
+    }
+    boost::json::object msg;
+    msg["type"] = "tally_snapshot";
+    msg["version"] = version;
+    msg["mock"] = is_mock;
+    msg["inputs"] = std::move(list);
+    out.push_back({ make_cbor_event("tally_snapshot", msg, version), OutboundQueue::kNoCoalesceKey });
+    return covered;
+}
+
+bool SseServer::deliver_all(const std::shared_ptr<SseClient>& client, const std::vector<StreamEvent>& events)
+{
+    const auto now = OutboundQueue::Clock::now();
+    return std::all_of(events.begin(), events.end(), [this, &client, now](const StreamEvent& event) {
+        return deliver(client, event.payload, event.coalesce_key, now);
     });
-    service_->publish(tally_resource);
+}
+
+void SseServer::send_binary(const SessionRegistry::Snapshot& sessions, const SharedPayload& item, int32_t coalesce_key,
+    std::chrono::steady_clock::time_point now, uint64_t& copied)
+{
+    for (const auto& [client, inputs, encoding, format] : sessions.binary) {
+        const bool subscribed = inputs.empty() || coalesce_key == OutboundQueue::kNoCoalesceKey
+            || std::binary_search(inputs.begin(), inputs.end(), coalesce_key);
+        if (subscribed && client->is_open() && deliver(client, item, coalesce_key, now) && client->copies_payload()) {
+            copied += item->size();
+        }
+    }
+}
+
+void SseServer::close_event_stream(const std::shared_ptr<SseClient>& client)
+{
+    sse_sessions_.remove(client);
+}
+
+void SseServer::schedule_liveness_check(std::weak_ptr<SseClient> client, SharedPayload heartbeat)
+{
+    const auto interval = config_.sse_heartbeat_interval_ms > 0 ? config_.sse_heartbeat_interval_ms : config_.sse_dead_peer_timeout_ms;
+    if (interval == 0) {
+        return;
+    }
+    wheel_.schedule(std::chrono::milliseconds(interval), [this, client = std::move(client), heartbeat = std::move(heartbeat)]() { check_liveness(client, heartbeat); });
+}
+
+void SseServer::check_liveness(const std::weak_ptr<SseClient>& weak_client, const SharedPayload& heartbeat)
+{
+    const auto client = weak_client.lock();
+    if (!client) {
+        return; // Already gone
+    }
+
+    const auto now = OutboundQueue::Clock::now();
+    if (is_zombie(*client, now)) {
+        if (sse_sessions_.remove(client)) {
+            log(LogLevel::Warning) << "Reaping dead SSE client " << client->remote_address();
+            reaped_.fetch_add(1, std::memory_order_relaxed);
+        }
+        client->close();
+        return;
+    }
+
+    // Only idle streams need a heartbeat; a pending write already tests the peer.
+    if (config_.sse_heartbeat_interval_ms > 0 && !client->queue_stats().writing) {
+        heartbeats_.fetch_add(1, std::memory_order_relaxed);
+        if (!deliver(client, heartbeat, OutboundQueue::kNoCoalesceKey, now)) {
+            return;
+        }
+    }
+    schedule_liveness_check(weak_client, heartbeat);
+}
+
+bool SseServer::is_zombie(const SseClient& client, OutboundQueue::Clock::time_point now) const
+{
+    if (!client.is_open()) {
+        return true;
+    }
+    if (config_.sse_dead_peer_timeout_ms == 0) {
+        return false;
+    }
+    const auto queue = client.queue_stats();
+    return queue.writing && now - queue.last_progress > std::chrono::milliseconds(config_.sse_dead_peer_timeout_ms);
+}
+
+bool SseServer::deliver(const std::shared_ptr<SseClient>& client, const SharedPayload& payload, int32_t coalesce_key, OutboundQueue::Clock::time_point now)
+{
+    if (client->send(payload, coalesce_key, now)) {
+        return true;
+    }
+
+    // The client stopped draining its queue; drop it so it can't hold memory
+    // or delay anyone else.
+    log(LogLevel::Warning) << "Evicting stalled SSE client " << client->remote_address();
+    evictions_.fetch_add(1, std::memory_order_relaxed);
+    client->close();
+    sse_sessions_.remove(client);
+    return false;
+}
+
+HttpResponse SseServer::metrics_response(const HttpRequest& request)
+{
+    const auto stats = get_broadcast_stats();
+    boost::json::object broadcast;
+    broadcast["count"] = stats.broadcasts;
+    broadcast["payload_bytes"] = stats.payload_bytes;
+    broadcast["bytes_copied"] = stats.bytes_copied;
+    broadcast["last_bytes_copied"] = stats.last_bytes_copied;
+
+    boost::json::object latency;
+    latency["last"] = stats.last_latency_us;
+    latency["max"] = stats.max_latency_us;
+    latency["mean"] = stats.broadcasts > 0 ? stats.total_latency_us / stats.broadcasts : 0;
+    broadcast["latency_us"] = std::move(latency);
+
+    boost::json::object msg;
+    msg["engine"] = use_asio_engine() ? "asio" : "restbed";
+    msg["broadcast"] = std::move(broadcast);
+    const auto sessions = sse_sessions_.snapshot();
+    msg["sse_sessions"] = sessions->size();
+    msg["evictions"] = evictions_.load(std::memory_order_relaxed);
+    {
+        // Zombies are registered streams that are closed or whose peer has
+        // stopped reading; the reaper removes them on their next check.
+        const auto now = OutboundQueue::Clock::now();
+        std::size_t zombies = 0;
+        sessions->for_each([&](const auto& session) {
+            if (is_zombie(*session, now)) {
+                ++zombies;
+            }
+        });
+        boost::json::object liveness;
+        liveness["live"] = sessions->size() - zombies;
+        liveness["zombie"] = zombies;
+        liveness["reaped"] = reaped_.load(std::memory_order_relaxed);
+        liveness["heartbeats"] = heartbeats_.load(std::memory_order_relaxed);
+        liveness["timers"] = wheel_.size();
+        msg["liveness"] = std::move(liveness);
+    }
+    {
+        const auto pages = page_cache_.stats();
+        boost::json::object cache;
+        cache["entries"] = pages.entries;
+        cache["hits"] = pages.hits;
+        cache["misses"] = pages.misses;
+        cache["not_modified"] = pages.not_modified;
+        cache["invalidations"] = pages.invalidations;
+        cache["bytes_saved"] = pages.bytes_saved;
+        msg["page_cache"] = std::move(cache);
+    }
+    {
+        // Ratio is compressed over uncompressed bytes; the cost is the time
+        // spent in deflate, spread over the events compressed.
+        const auto events = compressed_events_.load(std::memory_order_relaxed);
+        const auto bytes_in = compressed_bytes_in_.load(std::memory_order_relaxed);
+        const auto bytes_out = compressed_bytes_out_.load(std::memory_order_relaxed);
+        std::size_t streams = 0;
+        for (const auto& [channel, members] : sessions->channels) {
+            streams += members.size();
+        }
+        boost::json::object compression;
+        compression["enabled"] = config_.sse_compression;
+        compression["streams"] = streams;
+        compression["channels"] = sessions->channels.size();
+        compression["blocks"] = compressions_.load(std::memory_order_relaxed);
+        compression["events"] = events;
+        compression["bytes_in"] = bytes_in;
+        compression["bytes_out"] = bytes_out;
+        compression["ratio"] = bytes_in > 0 ? static_cast<double>(bytes_out) / static_cast<double>(bytes_in) : 0.0;
+        compression["ns_per_event"] = events > 0 ? compress_ns_.load(std::memory_order_relaxed) / events : 0;
+        msg["compression"] = std::move(compression);
+    }
+    msg["websocket_clients"] = sessions->binary.size();
+    msg["resumes"] = resumes_.load(std::memory_order_relaxed);
+    {
+        const auto polls = long_poll_.stats();
+        boost::json::object long_poll;
+        long_poll["waiting"] = polls.waiting;
+        long_poll["parked"] = polls.parked;
+        long_poll["answered"] = polls.answered;
+        long_poll["timed_out"] = polls.timed_out;
+        long_poll["rejected"] = polls.rejected;
+        msg["long_poll"] = std::move(long_poll);
+    }
+    msg["resume_fallbacks"] = resume_fallbacks_.load(std::memory_order_relaxed);
+
+    // Per-session queue details are opt-in; the list can be long.
+    if (request.get_query("sessions") == "true") {
+        boost::json::array list;
+        list.reserve(sessions->size());
+        for (const auto& [session, inputs, encoding, format] : sessions->entries) {
+            const auto queue = session->queue_stats();
+            boost::json::object entry;
+            entry["remote"] = session->remote_address();
+            if (!inputs.empty()) {
+                entry["inputs"] = boost::json::value_from(inputs);
+            }
+            if (encoding != StreamEncoding::Identity) {
+                entry["encoding"] = content_encoding_name(encoding);
+            }
+            if (format == StreamFormat::Bitmap) {
+                entry["format"] = "bitmap";
+            } else if (format == StreamFormat::Cbor) {
+                entry["format"] = "cbor";
+            }
+            entry["queue_depth"] = queue.depth;
+            entry["max_queue_depth"] = queue.max_depth;
+            entry["written"] = queue.written;
+            entry["coalesced"] = queue.coalesced;
+            entry["overflows"] = queue.overflows;
+            list.emplace_back(std::move(entry));
+        }
+        msg["sessions"] = std::move(list);
+    }
+    if (const auto batch = get_batch_stats()) {
+        boost::json::object batching;
+        batching["window_ms"] = config_.sse_batch_window_ms;
+        batching["batches"] = batch->batches;
+        batching["updates"] = batch->updates;
+        batching["merged"] = batch->merged;
+        batching["writes_saved"] = batch_writes_saved_.load(std::memory_order_relaxed);
+        boost::json::object delay;
+        delay["last"] = batch->last_delay_us;
+        delay["max"] = batch->max_delay_us;
+        delay["mean"] = batch->updates > batch->merged ? batch->total_delay_us / (batch->updates - batch->merged) : 0;
+        batching["added_latency_us"] = std::move(delay);
+        msg["batching"] = std::move(batching);
+    }
+    if (asio_server_) {
+        msg["connections"] = asio_server_->connection_count();
+        msg["io_threads"] = boost::json::value_from(asio_server_->thread_stats());
+        if (config_.http2_enabled) {
+            boost::json::object http2;
+            http2["connections"] = asio_server_->http2_connection_count();
+            http2["streams"] = asio_server_->http2_stream_count();
+            msg["http2"] = std::move(http2);
+        }
+    }
+    msg["resident_bytes"] = platform::get_resident_memory();
+    for (const auto& [name, source] : metrics_sources_) {
+        msg[name] = source();
+    }
+    return { restbed::OK, { { "Content-Type", "application/json" } }, boost::json::serialize(msg) };
+}
+
+void SseServer::setup_endpoints()
+{
+    // Pages are rendered by handle_request(); restbed only adapts the session.
+    // A deferred request keeps the session until its responder runs.
+    const auto page_handler = [this](const std::shared_ptr<restbed::Session> session) {
+        const auto request = to_http_request(*session->get_request());
+        if (is_deferred(request)) {
+            handle_deferred(request, [session](const HttpResponse& response) { send_response(session, response); });
+            return;
+        }
+        send_response(session, handle_request(request));
+    };
+    for (const auto* path : { "/", "/status", "/tally/{id: [A-Za-z0-9_.-]*:?\\d+}", "/metrics", "/api/tally" }) {
+        auto resource = std::make_shared<restbed::Resource>();
+        resource->set_path(path);
+        resource->set_method_handler("GET", page_handler);
+        service_->publish(resource);
+    }
 
     // --- SSE Events Endpoint ---
     auto sse_resource = std::make_shared<restbed::Resource>();
-    sse_resource->set_path("/events");
+    sse_resource->set_paths({ "/events", "/events/{id: [A-Za-z0-9_.-]*:?\\d+}" });
     sse_resource->set_method_handler("GET", [this](const std::shared_ptr<restbed::Session> session) {
-        // Add session to our list
-        {
-            const std::scoped_lock lock(sessions_mutex_);
-            sse_sessions_.insert(session);
-        }
-
-        const std::multimap<std::string, std::string> headers = {
+        const auto request = to_http_request(*session->get_request());
+        std::multimap<std::string, std::string> headers = {
             { "Content-Type", "text/event-stream" },
             { "Cache-Control", "no-cache" },
             { "Connection", "keep-alive" }
         };
+        if (const auto encoding = event_stream_encoding(request); !encoding.empty()) {
+            headers.emplace("Content-Encoding", encoding);
+            headers.emplace("Vary", "Accept-Encoding");
+        }
 
         // Send the headers to start the event stream.
         session->yield(restbed::OK, headers);
 
-        // Send server info to the newly connected client for version checking
-        {
-            boost::json::object msg;
-            msg["server_version"] = version::GIT_VERSION;
-            session->yield("event: server_info\ndata: " + boost::json::serialize(boost::json::value_from(msg)) + "\n\n");
-        }
+        open_event_stream(std::make_shared<RestbedSseClient>(session, config_), request);
+    });
 
-        // Send initial state to the newly connected client
-        for (const auto& state : monitor_.get_all_tally_states()) {
-            const TallyUpdate update = state.to_update(monitor_.is_mock_mode());
-            const auto data = boost::json::serialize(boost::json::value_from(update));
-            const auto message = "event: tally_update\ndata: " + data + "\n\n";
-            session->yield(message);
+    service_->publish(sse_resource);
+
+    // --- WebSocket Endpoint ---
+    auto ws_resource = std::make_shared<restbed::Resource>();
+    ws_resource->set_path(std::string(kWebSocketPath));
+    ws_resource->set_method_handler("GET", [this](const std::shared_ptr<restbed::Session> session) {
+        const auto request = to_http_request(*session->get_request());
+        if (!is_websocket_upgrade(request)) {
+            send_response(session, { 426, { { "Upgrade", "websocket" }, { "Content-Type", "text/plain" } }, "Upgrade Required" });
+            return;
         }
+        const std::multimap<std::string, std::string> headers = {
+            { "Upgrade", "websocket" },
+            { "Connection", "Upgrade" },
+            { "Sec-WebSocket-Accept", websocket_accept_key(request.get_header("Sec-WebSocket-Key")) }
+        };
+        session->upgrade(restbed::SWITCHING_PROTOCOLS, headers, [this, request, remote = session->get_origin()](const std::shared_ptr<restbed::WebSocket> socket) {
+            auto client = std::make_shared<RestbedWebSocketClient>(socket, remote, config_);
+            const std::weak_ptr<SseClient> weak_client = client;
+            socket->set_close_handler([this, weak_client](const std::shared_ptr<restbed::WebSocket>) {
+                if (const auto closed = weak_client.lock()) {
+                    close_event_stream(closed);
+                }
+            });
+            socket->set_error_handler([this, weak_client](const std::shared_ptr<restbed::WebSocket> source, const std::error_code) {
+                source->close();
+                if (const auto closed = weak_client.lock()) {
+                    close_event_stream(closed);
+                }
+            });
+            // Clients only send control frames; anything else is ignored.
+            socket->set_message_handler([](const std::shared_ptr<restbed::WebSocket> source, const std::shared_ptr<restbed::WebSocketMessage> message) {
+                const auto opcode = message->get_opcode();
+                if (opcode == restbed::WebSocketMessage::PING_FRAME) {
+                    source->send(restbed::WebSocketMessage::PONG_FRAME);
+                } else if (opcode == restbed::WebSocketMessage::CONNECTION_CLOSE_FRAME) {
+                    source->close();
+                }
+            });
+            open_websocket(client, request);
+        });
     });
+    service_->publish(ws_resource);
+}
 
-    service_->publish(sse_resource);
+void SseServer::broadcast(std::string_view event, const boost::json::value& data, int32_t coalesce_key, uint64_t version)
+{
+    const auto started = std::chrono::steady_clock::now();
+
+    const auto json = boost::json::serialize(data);
+
+    // Record the event even with no one connected, so a client that drops
+    // now can still resume from it. The current snapshot is taken with it;
+    // connects and disconnects publish a new one without waiting for this
+    // broadcast to finish.
+    SharedPayload payload;
+    std::shared_ptr<const SessionRegistry::Snapshot> sessions;
+    std::unique_lock<std::mutex> channel_lock;
+    uint64_t copied = 0;
+    {
+        const std::scoped_lock lock(sequence_mutex_);
+        // Frame the event once, with its position in the ring as its id.
+        // Every session is handed the same immutable buffer instead of a
+        // per-session std::string.
+        payload = make_sse_payload(event, json, monitor_.format_event_id(replay_ring_.pushed() + 1));
+        replay_ring_.push(coalesce_key, payload);
+        sessions = sse_sessions_.snapshot();
+
+        // Queue to uncompressed clients in ring order, so the last id a
+        // client saw always marks everything before it as seen. `send` only
+        // queues and is thread-safe, so we can call it directly.
+        const auto send_to = [&](const std::shared_ptr<SseClient>& session) {
+            if (session->is_open() && deliver(session, payload, coalesce_key, started) && session->copies_payload()) {
+                copied += payload->size();
+            }
+        };
+        if (coalesce_key == OutboundQueue::kNoCoalesceKey) {
+            sessions->for_each_uncompressed(send_to);
+        } else {
+            // Tally updates only reach clients subscribed to that input.
+            sessions->for_each_subscriber(coalesce_key, send_to);
+        }
+        if (needs_ordered_fanout(*sessions)) {
+            channel_lock = std::unique_lock(channel_mutex_);
+        }
+    }
+    if (sessions->empty()) {
+        return;
+    }
+
+    if (channel_lock) {
+        send_to_channels(
+            *sessions, [&](const SessionRegistry::ChannelKey& channel, std::vector<SharedPayload>& events) {
+                if (channel.receives(coalesce_key)) {
+                    events.push_back(payload);
+                }
+            },
+            started, copied);
+        send_bitmaps(*sessions, started, copied);
+        channel_lock.unlock();
+    }
+
+    if (!sessions->binary.empty()) {
+        send_binary(*sessions, make_cbor_event(event, data, version), coalesce_key, started, copied);
+    }
+
+    record_broadcast(started, payload->size(), copied);
 }
 
-void SseServer::broadcast(const std::string& event, const std::string& data)
+void SseServer::broadcast_tally_batch(std::vector<TallyBatcher::Entry> batch)
 {
-    const std::scoped_lock lock(sessions_mutex_);
-    if (sse_sessions_.empty()) {
+    if (batch.size() == 1) {
+        const auto& entry = batch.front();
+        broadcast("tally_update", boost::json::value_from(entry.update), entry.update.key(), entry.version);
         return;
     }
 
-    const auto message = "event: " + event + "\ndata: " + data + "\n\n";
+    const auto started = std::chrono::steady_clock::now();
 
-    // `yield` is thread-safe, so we can call it directly.
-    for (const auto& session : sse_sessions_) {
-        if (session->is_open()) {
-            session->yield(message);
+    // Push the updates in the order the monitor applied them.
+    std::sort(batch.begin(), batch.end(), [](const auto& a, const auto& b) { return a.version < b.version; });
+
+    std::vector<std::string> jsons;
+    jsons.reserve(batch.size());
+    boost::json::array list;
+    list.reserve(batch.size());
+    for (const auto& entry : batch) {
+        auto value = boost::json::value_from(entry.update);
+        jsons.push_back(boost::json::serialize(value));
+        list.emplace_back(std::move(value));
+    }
+    boost::json::object msg;
+    msg["type"] = "tally_batch";
+    msg["updates"] = list;
+    const auto combined_json = boost::json::serialize(msg);
+
+    std::vector<SharedPayload> updates;
+    updates.reserve(batch.size());
+    SharedPayload combined;
+    std::shared_ptr<const SessionRegistry::Snapshot> sessions;
+    std::unique_lock<std::mutex> channel_lock;
+    uint64_t copied = 0;
+    {
+        const std::scoped_lock lock(sequence_mutex_);
+        // The ring keeps the individual updates so filtered clients can resume
+        // too. The combined event carries the id of the last of them.
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            updates.push_back(make_sse_payload("tally_update", jsons[i], monitor_.format_event_id(replay_ring_.pushed() + 1)));
+            replay_ring_.push(batch[i].update.key(), updates[i]);
+        }
+        combined = make_sse_payload("tally_batch", combined_json, monitor_.format_event_id(replay_ring_.pushed()));
+        sessions = sse_sessions_.snapshot();
+
+        // Queued in ring order, as in broadcast().
+        const auto send = [&](const std::shared_ptr<SseClient>& session, const SharedPayload& payload, int32_t coalesce_key) {
+            if (session->is_open() && deliver(session, payload, coalesce_key, started) && session->copies_payload()) {
+                copied += payload->size();
+            }
+        };
+        // One write per client that follows every input...
+        for (const auto& session : sessions->unfiltered) {
+            send(session, combined, OutboundQueue::kNoCoalesceKey);
         }
+        // ...and the matching single updates for filtered clients.
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            if (const auto it = sessions->by_input.find(batch[i].update.key()); it != sessions->by_input.end()) {
+                for (const auto& session : it->second) {
+                    send(session, updates[i], batch[i].update.key());
+                }
+            }
+        }
+        if (needs_ordered_fanout(*sessions)) {
+            channel_lock = std::unique_lock(channel_mutex_);
+        }
+    }
+    if (sessions->empty()) {
+        return;
     }
+
+    if (channel_lock) {
+        // Compressed channels get the same split, one block per channel.
+        send_to_channels(
+            *sessions, [&](const SessionRegistry::ChannelKey& channel, std::vector<SharedPayload>& events) {
+                if (channel.inputs.empty()) {
+                    events.push_back(combined);
+                    return;
+                }
+                for (std::size_t i = 0; i < batch.size(); ++i) {
+                    if (channel.receives(batch[i].update.key())) {
+                        events.push_back(updates[i]);
+                    }
+                }
+            },
+            started, copied);
+        send_bitmaps(*sessions, started, copied);
+        channel_lock.unlock();
+    }
+
+    // WebSocket clients get the single updates; their transport packs
+    // whatever is queued into one message anyway.
+    if (!sessions->binary.empty()) {
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            send_binary(*sessions, make_cbor_event("tally_update", list[i], batch[i].version), batch[i].update.key(), started, copied);
+        }
+    }
+    batch_writes_saved_.fetch_add((batch.size() - 1) * sessions->unfiltered.size(), std::memory_order_relaxed);
+
+    uint64_t payload_bytes = combined->size();
+    for (const auto& update : updates) {
+        payload_bytes += update->size();
+    }
+    record_broadcast(started, payload_bytes, copied);
+}
+
+bool SseServer::needs_ordered_fanout(const SessionRegistry::Snapshot& sessions)
+{
+    return !sessions.channels.empty() || sessions.has_bitmap_clients();
+}
+
+void SseServer::record_broadcast(std::chrono::steady_clock::time_point started, uint64_t payload_bytes, uint64_t copied)
+{
+    const auto latency_us = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count());
+
+    broadcasts_.fetch_add(1, std::memory_order_relaxed);
+    payload_bytes_.fetch_add(payload_bytes, std::memory_order_relaxed);
+    bytes_copied_.fetch_add(copied, std::memory_order_relaxed);
+    last_bytes_copied_.store(copied, std::memory_order_relaxed);
+    last_latency_us_.store(latency_us, std::memory_order_relaxed);
+    total_latency_us_.fetch_add(latency_us, std::memory_order_relaxed);
+    auto max = max_latency_us_.load(std::memory_order_relaxed);
+    while (latency_us > max && !max_latency_us_.compare_exchange_weak(max, latency_us, std::memory_order_relaxed)) { }
 }
 
 } // namespace atem
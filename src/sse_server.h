@@ -1,25 +1,57 @@
 #pragma once
 
+#include "event_ring.h"
+#include "http_message.h"
+#include "long_poll.h"
+#include "page_cache.h"
+#include "session_registry.h"
+#include "sse_compression.h"
+#include "sse_payload.h"
+#include "tally_batcher.h"
 #include "tally_state.h"
+#include "timer_wheel.h"
+#include <atomic>
+#include <boost/asio.hpp>
+#include <boost/json.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <gsl/gsl>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wdeprecated-declarations"
 #include <restbed>
 #pragma clang diagnostic pop
 #include <string>
-#include <unordered_set>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace atem {
 
 struct Config;
 class TallyMonitor;
+class AsioHttpServer;
 
-class SseServer final {
+class SseServer final : private HttpHandler {
 public:
-    SseServer(const Config& config, gsl::not_null<TallyMonitor*> monitor);
-    ~SseServer();
+    // Counters describing the cost of the broadcast path.
+    struct BroadcastStats {
+        uint64_t broadcasts = 0;
+        uint64_t payload_bytes = 0; // Bytes framed, once per broadcast
+        uint64_t bytes_copied = 0; // Bytes duplicated for individual sessions
+        uint64_t last_bytes_copied = 0; // bytes_copied of the most recent broadcast
+        uint64_t last_latency_us = 0; // Time to hand the most recent event to every session
+        uint64_t max_latency_us = 0;
+        uint64_t total_latency_us = 0;
+    };
+
+    // `ioc` is the monitor's io_context; it runs the tally batching window.
+    SseServer(boost::asio::io_context& ioc, const Config& config, gsl::not_null<TallyMonitor*> monitor);
+    ~SseServer() override;
 
     // Non-copyable, non-movable
     SseServer(const SseServer&) = delete;
@@ -27,21 +59,167 @@ public:
     SseServer(SseServer&&) = delete;
     SseServer& operator=(SseServer&&) = delete;
 
+    // Runs the configured HTTP engine. Blocks until stop() is called.
     void start();
     void stop();
 
-    void broadcast_tally_update(const TallyUpdate& update);
-    void broadcast_mode_change(bool is_mock);
+    // `version` is the state version the monitor applied the change at; it
+    // becomes the event id.
+    void broadcast_tally_update(const TallyUpdate& update, uint64_t version);
+    void broadcast_mode_change(bool is_mock, uint64_t version);
+    // Sends every client the whole state again after a switcher's input list
+    // was replaced, and answers the long polls.
+    void broadcast_inputs_change(uint64_t version);
+
+    // Adds `source()` to /metrics under `name`, for components that live
+    // outside the server. Call before start().
+    using MetricsSource = std::function<boost::json::value()>;
+    void add_metrics(std::string name, MetricsSource source);
+
+    BroadcastStats get_broadcast_stats() const;
+    // Empty when batching is disabled.
+    std::optional<TallyBatcher::Stats> get_batch_stats() const;
 
 private:
+    // HttpHandler implementation, shared by the restbed and Asio engines.
+    HttpResponse handle_request(const HttpRequest& request) override;
+    // /api/tally?since= waits for the state to move past that version.
+    bool is_deferred(const HttpRequest& request) const override;
+    void handle_deferred(const HttpRequest& request, Responder respond) override;
+    bool is_event_stream(const HttpRequest& request) const override;
+    std::string_view event_stream_encoding(const HttpRequest& request) const override;
+    void open_event_stream(const std::shared_ptr<SseClient>& client, const HttpRequest& request) override;
+    bool is_websocket(const HttpRequest& request) const override;
+    // Sends server_info and the current state as CBOR items.
+    void open_websocket(const std::shared_ptr<SseClient>& client, const HttpRequest& request) override;
+    void close_event_stream(const std::shared_ptr<SseClient>& client) override;
+
+    HttpResponse metrics_response(const HttpRequest& request);
+    // The inputs that changed after version `since` as JSON, tagged with the
+    // current version as ETag. Since 0 is the full state.
+    HttpResponse tally_response(uint64_t since) const;
+    // Serves a rendered page from the cache, rendering it on a miss.
+    HttpResponse page_response(const HttpRequest& request, std::string_view route, int id, const PageCache::Renderer& render);
     void setup_endpoints();
-    void broadcast(const std::string& event, const std::string& data);
+    // Broadcasts one event, tagged with its position in the replay ring. Tally
+    // updates pass their tally key (tally_key()) as the coalescing key so a
+    // backed-up client only keeps the latest state; the same key limits
+    // delivery to that input's subscribers.
+    // The data is serialized once as JSON for SSE and, only when /ws clients
+    // are connected, once as CBOR.
+    void broadcast(std::string_view event, const boost::json::value& data, int32_t coalesce_key, uint64_t version);
+    // Sends the changes of one batching window: a single tally_batch event to
+    // clients that follow every input, and per-input tally_update events to
+    // filtered clients and the replay ring.
+    void broadcast_tally_batch(std::vector<TallyBatcher::Entry> batch);
+    void record_broadcast(std::chrono::steady_clock::time_point started, uint64_t payload_bytes, uint64_t copied);
+
+    // An event queued for one client, with its coalescing key.
+    struct StreamEvent {
+        SharedPayload payload;
+        int32_t coalesce_key = OutboundQueue::kNoCoalesceKey;
+    };
+
+    [[nodiscard]] StreamEncoding stream_encoding(const HttpRequest& request) const;
+    // Collects what a new client is sent before live events: the events it
+    // missed if it can resume, otherwise server_info and the current state.
+    // These collectors return how many events pushed to the replay ring the
+    // collected events cover.
+    uint64_t collect_initial_events(const HttpRequest& request, const std::vector<int32_t>& inputs, StreamFormat format,
+        std::vector<StreamEvent>& out);
+    uint64_t collect_state(const std::vector<int32_t>& inputs, StreamFormat format, std::vector<StreamEvent>& out);
+    // The events pushed after the first `covered`, or the current state if
+    // the ring no longer has them all.
+    uint64_t collect_events_after(uint64_t covered, const std::vector<int32_t>& inputs, StreamFormat format, std::vector<StreamEvent>& out);
+    // The state a /ws client starts from, as CBOR items.
+    uint64_t collect_websocket_state(const std::vector<int32_t>& inputs, std::vector<StreamEvent>& out);
+    // Registers a new client for live events once it has been sent every
+    // event pushed to the replay ring. `covered` is how many it has been sent;
+    // `collect_after` and `send` catch it up on events pushed since.
+    template <typename CollectAfter, typename Send, typename Register>
+    void join(uint64_t covered, CollectAfter&& collect_after, Send&& send, Register&& register_client);
+    // Sends a compressed client its own header and initial events, then joins
+    // it to the channel shared by clients with the same encoding and inputs.
+    void open_compressed_stream(const std::shared_ptr<SseClient>& client, const HttpRequest& request, SessionRegistry::ChannelKey channel);
+    // Compresses `events` as one sync-flushed block and records the cost.
+    SharedPayload compress(StreamCompressor& compressor, const std::vector<SharedPayload>& events);
+    // Whether a broadcast to `sessions` uses channel_mutex_.
+    static bool needs_ordered_fanout(const SessionRegistry::Snapshot& sessions);
+    // Compresses the events each per-input channel receives once and queues
+    // the result for every client in it. `events_for` returns the events for
+    // a channel. This and send_bitmaps() run under channel_mutex_.
+    template <typename EventsFor>
+    void send_to_channels(const SessionRegistry::Snapshot& sessions, EventsFor&& events_for,
+        std::chrono::steady_clock::time_point now, uint64_t& copied);
+    // Queues one CBOR item for every /ws client subscribed to `coalesce_key`.
+    void send_binary(const SessionRegistry::Snapshot& sessions, const SharedPayload& item, int32_t coalesce_key,
+        std::chrono::steady_clock::time_point now, uint64_t& copied);
+    // Sends the current tally_bitmap to every bitmap client, compressed or not.
+    void send_bitmaps(const SessionRegistry::Snapshot& sessions, std::chrono::steady_clock::time_point now, uint64_t& copied);
+
+    // Each stream has one entry on the timer wheel. When it fires, the stream
+    // gets `heartbeat` if idle, or is reaped if its peer has gone away.
+    void schedule_liveness_check(std::weak_ptr<SseClient> client, SharedPayload heartbeat);
+    void check_liveness(const std::weak_ptr<SseClient>& weak_client, const SharedPayload& heartbeat);
+    // A closed stream still in the registry, or one whose write has made no
+    // progress for the dead-peer timeout.
+    [[nodiscard]] bool is_zombie(const SseClient& client, OutboundQueue::Clock::time_point now) const;
+    // Collects the events a reconnecting client missed. Returns nothing when
+    // the client sent no Last-Event-ID or the gap is no longer in the ring.
+    std::optional<uint64_t> collect_missed_events(const HttpRequest& request, const std::vector<int32_t>& inputs,
+        std::vector<StreamEvent>& out);
+    // Moves the entries a client subscribed to into `out`.
+    static void collect_subscribed(std::vector<EventRing::Entry>& entries, const std::vector<int32_t>& inputs, std::vector<StreamEvent>& out);
+    // Queues a payload for one client and evicts it if it has stalled.
+    bool deliver(const std::shared_ptr<SseClient>& client, const SharedPayload& payload, int32_t coalesce_key,
+        OutboundQueue::Clock::time_point now = OutboundQueue::Clock::now());
+    // Queues `events` in order; false once one of them evicted the client.
+    bool deliver_all(const std::shared_ptr<SseClient>& client, const std::vector<StreamEvent>& events);
+    [[nodiscard]] bool use_asio_engine() const;
 
     const Config& config_;
     TallyMonitor& monitor_;
     const std::shared_ptr<restbed::Service> service_;
-    std::unordered_set<std::shared_ptr<restbed::Session>> sse_sessions_;
-    std::mutex sessions_mutex_;
+    std::unique_ptr<AsioHttpServer> asio_server_;
+    std::unique_ptr<TallyBatcher> batcher_;
+    TimerWheel wheel_;
+    SessionRegistry sse_sessions_;
+    EventRing replay_ring_;
+    PageCache page_cache_;
+    LongPollRegistry long_poll_;
+    // Held while a broadcast pushes an event to the replay ring, takes the
+    // session snapshot and queues the event for uncompressed clients, so every
+    // client gets events in ring order. Queueing never blocks on the network.
+    // Also held to register a client that has caught up (see join()). Building
+    // initial events, compression, bitmaps and CBOR happen without it.
+    std::mutex sequence_mutex_;
+    // Guards the channel compressors and the bitmap sends. A broadcast takes it
+    // before releasing sequence_mutex_, so each compressor sees events in
+    // push order and a bitmap never follows a newer one.
+    std::mutex channel_mutex_;
+    std::map<SessionRegistry::ChannelKey, std::unique_ptr<StreamCompressor>> compressors_;
+    uint64_t bitmap_index_version_ = 0; // Last tally_bitmap_index broadcast; guarded by channel_mutex_
+    std::vector<std::pair<std::string, MetricsSource>> metrics_sources_;
+    std::atomic<bool> running_ { false };
+
+    std::atomic<uint64_t> broadcasts_ { 0 };
+    std::atomic<uint64_t> payload_bytes_ { 0 };
+    std::atomic<uint64_t> bytes_copied_ { 0 };
+    std::atomic<uint64_t> last_bytes_copied_ { 0 };
+    std::atomic<uint64_t> last_latency_us_ { 0 };
+    std::atomic<uint64_t> max_latency_us_ { 0 };
+    std::atomic<uint64_t> total_latency_us_ { 0 };
+    std::atomic<uint64_t> evictions_ { 0 };
+    std::atomic<uint64_t> resumes_ { 0 };
+    std::atomic<uint64_t> resume_fallbacks_ { 0 };
+    std::atomic<uint64_t> batch_writes_saved_ { 0 };
+    std::atomic<uint64_t> heartbeats_ { 0 };
+    std::atomic<uint64_t> reaped_ { 0 };
+    std::atomic<uint64_t> compressions_ { 0 };
+    std::atomic<uint64_t> compressed_events_ { 0 };
+    std::atomic<uint64_t> compressed_bytes_in_ { 0 };
+    std::atomic<uint64_t> compressed_bytes_out_ { 0 };
+    std::atomic<uint64_t> compress_ns_ { 0 };
 };
 
 } // namespace atem
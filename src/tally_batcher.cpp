@@ -0,0 +1,74 @@
+#include "tally_batcher.h"
+#include <algorithm>
+#include <utility>
+
+namespace atem {
+
+TallyBatcher::TallyBatcher(boost::asio::io_context& ioc, std::chrono::milliseconds window, FlushCallback callback)
+    : window_(window)
+    , callback_(std::move(callback))
+    , timer_(ioc)
+{
+}
+
+void TallyBatcher::add(const TallyUpdate& update, uint64_t version)
+{
+    const std::scoped_lock lock(mutex_);
+    ++stats_.updates;
+
+    const auto it = std::find_if(pending_.begin(), pending_.end(),
+        [&update](const Entry& entry) { return entry.update.key() == update.key(); });
+    if (it != pending_.end()) {
+        // Only the latest state of an input matters; keep its original queue time.
+        it->update = update;
+        it->version = version;
+        ++stats_.merged;
+        return;
+    }
+
+    pending_.push_back({ update, version, Clock::now() });
+    if (pending_.size() == 1) {
+        timer_.expires_after(window_);
+        timer_.async_wait([this](const boost::system::error_code& ec) {
+            if (!ec) {
+                flush();
+            }
+        });
+    }
+}
+
+void TallyBatcher::flush()
+{
+    const std::scoped_lock flush_lock(flush_mutex_);
+
+    std::vector<Entry> batch;
+    {
+        const std::scoped_lock lock(mutex_);
+        if (pending_.empty()) {
+            return;
+        }
+        batch.swap(pending_);
+        timer_.cancel();
+
+        const auto now = Clock::now();
+        uint64_t oldest_us = 0;
+        for (const auto& entry : batch) {
+            const auto delay_us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - entry.queued).count());
+            stats_.total_delay_us += delay_us;
+            oldest_us = std::max(oldest_us, delay_us);
+        }
+        ++stats_.batches;
+        stats_.last_delay_us = oldest_us;
+        stats_.max_delay_us = std::max(stats_.max_delay_us, oldest_us);
+    }
+
+    callback_(batch);
+}
+
+TallyBatcher::Stats TallyBatcher::stats() const
+{
+    const std::scoped_lock lock(mutex_);
+    return stats_;
+}
+
+} // namespace atem
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "tally_state.h"
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace atem {
+
+/**
+ * @class TallyBatcher
+ * @brief Collects the tally changes of one transition into a single broadcast.
+ *
+ * A cut on the switcher arrives as separate program and preview changes. The
+ * first change opens a short window; every change that arrives before it
+ * closes is merged (latest state per input) and handed to the flush callback
+ * in one go.
+ */
+class TallyBatcher final {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        TallyUpdate update;
+        uint64_t version; // Monitor state version of this change
+        Clock::time_point queued; // When the input first entered this batch
+    };
+
+    struct Stats {
+        uint64_t batches = 0;
+        uint64_t updates = 0; // Changes received
+        uint64_t merged = 0; // Changes superseded by a later one for the same input
+        uint64_t last_delay_us = 0; // Time the most recent batch held its oldest change
+        uint64_t max_delay_us = 0;
+        uint64_t total_delay_us = 0; // Summed over every flushed change
+    };
+
+    using FlushCallback = std::function<void(const std::vector<Entry>& batch)>;
+
+    TallyBatcher(boost::asio::io_context& ioc, std::chrono::milliseconds window, FlushCallback callback);
+
+    // Non-copyable, non-movable
+    TallyBatcher(const TallyBatcher&) = delete;
+    TallyBatcher& operator=(const TallyBatcher&) = delete;
+    TallyBatcher(TallyBatcher&&) = delete;
+    TallyBatcher& operator=(TallyBatcher&&) = delete;
+    ~TallyBatcher() = default;
+
+    void add(const TallyUpdate& update, uint64_t version);
+    // Hands any pending changes to the callback now, e.g. before an event
+    // that must not overtake them.
+    void flush();
+
+    [[nodiscard]] Stats stats() const;
+
+private:
+    const std::chrono::milliseconds window_;
+    const FlushCallback callback_;
+    boost::asio::steady_timer timer_;
+
+    // Held for the whole flush so batches reach the callback in order.
+    std::mutex flush_mutex_;
+    mutable std::mutex mutex_;
+    std::vector<Entry> pending_;
+    Stats stats_;
+};
+
+} // namespace atem
@@ -0,0 +1,92 @@
+#include "tally_frame.h"
+
+namespace atem {
+
+namespace {
+
+    constexpr uint8_t kMagic0 = 'A';
+    constexpr uint8_t kMagic1 = 'T';
+    constexpr uint8_t kFormatVersion = 1;
+    constexpr uint8_t kProgramBit = 0x01;
+    constexpr uint8_t kPreviewBit = 0x02;
+    constexpr unsigned int kSwitcherShift = 2;
+    constexpr uint8_t kSwitcherMask = 0x07;
+
+    void put16(std::vector<uint8_t>& out, uint16_t value)
+    {
+        out.push_back(static_cast<uint8_t>(value >> 8));
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    void put32(std::vector<uint8_t>& out, uint32_t value)
+    {
+        put16(out, static_cast<uint16_t>(value >> 16));
+        put16(out, static_cast<uint16_t>(value));
+    }
+
+    uint16_t get16(std::span<const uint8_t> in, std::size_t offset)
+    {
+        return static_cast<uint16_t>((in[offset] << 8) | in[offset + 1]);
+    }
+
+    uint32_t get32(std::span<const uint8_t> in, std::size_t offset)
+    {
+        return (static_cast<uint32_t>(get16(in, offset)) << 16) | get16(in, offset + 2);
+    }
+
+}
+
+void encode_tally_frame(const TallyFrame& frame, std::vector<uint8_t>& out)
+{
+    const bool is_nack = frame.type == TallyFrameType::Nack;
+    out.reserve(out.size() + kTallyFrameHeaderSize + (is_nack ? 0 : frame.entries.size() * kTallyFrameEntrySize));
+    out.push_back(kMagic0);
+    out.push_back(kMagic1);
+    out.push_back(kFormatVersion);
+    out.push_back(static_cast<uint8_t>(frame.type));
+    out.push_back(frame.flags);
+    out.push_back(0);
+    put32(out, frame.stream_id);
+    put32(out, frame.sequence);
+    put16(out, is_nack ? frame.count : static_cast<uint16_t>(frame.entries.size()));
+    if (is_nack) {
+        return;
+    }
+    for (const auto& entry : frame.entries) {
+        put16(out, entry.input_id);
+        out.push_back(static_cast<uint8_t>((entry.program ? kProgramBit : 0) | (entry.preview ? kPreviewBit : 0)
+            | (entry.switcher & kSwitcherMask) << kSwitcherShift));
+    }
+}
+
+bool decode_tally_frame(std::span<const uint8_t> datagram, TallyFrame& frame)
+{
+    if (datagram.size() < kTallyFrameHeaderSize || datagram[0] != kMagic0 || datagram[1] != kMagic1 || datagram[2] != kFormatVersion) {
+        return false;
+    }
+    const auto type = datagram[3];
+    if (type < static_cast<uint8_t>(TallyFrameType::Delta) || type > static_cast<uint8_t>(TallyFrameType::Nack)) {
+        return false;
+    }
+    frame.type = static_cast<TallyFrameType>(type);
+    frame.flags = datagram[4];
+    frame.stream_id = get32(datagram, 6);
+    frame.sequence = get32(datagram, 10);
+    frame.count = get16(datagram, 14);
+    frame.entries.clear();
+    if (frame.type == TallyFrameType::Nack) {
+        return datagram.size() == kTallyFrameHeaderSize;
+    }
+    if (datagram.size() != kTallyFrameHeaderSize + std::size_t { frame.count } * kTallyFrameEntrySize) {
+        return false;
+    }
+    frame.entries.reserve(frame.count);
+    for (std::size_t offset = kTallyFrameHeaderSize; offset < datagram.size(); offset += kTallyFrameEntrySize) {
+        const auto state = datagram[offset + 2];
+        frame.entries.push_back({ get16(datagram, offset), (state & kProgramBit) != 0, (state & kPreviewBit) != 0,
+            static_cast<uint8_t>(state >> kSwitcherShift & kSwitcherMask) });
+    }
+    return true;
+}
+
+} // namespace atem
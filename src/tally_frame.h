@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace atem {
+
+// Wire format of the multicast tally stream. Integers are big-endian.
+//
+//   offset  size  field
+//        0     2  magic "AT"
+//        2     1  format version (1)
+//        3     1  TallyFrameType
+//        4     1  flags (kTallyFrame*)
+//        5     1  reserved, zero
+//        6     4  stream id; changes when the server restarts
+//       10     4  sequence number
+//       14     2  entry count (a NACK's number of missing sequences)
+//       16   3*n  entries: input id (2), state (1: bit 0 program, bit 1 preview,
+//                 bits 2-4 the index of the switcher the input belongs to)
+//
+// Every change is a Delta with the next sequence number. A Keyframe carries
+// the full state and the sequence of the last Delta it includes; a large one is
+// split over several datagrams, all but the last flagged kTallyFrameMore. A
+// receiver that sees a gap sends a Nack to the sender's address, asking for
+// `count` sequences starting at `sequence`.
+enum class TallyFrameType : uint8_t {
+    Delta = 1,
+    Keyframe = 2,
+    Nack = 3,
+};
+
+constexpr uint8_t kTallyFrameMock = 0x01; // The server is running in mock mode
+constexpr uint8_t kTallyFrameRepair = 0x02; // Resent, unicast, in answer to a NACK
+constexpr uint8_t kTallyFrameMore = 0x04; // The keyframe continues in the next datagram
+
+constexpr std::size_t kTallyFrameHeaderSize = 16;
+constexpr std::size_t kTallyFrameEntrySize = 3;
+// Keeps a datagram within a 1500-byte Ethernet MTU.
+constexpr std::size_t kMaxTallyFrameSize = 1472;
+constexpr std::size_t kMaxTallyFrameEntries = (kMaxTallyFrameSize - kTallyFrameHeaderSize) / kTallyFrameEntrySize;
+
+struct TallyFrameEntry {
+    uint16_t input_id = 0;
+    bool program = false;
+    bool preview = false;
+    uint8_t switcher = 0; // 0-7
+};
+
+struct TallyFrame {
+    TallyFrameType type = TallyFrameType::Delta;
+    uint8_t flags = 0;
+    uint32_t stream_id = 0;
+    uint32_t sequence = 0;
+    uint16_t count = 0; // Entry count; for a NACK, the number of sequences requested
+    std::vector<TallyFrameEntry> entries;
+};
+
+// Appends the encoded frame to `out`. The entry count is taken from
+// `entries`, except for a NACK.
+void encode_tally_frame(const TallyFrame& frame, std::vector<uint8_t>& out);
+
+// Returns false if `datagram` is not a well-formed frame.
+bool decode_tally_frame(std::span<const uint8_t> datagram, TallyFrame& frame);
+
+} // namespace atem
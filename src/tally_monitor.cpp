@@ -2,26 +2,76 @@
 
 #include "atem/atem_connection_mock.h"
 #include "atem/atem_connection_real.h"
+#include "http_message.h"
+#include "logger.h"
 #include "tally_monitor.h"
+#include <algorithm>
+#include <charconv>
 #include <chrono>
-#include <iostream>
+#include <iterator>
+#include <string>
+#include <utility>
 
 using namespace std::chrono_literals;
 
 namespace atem {
 
+namespace {
+
+    constexpr auto kFirstReconnectDelay = 1s;
+    constexpr auto kMaxReconnectDelay = 30s;
+
+}
+
+TallyMonitor::Switcher::Switcher(boost::asio::io_context& ioc, uint8_t switcher_index, SwitcherConfig switcher_config)
+    : index(switcher_index)
+    , config(std::move(switcher_config))
+    , strand(boost::asio::make_strand(ioc))
+    , poll_timer(strand)
+    , reconnect_timer(strand)
+    , backoff(kFirstReconnectDelay)
+{
+    stats.id = config.id;
+    stats.interval_ms = config.poll_rate_ms;
+}
+
+TallyMonitor::Switcher::~Switcher()
+{
+    if (connect_thread.joinable()) {
+        connect_thread.join();
+    }
+}
+
 TallyMonitor::TallyMonitor(boost::asio::io_context& ioc, const Config& config)
     : ioc_(ioc)
     , config_(config)
-    , monitor_timer_(std::make_unique<boost::asio::steady_timer>(ioc))
+    , epoch_(static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count()))
 {
-    if (config_.mock_enabled) {
-        atem_connection_ = std::make_unique<ATEMConnectionMock>(ioc_, config_.mock_inputs);
-    } else {
-        atem_connection_ = std::make_unique<ATEMConnectionReal>();
+    auto switchers = config_.switchers();
+    for (std::size_t i = 0; i < switchers.size(); ++i) {
+        switcher_ids_.push_back(switchers[i].id);
+        switchers_.push_back(std::make_unique<Switcher>(ioc_, static_cast<uint8_t>(i), std::move(switchers[i])));
     }
 }
 
+TallyMonitor::TallyMonitor(boost::asio::io_context& ioc, const Config& config, std::unique_ptr<IATEMConnection> connection)
+    : ioc_(ioc)
+    , config_(config)
+    , epoch_(static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count()))
+{
+    // The connection speaks for every configured switcher; the ids still
+    // name the switchers its changes come from.
+    auto switchers = config_.switchers();
+    for (const auto& switcher : switchers) {
+        switcher_ids_.push_back(switcher.id);
+    }
+    auto& sw = *switchers_.emplace_back(std::make_unique<Switcher>(ioc_, 0, std::move(switchers.front())));
+    sw.connection = std::move(connection);
+    sw.injected = true;
+}
+
 TallyMonitor::~TallyMonitor()
 {
     stop();
@@ -33,88 +83,222 @@ void TallyMonitor::start()
         return; // Already running
     }
 
-    std::cout << "Starting ATEM tally monitor...\n";
+    log(LogLevel::Info) << "Starting ATEM tally monitor for " << switchers_.size() << " switcher(s)...";
 
-    // Initialize ATEM connection
-    if (!atem_connection_->connect(config_.atem_ip)) {
-        if (config_.use_mock_automatically) {
-            std::cout << "Warning: Could not connect to ATEM switcher. Using mock data automatically.\n";
-            // If connection fails, replace the connection object with a mock one and connect it.
-            atem_connection_ = std::make_unique<ATEMConnectionMock>(ioc_, config_.mock_inputs);
-            atem_connection_->connect(config_.atem_ip); // This starts the mock timer
-            notify_mode_change(true);
-        } else {
-            std::cerr << "Error: Could not connect to ATEM switcher. Automatic mock fallback is disabled.\n";
-            // No connection is made, the server will show a disconnected state.
-        }
+    pending_first_attempts_.store(switchers_.size(), std::memory_order_relaxed);
+    for (auto& sw : switchers_) {
+        boost::asio::post(sw->strand, [this, &sw = *sw]() { begin_connect(sw, config_.use_mock_automatically); });
     }
+}
 
-    // Pre-populate the tally states so clients get a full list on connect.
-    // This is done *after* connecting so we can get the count from the device.
-    const auto inputs = atem_connection_->get_inputs();
-    for (const auto& input : inputs) {
-        current_tally_states_[input.id] = {
-            input.id, input.short_name, false, false, std::chrono::system_clock::now()
-        };
+void TallyMonitor::stop()
+{
+    if (!running_.exchange(false, std::memory_order_acq_rel)) {
+        return; // Already stopped
     }
 
-    if (ready_callback_) {
-        ready_callback_();
+    log(LogLevel::Info) << "Stopping ATEM tally monitor...";
+
+    for (auto& sw : switchers_) {
+        // A connect in progress finishes first; its result is discarded.
+        if (sw->connect_thread.joinable()) {
+            sw->connect_thread.join();
+        }
+        sw->poll_timer.cancel();
+        sw->reconnect_timer.cancel();
+        if (sw->connection) {
+            sw->connection->disconnect();
+        }
+        const std::scoped_lock lock(sw->mutex);
+        sw->stats.connected = false;
+        sw->stats.polling = false;
     }
+}
 
-    // Set up tally callback
-    atem_connection_->on_tally_change([this](const TallyUpdate& update) { handle_tally_change(update); });
+void TallyMonitor::reconnect()
+{
+    for (auto& sw : switchers_) {
+        boost::asio::post(sw->strand, [this, &sw = *sw]() {
+            if (!running_ || sw.connecting) {
+                return; // Stopped, or a connect is already in progress
+            }
+            log(LogLevel::Info) << "Reconnecting to ATEM switcher " << sw.config.id << "...";
+            sw.reconnect_timer.cancel();
+            sw.poll_timer.cancel();
+            if (sw.connection) {
+                sw.connection->disconnect();
+            }
+            begin_connect(sw, config_.use_mock_automatically);
+        });
+    }
+}
 
-    // Start monitoring loop
-    poll_atem();
+void TallyMonitor::begin_connect(Switcher& sw, bool allow_mock)
+{
+    if (!running_) {
+        return;
+    }
+    if (sw.connect_thread.joinable()) {
+        sw.connect_thread.join(); // The previous attempt has already posted its result
+    }
+    {
+        const std::scoped_lock lock(sw.mutex);
+        ++sw.stats.connects;
+    }
+    if (!sw.injected) {
+        sw.connection = make_connection(sw);
+    }
+
+    // Mocks and the shared connection connect at once. A switcher can take
+    // seconds to answer or time out, so it connects on a thread of its own
+    // and the other switchers carry on meanwhile.
+    if (sw.injected || sw.connection->is_mock_mode()) {
+        finish_connect(sw, sw.connection->connect(sw.config.ip_address), allow_mock);
+        return;
+    }
+    sw.connecting = true;
+    sw.connect_thread = std::thread([this, &sw, connection = sw.connection.get(), allow_mock]() {
+        const bool connected = connection->connect(sw.config.ip_address);
+        boost::asio::post(sw.strand, [this, &sw, connected, allow_mock]() { finish_connect(sw, connected, allow_mock); });
+    });
 }
 
-void TallyMonitor::stop()
+void TallyMonitor::finish_connect(Switcher& sw, bool connected, bool allow_mock)
 {
-    if (!running_.exchange(false, std::memory_order_acq_rel)) {
-        return; // Already stopped
+    sw.connecting = false;
+    if (!running_) {
+        return;
+    }
+    if (!connected) {
+        if (allow_mock) {
+            log(LogLevel::Warning) << "Could not connect to ATEM switcher " << sw.config.id << ". Using mock data automatically.";
+            // Replace the connection with a mock one; connecting starts its timer.
+            sw.connection = std::make_unique<ATEMConnectionMock>(ioc_, config_.mock_inputs, sw.index);
+            connected = sw.connection->connect(sw.config.ip_address);
+        } else {
+            log(LogLevel::Error) << "Could not connect to ATEM switcher " << sw.config.id << ".";
+            schedule_reconnect(sw);
+        }
+    }
+
+    if (connected) {
+        sw.backoff = kFirstReconnectDelay;
+        // Pre-populate the tally states so clients get a full list on
+        // connect. This is done *after* connecting so we can get the count
+        // from the device.
+        refresh_inputs(sw);
+        {
+            const std::scoped_lock lock(sw.mutex);
+            sw.stats.connected = true;
+            sw.stats.mock = sw.connection->is_mock_mode();
+            sw.stats.interval_ms = sw.config.poll_rate_ms;
+        }
+        update_mode();
+
+        // Set up the callbacks. A mock sends its current state as soon as it
+        // has a tally callback, so the table must be ready for it.
+        const auto* source = sw.connection.get();
+        sw.connection->on_tally_change([this, &sw](const TallyUpdate& update) { handle_tally_change(sw, update); });
+        sw.connection->on_mode_change([this, &sw](bool is_mock) {
+            {
+                const std::scoped_lock lock(sw.mutex);
+                sw.stats.mock = is_mock;
+            }
+            update_mode();
+        });
+        sw.connection->on_inputs_change([this, &sw]() { refresh_inputs(sw); });
+        sw.connection->on_disconnect([this, &sw, source]() {
+            boost::asio::post(sw.strand, [this, &sw, source]() { handle_disconnect(sw, source); });
+        });
+
+        // Poll only if the connection can't deliver changes by itself
+        schedule_poll(sw);
     }
 
-    std::cout << "Stopping ATEM tally monitor...\n";
+    if (std::exchange(sw.first_attempt, false) && pending_first_attempts_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        ready_.store(true, std::memory_order_release);
+        if (ready_callback_) {
+            ready_callback_();
+        }
+    }
+}
 
-    if (monitor_timer_) {
-        monitor_timer_->cancel();
+void TallyMonitor::handle_disconnect(Switcher& sw, const IATEMConnection* connection)
+{
+    if (!running_ || sw.connection.get() != connection) {
+        return; // Stopped, or a connection that has since been replaced
+    }
+    {
+        const std::scoped_lock lock(sw.mutex);
+        ++sw.stats.disconnects;
+        sw.stats.connected = false;
+        sw.stats.polling = false;
     }
+    sw.poll_timer.cancel();
+    schedule_reconnect(sw);
+}
+
+void TallyMonitor::schedule_reconnect(Switcher& sw)
+{
+    // A switcher that was there before is retried, not replaced by a mock.
+    log(LogLevel::Info) << "Retrying ATEM switcher " << sw.config.id << " in " << sw.backoff.count() << " ms";
+    sw.reconnect_timer.expires_after(sw.backoff);
+    sw.reconnect_timer.async_wait([this, &sw](const boost::system::error_code& ec) {
+        if (!ec) {
+            begin_connect(sw, false);
+        }
+    });
+    sw.backoff = std::min<std::chrono::milliseconds>(sw.backoff * 2, kMaxReconnectDelay);
+}
 
-    if (atem_connection_) {
-        atem_connection_->disconnect();
+std::unique_ptr<IATEMConnection> TallyMonitor::make_connection(const Switcher& sw) const
+{
+    if (config_.mock_enabled || sw.config.mock) {
+        return std::make_unique<ATEMConnectionMock>(ioc_, config_.mock_inputs, sw.index);
     }
+    return std::make_unique<ATEMConnectionReal>(sw.index);
 }
 
-void TallyMonitor::reconnect()
+void TallyMonitor::refresh_inputs(Switcher& sw)
 {
-    // Post to the io_context to ensure this happens on the correct thread.
-    boost::asio::post(ioc_, [this]() {
-        std::cout << "Reconnecting to ATEM switcher...\n";
-        atem_connection_->disconnect();
-        if (config_.mock_enabled) {
-            atem_connection_ = std::make_unique<ATEMConnectionMock>(ioc_, config_.mock_inputs);
-        } else {
-            atem_connection_ = std::make_unique<ATEMConnectionReal>();
-        }
-
-        // Attempt to connect with the potentially updated IP from config_
-        if (!atem_connection_->connect(config_.atem_ip)) {
-            if (config_.use_mock_automatically) {
-                std::cout << "Warning: Could not reconnect to ATEM switcher. Using mock data automatically.\n";
-                // If connection fails, replace the connection object with a mock one and connect it.
-                atem_connection_ = std::make_unique<ATEMConnectionMock>(ioc_, config_.mock_inputs);
-                atem_connection_->connect(config_.atem_ip); // This starts the mock timer
-                notify_mode_change(true);
-            } else {
-                std::cerr << "Error: Could not reconnect to ATEM switcher. Automatic mock fallback is disabled.\n";
+    auto inputs = sw.connection->get_inputs();
+    if (!sw.injected) {
+        for (auto& input : inputs) {
+            input.switcher = sw.index;
+        }
+    }
+
+    // Every switcher the inputs come from, or came from, gets its new list;
+    // a switcher connection's are all its own.
+    std::vector<uint8_t> replaced { sw.index };
+    {
+        const std::scoped_lock lock(sw.mutex);
+        for (const auto* list : { &sw.inputs, &inputs }) {
+            for (const auto& input : *list) {
+                if (std::find(replaced.begin(), replaced.end(), input.switcher) == replaced.end()) {
+                    replaced.push_back(input.switcher);
+                }
             }
-        } else {
-            notify_mode_change(atem_connection_->is_mock_mode());
         }
-        // Re-register the callback on the new connection object
-        atem_connection_->on_tally_change([this](const TallyUpdate& update) { handle_tally_change(update); });
-    });
+        sw.inputs = inputs;
+    }
+    uint64_t version = 0;
+    {
+        const std::scoped_lock lock(write_mutex_);
+        version = state_version_.load(std::memory_order_relaxed) + 1;
+        for (const auto switcher : replaced) {
+            std::vector<InputInfo> own;
+            std::copy_if(inputs.begin(), inputs.end(), std::back_inserter(own),
+                [switcher](const InputInfo& input) { return input.switcher == switcher; });
+            tally_table_.reset(switcher, own, version);
+        }
+        state_version_.store(version, std::memory_order_release);
+    }
+    names_version_.fetch_add(1, std::memory_order_relaxed);
+
+    if (ready_.load(std::memory_order_acquire) && inputs_change_callback_) {
+        inputs_change_callback_(version);
+    }
 }
 
 void TallyMonitor::on_ready(ReadyCallback callback)
@@ -132,98 +316,339 @@ void TallyMonitor::on_mode_change(ModeChangeCallback callback)
     mode_change_callback_ = std::move(callback);
 }
 
-TallyState TallyMonitor::get_tally_state(uint16_t input_id) const
+void TallyMonitor::on_inputs_change(InputsChangeCallback callback)
 {
-    std::lock_guard<std::mutex> lock(tally_states_mutex_);
+    inputs_change_callback_ = std::move(callback);
+}
 
-    auto it = current_tally_states_.find(input_id);
-    if (it != current_tally_states_.end()) {
-        return it->second;
+TallyState TallyMonitor::get_tally_state(uint8_t switcher, uint16_t input_id) const
+{
+    if (auto state = tally_table_.get(switcher, input_id)) {
+        return *std::move(state);
     }
 
     // Return default state if not found
-    return TallyState { input_id, "N/A", false, false, std::chrono::system_clock::now() };
+    TallyState state { input_id, "N/A", false, false, std::chrono::system_clock::now() };
+    state.switcher = switcher;
+    return state;
 }
 
 std::vector<TallyState> TallyMonitor::get_all_tally_states() const
 {
-    std::lock_guard<std::mutex> lock(tally_states_mutex_);
+    return tally_table_.get_all();
+}
 
-    std::vector<TallyState> states;
-    states.reserve(current_tally_states_.size());
+TallySnapshot TallyMonitor::get_tally_snapshot() const
+{
+    std::lock_guard<std::mutex> snapshot_lock(snapshot_mutex_);
+
+    // The version is read before the table, so the states are at least
+    // that new. Concurrent callers wait on snapshot_mutex_ and then reuse
+    // the result.
+    const auto version = state_version_.load(std::memory_order_acquire);
+    if (snapshot_.event && snapshot_.version == version) {
+        return snapshot_;
+    }
+    snapshot_.version = version;
+    const auto states = tally_table_.get_all();
+    const bool is_mock = is_mock_mode();
+    boost::json::array list;
+    list.reserve(states.size());
+    for (const auto& state : states) {
+        list.emplace_back(boost::json::value_from(state.to_update(is_mock)));
+    }
+    boost::json::object msg;
+    msg["type"] = "tally_snapshot";
+    msg["version"] = snapshot_.version;
+    msg["mock"] = is_mock;
+    msg["inputs"] = std::move(list);
+
+    snapshot_.event = make_sse_payload("tally_snapshot", boost::json::serialize(msg));
+    return snapshot_;
+}
 
-    for (const auto& [input_id, state] : current_tally_states_) {
-        states.push_back(state);
+TallyBitmap TallyMonitor::get_tally_bitmap() const
+{
+    std::lock_guard<std::mutex> bitmap_lock(bitmap_mutex_);
+
+    const auto version = state_version_.load(std::memory_order_acquire);
+    if (bitmap_.event && bitmap_.version == version && bitmap_.index_version == tally_table_.generation()) {
+        return bitmap_;
+    }
+    bitmap_.version = version;
+    // The index version is the generation of the layout the states were
+    // read from, so the index always matches the bits.
+    uint64_t index_version = 0;
+    const auto states = tally_table_.get_all(index_version);
+
+    // The dense index is the inputs in switcher then id order; bit i (LSB
+    // first within each byte) of both bitmaps belongs to the i-th id in the
+    // index, on the i-th switcher.
+    if (!bitmap_.index || bitmap_.index_version != index_version) {
+        boost::json::array ids;
+        boost::json::array switchers;
+        ids.reserve(states.size());
+        switchers.reserve(states.size());
+        for (const auto& state : states) {
+            ids.emplace_back(state.input_id);
+            switchers.emplace_back(state.switcher);
+        }
+        boost::json::object msg;
+        msg["index_version"] = index_version;
+        msg["inputs"] = std::move(ids);
+        msg["switchers"] = std::move(switchers);
+        bitmap_.index_version = index_version;
+        bitmap_.index = make_sse_payload("tally_bitmap_index", boost::json::serialize(msg));
+    }
+
+    std::vector<uint8_t> program((states.size() + 7) / 8);
+    std::vector<uint8_t> preview(program.size());
+    for (std::size_t i = 0; i < states.size(); ++i) {
+        const auto bit = static_cast<uint8_t>(1U << (i % 8));
+        if (states[i].program) {
+            program[i / 8] |= bit;
+        }
+        if (states[i].preview) {
+            preview[i / 8] |= bit;
+        }
     }
+    boost::json::object msg;
+    msg["version"] = bitmap_.version;
+    msg["index_version"] = index_version;
+    msg["mock"] = is_mock_mode();
+    msg["count"] = states.size();
+    msg["program"] = base64_encode(program);
+    msg["preview"] = base64_encode(preview);
+
+    bitmap_.event = make_sse_payload("tally_bitmap", boost::json::serialize(msg));
+    return bitmap_;
+}
 
-    return states;
+uint64_t TallyMonitor::get_state_version() const
+{
+    return state_version_.load(std::memory_order_acquire);
+}
+
+TallyDelta TallyMonitor::get_changes_since(uint64_t since) const
+{
+    // Read before the table, so no change up to this version is missed.
+    // Changes made in between may be included too.
+    TallyDelta delta;
+    delta.version = state_version_.load(std::memory_order_acquire);
+    delta.changed = tally_table_.get_changed_since(since);
+    delta.mock = is_mock_mode();
+    return delta;
+}
+
+uint64_t TallyMonitor::get_names_version() const
+{
+    return names_version_.load(std::memory_order_relaxed);
+}
+
+std::string TallyMonitor::format_event_id(uint64_t version) const
+{
+    return std::to_string(epoch_) + "-" + std::to_string(version);
+}
+
+std::optional<uint64_t> TallyMonitor::parse_event_id(std::string_view id) const
+{
+    const auto dash = id.find('-');
+    if (dash == std::string_view::npos) {
+        return std::nullopt;
+    }
+    uint64_t epoch = 0;
+    uint64_t version = 0;
+    const auto epoch_end = id.data() + dash;
+    const auto [epoch_ptr, epoch_ec] = std::from_chars(id.data(), epoch_end, epoch);
+    const auto [version_ptr, version_ec] = std::from_chars(epoch_end + 1, id.data() + id.size(), version);
+    if (epoch_ec != std::errc() || epoch_ptr != epoch_end || version_ec != std::errc() || version_ptr != id.data() + id.size()
+        || epoch != epoch_) {
+        return std::nullopt;
+    }
+    return version;
 }
 
 bool TallyMonitor::is_mock_mode() const
 {
-    return atem_connection_ ? atem_connection_->is_mock_mode() : false;
+    return std::any_of(switchers_.begin(), switchers_.end(), [](const auto& sw) {
+        const std::scoped_lock lock(sw->mutex);
+        return sw->stats.mock;
+    });
 }
 
 uint16_t TallyMonitor::get_input_count() const
 {
-    return atem_connection_ ? atem_connection_->get_input_count() : 0;
+    return static_cast<uint16_t>(get_inputs().size());
 }
 
 std::vector<InputInfo> TallyMonitor::get_inputs() const
 {
-    return atem_connection_ ? atem_connection_->get_inputs() : std::vector<InputInfo> {};
+    std::vector<InputInfo> inputs;
+    for (const auto& sw : switchers_) {
+        const std::scoped_lock lock(sw->mutex);
+        inputs.insert(inputs.end(), sw->inputs.begin(), sw->inputs.end());
+    }
+    return inputs;
 }
 
-void TallyMonitor::poll_atem()
+const std::vector<std::string>& TallyMonitor::get_switcher_ids() const
 {
-    if (!running_) {
-        return;
+    return switcher_ids_;
+}
+
+std::optional<uint8_t> TallyMonitor::find_switcher(std::string_view id) const
+{
+    const auto it = std::find(switcher_ids_.begin(), switcher_ids_.end(), id);
+    if (it == switcher_ids_.end()) {
+        return std::nullopt;
+    }
+    return static_cast<uint8_t>(it - switcher_ids_.begin());
+}
+
+TallyMonitor::Stats TallyMonitor::stats() const
+{
+    Stats stats;
+    for (const auto& sw : switchers_) {
+        const std::scoped_lock lock(sw->mutex);
+        stats.switchers.push_back(sw->stats);
     }
+    return stats;
+}
 
-    // Poll ATEM connection for updates
-    atem_connection_->poll();
+void TallyMonitor::schedule_poll(Switcher& sw)
+{
+    std::chrono::milliseconds interval {};
+    {
+        const std::scoped_lock lock(sw.mutex);
+        sw.stats.polling = running_ && sw.connection && sw.connection->needs_polling();
+        if (!sw.stats.polling) {
+            return;
+        }
+        interval = std::chrono::milliseconds(sw.stats.interval_ms);
+    }
 
-    // Schedule next poll
-    monitor_timer_->expires_after(16ms); // ~60fps polling rate
-    monitor_timer_->async_wait([this](const boost::system::error_code& ec) {
+    // Re-arming cancels a wait that is already pending.
+    sw.poll_timer.expires_after(interval);
+    sw.poll_timer.async_wait([this, &sw](const boost::system::error_code& ec) {
         if (ec) {
             return; // Timer was cancelled
         }
-        if (running_) {
-            poll_atem();
-        } });
+        poll_atem(sw);
+    });
+}
+
+void TallyMonitor::poll_atem(Switcher& sw)
+{
+    if (!running_) {
+        return;
+    }
+
+    const auto started = std::chrono::steady_clock::now();
+    const bool delivered = sw.connection->poll();
+    const auto elapsed_us = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count());
+    {
+        const std::scoped_lock lock(sw.mutex);
+        ++sw.stats.polls;
+        if (!delivered) {
+            ++sw.stats.idle_polls;
+        }
+        sw.stats.last_poll_us = elapsed_us;
+        sw.stats.max_poll_us = std::max(sw.stats.max_poll_us, elapsed_us);
+        // Poll at the full rate while changes arrive; halve it after each
+        // idle poll.
+        sw.stats.interval_ms = delivered ? sw.config.poll_rate_ms
+                                         : std::min<uint64_t>(sw.stats.interval_ms * 2, sw.config.poll_max_interval_ms);
+    }
+    schedule_poll(sw);
 }
 
-void TallyMonitor::handle_tally_change(const TallyUpdate& update)
+void TallyMonitor::handle_tally_change(Switcher& sw, const TallyUpdate& update)
 {
+    // A change means more are likely; bring a backed-off poll forward.
+    bool hurry = false;
+    {
+        const std::scoped_lock lock(sw.mutex);
+        ++sw.stats.changes;
+        if (sw.stats.polling && sw.stats.interval_ms > sw.config.poll_rate_ms) {
+            sw.stats.interval_ms = sw.config.poll_rate_ms;
+            hurry = true;
+        }
+    }
+    if (hurry) {
+        boost::asio::post(sw.strand, [this, &sw]() { schedule_poll(sw); });
+    }
 
-    // Update internal state, with thread safety
+    // Update internal state, with thread safety. One mutex for every
+    // switcher, so versions stay in the order changes were applied.
+    uint64_t version = 0;
     {
-        std::lock_guard<std::mutex> lock(tally_states_mutex_);
-        auto it = current_tally_states_.find(update.input_id);
-        if (it != current_tally_states_.end()) {
-            it->second.program = update.program;
-            it->second.preview = update.preview;
-            it->second.short_name = update.short_name;
-            it->second.last_updated = std::chrono::system_clock::now();
-        } // Mutex lock is released here
-    }
-    std::cout << "Tally update - Input " << update.input_id
-              << " Program: " << (update.program ? "ON" : "OFF")
-              << " Preview: " << (update.preview ? "ON" : "OFF") << "\n";
+        const std::scoped_lock lock(write_mutex_);
+        // Every broadcast gets its own version, so bump even for unknown inputs.
+        version = state_version_.load(std::memory_order_relaxed) + 1;
+        if (tally_table_.update(update, version) == TallyTable::UpdateResult::Renamed) {
+            names_version_.fetch_add(1, std::memory_order_relaxed);
+        }
+        state_version_.store(version, std::memory_order_release);
+    } // Mutex lock is released here
+    log(LogLevel::Info) << "Tally update - " << (update.switcher < switcher_ids_.size() ? switcher_ids_[update.switcher] : "?")
+                        << " Input " << update.input_id
+                        << " Program: " << (update.program ? "ON" : "OFF")
+                        << " Preview: " << (update.preview ? "ON" : "OFF");
     // Notify callback
     if (tally_callback_) {
         // Post to IO context to ensure thread safety
-        tally_callback_(update);
+        tally_callback_(update, version);
+    }
+}
+
+void TallyMonitor::update_mode()
+{
+    const bool is_mock = is_mock_mode();
+    {
+        const std::scoped_lock lock(mode_mutex_);
+        if (is_mock == reported_mock_) {
+            return;
+        }
+        reported_mock_ = is_mock;
     }
+    notify_mode_change(is_mock);
 }
 
 void TallyMonitor::notify_mode_change(bool is_mock)
 {
+    uint64_t version = 0;
+    {
+        // The snapshot carries the mock flag, so a mode change invalidates it.
+        const std::scoped_lock lock(write_mutex_);
+        version = state_version_.fetch_add(1, std::memory_order_release) + 1;
+    }
     if (mode_change_callback_) {
         // Post to IO context to ensure thread safety
-        mode_change_callback_(is_mock);
+        mode_change_callback_(is_mock, version);
     }
 }
 
+void tag_invoke(const boost::json::value_from_tag&, boost::json::value& jv, const TallyMonitor::SwitcherStats& stats)
+{
+    jv = {
+        { "id", stats.id },
+        { "connected", stats.connected },
+        { "mock", stats.mock },
+        { "connects", stats.connects },
+        { "disconnects", stats.disconnects },
+        { "polling", stats.polling },
+        { "interval_ms", stats.interval_ms },
+        { "polls", stats.polls },
+        { "idle_polls", stats.idle_polls },
+        { "changes", stats.changes },
+        { "poll_us", { { "last", stats.last_poll_us }, { "max", stats.max_poll_us } } },
+    };
+}
+
+void tag_invoke(const boost::json::value_from_tag&, boost::json::value& jv, const TallyMonitor::Stats& stats)
+{
+    jv = { { "switchers", boost::json::value_from(stats.switchers) } };
+}
+
 } // namespace atem
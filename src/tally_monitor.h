@@ -2,24 +2,95 @@
 
 #include "atem/iatem_connection.h"
 #include "config.h" // Include the full definition of Config
+#include "sse_payload.h"
 #include "tally_state.h"
+#include "tally_table.h"
 #include <atomic>
 #include <boost/asio.hpp>
+#include <boost/json.hpp>
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <thread>
-#include <unordered_map>
 #include <vector>
 
 namespace atem {
 
+// Every input's state, framed once as a `tally_snapshot` SSE event. The event
+// has no id; the server gives each client one (make_sse_id()).
+struct TallySnapshot {
+    uint64_t version = 0; // Bumped on every tally or mode change
+    SharedPayload event;
+};
+
+// Program and preview of every input as two bitmaps over a dense input index,
+// framed once as a `tally_bitmap` SSE event.
+struct TallyBitmap {
+    uint64_t version = 0; // State version the bitmaps were taken at
+    uint64_t index_version = 0; // The tally table's layout generation; changes with the input list
+    SharedPayload index; // `tally_bitmap_index`: the input id at each bit
+    SharedPayload event;
+};
+
+// The inputs that changed after a given state version.
+struct TallyDelta {
+    uint64_t version = 0; // State version the delta runs up to
+    bool mock = false;
+    std::vector<TallyState> changed; // Sorted by switcher, then input id
+};
+
+/**
+ * @class TallyMonitor
+ * @brief Holds the state of every input and passes on the switchers' changes.
+ *
+ * Monitors every switcher in the `atem` config array. Each has its own
+ * connection, strand and reconnect timer: they are connected in parallel,
+ * a switcher that is slow to connect or is lost holds up none of the others,
+ * and a lost switcher is reconnected with backoff while the rest carry on.
+ * Inputs are namespaced by the switcher's index (see tally_key()).
+ *
+ * Connections deliver changes from their own timers, sockets or SDK threads.
+ * Only a connection that needs polling is polled: at its `poll_rate_ms`
+ * while changes arrive, backing off to `poll_max_interval_ms` while idle, so
+ * an idle monitor costs no wakeups.
+ */
 class TallyMonitor {
 public:
+    struct SwitcherStats {
+        std::string id;
+        bool connected = false;
+        bool mock = false;
+        uint64_t connects = 0; // Connection attempts
+        uint64_t disconnects = 0; // Connections lost
+        bool polling = false; // The connection needs polling
+        uint64_t interval_ms = 0; // Current poll interval
+        uint64_t polls = 0;
+        uint64_t idle_polls = 0; // Polls that delivered nothing
+        uint64_t changes = 0; // Tally changes received
+        uint64_t last_poll_us = 0; // Time spent in the connection's poll()
+        uint64_t max_poll_us = 0;
+    };
+
+    struct Stats {
+        std::vector<SwitcherStats> switchers;
+    };
+
     using ReadyCallback = std::function<void()>;
-    using ModeChangeCallback = std::function<void(bool is_mock)>;
-    using TallyCallback = std::function<void(const TallyUpdate&)>;
+    // Both get the state version the change was applied at. Changes from
+    // different switchers can be reported concurrently, so get_state_version()
+    // may already have moved past it.
+    using ModeChangeCallback = std::function<void(bool is_mock, uint64_t version)>;
+    using TallyCallback = std::function<void(const TallyUpdate&, uint64_t version)>;
+    using InputsChangeCallback = std::function<void(uint64_t version)>;
 
     explicit TallyMonitor(boost::asio::io_context& ioc, const Config& config);
+    // Monitors `connection` instead of the switchers or mocks the config
+    // selects. Its changes keep the switcher index they carry.
+    TallyMonitor(boost::asio::io_context& ioc, const Config& config, std::unique_ptr<IATEMConnection> connection);
     ~TallyMonitor();
 
     // Non-copyable, non-movable
@@ -28,45 +99,146 @@ public:
     TallyMonitor(TallyMonitor&&) = delete;
     TallyMonitor& operator=(TallyMonitor&&) = delete;
 
+    // Starts connecting to every switcher and returns; the ready callback
+    // runs once each has made its first attempt.
     void start();
+    // Cancels the switchers' timers and disconnects them. These belong to the
+    // switchers' strands, so call it only once the io_context's threads have
+    // returned.
     void stop();
 
-    void reconnect(); // Reconnect to the ATEM switcher with current config.
+    void reconnect(); // Reconnect to every switcher with current config.
 
     void on_ready(ReadyCallback callback);
     void on_tally_change(TallyCallback callback);
     void on_mode_change(ModeChangeCallback callback);
+    // Called after ready whenever a switcher's input list is replaced.
+    void on_inputs_change(InputsChangeCallback callback);
 
     // Get current tally state for a specific input
-    TallyState get_tally_state(uint16_t input_id) const;
+    TallyState get_tally_state(uint8_t switcher, uint16_t input_id) const;
 
-    // Get all current tally states
+    // Get all current tally states, in switcher then input id order
     std::vector<TallyState> get_all_tally_states() const;
 
+    // Get the current state of every input as one pre-serialized event. The
+    // event is rebuilt only when the state version has moved on.
+    TallySnapshot get_tally_snapshot() const;
+    // The same state as bitmaps. Both events are rebuilt only when the state
+    // version or the input list has moved on.
+    TallyBitmap get_tally_bitmap() const;
+
+    // Version of the most recent tally or mode change.
+    uint64_t get_state_version() const;
+
+    // Every input whose state changed after version `since`; 0 returns them all.
+    TallyDelta get_changes_since(uint64_t since) const;
+
+    // Bumped whenever the input list or an input name may have changed.
+    uint64_t get_names_version() const;
+
+    // SSE event ids ("<epoch>-<position>") and API state versions
+    // ("<epoch>-<version>") carry the start time, so an id handed out before
+    // a restart is never mistaken for one of the current process.
+    std::string format_event_id(uint64_t version) const;
+    // Returns the number in `id`, or nothing if it came from another run.
+    std::optional<uint64_t> parse_event_id(std::string_view id) const;
+
+    // Whether any switcher is a mock.
     bool is_mock_mode() const;
 
     uint16_t get_input_count() const;
 
+    // Every switcher's inputs, in switcher order.
     std::vector<InputInfo> get_inputs() const;
 
+    // The configured switcher ids, by index.
+    [[nodiscard]] const std::vector<std::string>& get_switcher_ids() const;
+    // The index of the switcher with id `id`, if there is one.
+    [[nodiscard]] std::optional<uint8_t> find_switcher(std::string_view id) const;
+
+    [[nodiscard]] Stats stats() const;
+
 private:
-    void monitor_loop();
-    void handle_tally_change(const TallyUpdate& update);
+    // One monitored switcher. Its connection is only replaced, polled and
+    // reconnected on its strand; the fields other threads read are copied
+    // under its mutex.
+    struct Switcher {
+        Switcher(boost::asio::io_context& ioc, uint8_t switcher_index, SwitcherConfig switcher_config);
+        ~Switcher();
+
+        Switcher(const Switcher&) = delete;
+        Switcher& operator=(const Switcher&) = delete;
+        Switcher(Switcher&&) = delete;
+        Switcher& operator=(Switcher&&) = delete;
+
+        const uint8_t index;
+        const SwitcherConfig config;
+        boost::asio::strand<boost::asio::io_context::executor_type> strand;
+        boost::asio::steady_timer poll_timer;
+        boost::asio::steady_timer reconnect_timer;
+        std::unique_ptr<IATEMConnection> connection;
+        bool injected = false; // The connection was handed in; never replaced
+        std::thread connect_thread; // Runs a blocking connect()
+        bool connecting = false;
+        std::chrono::milliseconds backoff;
+        bool first_attempt = true;
+
+        mutable std::mutex mutex;
+        std::vector<InputInfo> inputs;
+        SwitcherStats stats; // interval_ms also paces the poll timer
+    };
+
+    // Run on the switcher's strand.
+    void begin_connect(Switcher& sw, bool allow_mock);
+    void finish_connect(Switcher& sw, bool connected, bool allow_mock);
+    void handle_disconnect(Switcher& sw, const IATEMConnection* connection);
+    void schedule_reconnect(Switcher& sw);
+    void schedule_poll(Switcher& sw);
+    void poll_atem(Switcher& sw);
+
+    std::unique_ptr<IATEMConnection> make_connection(const Switcher& sw) const;
+    // Replaces the switcher's inputs in the table with its connection's.
+    void refresh_inputs(Switcher& sw);
+    void handle_tally_change(Switcher& sw, const TallyUpdate& update);
+    // Reports the mode if switchers going mock or real changed it.
+    void update_mode();
     void notify_mode_change(bool is_mock);
 
-    void poll_atem();
     ReadyCallback ready_callback_;
     boost::asio::io_context& ioc_;
     const Config& config_;
-    std::unique_ptr<IATEMConnection> atem_connection_;
-    std::unique_ptr<boost::asio::steady_timer> monitor_timer_;
+    std::vector<std::string> switcher_ids_;
+    std::vector<std::unique_ptr<Switcher>> switchers_;
 
     ModeChangeCallback mode_change_callback_;
     TallyCallback tally_callback_;
+    InputsChangeCallback inputs_change_callback_;
     std::atomic<bool> running_ { false };
-
-    mutable std::mutex tally_states_mutex_;
-    std::unordered_map<uint16_t, TallyState> current_tally_states_;
+    std::atomic<std::size_t> pending_first_attempts_ { 0 };
+    std::atomic<bool> ready_ { false };
+    std::mutex mode_mutex_;
+    bool reported_mock_ = false; // The mode last reported; guarded by mode_mutex_
+
+    // Readers never lock: the table is read through per-slot sequence
+    // counters. Writers take write_mutex_ and update the table before they
+    // publish the new state version, so a reader that loads the version
+    // first sees every change up to it.
+    std::mutex write_mutex_;
+    TallyTable tally_table_;
+    std::atomic<uint64_t> state_version_ { 0 };
+    const uint64_t epoch_; // Start time in milliseconds; qualifies event ids
+    std::atomic<uint64_t> names_version_ { 0 };
+
+    // Cached snapshot event. Separate from the state mutex so serializing it
+    // never blocks a tally update.
+    mutable std::mutex snapshot_mutex_;
+    mutable TallySnapshot snapshot_;
+    mutable std::mutex bitmap_mutex_;
+    mutable TallyBitmap bitmap_;
 };
 
+void tag_invoke(const boost::json::value_from_tag&, boost::json::value& jv, const TallyMonitor::SwitcherStats& stats);
+void tag_invoke(const boost::json::value_from_tag&, boost::json::value& jv, const TallyMonitor::Stats& stats);
+
 } // namespace atem
@@ -0,0 +1,289 @@
+#include "tally_table.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <thread>
+
+namespace atem {
+
+namespace {
+
+    uint8_t copy_name(char* out, std::size_t out_size, const std::string& name)
+    {
+        const auto length = std::min(name.size(), out_size - 1);
+        std::memcpy(out, name.data(), length);
+        out[length] = '\0';
+        return static_cast<uint8_t>(length);
+    }
+
+}
+
+TallyTable::TallyTable()
+    : current_(nullptr)
+{
+    reset(0, {}, 0);
+}
+
+TallyTable::~TallyTable() = default;
+
+void TallyTable::reset(uint8_t switcher, const std::vector<InputInfo>& inputs, uint64_t version)
+{
+    if (switcher >= kMaxSwitchers) {
+        return;
+    }
+    std::vector<const InputInfo*> sorted;
+    sorted.reserve(inputs.size());
+    for (const auto& input : inputs) {
+        sorted.push_back(&input);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const InputInfo* a, const InputInfo* b) { return a->id < b->id; });
+    sorted.erase(std::unique(sorted.begin(), sorted.end(), [](const InputInfo* a, const InputInfo* b) { return a->id == b->id; }),
+        sorted.end());
+
+    const auto* current = current_.load(std::memory_order_relaxed);
+    const auto now = std::chrono::system_clock::now();
+
+    // A switcher reconnecting with the inputs it had keeps its layout; its
+    // inputs are cleared in place.
+    if (current != nullptr && same_inputs(*current, switcher, sorted)) {
+        for (const auto* input : sorted) {
+            auto* slot = find(*current, switcher, input->id);
+            Entry entry = slot->entry;
+            entry.program = false;
+            entry.preview = false;
+            entry.version = version;
+            entry.last_updated = now;
+            write(*slot, entry);
+        }
+        return;
+    }
+
+    // The other switchers' inputs as they are (only the writer changes
+    // slots), and this switcher's new ones.
+    std::vector<Entry> entries;
+    entries.reserve((current != nullptr ? current->size : 0) + sorted.size());
+    if (current != nullptr) {
+        for (std::size_t i = 0; i < current->size; ++i) {
+            if (current->slots[i].entry.switcher != switcher) {
+                entries.push_back(current->slots[i].entry);
+            }
+        }
+    }
+    for (const auto* input : sorted) {
+        auto& entry = entries.emplace_back();
+        entry.input_id = input->id;
+        entry.switcher = switcher;
+        entry.version = version;
+        entry.last_updated = now;
+        entry.name_length = copy_name(entry.short_name, sizeof(entry.short_name), input->short_name);
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.switcher != b.switcher ? a.switcher < b.switcher : a.input_id < b.input_id;
+    });
+    entries.resize(std::min<std::size_t>(entries.size(), kNoSlot));
+
+    auto layout = std::make_unique<Layout>();
+    layout->generation = current != nullptr ? current->generation + 1 : 0;
+    layout->size = entries.size();
+    layout->slots = std::make_unique<Slot[]>(entries.size()); // NOLINT(cppcoreguidelines-avoid-c-arrays)
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        const auto& entry = entries[i];
+        layout->slots[i].entry = entry;
+
+        auto& page = layout->index[entry.switcher][entry.input_id >> 8];
+        if (!page) {
+            page = std::make_unique<IndexPage>();
+            page->fill(kNoSlot);
+        }
+        (*page)[entry.input_id & 0xFF] = static_cast<uint16_t>(i);
+    }
+
+    // Fully built before it is published. The store and the reader count
+    // check in reclaim() are sequentially consistent with a Pin's count and
+    // load, so a reader the writer does not see loads the new layout.
+    current_.store(layout.get(), std::memory_order_seq_cst);
+    if (layout_) {
+        retired_.push_back(std::move(layout_));
+    }
+    layout_ = std::move(layout);
+    reclaim();
+}
+
+void TallyTable::reclaim()
+{
+    if (!retired_.empty() && readers_.load(std::memory_order_seq_cst) == 0) {
+        retired_.clear();
+    }
+}
+
+TallyTable::UpdateResult TallyTable::update(const TallyUpdate& update, uint64_t version)
+{
+    // Readers may have held the old layout when it was replaced; retry now.
+    reclaim();
+
+    auto* slot = find(*current_.load(std::memory_order_relaxed), update.switcher, update.input_id);
+    if (slot == nullptr) {
+        return UpdateResult::Unknown;
+    }
+
+    Entry entry = slot->entry; // Only the writer changes a slot
+    char name[kMaxNameLength + 1] {}; // NOLINT(cppcoreguidelines-avoid-c-arrays)
+    const auto name_length = copy_name(name, sizeof(name), update.short_name);
+    const bool renamed = name_length != entry.name_length || std::memcmp(name, entry.short_name, name_length) != 0;
+    entry.program = update.program;
+    entry.preview = update.preview;
+    entry.version = version;
+    entry.last_updated = std::chrono::system_clock::now();
+    entry.name_length = name_length;
+    std::memcpy(entry.short_name, name, sizeof(name));
+
+    write(*slot, entry);
+    return renamed ? UpdateResult::Renamed : UpdateResult::Updated;
+}
+
+std::optional<TallyState> TallyTable::get(uint8_t switcher, uint16_t input_id) const
+{
+    const Pin pin(*this);
+    const auto* slot = find(pin.layout(), switcher, input_id);
+    if (slot == nullptr) {
+        return std::nullopt;
+    }
+    const auto entry = read(*slot);
+    std::optional<TallyState> state(std::in_place, entry.input_id, std::string(entry.short_name, entry.name_length), entry.program,
+        entry.preview, entry.last_updated);
+    state->version = entry.version;
+    state->switcher = entry.switcher;
+    return state;
+}
+
+std::vector<TallyState> TallyTable::get_all() const
+{
+    return get_changed_since(0);
+}
+
+std::vector<TallyState> TallyTable::get_all(uint64_t& generation) const
+{
+    const Pin pin(*this);
+    const auto& layout = pin.layout();
+    generation = layout.generation;
+    std::vector<TallyState> states;
+    states.reserve(layout.size);
+    for (std::size_t i = 0; i < layout.size; ++i) {
+        emplace_state(states, read(layout.slots[i]));
+    }
+    return states;
+}
+
+uint64_t TallyTable::generation() const
+{
+    const Pin pin(*this);
+    return pin.layout().generation;
+}
+
+std::vector<TallyState> TallyTable::get_changed_since(uint64_t since) const
+{
+    const Pin pin(*this);
+    const auto& layout = pin.layout();
+    std::vector<TallyState> states;
+    states.reserve(since == 0 ? layout.size : 0);
+    for (std::size_t i = 0; i < layout.size; ++i) {
+        const auto entry = read(layout.slots[i]);
+        if (since == 0 || entry.version > since) {
+            emplace_state(states, entry);
+        }
+    }
+    return states;
+}
+
+std::size_t TallyTable::size() const
+{
+    const Pin pin(*this);
+    return pin.layout().size;
+}
+
+TallyTable::Pin::Pin(const TallyTable& table)
+    : table_(table)
+{
+    table_.readers_.fetch_add(1, std::memory_order_seq_cst);
+    layout_ = table_.current_.load(std::memory_order_seq_cst);
+}
+
+TallyTable::Pin::~Pin()
+{
+    table_.readers_.fetch_sub(1, std::memory_order_release);
+}
+
+TallyTable::Slot* TallyTable::find(const Layout& layout, uint8_t switcher, uint16_t input_id)
+{
+    if (switcher >= kMaxSwitchers) {
+        return nullptr;
+    }
+    const auto& page = layout.index[switcher][input_id >> 8];
+    if (!page) {
+        return nullptr;
+    }
+    const auto slot = (*page)[input_id & 0xFF];
+    return slot == kNoSlot ? nullptr : &layout.slots[slot];
+}
+
+void TallyTable::write(Slot& slot, const Entry& entry)
+{
+    const auto sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.entry = entry;
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool TallyTable::same_inputs(const Layout& layout, uint8_t switcher, const std::vector<const InputInfo*>& inputs)
+{
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < layout.size; ++i) {
+        count += layout.slots[i].entry.switcher == switcher ? 1 : 0;
+    }
+    if (count != inputs.size()) {
+        return false;
+    }
+    for (const auto* input : inputs) {
+        const auto* slot = find(layout, switcher, input->id);
+        if (slot == nullptr) {
+            return false;
+        }
+        const auto length = std::min(input->short_name.size(), kMaxNameLength);
+        if (length != slot->entry.name_length || std::memcmp(input->short_name.data(), slot->entry.short_name, length) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TallyTable::Entry TallyTable::read(const Slot& slot)
+{
+    for (unsigned int attempt = 0;; ++attempt) {
+        const auto before = slot.sequence.load(std::memory_order_acquire);
+        if ((before & 1) == 0) {
+            Entry entry;
+            std::memcpy(static_cast<void*>(&entry), static_cast<const void*>(&slot.entry), sizeof(Entry));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) == before) {
+                entry.name_length = std::min<uint8_t>(entry.name_length, kMaxNameLength);
+                return entry;
+            }
+        }
+        // The writer holds a slot for a few stores; only a preempted writer
+        // keeps a reader here.
+        if (attempt % 64 == 63) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void TallyTable::emplace_state(std::vector<TallyState>& states, const Entry& entry)
+{
+    auto& state = states.emplace_back(entry.input_id, std::string(entry.short_name, entry.name_length), entry.program, entry.preview,
+        entry.last_updated);
+    state.version = entry.version;
+    state.switcher = entry.switcher;
+}
+
+} // namespace atem
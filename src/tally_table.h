@@ -0,0 +1,135 @@
+#pragma once
+
+#include "atem/iatem_connection.h"
+#include "tally_state.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace atem {
+
+/**
+ * @class TallyTable
+ * @brief The state of every input in a dense array, readable without locks.
+ *
+ * Inputs live in one slot each, in switcher then input id order, so a full
+ * read walks contiguous memory. ATEM input ids are sparse (1-40, 1000, 2001,
+ * 3010, 10010, ...); per switcher, a two-level index of 256-entry pages maps
+ * an id to its slot and only allocates the pages that hold inputs.
+ *
+ * There is one writer at a time. Each slot carries a sequence counter that is
+ * odd while the slot is being written, and a reader that sees it change
+ * under it copies the slot again, so readers never block the writer and
+ * never block each other. The layout (index and slots) is replaced only when
+ * a switcher's input list changes. Readers count themselves in while they
+ * use a layout, and a replaced layout is freed by the writer once it sees no
+ * reader in, since any reader that comes later loads the new one.
+ */
+class TallyTable final {
+public:
+    static constexpr std::size_t kMaxNameLength = 31; // Longer short names are truncated
+
+    enum class UpdateResult : uint8_t {
+        Unknown, // The input is not in the table
+        Updated,
+        Renamed, // Updated, and the short name changed
+    };
+
+    TallyTable();
+    ~TallyTable();
+
+    // Non-copyable, non-movable
+    TallyTable(const TallyTable&) = delete;
+    TallyTable& operator=(const TallyTable&) = delete;
+    TallyTable(TallyTable&&) = delete;
+    TallyTable& operator=(TallyTable&&) = delete;
+
+    // Writer side. Calls must not overlap.
+    // Replaces one switcher's input list; each of its inputs starts off
+    // program and preview. The other switchers' inputs keep their state.
+    void reset(uint8_t switcher, const std::vector<InputInfo>& inputs, uint64_t version);
+    UpdateResult update(const TallyUpdate& update, uint64_t version);
+
+    // Reader side, safe from any thread.
+    [[nodiscard]] std::optional<TallyState> get(uint8_t switcher, uint16_t input_id) const;
+    // Every input, in switcher then input id order.
+    [[nodiscard]] std::vector<TallyState> get_all() const;
+    // The same, with the generation of the layout they were read from. The
+    // generation changes whenever the input list does.
+    [[nodiscard]] std::vector<TallyState> get_all(uint64_t& generation) const;
+    [[nodiscard]] uint64_t generation() const;
+    // Every input whose version is above `since`, in switcher then input id
+    // order.
+    [[nodiscard]] std::vector<TallyState> get_changed_since(uint64_t since) const;
+    [[nodiscard]] std::size_t size() const;
+
+private:
+    // Plain data, so a reader can copy it while it is being written and
+    // discard the copy if the sequence counter moved.
+    struct Entry {
+        uint64_t version = 0;
+        std::chrono::system_clock::time_point last_updated;
+        uint16_t input_id = 0;
+        uint8_t switcher = 0;
+        bool program = false;
+        bool preview = false;
+        uint8_t name_length = 0;
+        char short_name[kMaxNameLength + 1] {}; // NOLINT(cppcoreguidelines-avoid-c-arrays)
+    };
+
+    // One cache line per input, so writes to one input never disturb
+    // readers of its neighbours.
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> sequence { 0 }; // Odd while being written
+        Entry entry;
+    };
+
+    static constexpr uint16_t kNoSlot = 0xFFFF;
+    using IndexPage = std::array<uint16_t, 256>;
+    using Index = std::array<std::unique_ptr<IndexPage>, 256>; // By the id's high byte
+
+    struct Layout {
+        uint64_t generation = 0;
+        std::size_t size = 0;
+        std::unique_ptr<Slot[]> slots; // NOLINT(cppcoreguidelines-avoid-c-arrays)
+        std::array<Index, kMaxSwitchers> index; // By switcher
+    };
+
+    // Counts a reader in for its lifetime, keeping the layout it loaded alive.
+    class Pin final {
+    public:
+        explicit Pin(const TallyTable& table);
+        ~Pin();
+        Pin(const Pin&) = delete;
+        Pin& operator=(const Pin&) = delete;
+        Pin(Pin&&) = delete;
+        Pin& operator=(Pin&&) = delete;
+
+        [[nodiscard]] const Layout& layout() const { return *layout_; }
+
+    private:
+        const TallyTable& table_;
+        const Layout* layout_;
+    };
+
+    // Frees the replaced layouts if no reader is in. Writer only.
+    void reclaim();
+
+    [[nodiscard]] static Slot* find(const Layout& layout, uint8_t switcher, uint16_t input_id);
+    [[nodiscard]] static Entry read(const Slot& slot);
+    static void write(Slot& slot, const Entry& entry);
+    [[nodiscard]] static bool same_inputs(const Layout& layout, uint8_t switcher, const std::vector<const InputInfo*>& inputs);
+    static void emplace_state(std::vector<TallyState>& states, const Entry& entry);
+
+    std::atomic<Layout*> current_;
+    alignas(64) mutable std::atomic<uint32_t> readers_ { 0 }; // Pins alive
+    std::unique_ptr<Layout> layout_; // Owns current_; writer only
+    std::vector<std::unique_ptr<Layout>> retired_; // Replaced, maybe still read; writer only
+};
+
+} // namespace atem
@@ -0,0 +1,127 @@
+#include "thread_pool.h"
+#include "logger.h"
+#include "platform_interface.h"
+#include <algorithm>
+
+namespace atem {
+
+ThreadPool::ThreadPool(std::string name, unsigned int size, std::vector<int> cpus, std::chrono::milliseconds lag_probe_interval)
+    : name_(std::move(name))
+    , size_(std::max(1U, size))
+    , cpus_(std::move(cpus))
+    , lag_probe_interval_(lag_probe_interval)
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+    join();
+}
+
+void ThreadPool::start(boost::asio::io_context& ioc)
+{
+    {
+        const std::scoped_lock lock(stats_mutex_);
+        thread_stats_.assign(size_, ThreadStats {});
+    }
+    if (lag_probe_interval_.count() > 0) {
+        probe_timer_ = std::make_unique<boost::asio::steady_timer>(ioc);
+        schedule_probe();
+    }
+    threads_.reserve(size_);
+    for (std::size_t i = 0; i < size_; ++i) {
+        threads_.emplace_back([this, &ioc, i]() { run(ioc, i); });
+    }
+}
+
+void ThreadPool::join()
+{
+    for (auto& thread : threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    threads_.clear();
+}
+
+void ThreadPool::run(boost::asio::io_context& ioc, std::size_t index)
+{
+    ThreadStats thread;
+    thread.name = name_ + "-" + std::to_string(index);
+    platform::set_current_thread_name(thread.name);
+    if (!cpus_.empty()) {
+        thread.cpu = cpus_[index % cpus_.size()];
+        thread.pinned = platform::pin_current_thread(thread.cpu);
+        if (!thread.pinned) {
+            log(LogLevel::Warning) << "Could not pin thread " << thread.name << " to CPU " << thread.cpu;
+        }
+    }
+    {
+        const std::scoped_lock lock(stats_mutex_);
+        thread_stats_[index] = thread;
+    }
+    ioc.run();
+}
+
+void ThreadPool::schedule_probe()
+{
+    probe_timer_->expires_after(lag_probe_interval_);
+    probe_timer_->async_wait([this](const boost::system::error_code& ec) {
+        if (ec) {
+            return;
+        }
+        const auto late = std::chrono::steady_clock::now() - probe_timer_->expiry();
+        const auto lag_us = static_cast<uint64_t>(std::max<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(late).count(), 0));
+        probes_.fetch_add(1, std::memory_order_relaxed);
+        last_lag_us_.store(lag_us, std::memory_order_relaxed);
+        total_lag_us_.fetch_add(lag_us, std::memory_order_relaxed);
+        // Only the probe writes it, so no compare-exchange is needed.
+        if (lag_us > max_lag_us_.load(std::memory_order_relaxed)) {
+            max_lag_us_.store(lag_us, std::memory_order_relaxed);
+        }
+        schedule_probe();
+    });
+}
+
+ThreadPool::Stats ThreadPool::stats() const
+{
+    Stats stats;
+    stats.name = name_;
+    {
+        const std::scoped_lock lock(stats_mutex_);
+        stats.threads = thread_stats_;
+    }
+    stats.lag = {
+        probes_.load(std::memory_order_relaxed),
+        last_lag_us_.load(std::memory_order_relaxed),
+        max_lag_us_.load(std::memory_order_relaxed),
+        total_lag_us_.load(std::memory_order_relaxed),
+    };
+    return stats;
+}
+
+void tag_invoke(const boost::json::value_from_tag&, boost::json::value& jv, const ThreadPool::Stats& stats)
+{
+    boost::json::array threads;
+    for (const auto& thread : stats.threads) {
+        threads.push_back({
+            { "name", thread.name },
+            { "cpu", thread.cpu },
+            { "pinned", thread.pinned },
+        });
+    }
+    boost::json::object object;
+    object["name"] = stats.name;
+    object["threads"] = std::move(threads);
+    if (stats.lag.probes > 0) {
+        object["lag_us"] = {
+            { "last", stats.lag.last_us },
+            { "max", stats.lag.max_us },
+            { "mean", stats.lag.total_us / stats.lag.probes },
+            { "probes", stats.lag.probes },
+        };
+    }
+    jv = std::move(object);
+}
+
+} // namespace atem
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <boost/asio.hpp>
+#include <boost/json.hpp>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace atem {
+
+/**
+ * @class ThreadPool
+ * @brief Named threads running one io_context, optionally pinned to CPUs.
+ *
+ * Every thread the server starts for an io_context comes from a pool: the
+ * event thread that runs the monitor, the sinks and the tally path, and the
+ * HTTP I/O threads of the Asio engine. Threads are named `<pool>-<n>` and, if
+ * the pool was given CPUs, each is pinned to one of them in turn.
+ *
+ * A pool can also measure how late its io_context runs a handler: a timer
+ * fires every `lag_probe_interval`, and how long after its deadline it runs
+ * is the time a ready handler waited for a thread, whether because the
+ * threads were busy or because the scheduler gave their cores to someone
+ * else.
+ */
+class ThreadPool final {
+public:
+    struct ThreadStats {
+        std::string name;
+        int cpu = -1; // -1 = not pinned
+        bool pinned = false; // Whether the scheduler accepted the pinning
+    };
+
+    struct LagStats {
+        uint64_t probes = 0;
+        uint64_t last_us = 0;
+        uint64_t max_us = 0;
+        uint64_t total_us = 0;
+    };
+
+    struct Stats {
+        std::string name;
+        std::vector<ThreadStats> threads;
+        LagStats lag;
+    };
+
+    // `cpus` are assigned to the threads round robin; empty = not pinned.
+    // A zero `lag_probe_interval` turns the probe off.
+    ThreadPool(std::string name, unsigned int size, std::vector<int> cpus, std::chrono::milliseconds lag_probe_interval);
+    ~ThreadPool();
+
+    // Non-copyable, non-movable
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ThreadPool(ThreadPool&&) = delete;
+    ThreadPool& operator=(ThreadPool&&) = delete;
+
+    // Starts the threads, each running `ioc` until it is stopped. The pool
+    // must be destroyed before `ioc`.
+    void start(boost::asio::io_context& ioc);
+    // Waits for every thread to return from the io_context.
+    void join();
+
+    [[nodiscard]] Stats stats() const;
+
+private:
+    void run(boost::asio::io_context& ioc, std::size_t index);
+    void schedule_probe();
+
+    const std::string name_;
+    const unsigned int size_;
+    const std::vector<int> cpus_;
+    const std::chrono::milliseconds lag_probe_interval_;
+
+    std::vector<std::thread> threads_;
+    mutable std::mutex stats_mutex_;
+    std::vector<ThreadStats> thread_stats_;
+
+    std::unique_ptr<boost::asio::steady_timer> probe_timer_;
+    std::atomic<uint64_t> probes_ { 0 };
+    std::atomic<uint64_t> last_lag_us_ { 0 };
+    std::atomic<uint64_t> max_lag_us_ { 0 };
+    std::atomic<uint64_t> total_lag_us_ { 0 };
+};
+
+void tag_invoke(const boost::json::value_from_tag&, boost::json::value& jv, const ThreadPool::Stats& stats);
+
+} // namespace atem
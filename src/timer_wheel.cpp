@@ -0,0 +1,147 @@
+#include "timer_wheel.h"
+#include <algorithm>
+#include <utility>
+
+namespace atem {
+
+TimerWheel::TimerWheel(boost::asio::io_context& ioc, std::chrono::milliseconds tick)
+    : tick_(tick.count() > 0 ? tick : std::chrono::milliseconds(1))
+    , timer_(ioc)
+{
+}
+
+TimerWheel::~TimerWheel()
+{
+    stop();
+}
+
+void TimerWheel::start()
+{
+    const std::scoped_lock lock(mutex_);
+    if (running_) {
+        return;
+    }
+    running_ = true;
+    started_ = std::chrono::steady_clock::now() - current_tick_ * tick_;
+    wait();
+}
+
+void TimerWheel::stop()
+{
+    const std::scoped_lock lock(mutex_);
+    running_ = false;
+    timer_.cancel();
+}
+
+TimerWheel::TimerId TimerWheel::schedule(std::chrono::milliseconds delay, Callback callback)
+{
+    const std::scoped_lock lock(mutex_);
+    // Measure from the clock rather than current_tick_, which may lag behind
+    // it, and round up so a timer never fires early.
+    const auto from_start = (running_ ? std::chrono::steady_clock::now() - started_ : current_tick_ * tick_) + delay;
+    const auto expiry = static_cast<uint64_t>((from_start + tick_ - std::chrono::nanoseconds(1)) / tick_);
+
+    const TimerId id = next_id_++;
+    pending_.insert(id);
+    insert({ id, std::max(expiry, current_tick_ + 1), std::move(callback) });
+    return id;
+}
+
+void TimerWheel::cancel(TimerId id)
+{
+    // The entry stays in its slot and is skipped when it comes due.
+    const std::scoped_lock lock(mutex_);
+    pending_.erase(id);
+}
+
+std::size_t TimerWheel::size() const
+{
+    const std::scoped_lock lock(mutex_);
+    return pending_.size();
+}
+
+void TimerWheel::insert(Timer timer)
+{
+    const uint64_t delta = timer.expiry > current_tick_ ? timer.expiry - current_tick_ : 0;
+    std::size_t level = 0;
+    while (level + 1 < kLevels && delta >= (uint64_t { 1 } << (kSlotBits * (level + 1)))) {
+        ++level;
+    }
+    // Deadlines beyond the top level wait in its furthest slot and are
+    // re-inserted when it cascades.
+    const uint64_t expiry = level + 1 == kLevels && delta >= (uint64_t { 1 } << (kSlotBits * kLevels))
+        ? current_tick_ + (uint64_t { 1 } << (kSlotBits * kLevels)) - 1
+        : timer.expiry;
+    const auto slot = static_cast<std::size_t>((expiry >> (kSlotBits * level)) & (kSlots - 1));
+    levels_.at(level).at(slot).push_back(std::move(timer));
+}
+
+void TimerWheel::advance(std::vector<Timer>& due)
+{
+    ++current_tick_;
+
+    // Cascade from the top down: a higher level may drop timers into a lower
+    // level's slot that is due at this very tick.
+    for (std::size_t level = kLevels - 1; level > 0; --level) {
+        const uint64_t span = uint64_t { 1 } << (kSlotBits * level);
+        if (current_tick_ % span != 0) {
+            continue;
+        }
+        const auto slot = static_cast<std::size_t>((current_tick_ >> (kSlotBits * level)) & (kSlots - 1));
+        Slot timers;
+        timers.swap(levels_.at(level).at(slot));
+        for (auto& timer : timers) {
+            if (pending_.contains(timer.id)) {
+                insert(std::move(timer));
+            }
+        }
+    }
+
+    Slot timers;
+    timers.swap(levels_.at(0).at(static_cast<std::size_t>(current_tick_ & (kSlots - 1))));
+    for (auto& timer : timers) {
+        if (!pending_.contains(timer.id)) {
+            continue; // Cancelled
+        }
+        if (timer.expiry > current_tick_) {
+            insert(std::move(timer)); // Parked beyond the top level
+            continue;
+        }
+        pending_.erase(timer.id);
+        due.push_back(std::move(timer));
+    }
+}
+
+void TimerWheel::wait()
+{
+    timer_.expires_at(started_ + (current_tick_ + 1) * tick_);
+    timer_.async_wait([this](const boost::system::error_code& ec) {
+        if (!ec) {
+            on_tick();
+        }
+    });
+}
+
+void TimerWheel::on_tick()
+{
+    std::vector<Timer> due;
+    {
+        const std::scoped_lock lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        // Catch up on every tick that has elapsed, so a busy io_context delays
+        // timers instead of losing them.
+        const auto target = static_cast<uint64_t>((std::chrono::steady_clock::now() - started_) / tick_);
+        while (current_tick_ < target) {
+            advance(due);
+        }
+        wait();
+    }
+
+    for (auto& timer : due) {
+        timer.callback();
+    }
+}
+
+} // namespace atem
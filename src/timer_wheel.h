@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+namespace atem {
+
+/**
+ * @class TimerWheel
+ * @brief Many coarse deadlines driven by a single Asio timer.
+ *
+ * Deadlines are rounded up to whole ticks and kept in a hierarchical wheel of
+ * four levels of 64 slots. Scheduling and cancelling are O(1). Each tick only
+ * touches the slot that is due, plus an occasional cascade of a higher-level
+ * slot into the levels below. Callbacks run on the io_context, outside the
+ * wheel's lock, and may schedule new timers.
+ */
+class TimerWheel final {
+public:
+    using TimerId = uint64_t;
+    using Callback = std::function<void()>;
+
+    TimerWheel(boost::asio::io_context& ioc, std::chrono::milliseconds tick);
+    ~TimerWheel();
+
+    // Non-copyable, non-movable
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+    TimerWheel(TimerWheel&&) = delete;
+    TimerWheel& operator=(TimerWheel&&) = delete;
+
+    void start();
+    void stop();
+
+    // Thread-safe. The callback runs no earlier than `delay` from now and at
+    // most one tick later.
+    TimerId schedule(std::chrono::milliseconds delay, Callback callback);
+    void cancel(TimerId id);
+
+    [[nodiscard]] std::size_t size() const;
+
+private:
+    static constexpr unsigned int kSlotBits = 6;
+    static constexpr std::size_t kSlots = std::size_t { 1 } << kSlotBits;
+    static constexpr std::size_t kLevels = 4;
+
+    struct Timer {
+        TimerId id;
+        uint64_t expiry; // In ticks
+        Callback callback;
+    };
+    using Slot = std::vector<Timer>;
+
+    void insert(Timer timer); // Requires mutex_
+    void advance(std::vector<Timer>& due); // Requires mutex_
+    void wait();
+    void on_tick();
+
+    const std::chrono::milliseconds tick_;
+    boost::asio::steady_timer timer_;
+    std::chrono::steady_clock::time_point started_ {};
+    bool running_ = false;
+
+    mutable std::mutex mutex_;
+    std::array<std::array<Slot, kSlots>, kLevels> levels_ {};
+    std::unordered_set<TimerId> pending_; // Scheduled and not yet fired or cancelled
+    uint64_t current_tick_ = 0;
+    TimerId next_id_ = 1;
+};
+
+} // namespace atem
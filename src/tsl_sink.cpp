@@ -0,0 +1,371 @@
+#include "tsl_sink.h"
+#include "config.h"
+#include "logger.h"
+#include "tally_monitor.h"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace atem {
+
+namespace net = boost::asio;
+using net::ip::tcp;
+using net::ip::udp;
+
+namespace {
+
+    constexpr auto kReconnectDelay = std::chrono::seconds(2);
+
+    // Splits "host:port" at the last colon.
+    std::pair<std::string, std::string> split_destination(const std::string& destination)
+    {
+        const auto colon = destination.rfind(':');
+        if (colon == std::string::npos || colon == 0 || colon + 1 == destination.size()) {
+            throw std::invalid_argument("TSL destination '" + destination + "' is not host:port");
+        }
+        return { destination.substr(0, colon), destination.substr(colon + 1) };
+    }
+
+}
+
+TslSink::TcpPeer::TcpPeer(net::io_context& ioc)
+    : socket(ioc)
+    , retry_timer(ioc)
+{
+}
+
+TslSink::TslSink(const Config& config, gsl::not_null<TallyMonitor*> monitor)
+    : config_(config)
+    , monitor_(*monitor)
+    , udp_socket_(ioc_)
+    , resolver_(ioc_)
+    , refresh_timer_(ioc_)
+{
+}
+
+TslSink::~TslSink()
+{
+    stop();
+}
+
+void TslSink::start()
+{
+    udp::resolver resolver(ioc_);
+    for (const auto& destination : config_.tsl_udp_destinations) {
+        const auto [host, port] = split_destination(destination);
+        udp_targets_.push_back(*resolver.resolve(udp::v4(), host, port).begin());
+    }
+    if (!udp_targets_.empty()) {
+        udp_socket_.open(udp::v4());
+    }
+    for (const auto& destination : config_.tsl_tcp_destinations) {
+        auto peer = std::make_unique<TcpPeer>(ioc_);
+        std::tie(peer->host, peer->port) = split_destination(destination);
+        tcp_peers_.push_back(std::move(peer));
+    }
+
+    running_.store(true, std::memory_order_release);
+    work_.emplace(net::make_work_guard(ioc_));
+    net::post(ioc_, [this]() {
+        for (auto& peer : tcp_peers_) {
+            connect(*peer);
+        }
+        schedule_refresh();
+    });
+    log(LogLevel::Info) << "TSL UMD output to " << udp_targets_.size() << " UDP and " << tcp_peers_.size() << " TCP destinations";
+    thread_ = std::thread([this]() { ioc_.run(); });
+    publish_all();
+}
+
+void TslSink::stop()
+{
+    if (!running_.exchange(false, std::memory_order_acq_rel)) {
+        return;
+    }
+    net::post(ioc_, [this]() {
+        refresh_timer_.cancel();
+        resolver_.cancel();
+        for (auto& peer : tcp_peers_) {
+            peer->retry_timer.cancel();
+            boost::system::error_code ec;
+            peer->socket.close(ec);
+        }
+        boost::system::error_code ec;
+        udp_socket_.close(ec);
+    });
+    work_.reset();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void TslSink::publish(const TallyUpdate& update)
+{
+    if (!running_.load(std::memory_order_acquire)) {
+        return;
+    }
+    const std::scoped_lock lock(mutex_);
+    ++stats_.updates;
+    if (pending_.empty() && !refresh_pending_) {
+        oldest_pending_ = Clock::now();
+    }
+    if (refresh_pending_) {
+        // The refresh reads the state when it is sent, which includes this change.
+        ++stats_.coalesced;
+    } else if (const auto it = std::find_if(pending_.begin(), pending_.end(),
+                   [&update](const TallyUpdate& queued) { return queued.key() == update.key(); });
+        it != pending_.end()) {
+        *it = update;
+        ++stats_.coalesced;
+    } else if (pending_.size() >= std::max(1U, config_.tsl_queue_limit)) {
+        pending_.clear();
+        refresh_pending_ = true;
+        ++stats_.overflows;
+    } else {
+        pending_.push_back(update);
+    }
+    if (!std::exchange(flush_posted_, true)) {
+        net::post(ioc_, [this]() { flush(); });
+    }
+}
+
+void TslSink::publish_all()
+{
+    if (!running_.load(std::memory_order_acquire)) {
+        return;
+    }
+    const std::scoped_lock lock(mutex_);
+    if (pending_.empty() && !refresh_pending_) {
+        oldest_pending_ = Clock::now();
+    }
+    pending_.clear();
+    refresh_pending_ = true;
+    if (!std::exchange(flush_posted_, true)) {
+        net::post(ioc_, [this]() { flush(); });
+    }
+}
+
+void TslSink::flush()
+{
+    std::vector<TallyUpdate> updates;
+    bool refresh = false;
+    {
+        const std::scoped_lock lock(mutex_);
+        updates.swap(pending_);
+        refresh = std::exchange(refresh_pending_, false);
+        flush_posted_ = false;
+        const auto delay_us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - oldest_pending_).count());
+        stats_.last_delay_us = delay_us;
+        stats_.max_delay_us = std::max(stats_.max_delay_us, delay_us);
+        stats_.refreshes += refresh ? 1 : 0;
+    }
+
+    Displays displays;
+    if (refresh) {
+        displays = all_displays();
+    } else {
+        for (const auto& update : updates) {
+            if (update.switcher >= displays.size()) {
+                displays.resize(update.switcher + 1U);
+            }
+            displays[update.switcher].push_back(to_display(update.input_id, update.program, update.preview, update.short_name));
+        }
+    }
+    send(displays, nullptr);
+}
+
+void TslSink::schedule_refresh()
+{
+    if (config_.tsl_refresh_interval_ms == 0) {
+        return;
+    }
+    refresh_timer_.expires_after(std::chrono::milliseconds(config_.tsl_refresh_interval_ms));
+    refresh_timer_.async_wait([this](const boost::system::error_code& ec) {
+        if (ec || !running_.load(std::memory_order_acquire)) {
+            return;
+        }
+        publish_all();
+        schedule_refresh();
+    });
+}
+
+void TslSink::connect(TcpPeer& peer)
+{
+    resolver_.async_resolve(peer.host, peer.port, [this, &peer](const boost::system::error_code& ec, const tcp::resolver::results_type& results) {
+        if (ec) {
+            drop(peer);
+            return;
+        }
+        net::async_connect(peer.socket, results, [this, &peer](const boost::system::error_code& connect_ec, const tcp::endpoint&) {
+            if (connect_ec) {
+                drop(peer);
+                return;
+            }
+            peer.connected = true;
+            boost::system::error_code option_ec;
+            peer.socket.set_option(tcp::no_delay(true), option_ec);
+            tcp_connected_.fetch_add(1, std::memory_order_relaxed);
+            {
+                const std::scoped_lock lock(mutex_);
+                ++stats_.tcp_connects;
+            }
+            log(LogLevel::Info) << "TSL UMD connected to " << peer.host << ":" << peer.port;
+            send(all_displays(), &peer);
+        });
+    });
+}
+
+void TslSink::drop(TcpPeer& peer)
+{
+    if (peer.connected) {
+        peer.connected = false;
+        tcp_connected_.fetch_sub(1, std::memory_order_relaxed);
+        const std::scoped_lock lock(mutex_);
+        ++stats_.tcp_drops;
+    }
+    boost::system::error_code ec;
+    peer.socket.close(ec);
+    // A write in flight keeps its own reference to its packet.
+    ++peer.generation;
+    peer.queue.clear();
+    if (!running_.load(std::memory_order_acquire)) {
+        return;
+    }
+    peer.retry_timer.expires_after(kReconnectDelay);
+    peer.retry_timer.async_wait([this, &peer](const boost::system::error_code& timer_ec) {
+        if (!timer_ec && running_.load(std::memory_order_acquire)) {
+            connect(peer);
+        }
+    });
+}
+
+void TslSink::write(TcpPeer& peer)
+{
+    // The handler holds the packet, so the buffer outlives the write even if
+    // drop() empties the queue meanwhile.
+    auto packet = peer.queue.front();
+    const auto buffer = net::buffer(*packet);
+    net::async_write(peer.socket, buffer, [this, &peer, packet = std::move(packet), generation = peer.generation](const boost::system::error_code& ec, std::size_t) {
+        if (generation != peer.generation) {
+            return; // The connection was dropped while this was in flight
+        }
+        if (ec) {
+            if (ec != net::error::operation_aborted) {
+                drop(peer);
+            }
+            return;
+        }
+        peer.queue.pop_front();
+        if (!peer.queue.empty()) {
+            write(peer);
+        }
+    });
+}
+
+void TslSink::send(const Displays& displays, TcpPeer* only)
+{
+    std::vector<std::vector<uint8_t>> packets;
+    for (std::size_t switcher = 0; switcher < displays.size(); ++switcher) {
+        encode_tsl_packets(static_cast<uint16_t>(config_.tsl_screen + switcher), displays[switcher], packets);
+    }
+    if (packets.empty()) {
+        return;
+    }
+
+    uint64_t sent = 0;
+    uint64_t bytes = 0;
+    uint64_t errors = 0;
+    if (only == nullptr) {
+        for (const auto& target : udp_targets_) {
+            for (const auto& packet : packets) {
+                boost::system::error_code ec;
+                udp_socket_.send_to(net::buffer(packet), target, 0, ec);
+                errors += ec ? 1 : 0;
+                sent += ec ? 0 : 1;
+                bytes += ec ? 0 : packet.size();
+            }
+        }
+    }
+    if (!tcp_peers_.empty()) {
+        // One framed buffer per flush, shared by every connection.
+        auto framed = std::make_shared<std::vector<uint8_t>>();
+        for (const auto& packet : packets) {
+            append_tsl_tcp_frame(packet, *framed);
+        }
+        const Packet shared = std::move(framed);
+        for (auto& peer : tcp_peers_) {
+            if (!peer->connected || (only != nullptr && only != peer.get())) {
+                continue;
+            }
+            if (peer->queue.size() >= std::max(1U, config_.tsl_queue_limit)) {
+                log(LogLevel::Warning) << "Dropping TSL UMD connection to " << peer->host << ":" << peer->port << ": too far behind";
+                drop(*peer);
+                continue;
+            }
+            peer->queue.push_back(shared);
+            sent += packets.size();
+            bytes += shared->size();
+            if (peer->queue.size() == 1) {
+                write(*peer);
+            }
+        }
+    }
+
+    const std::scoped_lock lock(mutex_);
+    stats_.packets += sent;
+    stats_.bytes += bytes;
+    stats_.send_errors += errors;
+}
+
+TslSink::Displays TslSink::all_displays() const
+{
+    auto states = monitor_.get_all_tally_states();
+    std::sort(states.begin(), states.end(), [](const TallyState& a, const TallyState& b) { return a.key() < b.key(); });
+    Displays displays;
+    for (const auto& state : states) {
+        if (state.switcher >= displays.size()) {
+            displays.resize(state.switcher + 1U);
+        }
+        displays[state.switcher].push_back(to_display(state.input_id, state.program, state.preview, state.short_name));
+    }
+    return displays;
+}
+
+TslDisplay TslSink::to_display(uint16_t input_id, bool program, bool preview, const std::string& name) const
+{
+    TslDisplay display;
+    display.index = static_cast<uint16_t>(std::clamp(int { input_id } + config_.tsl_index_offset, 0, int { kTslBroadcast } - 1));
+    display.rh_tally = program ? TslTally::Red : TslTally::Off;
+    display.lh_tally = preview ? TslTally::Green : TslTally::Off;
+    display.text_tally = program ? TslTally::Red : (preview ? TslTally::Green : TslTally::Off);
+    display.brightness = static_cast<uint8_t>(std::min(config_.tsl_brightness, 3U));
+    display.text = name.empty() ? std::to_string(input_id) : name;
+    return display;
+}
+
+TslSink::Stats TslSink::stats() const
+{
+    const std::scoped_lock lock(mutex_);
+    auto stats = stats_;
+    stats.tcp_connected = tcp_connected_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void tag_invoke(const boost::json::value_from_tag&, boost::json::value& jv, const TslSink::Stats& stats)
+{
+    jv = {
+        { "updates", stats.updates },
+        { "coalesced", stats.coalesced },
+        { "overflows", stats.overflows },
+        { "refreshes", stats.refreshes },
+        { "packets", stats.packets },
+        { "bytes", stats.bytes },
+        { "send_errors", stats.send_errors },
+        { "tcp_connected", stats.tcp_connected },
+        { "tcp_connects", stats.tcp_connects },
+        { "tcp_drops", stats.tcp_drops },
+        { "queue_delay_us", { { "last", stats.last_delay_us }, { "max", stats.max_delay_us } } },
+    };
+}
+
+} // namespace atem
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "tally_state.h"
+#include "tsl_umd.h"
+#include <atomic>
+#include <boost/asio.hpp>
+#include <boost/json.hpp>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <gsl/gsl>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace atem {
+
+struct Config;
+class TallyMonitor;
+
+/**
+ * @class TslSink
+ * @brief Drives TSL UMD v5.0 displays, over UDP and TCP, from the monitor's tally state.
+ *
+ * Tally changes are handed over through a bounded queue and sent from the
+ * sink's own I/O thread, so a slow display never holds up the monitor. While
+ * the queue waits, a newer change to an input replaces the older one; if it
+ * fills anyway, it is replaced by one full-state refresh. Each input is one
+ * display: program lights the right-hand tally red, preview the left-hand
+ * tally green, and the text tally shows whichever is active (program first).
+ * The input's short name is the UMD text. Each switcher's inputs go to a
+ * screen of their own: `tsl.screen` plus the switcher's index.
+ *
+ * TCP destinations are connected to, and reconnected after a failure. A
+ * connection gets the full state as soon as it opens, and is dropped if it
+ * falls more than a queue's worth of packets behind. The full state is also
+ * sent to every destination at the refresh interval.
+ */
+class TslSink final {
+public:
+    struct Stats {
+        uint64_t updates = 0; // Tally changes handed to the sink
+        uint64_t coalesced = 0; // Changes superseded by a newer one while queued
+        uint64_t overflows = 0; // Times the queue filled and became a full refresh
+        uint64_t refreshes = 0;
+        uint64_t packets = 0; // Packets sent, counted per destination
+        uint64_t bytes = 0;
+        uint64_t send_errors = 0;
+        uint64_t tcp_connected = 0;
+        uint64_t tcp_connects = 0;
+        uint64_t tcp_drops = 0; // Connections closed for falling behind or failing
+        uint64_t last_delay_us = 0; // Time the oldest change of a flush spent queued
+        uint64_t max_delay_us = 0;
+    };
+
+    TslSink(const Config& config, gsl::not_null<TallyMonitor*> monitor);
+    ~TslSink();
+
+    // Non-copyable, non-movable
+    TslSink(const TslSink&) = delete;
+    TslSink& operator=(const TslSink&) = delete;
+    TslSink(TslSink&&) = delete;
+    TslSink& operator=(TslSink&&) = delete;
+
+    // Resolves the UDP destinations and starts the I/O thread. Throws if a
+    // destination is malformed or can't be resolved.
+    void start();
+    void stop();
+
+    void publish(const TallyUpdate& update);
+    // Queues a refresh of every display, e.g. after a mode change.
+    void publish_all();
+
+    [[nodiscard]] Stats stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+    using Packet = std::shared_ptr<const std::vector<uint8_t>>;
+
+    struct TcpPeer {
+        explicit TcpPeer(boost::asio::io_context& ioc);
+
+        std::string host;
+        std::string port;
+        boost::asio::ip::tcp::socket socket;
+        boost::asio::steady_timer retry_timer;
+        bool connected = false;
+        // Bumped by drop(), so a write that completes after its connection was
+        // dropped leaves the new connection's queue alone.
+        uint64_t generation = 0;
+        std::deque<Packet> queue; // The front one is being written
+    };
+
+    // The rest run on the I/O thread.
+    void flush();
+    void schedule_refresh();
+    void connect(TcpPeer& peer);
+    void drop(TcpPeer& peer);
+    void write(TcpPeer& peer);
+    // Displays by switcher index, and so by screen.
+    using Displays = std::vector<std::vector<TslDisplay>>;
+
+    void send(const Displays& displays, TcpPeer* only);
+    [[nodiscard]] Displays all_displays() const;
+    [[nodiscard]] TslDisplay to_display(uint16_t input_id, bool program, bool preview, const std::string& name) const;
+
+    const Config& config_;
+    TallyMonitor& monitor_;
+    boost::asio::io_context ioc_;
+    std::optional<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> work_;
+    std::thread thread_;
+    boost::asio::ip::udp::socket udp_socket_;
+    std::vector<boost::asio::ip::udp::endpoint> udp_targets_;
+    boost::asio::ip::tcp::resolver resolver_;
+    std::vector<std::unique_ptr<TcpPeer>> tcp_peers_;
+    boost::asio::steady_timer refresh_timer_;
+    std::atomic<bool> running_ { false };
+    std::atomic<uint64_t> tcp_connected_ { 0 };
+
+    // Guards the queue and the counters.
+    mutable std::mutex mutex_;
+    std::vector<TallyUpdate> pending_;
+    Clock::time_point oldest_pending_ {};
+    bool refresh_pending_ = false;
+    bool flush_posted_ = false;
+    Stats stats_; // tcp_connected is filled in by stats()
+};
+
+void tag_invoke(const boost::json::value_from_tag&, boost::json::value& jv, const TslSink::Stats& stats);
+
+} // namespace atem
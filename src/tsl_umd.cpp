@@ -0,0 +1,134 @@
+#include "tsl_umd.h"
+#include <algorithm>
+
+namespace atem {
+
+namespace {
+
+    constexpr std::size_t kHeaderSize = 6; // PBC, VER, FLAGS, SCREEN
+    constexpr std::size_t kMessageHeaderSize = 6; // INDEX, CONTROL, LENGTH
+    constexpr uint8_t kVersion = 0;
+    constexpr uint8_t kFlagUnicode = 0x01;
+    constexpr uint8_t kFlagScreenControl = 0x02;
+    constexpr uint16_t kControlData = 0x8000; // The message carries control data, not display data
+
+    void put16(std::vector<uint8_t>& out, uint16_t value)
+    {
+        out.push_back(static_cast<uint8_t>(value));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+    }
+
+    uint16_t get16(std::span<const uint8_t> in, std::size_t offset)
+    {
+        return static_cast<uint16_t>(in[offset] | (in[offset + 1] << 8));
+    }
+
+    uint16_t control_word(const TslDisplay& display)
+    {
+        return static_cast<uint16_t>(static_cast<unsigned int>(display.rh_tally)
+            | (static_cast<unsigned int>(display.text_tally) << 2)
+            | (static_cast<unsigned int>(display.lh_tally) << 4)
+            | ((display.brightness & 0x03U) << 6));
+    }
+
+    std::vector<uint8_t> start_packet(uint16_t screen)
+    {
+        std::vector<uint8_t> packet;
+        packet.reserve(kMaxTslPacketSize);
+        put16(packet, 0); // PBC, filled in by finish_packet
+        packet.push_back(kVersion);
+        packet.push_back(0);
+        put16(packet, screen);
+        return packet;
+    }
+
+    void finish_packet(std::vector<uint8_t>& packet, std::vector<std::vector<uint8_t>>& out)
+    {
+        const auto count = static_cast<uint16_t>(packet.size() - 2);
+        packet[0] = static_cast<uint8_t>(count);
+        packet[1] = static_cast<uint8_t>(count >> 8);
+        out.push_back(std::move(packet));
+    }
+
+}
+
+void encode_tsl_packets(uint16_t screen, std::span<const TslDisplay> displays, std::vector<std::vector<uint8_t>>& out)
+{
+    constexpr std::size_t kMaxText = kMaxTslPacketSize - kHeaderSize - kMessageHeaderSize;
+    auto packet = start_packet(screen);
+    for (const auto& display : displays) {
+        const auto length = std::min(display.text.size(), kMaxText);
+        if (packet.size() + kMessageHeaderSize + length > kMaxTslPacketSize) {
+            finish_packet(packet, out);
+            packet = start_packet(screen);
+        }
+        put16(packet, display.index);
+        put16(packet, control_word(display));
+        put16(packet, static_cast<uint16_t>(length));
+        for (std::size_t i = 0; i < length; ++i) {
+            const auto c = static_cast<uint8_t>(display.text[i]);
+            packet.push_back(c >= 0x20 && c < 0x7F ? c : static_cast<uint8_t>('?'));
+        }
+    }
+    if (packet.size() > kHeaderSize) {
+        finish_packet(packet, out);
+    }
+}
+
+void append_tsl_tcp_frame(std::span<const uint8_t> packet, std::vector<uint8_t>& out)
+{
+    out.reserve(out.size() + 2 + packet.size() + packet.size() / 16);
+    out.push_back(kTslDle);
+    out.push_back(kTslStx);
+    for (const auto byte : packet) {
+        out.push_back(byte);
+        if (byte == kTslDle) {
+            out.push_back(kTslDle);
+        }
+    }
+}
+
+bool decode_tsl_packet(std::span<const uint8_t> packet, uint16_t& screen, std::vector<TslDisplay>& displays)
+{
+    if (packet.size() < kHeaderSize || std::size_t { get16(packet, 0) } + 2 != packet.size()) {
+        return false;
+    }
+    const auto flags = packet[3];
+    if ((flags & kFlagScreenControl) != 0) {
+        return false;
+    }
+    screen = get16(packet, 4);
+    displays.clear();
+    for (std::size_t offset = kHeaderSize; offset < packet.size();) {
+        if (packet.size() - offset < kMessageHeaderSize) {
+            return false;
+        }
+        const auto control = get16(packet, offset + 2);
+        const auto length = get16(packet, offset + 4);
+        offset += kMessageHeaderSize;
+        if (packet.size() - offset < length) {
+            return false;
+        }
+        if ((control & kControlData) == 0) {
+            TslDisplay display;
+            display.index = get16(packet, offset - kMessageHeaderSize);
+            display.rh_tally = static_cast<TslTally>(control & 0x03U);
+            display.text_tally = static_cast<TslTally>((control >> 2) & 0x03U);
+            display.lh_tally = static_cast<TslTally>((control >> 4) & 0x03U);
+            display.brightness = static_cast<uint8_t>((control >> 6) & 0x03U);
+            if ((flags & kFlagUnicode) != 0) {
+                // UTF-16LE; keep the low byte of each code unit, enough for a listing.
+                for (std::size_t i = 0; i + 1 < length; i += 2) {
+                    display.text.push_back(static_cast<char>(packet[offset + i]));
+                }
+            } else {
+                display.text.assign(reinterpret_cast<const char*>(packet.data() + offset), length);
+            }
+            displays.push_back(std::move(display));
+        }
+        offset += length;
+    }
+    return true;
+}
+
+} // namespace atem
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace atem {
+
+// TSL UMD protocol v5.0. Integers are little-endian.
+//
+// A packet is PBC (2, byte count after this field), VER (1, minor version 0),
+// FLAGS (1), SCREEN (2), then one DMSG per display: INDEX (2), CONTROL (2),
+// LENGTH (2) and LENGTH bytes of text. CONTROL packs the right-hand, text and
+// left-hand tallies (2 bits each, from bit 0) and the brightness (bits 6-7).
+// Over UDP a datagram carries one packet. Over TCP each packet is preceded by
+// DLE/STX (0xFE 0x02), and any DLE inside the packet is sent twice.
+
+enum class TslTally : uint8_t {
+    Off = 0,
+    Red = 1,
+    Green = 2,
+    Amber = 3,
+};
+
+struct TslDisplay {
+    uint16_t index = 0;
+    TslTally rh_tally = TslTally::Off;
+    TslTally text_tally = TslTally::Off;
+    TslTally lh_tally = TslTally::Off;
+    uint8_t brightness = 3; // 0-3
+    std::string text; // ASCII; other bytes are sent as '?'
+};
+
+constexpr std::size_t kMaxTslPacketSize = 2048;
+constexpr uint16_t kTslBroadcast = 0xFFFF; // Screen or display index meaning "all"
+constexpr uint8_t kTslDle = 0xFE;
+constexpr uint8_t kTslStx = 0x02;
+
+// Packs `displays` into as few packets of at most kMaxTslPacketSize bytes as
+// possible and appends them to `out`. Text that would not fit is truncated.
+void encode_tsl_packets(uint16_t screen, std::span<const TslDisplay> displays, std::vector<std::vector<uint8_t>>& out);
+
+// Appends `packet` to `out` in TCP framing: DLE/STX, then the packet with
+// every DLE doubled.
+void append_tsl_tcp_frame(std::span<const uint8_t> packet, std::vector<uint8_t>& out);
+
+// Decodes one unframed packet. Returns false if it is malformed or carries
+// screen control messages rather than display messages.
+bool decode_tsl_packet(std::span<const uint8_t> packet, uint16_t& screen, std::vector<TslDisplay>& displays);
+
+} // namespace atem
@@ -0,0 +1,178 @@
+#include "websocket.h"
+#include <algorithm>
+#include <cctype>
+
+namespace atem {
+namespace {
+
+    constexpr std::string_view kHandshakeGuid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+    bool contains_token(std::string value, std::string_view token)
+    {
+        std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return value.find(token) != std::string::npos;
+    }
+
+    uint32_t rotl(uint32_t value, int bits)
+    {
+        return (value << bits) | (value >> (32 - bits));
+    }
+
+    // SHA-1 is only used for the handshake, which the RFC fixes to it.
+    std::array<uint8_t, 20> sha1(std::string_view input)
+    {
+        std::array<uint32_t, 5> h { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+        std::string message(input);
+        const uint64_t bit_length = static_cast<uint64_t>(input.size()) * 8;
+        message += static_cast<char>(0x80);
+        while (message.size() % 64 != 56) {
+            message += '\0';
+        }
+        for (int i = 7; i >= 0; --i) {
+            message += static_cast<char>((bit_length >> (i * 8)) & 0xff);
+        }
+
+        for (std::size_t chunk = 0; chunk < message.size(); chunk += 64) {
+            std::array<uint32_t, 80> w {};
+            for (std::size_t i = 0; i < 16; ++i) {
+                const auto byte = [&](std::size_t k) { return static_cast<uint32_t>(static_cast<unsigned char>(message[chunk + i * 4 + k])); };
+                w[i] = (byte(0) << 24) | (byte(1) << 16) | (byte(2) << 8) | byte(3);
+            }
+            for (std::size_t i = 16; i < 80; ++i) {
+                w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+            }
+
+            auto [a, b, c, d, e] = h;
+            for (std::size_t i = 0; i < 80; ++i) {
+                uint32_t f = 0;
+                uint32_t k = 0;
+                if (i < 20) {
+                    f = (b & c) | (~b & d);
+                    k = 0x5A827999;
+                } else if (i < 40) {
+                    f = b ^ c ^ d;
+                    k = 0x6ED9EBA1;
+                } else if (i < 60) {
+                    f = (b & c) | (b & d) | (c & d);
+                    k = 0x8F1BBCDC;
+                } else {
+                    f = b ^ c ^ d;
+                    k = 0xCA62C1D6;
+                }
+                const uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = rotl(b, 30);
+                b = a;
+                a = temp;
+            }
+            h[0] += a;
+            h[1] += b;
+            h[2] += c;
+            h[3] += d;
+            h[4] += e;
+        }
+
+        std::array<uint8_t, 20> digest {};
+        for (std::size_t i = 0; i < 20; ++i) {
+            digest[i] = static_cast<uint8_t>((h[i / 4] >> (24 - (i % 4) * 8)) & 0xff);
+        }
+        return digest;
+    }
+
+} // namespace
+
+bool is_websocket_upgrade(const HttpRequest& request)
+{
+    return request.method == "GET"
+        && contains_token(request.get_header("Upgrade"), "websocket")
+        && contains_token(request.get_header("Connection"), "upgrade")
+        && request.get_header("Sec-WebSocket-Version") == "13"
+        && !request.get_header("Sec-WebSocket-Key").empty();
+}
+
+std::string websocket_accept_key(std::string_view client_key)
+{
+    std::string input(client_key);
+    input += kHandshakeGuid;
+    return base64_encode(sha1(input));
+}
+
+std::size_t encode_websocket_header(WebSocketOpcode opcode, uint64_t payload_size, std::array<uint8_t, kMaxWebSocketHeader>& out)
+{
+    out[0] = static_cast<uint8_t>(0x80 | static_cast<uint8_t>(opcode));
+    if (payload_size < 126) {
+        out[1] = static_cast<uint8_t>(payload_size);
+        return 2;
+    }
+    if (payload_size <= 0xffff) {
+        out[1] = 126;
+        out[2] = static_cast<uint8_t>(payload_size >> 8);
+        out[3] = static_cast<uint8_t>(payload_size);
+        return 4;
+    }
+    out[1] = 127;
+    for (std::size_t i = 0; i < 8; ++i) {
+        out[2 + i] = static_cast<uint8_t>(payload_size >> ((7 - i) * 8));
+    }
+    return 10;
+}
+
+std::string make_websocket_control_frame(WebSocketOpcode opcode, std::string_view payload)
+{
+    // Control frame payloads are limited to 125 bytes.
+    payload = payload.substr(0, 125);
+    std::array<uint8_t, kMaxWebSocketHeader> header {};
+    const auto header_size = encode_websocket_header(opcode, payload.size(), header);
+    std::string frame(reinterpret_cast<const char*>(header.data()), header_size); // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+    frame += payload;
+    return frame;
+}
+
+std::optional<std::size_t> parse_websocket_frame(std::span<char> data, WebSocketFrame& frame)
+{
+    if (data.size() < 2) {
+        return 0;
+    }
+    const auto byte = [&data](std::size_t i) { return static_cast<uint8_t>(data[i]); };
+    const bool masked = (byte(1) & 0x80) != 0;
+    if (!masked || (byte(0) & 0x70) != 0) {
+        return std::nullopt; // Clients must mask; no extensions were negotiated.
+    }
+
+    std::size_t offset = 2;
+    uint64_t length = byte(1) & 0x7f;
+    if (length == 126) {
+        if (data.size() < 4) {
+            return 0;
+        }
+        length = (uint64_t { byte(2) } << 8) | byte(3);
+        offset = 4;
+    } else if (length == 127) {
+        if (data.size() < 10) {
+            return 0;
+        }
+        length = 0;
+        for (std::size_t i = 0; i < 8; ++i) {
+            length = (length << 8) | byte(2 + i);
+        }
+        offset = 10;
+    }
+    if (length > data.size() || data.size() - offset < 4 + length) {
+        return 0;
+    }
+
+    const std::array<uint8_t, 4> mask { byte(offset), byte(offset + 1), byte(offset + 2), byte(offset + 3) };
+    offset += 4;
+    for (std::size_t i = 0; i < length; ++i) {
+        data[offset + i] = static_cast<char>(byte(offset + i) ^ mask[i % 4]);
+    }
+
+    frame.fin = (byte(0) & 0x80) != 0;
+    frame.opcode = static_cast<WebSocketOpcode>(byte(0) & 0x0f);
+    frame.payload = data.subspan(offset, static_cast<std::size_t>(length));
+    return offset + static_cast<std::size_t>(length);
+}
+
+} // namespace atem
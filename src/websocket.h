@@ -0,0 +1,52 @@
+#pragma once
+
+#include "http_message.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace atem {
+
+// The RFC 6455 pieces the /ws endpoint needs: the handshake, unmasked server
+// frames, and parsing the masked control frames a client may send.
+
+enum class WebSocketOpcode : uint8_t {
+    Continuation = 0x0,
+    Text = 0x1,
+    Binary = 0x2,
+    Close = 0x8,
+    Ping = 0x9,
+    Pong = 0xa,
+};
+
+// Largest frame header a server writes: 2 bytes plus a 64-bit length.
+constexpr std::size_t kMaxWebSocketHeader = 10;
+
+// True for a GET carrying a version 13 upgrade to websocket and a key.
+bool is_websocket_upgrade(const HttpRequest& request);
+
+// The Sec-WebSocket-Accept value for a client's Sec-WebSocket-Key.
+std::string websocket_accept_key(std::string_view client_key);
+
+// Writes the header of one final, unmasked frame and returns its length.
+std::size_t encode_websocket_header(WebSocketOpcode opcode, uint64_t payload_size, std::array<uint8_t, kMaxWebSocketHeader>& out);
+
+// Builds a complete control frame (close, ping or pong) with `payload`.
+std::string make_websocket_control_frame(WebSocketOpcode opcode, std::string_view payload = {});
+
+struct WebSocketFrame {
+    WebSocketOpcode opcode = WebSocketOpcode::Continuation;
+    bool fin = false;
+    std::span<const char> payload; // Unmasked in place
+};
+
+// Parses one client frame at the start of `data` and unmasks its payload in
+// place. Returns the bytes the frame spans, 0 if more data is needed, or
+// nothing if the frame breaks the protocol (for example, it is unmasked).
+std::optional<std::size_t> parse_websocket_frame(std::span<char> data, WebSocketFrame& frame);
+
+} // namespace atem
@@ -0,0 +1,80 @@
+#include "worker_pool.h"
+#include "logger.h"
+#include "platform_interface.h"
+#include <array>
+#include <stdexcept>
+#include <string>
+
+namespace atem {
+
+namespace net = boost::asio;
+using net::ip::udp;
+
+WorkerPool::WorkerPool(std::size_t count, SharedTallyRing& ring)
+    : count_(count)
+    , ring_(ring)
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+    if (!exited_.load(std::memory_order_acquire)) {
+        stop();
+        wait();
+    }
+}
+
+void WorkerPool::start(const WorkerMain& worker_main)
+{
+    for (std::size_t i = 0; i < count_; ++i) {
+        const long pid = platform::start_worker_process([&worker_main, i]() { return worker_main(i); });
+        if (pid < 0) {
+            stop();
+            wait();
+            throw std::runtime_error("Cannot start worker processes: " + platform::get_last_error());
+        }
+        pids_.push_back(pid);
+    }
+
+    doorbell_ = std::make_unique<udp::socket>(ioc_, udp::v4());
+    // A doorbell must never hold up a tally change; a worker that misses one
+    // catches up on its next poll.
+    doorbell_->non_blocking(true);
+    log(LogLevel::Info) << "Started " << pids_.size() << " worker processes";
+}
+
+void WorkerPool::notify()
+{
+    const std::scoped_lock lock(doorbell_mutex_);
+    if (!doorbell_) {
+        return;
+    }
+    static constexpr std::array<uint8_t, 1> kRing { 1 };
+    for (std::size_t i = 0; i < pids_.size(); ++i) {
+        if (const auto port = ring_.doorbell(i); port != 0) {
+            boost::system::error_code ec;
+            doorbell_->send_to(net::buffer(kRing), udp::endpoint(net::ip::address_v4::loopback(), port), 0, ec);
+        }
+    }
+}
+
+void WorkerPool::stop()
+{
+    if (exited_.load(std::memory_order_acquire)) {
+        return; // The process ids may have been reused
+    }
+    for (const auto pid : pids_) {
+        platform::stop_worker_process(pid);
+    }
+}
+
+void WorkerPool::wait()
+{
+    for (const auto pid : pids_) {
+        const int code = platform::wait_worker_process(pid);
+        log(LogLevel::Info) << "Worker process " << pid << " exited with code " << code;
+    }
+    exited_.store(true, std::memory_order_release);
+}
+
+} // namespace atem
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "shared_tally_ring.h"
+#include <atomic>
+#include <boost/asio.hpp>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace atem {
+
+/**
+ * @class WorkerPool
+ * @brief The supervisor's handle on the worker processes that serve HTTP.
+ *
+ * Each worker is a copy of the supervisor started before any threads, so it
+ * shares the SharedTallyRing mapping. Workers bind the listen port with
+ * SO_REUSEPORT and serve clients on their own; the supervisor only publishes
+ * tally changes into the ring and rings each worker's doorbell.
+ */
+class WorkerPool final {
+public:
+    // Runs in the worker process; its result is the worker's exit code.
+    using WorkerMain = std::function<int(std::size_t worker)>;
+
+    WorkerPool(std::size_t count, SharedTallyRing& ring);
+    ~WorkerPool();
+
+    // Non-copyable, non-movable
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+    WorkerPool(WorkerPool&&) = delete;
+    WorkerPool& operator=(WorkerPool&&) = delete;
+
+    // Starts the workers. Call before starting any threads. Throws if worker
+    // processes are unsupported on this platform.
+    void start(const WorkerMain& worker_main);
+    // Wakes every worker after a change has been published to the ring.
+    void notify();
+    // Asks every worker to shut down. Safe to call from another thread
+    // while wait() blocks.
+    void stop();
+    // Blocks until every worker has exited.
+    void wait();
+
+    [[nodiscard]] std::size_t size() const { return pids_.size(); }
+
+private:
+    const std::size_t count_;
+    SharedTallyRing& ring_;
+    std::vector<long> pids_; // Written only by start(), before any threads
+    std::atomic<bool> exited_ { false };
+
+    // Created after the workers start, so they never inherit it.
+    boost::asio::io_context ioc_;
+    std::mutex doorbell_mutex_;
+    std::unique_ptr<boost::asio::ip::udp::socket> doorbell_;
+};
+
+} // namespace atem
@@ -0,0 +1,243 @@
+// Opens many /events streams against a running server, either as one
+// HTTP/1.1 connection per stream or multiplexed over h2c connections, and
+// reports what they cost: TCP connections, time until every stream has its
+// first event, and the server's resident memory per stream (from /metrics).
+//
+// The server needs the asio engine, and http2.enabled for --http 2.
+//
+// Usage: h2_sse_bench [--host 127.0.0.1] [--port 8080] [--clients 200]
+//                     [--http 1|2] [--path /events] [--streams-per-connection 100]
+
+#include <array>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <nghttp2/nghttp2.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+
+struct Options {
+    std::string host = "127.0.0.1";
+    unsigned short port = 8080;
+    unsigned int clients = 200;
+    unsigned int http = 1;
+    std::string path = "/events";
+    unsigned int streams_per_connection = 100;
+};
+
+// Reads one numeric field from the /metrics JSON.
+uint64_t metric(const std::string& json, std::string_view name)
+{
+    const auto key = "\"" + std::string(name) + "\":";
+    const auto at = json.find(key);
+    return at == std::string::npos ? 0 : std::strtoull(json.c_str() + at + key.size(), nullptr, 10);
+}
+
+std::string fetch_metrics(net::io_context& ioc, const tcp::endpoint& endpoint, const Options& options)
+{
+    tcp::socket socket(ioc);
+    socket.connect(endpoint);
+    const auto request = "GET /metrics HTTP/1.1\r\nHost: " + options.host + "\r\nConnection: close\r\n\r\n";
+    net::write(socket, net::buffer(request));
+    std::string response;
+    boost::system::error_code ec;
+    net::read(socket, net::dynamic_buffer(response), ec);
+    const auto body = response.find("\r\n\r\n");
+    return body == std::string::npos ? std::string {} : response.substr(body + 4);
+}
+
+// One socket per stream. A stream is ready once the response headers and
+// one complete event have arrived.
+std::vector<tcp::socket> open_http1(net::io_context& ioc, const tcp::endpoint& endpoint, const Options& options)
+{
+    std::vector<tcp::socket> sockets;
+    sockets.reserve(options.clients);
+    const auto request = "GET " + options.path + " HTTP/1.1\r\nHost: " + options.host + "\r\nAccept: text/event-stream\r\n\r\n";
+    for (unsigned int i = 0; i < options.clients; ++i) {
+        auto& socket = sockets.emplace_back(ioc);
+        socket.connect(endpoint);
+        net::write(socket, net::buffer(request));
+    }
+    for (auto& socket : sockets) {
+        std::string received;
+        while (true) {
+            const auto head = received.find("\r\n\r\n");
+            if (head != std::string::npos && received.find("\n\n", head + 4) != std::string::npos) {
+                break;
+            }
+            std::array<char, 4096> buffer {};
+            received.append(buffer.data(), socket.read_some(net::buffer(buffer)));
+        }
+    }
+    return sockets;
+}
+
+// One h2c connection carrying many streams.
+class Http2Client {
+public:
+    Http2Client(net::io_context& ioc, const tcp::endpoint& endpoint)
+        : socket_(ioc)
+    {
+        socket_.connect(endpoint);
+        nghttp2_session_callbacks* callbacks = nullptr;
+        nghttp2_session_callbacks_new(&callbacks);
+        nghttp2_session_callbacks_set_on_data_chunk_recv_callback(callbacks, &Http2Client::on_data);
+        nghttp2_session_client_new(&session_, callbacks, this);
+        nghttp2_session_callbacks_del(callbacks);
+        nghttp2_submit_settings(session_, NGHTTP2_FLAG_NONE, nullptr, 0);
+    }
+
+    ~Http2Client()
+    {
+        nghttp2_session_del(session_);
+    }
+
+    Http2Client(const Http2Client&) = delete;
+    Http2Client& operator=(const Http2Client&) = delete;
+    Http2Client(Http2Client&&) = delete;
+    Http2Client& operator=(Http2Client&&) = delete;
+
+    void request(const Options& options)
+    {
+        const auto authority = options.host + ":" + std::to_string(options.port);
+        const auto make = [](std::string_view name, std::string_view value) {
+            return nghttp2_nv { reinterpret_cast<uint8_t*>(const_cast<char*>(name.data())), // NOLINT(cppcoreguidelines-pro-type-const-cast)
+                reinterpret_cast<uint8_t*>(const_cast<char*>(value.data())), // NOLINT(cppcoreguidelines-pro-type-const-cast)
+                name.size(), value.size(), NGHTTP2_NV_FLAG_NONE };
+        };
+        const std::array<nghttp2_nv, 5> headers {
+            make(":method", "GET"),
+            make(":scheme", "http"),
+            make(":authority", authority),
+            make(":path", options.path),
+            make("accept", "text/event-stream"),
+        };
+        nghttp2_submit_request2(session_, nullptr, headers.data(), headers.size(), nullptr, nullptr);
+        ++requested_;
+    }
+
+    // Exchanges frames until every stream has received data.
+    void wait_ready()
+    {
+        while (true) {
+            const uint8_t* data = nullptr;
+            nghttp2_ssize length = 0;
+            while ((length = nghttp2_session_mem_send2(session_, &data)) > 0) {
+                net::write(socket_, net::buffer(data, static_cast<std::size_t>(length)));
+            }
+            if (ready_ >= requested_) {
+                return;
+            }
+            std::array<uint8_t, 16384> buffer {};
+            const auto received = socket_.read_some(net::buffer(buffer));
+            if (nghttp2_session_mem_recv2(session_, buffer.data(), received) < 0) {
+                throw std::runtime_error("HTTP/2 protocol error");
+            }
+        }
+    }
+
+private:
+    static int on_data(nghttp2_session* session, uint8_t /*flags*/, int32_t stream_id, const uint8_t* /*data*/, std::size_t /*length*/,
+        void* user_data)
+    {
+        auto& self = *static_cast<Http2Client*>(user_data);
+        if (nghttp2_session_get_stream_user_data(session, stream_id) == nullptr) {
+            nghttp2_session_set_stream_user_data(session, stream_id, &self);
+            ++self.ready_;
+        }
+        return 0;
+    }
+
+    tcp::socket socket_;
+    nghttp2_session* session_ = nullptr;
+    unsigned int requested_ = 0;
+    unsigned int ready_ = 0;
+};
+
+bool parse_options(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string_view name = argv[i];
+        const char* value = argv[i + 1];
+        if (name == "--host") {
+            options.host = value;
+        } else if (name == "--port") {
+            options.port = static_cast<unsigned short>(std::strtoul(value, nullptr, 10));
+        } else if (name == "--clients") {
+            options.clients = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+        } else if (name == "--http") {
+            options.http = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+        } else if (name == "--path") {
+            options.path = value;
+        } else if (name == "--streams-per-connection") {
+            options.streams_per_connection = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+        } else {
+            return false;
+        }
+    }
+    return argc % 2 == 1 && options.clients > 0 && (options.http == 1 || options.http == 2) && options.streams_per_connection > 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        std::fprintf(stderr,
+            "Usage: %s [--host 127.0.0.1] [--port 8080] [--clients 200] [--http 1|2] [--path /events] [--streams-per-connection 100]\n",
+            argv[0]);
+        return 1;
+    }
+
+    try {
+        net::io_context ioc;
+        const tcp::endpoint endpoint(net::ip::make_address(options.host), options.port);
+        const auto before = fetch_metrics(ioc, endpoint, options);
+
+        const auto started = std::chrono::steady_clock::now();
+        std::vector<tcp::socket> http1;
+        std::vector<std::unique_ptr<Http2Client>> http2;
+        if (options.http == 1) {
+            http1 = open_http1(ioc, endpoint, options);
+        } else {
+            for (unsigned int opened = 0; opened < options.clients;) {
+                auto& client = http2.emplace_back(std::make_unique<Http2Client>(ioc, endpoint));
+                for (unsigned int i = 0; i < options.streams_per_connection && opened < options.clients; ++i, ++opened) {
+                    client->request(options);
+                }
+            }
+            for (auto& client : http2) {
+                client->wait_ready();
+            }
+        }
+        const auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+
+        // The metrics request is one more connection on top of the streams.
+        const auto after = fetch_metrics(ioc, endpoint, options);
+        const auto rss_before = metric(before, "resident_bytes");
+        const auto rss_after = metric(after, "resident_bytes");
+        const auto tcp_connections = options.http == 1 ? http1.size() : http2.size();
+        const auto server_connections = metric(after, "connections");
+        std::printf("http/%u streams=%u tcp_connections=%zu server_connections=%llu open_ms=%lld\n", options.http, options.clients,
+            tcp_connections, static_cast<unsigned long long>(server_connections > 0 ? server_connections - 1 : 0), static_cast<long long>(elapsed_ms));
+        std::printf("server_resident_bytes before=%llu after=%llu per_stream=%.0f\n", static_cast<unsigned long long>(rss_before),
+            static_cast<unsigned long long>(rss_after),
+            rss_after > rss_before ? static_cast<double>(rss_after - rss_before) / options.clients : 0.0);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "Error: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
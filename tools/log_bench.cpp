@@ -0,0 +1,146 @@
+// Measures how long a tally update's log line holds up the thread that
+// handles it, with the output going somewhere slow.
+//
+// The sink stands in for a busy terminal, a pipe into a log shipper or a
+// file on a slow disk: every line costs it some microseconds and every flush
+// more. "sync" writes each line to the sink on the calling thread, as the
+// server did with std::cout; "async" hands it to the Logger, whose writer
+// thread does the writing. One thread logs a "Tally update" line at a steady
+// rate, and the time each call takes is recorded.
+//
+// Usage: log_bench [lines] [interval_us] [sink_line_us]
+
+#include "logger.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void busy_wait(std::chrono::nanoseconds duration)
+{
+    const auto until = Clock::now() + duration;
+    while (Clock::now() < until) {
+    }
+}
+
+// A sink that takes its time.
+class SlowSink final : public atem::LogSink {
+public:
+    explicit SlowSink(std::chrono::microseconds per_line)
+        : per_line_(per_line)
+    {
+    }
+
+    void write(atem::LogLevel /*level*/, std::string_view /*line*/) override
+    {
+        busy_wait(per_line_);
+    }
+
+    void flush() override
+    {
+        busy_wait(per_line_ * 4);
+    }
+
+private:
+    std::chrono::microseconds per_line_;
+};
+
+// The line TallyMonitor logs for each change.
+std::string_view format_update(std::array<char, 128>& buffer, uint16_t input, bool program, bool preview)
+{
+    const int length = std::snprintf(buffer.data(), buffer.size(), "Tally update - Input %u Program: %s Preview: %s",
+        static_cast<unsigned int>(input), program ? "ON" : "OFF", preview ? "ON" : "OFF");
+    return { buffer.data(), static_cast<std::size_t>(std::max(length, 0)) };
+}
+
+struct Result {
+    std::vector<uint64_t> latencies_ns;
+    uint64_t dropped = 0;
+};
+
+template <typename LogFn>
+Result run(unsigned int lines, std::chrono::microseconds interval, LogFn&& log_line)
+{
+    Result result;
+    result.latencies_ns.reserve(lines);
+    auto next = Clock::now();
+    for (unsigned int i = 0; i < lines; ++i) {
+        next += interval;
+        const auto before = Clock::now();
+        if (!log_line(static_cast<uint16_t>(i % 20 + 1), i % 3 == 0, i % 3 == 1)) {
+            ++result.dropped;
+        }
+        result.latencies_ns.push_back(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - before).count()));
+        std::this_thread::sleep_until(next);
+    }
+    return result;
+}
+
+void report(const char* name, Result result)
+{
+    auto& latencies = result.latencies_ns;
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&latencies](double p) {
+        return static_cast<double>(latencies[static_cast<std::size_t>(p * static_cast<double>(latencies.size() - 1))]) / 1000.0;
+    };
+    std::printf("%-5s lines=%-7zu p50_us=%-8.2f p99_us=%-8.2f p999_us=%-8.2f max_us=%-9.2f dropped=%llu\n", name, latencies.size(),
+        percentile(0.5), percentile(0.99), percentile(0.999), static_cast<double>(latencies.back()) / 1000.0,
+        static_cast<unsigned long long>(result.dropped));
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const unsigned int lines = argc > 1 ? static_cast<unsigned int>(std::strtoul(argv[1], nullptr, 10)) : 20000;
+    const unsigned int interval_us = argc > 2 ? static_cast<unsigned int>(std::strtoul(argv[2], nullptr, 10)) : 100;
+    const unsigned int sink_line_us = argc > 3 ? static_cast<unsigned int>(std::strtoul(argv[3], nullptr, 10)) : 20;
+    if (lines == 0) {
+        std::fprintf(stderr, "Usage: %s [lines] [interval_us] [sink_line_us]\n", argv[0]);
+        return 1;
+    }
+    const std::chrono::microseconds interval(interval_us);
+    const std::chrono::microseconds sink_line(sink_line_us);
+
+    // What the server did: format, write and flush on the calling thread,
+    // serialized on the stream.
+    {
+        SlowSink sink(sink_line);
+        std::mutex mutex;
+        report("sync", run(lines, interval, [&](uint16_t input, bool program, bool preview) {
+            std::array<char, 128> buffer {};
+            auto line = std::string(format_update(buffer, input, program, preview));
+            line += '\n';
+            const std::scoped_lock lock(mutex);
+            sink.write(atem::LogLevel::Info, line);
+            sink.flush();
+            return true;
+        }));
+    }
+
+    {
+        std::vector<std::unique_ptr<atem::LogSink>> sinks;
+        sinks.push_back(std::make_unique<SlowSink>(sink_line));
+        atem::Logger logger(atem::LogLevel::Info, atem::LogFormat::Text, std::move(sinks));
+        report("async", run(lines, interval, [&](uint16_t input, bool program, bool preview) {
+            std::array<char, 128> buffer {};
+            return logger.log(atem::LogLevel::Info, format_update(buffer, input, program, preview));
+        }));
+        const auto stats = logger.stats();
+        std::printf("async logged=%llu written=%llu batches=%llu\n", static_cast<unsigned long long>(stats.logged),
+            static_cast<unsigned long long>(stats.written), static_cast<unsigned long long>(stats.batches));
+    }
+    return 0;
+}
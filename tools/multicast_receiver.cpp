@@ -0,0 +1,254 @@
+// A test receiver for the multicast tally stream (see src/tally_frame.h).
+//
+// Joins the group, applies deltas and keyframes, and NACKs gaps back to the
+// sender, printing every input whose state changes and a summary line every
+// few seconds. `--drop` discards a share of the incoming non-repair datagrams
+// so the repair path can be exercised on loopback.
+//
+// Usage: multicast_receiver [--group 239.255.84.1] [--port 9920]
+//                           [--interface 0.0.0.0] [--drop PERCENT]
+
+#include "tally_frame.h"
+#include <algorithm>
+#include <array>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <random>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+namespace net = boost::asio;
+using net::ip::udp;
+
+constexpr auto kTickInterval = std::chrono::milliseconds(250);
+constexpr int kTicksPerSummary = 20;
+
+// True when sequence `a` comes after `b`, allowing for wrap-around.
+bool after(uint32_t a, uint32_t b)
+{
+    return static_cast<int32_t>(a - b) > 0;
+}
+
+class Receiver {
+public:
+    Receiver(net::io_context& ioc, const udp::endpoint& listen, const net::ip::address& group, const net::ip::address& interface_address,
+        unsigned int drop_percent)
+        : socket_(ioc)
+        , timer_(ioc)
+        , drop_percent_(drop_percent)
+    {
+        socket_.open(listen.protocol());
+        socket_.set_option(udp::socket::reuse_address(true));
+        socket_.bind(listen);
+        if (group.is_v4() && interface_address.is_v4()) {
+            socket_.set_option(net::ip::multicast::join_group(group.to_v4(), interface_address.to_v4()));
+        } else {
+            socket_.set_option(net::ip::multicast::join_group(group));
+        }
+        receive();
+        tick();
+    }
+
+private:
+    struct InputState {
+        bool program = false;
+        bool preview = false;
+        uint32_t sequence = 0; // Sequence of the delta or keyframe that set this state
+    };
+
+    void receive()
+    {
+        socket_.async_receive_from(net::buffer(buffer_), sender_, [this](const boost::system::error_code& ec, std::size_t size) {
+            if (ec == net::error::operation_aborted) {
+                return;
+            }
+            if (!ec) {
+                handle(std::span<const uint8_t>(buffer_.data(), size));
+            }
+            receive();
+        });
+    }
+
+    void handle(std::span<const uint8_t> datagram)
+    {
+        atem::TallyFrame frame;
+        if (!atem::decode_tally_frame(datagram, frame) || frame.type == atem::TallyFrameType::Nack) {
+            return;
+        }
+        const bool repair = (frame.flags & atem::kTallyFrameRepair) != 0;
+        if (!repair && drop_percent_ > 0 && std::uniform_int_distribution<unsigned int>(0, 99)(random_) < drop_percent_) {
+            ++dropped_;
+            return;
+        }
+        stream_source_ = sender_;
+        repairs_ += repair ? 1 : 0;
+
+        if (!stream_id_ || *stream_id_ != frame.stream_id) {
+            std::cout << "Stream " << frame.stream_id << " from " << sender_ << "\n";
+            stream_id_ = frame.stream_id;
+            states_.clear();
+            missing_.clear();
+            highest_.reset();
+        }
+
+        if (frame.type == atem::TallyFrameType::Keyframe) {
+            keyframes_ += (frame.flags & atem::kTallyFrameMore) == 0 ? 1 : 0;
+            // Everything up to the keyframe's sequence is now known.
+            std::erase_if(missing_, [&frame](uint32_t sequence) { return !after(sequence, frame.sequence); });
+            if (!highest_ || after(frame.sequence, *highest_)) {
+                highest_ = frame.sequence;
+            }
+            apply(frame, frame.sequence, true);
+            return;
+        }
+
+        ++deltas_;
+        if (!highest_) {
+            highest_ = frame.sequence;
+        } else if (after(frame.sequence, *highest_)) {
+            const uint32_t gap = frame.sequence - *highest_ - 1;
+            if (gap > 0) {
+                ++gaps_;
+                for (uint32_t sequence = *highest_ + 1; sequence != frame.sequence; ++sequence) {
+                    missing_.insert(sequence);
+                }
+                send_nack(*highest_ + 1, gap);
+            }
+            highest_ = frame.sequence;
+        } else {
+            missing_.erase(frame.sequence);
+        }
+        apply(frame, frame.sequence, false);
+    }
+
+    // A delta is applied only if no newer change for the input has been seen,
+    // so a late repair never rolls an input back. A keyframe also wins a tie
+    // with the delta it includes.
+    void apply(const atem::TallyFrame& frame, uint32_t sequence, bool keyframe)
+    {
+        for (const auto& entry : frame.entries) {
+            auto [it, inserted] = states_.try_emplace({ entry.switcher, entry.input_id });
+            auto& state = it->second;
+            if (!inserted && (keyframe ? after(state.sequence, sequence) : !after(sequence, state.sequence))) {
+                continue;
+            }
+            const bool changed = inserted || state.program != entry.program || state.preview != entry.preview;
+            state = { entry.program, entry.preview, sequence };
+            if (changed) {
+                std::cout << "Input " << (entry.switcher > 0 ? std::to_string(entry.switcher) + ":" : "") << entry.input_id << ": " << (entry.program ? "PROGRAM" : "-") << " " << (entry.preview ? "PREVIEW" : "-")
+                          << " (seq " << sequence << (keyframe ? ", keyframe" : "") << ")\n";
+            }
+        }
+    }
+
+    void send_nack(uint32_t first, uint32_t count)
+    {
+        atem::TallyFrame nack;
+        nack.type = atem::TallyFrameType::Nack;
+        nack.stream_id = stream_id_.value_or(0);
+        nack.sequence = first;
+        nack.count = static_cast<uint16_t>(std::min<uint32_t>(count, UINT16_MAX));
+        std::vector<uint8_t> datagram;
+        atem::encode_tally_frame(nack, datagram);
+        boost::system::error_code ec;
+        socket_.send_to(net::buffer(datagram), stream_source_, 0, ec);
+        ++nacks_;
+    }
+
+    void tick()
+    {
+        timer_.expires_after(kTickInterval);
+        timer_.async_wait([this](const boost::system::error_code& ec) {
+            if (ec) {
+                return;
+            }
+            // Ask again for whatever is still missing, from the oldest gap on.
+            if (!missing_.empty()) {
+                const auto first = *missing_.begin();
+                send_nack(first, *missing_.rbegin() - first + 1);
+            }
+            if (++ticks_ % kTicksPerSummary == 0) {
+                std::size_t on_program = 0;
+                std::size_t on_preview = 0;
+                for (const auto& [input, state] : states_) {
+                    on_program += state.program ? 1 : 0;
+                    on_preview += state.preview ? 1 : 0;
+                }
+                std::cout << "inputs=" << states_.size() << " program=" << on_program << " preview=" << on_preview
+                          << " seq=" << highest_.value_or(0) << " deltas=" << deltas_ << " keyframes=" << keyframes_ << " dropped=" << dropped_
+                          << " gaps=" << gaps_ << " nacks=" << nacks_ << " repairs=" << repairs_ << " missing=" << missing_.size() << "\n";
+            }
+            tick();
+        });
+    }
+
+    udp::socket socket_;
+    net::steady_timer timer_;
+    const unsigned int drop_percent_;
+    std::mt19937 random_ { std::random_device {}() };
+    std::array<uint8_t, atem::kMaxTallyFrameSize> buffer_ {};
+    udp::endpoint sender_;
+    udp::endpoint stream_source_; // Where NACKs go: the source of the stream
+
+    std::optional<uint32_t> stream_id_;
+    std::optional<uint32_t> highest_; // Newest sequence seen
+    std::set<uint32_t> missing_; // Not wrap-aware; fine for a test tool
+    std::map<std::pair<uint8_t, uint16_t>, InputState> states_; // By switcher, input id
+
+    uint64_t ticks_ = 0;
+    uint64_t deltas_ = 0;
+    uint64_t keyframes_ = 0;
+    uint64_t dropped_ = 0;
+    uint64_t gaps_ = 0;
+    uint64_t nacks_ = 0;
+    uint64_t repairs_ = 0;
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::string group = "239.255.84.1";
+    unsigned short port = 9920;
+    std::string interface_address = "0.0.0.0";
+    unsigned int drop_percent = 0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string_view option = argv[i];
+        if (option == "--group") {
+            group = argv[i + 1];
+        } else if (option == "--port") {
+            port = static_cast<unsigned short>(std::strtoul(argv[i + 1], nullptr, 10));
+        } else if (option == "--interface") {
+            interface_address = argv[i + 1];
+        } else if (option == "--drop") {
+            drop_percent = static_cast<unsigned int>(std::strtoul(argv[i + 1], nullptr, 10));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--group ADDR] [--port PORT] [--interface ADDR] [--drop PERCENT]\n";
+            return 1;
+        }
+    }
+
+    try {
+        net::io_context ioc;
+        const auto group_address = net::ip::make_address(group);
+        const udp::endpoint listen(group_address.is_v4() ? udp::v4() : udp::v6(), port);
+        Receiver receiver(ioc, listen, group_address, net::ip::make_address(interface_address), drop_percent);
+        std::cout << "Listening on " << group << ":" << port << (drop_percent > 0 ? " dropping " + std::to_string(drop_percent) + "%" : "") << "\n";
+        ioc.run();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,200 @@
+// Measures how long a tally broadcast takes while a crowd of clients connects
+// and disconnects at once, with the copy-on-write SessionRegistry and with
+// the single mutex-guarded list it replaced.
+//
+// A set of resident clients stays connected throughout. The main thread
+// broadcasts a tally update to every subscriber at a steady rate and records
+// how long each broadcast takes, as the monitor's callback would. Meanwhile
+// connector threads are released together to add `clients` more, all at
+// once, and then remove them again, over and over, like a reconnect storm
+// after a network blip. With the mutex, every add and remove queues
+// behind a broadcast and every broadcast behind them; with the registry, a
+// broadcast only copies the current snapshot pointer.
+//
+// Usage: session_contention_bench [clients] [connector_threads] [milliseconds]
+
+#include "session_registry.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::size_t kResidentClients = 200;
+constexpr int32_t kInput = 1;
+constexpr auto kBroadcastInterval = std::chrono::microseconds(200);
+
+// A client that only counts what it is sent.
+class CountingClient final : public atem::SseClient {
+public:
+    bool send(const atem::SharedPayload& /*payload*/, int32_t /*coalesce_key*/, atem::OutboundQueue::Clock::time_point /*now*/) override
+    {
+        sent_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    void close() override { }
+    [[nodiscard]] bool is_open() const override { return true; }
+    [[nodiscard]] atem::OutboundQueue::Stats queue_stats() const override { return {}; }
+    [[nodiscard]] std::string remote_address() const override { return "127.0.0.1"; }
+    [[nodiscard]] bool copies_payload() const override { return false; }
+
+private:
+    std::atomic<uint64_t> sent_ { 0 };
+};
+
+// The previous design: one list behind one mutex, held by connects,
+// disconnects and the whole broadcast alike.
+class MutexSessions {
+public:
+    void add(const std::shared_ptr<atem::SseClient>& client)
+    {
+        const std::scoped_lock lock(mutex_);
+        clients_.push_back(client);
+    }
+
+    void remove(const std::shared_ptr<atem::SseClient>& client)
+    {
+        const std::scoped_lock lock(mutex_);
+        const auto it = std::find(clients_.begin(), clients_.end(), client);
+        if (it != clients_.end()) {
+            *it = std::move(clients_.back());
+            clients_.pop_back();
+        }
+    }
+
+    std::size_t broadcast(const atem::SharedPayload& payload, Clock::time_point now)
+    {
+        const std::scoped_lock lock(mutex_);
+        for (const auto& client : clients_) {
+            client->send(payload, kInput, now);
+        }
+        return clients_.size();
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<atem::SseClient>> clients_;
+};
+
+// The registry under test, used as SseServer uses it.
+class RegistrySessions {
+public:
+    void add(const std::shared_ptr<atem::SseClient>& client)
+    {
+        registry_.add(client);
+    }
+
+    void remove(const std::shared_ptr<atem::SseClient>& client)
+    {
+        registry_.remove(client);
+    }
+
+    std::size_t broadcast(const atem::SharedPayload& payload, Clock::time_point now)
+    {
+        const auto snapshot = registry_.snapshot();
+        std::size_t sent = 0;
+        snapshot->for_each_subscriber(kInput, [&payload, now, &sent](const std::shared_ptr<atem::SseClient>& client) {
+            client->send(payload, kInput, now);
+            ++sent;
+        });
+        return sent;
+    }
+
+private:
+    atem::SessionRegistry registry_;
+};
+
+template <typename Sessions>
+void run(const char* name, std::size_t clients, unsigned int connectors, std::chrono::milliseconds duration)
+{
+    Sessions sessions;
+    for (std::size_t i = 0; i < kResidentClients; ++i) {
+        sessions.add(std::make_shared<CountingClient>());
+    }
+
+    std::vector<std::vector<std::shared_ptr<atem::SseClient>>> crowds(connectors);
+    for (std::size_t i = 0; i < clients; ++i) {
+        crowds[i % connectors].push_back(std::make_shared<CountingClient>());
+    }
+
+    // The connectors are released together, as the broadcasts start.
+    std::atomic<bool> go { false };
+    std::atomic<bool> stop { false };
+    std::atomic<uint64_t> operations { 0 };
+    std::vector<std::thread> threads;
+    threads.reserve(connectors);
+    for (unsigned int c = 0; c < connectors; ++c) {
+        threads.emplace_back([&, c]() {
+            auto& crowd = crowds[c];
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (const auto& client : crowd) {
+                    sessions.add(client);
+                }
+                for (const auto& client : crowd) {
+                    sessions.remove(client);
+                }
+                operations.fetch_add(crowd.size() * 2, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    const auto payload = atem::make_sse_payload("tally_update", R"({"type":"tally_update","input":1,"program":true,"preview":false})");
+    std::vector<uint64_t> latencies_ns;
+    uint64_t recipients = 0;
+    const auto started = Clock::now();
+    auto next = started;
+    go.store(true, std::memory_order_release);
+    while (Clock::now() - started < duration) {
+        next += kBroadcastInterval;
+        const auto before = Clock::now();
+        recipients += sessions.broadcast(payload, before);
+        latencies_ns.push_back(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - before).count()));
+        std::this_thread::sleep_until(next);
+    }
+    const auto elapsed = std::chrono::duration<double>(Clock::now() - started).count();
+    stop = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::sort(latencies_ns.begin(), latencies_ns.end());
+    const auto percentile = [&latencies_ns](double p) {
+        return static_cast<double>(latencies_ns[static_cast<std::size_t>(p * static_cast<double>(latencies_ns.size() - 1))]) / 1000.0;
+    };
+    std::printf("%-8s clients=%-5zu broadcasts=%-6zu p50_us=%-8.1f p99_us=%-9.1f p999_us=%-9.1f max_us=%-9.1f connects/s=%-10.0f "
+                "recipients/broadcast=%.0f\n",
+        name, clients, latencies_ns.size(), percentile(0.5), percentile(0.99), percentile(0.999),
+        static_cast<double>(latencies_ns.back()) / 1000.0, static_cast<double>(operations.load()) / 2.0 / elapsed,
+        static_cast<double>(recipients) / static_cast<double>(latencies_ns.size()));
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const std::size_t clients = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+    const unsigned int connectors = argc > 2 ? static_cast<unsigned int>(std::strtoul(argv[2], nullptr, 10)) : 16;
+    const unsigned int milliseconds = argc > 3 ? static_cast<unsigned int>(std::strtoul(argv[3], nullptr, 10)) : 2000;
+    if (clients == 0 || connectors == 0 || milliseconds == 0) {
+        std::fprintf(stderr, "Usage: %s [clients] [connector_threads] [milliseconds]\n", argv[0]);
+        return 1;
+    }
+
+    const std::chrono::milliseconds duration(milliseconds);
+    run<MutexSessions>("mutex", clients, connectors, duration);
+    run<RegistrySessions>("registry", clients, connectors, duration);
+    return 0;
+}
@@ -0,0 +1,72 @@
+// Measures what streaming compression costs and saves on a tally event stream.
+//
+// Feeds a synthetic stream of tally_update events, shaped like the server's,
+// through one long-lived compressor per encoding and reports the compression
+// ratio and deflate time per event. A server shares that work among every
+// client in a channel, so the per-client cost falls as clients are added.
+//
+// Usage: sse_compression_bench [events] [inputs]
+
+#include "sse_compression.h"
+#include "sse_payload.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<atem::SharedPayload> make_events(unsigned int count, unsigned int inputs)
+{
+    std::vector<atem::SharedPayload> events;
+    events.reserve(count);
+    const uint64_t epoch = 1700000000000;
+    for (unsigned int i = 0; i < count; ++i) {
+        const unsigned int input = 1 + (i * 7) % inputs;
+        const bool program = i % 5 == 0;
+        const bool preview = !program && i % 3 == 0;
+        const std::string data = "{\"input\":" + std::to_string(input) + ",\"program\":" + (program ? "true" : "false")
+            + ",\"preview\":" + (preview ? "true" : "false") + ",\"short_name\":\"CAM" + std::to_string(input)
+            + "\",\"mock\":false}";
+        events.push_back(atem::make_sse_payload("tally_update", data, std::to_string(epoch) + "-" + std::to_string(i + 1)));
+    }
+    return events;
+}
+
+void run(atem::StreamEncoding encoding, const std::vector<atem::SharedPayload>& events)
+{
+    atem::StreamCompressor compressor(encoding);
+    const auto started = std::chrono::steady_clock::now();
+    for (const auto& event : events) {
+        compressor.write(*event);
+        // The server flushes after every event so it reaches the client at once.
+        compressor.sync_flush();
+    }
+    const auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count();
+
+    const auto bytes_in = static_cast<double>(compressor.bytes_in());
+    const auto bytes_out = static_cast<double>(compressor.bytes_out());
+    std::printf("%-8s events=%zu bytes_in=%.0f bytes_out=%.0f ratio=%.3f bytes/event=%.1f ns/event=%.0f\n",
+        std::string(atem::content_encoding_name(encoding)).c_str(), events.size(), bytes_in, bytes_out,
+        bytes_out / bytes_in, bytes_out / static_cast<double>(events.size()),
+        static_cast<double>(elapsed_ns) / static_cast<double>(events.size()));
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const unsigned int count = argc > 1 ? static_cast<unsigned int>(std::strtoul(argv[1], nullptr, 10)) : 100000;
+    const unsigned int inputs = argc > 2 ? static_cast<unsigned int>(std::strtoul(argv[2], nullptr, 10)) : 20;
+    if (count == 0 || inputs == 0) {
+        std::fprintf(stderr, "Usage: %s [events] [inputs]\n", argv[0]);
+        return 1;
+    }
+
+    const auto events = make_events(count, inputs);
+    run(atem::StreamEncoding::Gzip, events);
+    run(atem::StreamEncoding::Deflate, events);
+    return 0;
+}
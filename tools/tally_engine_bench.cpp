@@ -0,0 +1,233 @@
+// Checks and times the TallyEngine on synthetic mix effect event streams.
+//
+// Each stream is a sequence of what M/E blocks report after an event: their
+// program and preview inputs and whether a transition is running. A cut
+// fires a program and a preview event, each reading the block's whole
+// selection, so the second repeats the first; a dissolve also fires the
+// transition events. Keyers, downstream keyers and SuperSource boxes instead
+// set the tally flags of the input they put on air. For every event the
+// tallies a client builds from the reported changes are compared with the
+// tallies worked out from every M/E and input flag. "naive" is what the SDK
+// callback did before: report the new program or preview input alone, never
+// the one it replaced, and nothing for keyed inputs. Reports the changes
+// each sent, the events after which the client was wrong, and the engine's
+// time per event.
+//
+// Usage: tally_engine_bench [events] [rounds]
+
+#include "tally_engine.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Event {
+    std::size_t mix_effect;
+    atem::MixEffectState state;
+    bool program_event; // Which SDK event fired, for the naive callback
+    // An input's own tally flags changed instead, if not 0
+    uint16_t input_id = 0;
+    atem::TallyEngine::Tally flags {};
+};
+
+using Stream = std::vector<Event>;
+
+constexpr uint16_t kInputs = 20;
+
+// Cuts and dissolves on `mix_effects` M/E blocks sharing the same inputs,
+// with `repeat_percent` of events reported twice and `key_percent` of them a
+// key going on or off air.
+Stream make_stream(std::size_t events, std::size_t mix_effects, unsigned int dissolve_percent, unsigned int repeat_percent,
+    unsigned int key_percent, uint32_t seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<unsigned int> percent(0, 99);
+    std::uniform_int_distribution<std::size_t> pick_me(0, mix_effects - 1);
+    std::uniform_int_distribution<uint16_t> pick_input(1, kInputs);
+
+    std::vector<atem::MixEffectState> states(mix_effects);
+    std::vector<atem::TallyEngine::Tally> keyed(kInputs + 1);
+    Stream stream;
+    stream.reserve(events + 8);
+    const auto emit = [&](std::size_t me, bool program_event) {
+        stream.push_back({ me, states[me], program_event });
+        if (percent(random) < repeat_percent) {
+            stream.push_back({ me, states[me], program_event });
+        }
+    };
+    for (std::size_t me = 0; me < mix_effects; ++me) {
+        states[me] = { pick_input(random), pick_input(random), false };
+        emit(me, true);
+    }
+
+    while (stream.size() < events) {
+        if (percent(random) < key_percent) {
+            const auto input_id = pick_input(random);
+            auto& flags = keyed[input_id];
+            flags.program = !flags.program;
+            stream.push_back({ 0, {}, false, input_id, flags });
+            continue;
+        }
+        const auto me = pick_me(random);
+        auto& state = states[me];
+        switch (percent(random) % 3) {
+        case 0: // Ready the next shot
+            state.preview = pick_input(random);
+            emit(me, false);
+            break;
+        case 1: // Cut
+            if (percent(random) < dissolve_percent) {
+                state.in_transition = true;
+                emit(me, true);
+            }
+            std::swap(state.program, state.preview);
+            state.in_transition = false;
+            emit(me, true);
+            emit(me, false);
+            break;
+        default: // Someone else's M/E takes a camera
+            state.program = pick_input(random);
+            emit(me, true);
+            break;
+        }
+    }
+    return stream;
+}
+
+// What a client shows, built from the changes it was sent.
+using Client = std::unordered_map<uint16_t, atem::TallyEngine::Tally>;
+
+// Whether `client` shows what `truth` works out from every M/E.
+bool matches(const Client& client, const atem::TallyEngine& truth)
+{
+    for (uint16_t input_id = 1; input_id <= kInputs; ++input_id) {
+        const auto expected = truth.tally(input_id);
+        const auto it = client.find(input_id);
+        const auto shown = it != client.end() ? it->second : atem::TallyEngine::Tally {};
+        if (shown.program != expected.program || shown.preview != expected.preview) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::size_t apply(atem::TallyEngine& engine, const Event& event, std::vector<atem::TallyEngine::Change>& changes)
+{
+    if (event.input_id != 0) {
+        return engine.set_input_tally(event.input_id, event.flags, changes);
+    }
+    return engine.update(event.mix_effect, event.state, changes);
+}
+
+struct Result {
+    uint64_t changes = 0;
+    uint64_t wrong = 0; // Events after which the client was wrong
+};
+
+Result check_engine(const Stream& stream)
+{
+    atem::TallyEngine engine;
+    Client client;
+    std::vector<atem::TallyEngine::Change> changes;
+    Result result;
+    for (const auto& event : stream) {
+        changes.clear();
+        apply(engine, event, changes);
+        for (const auto& change : changes) {
+            client[change.input_id] = { change.program, change.preview };
+        }
+        result.changes += changes.size();
+        result.wrong += matches(client, engine) ? 0 : 1;
+    }
+    return result;
+}
+
+Result check_naive(const Stream& stream)
+{
+    atem::TallyEngine truth;
+    Client client;
+    std::vector<atem::TallyEngine::Change> ignored;
+    Result result;
+    for (const auto& event : stream) {
+        apply(truth, event, ignored);
+        if (event.input_id != 0) {
+            // Not subscribed to
+        } else if (event.program_event && event.state.program != 0) {
+            client[event.state.program] = { true, false };
+            ++result.changes;
+        } else if (!event.program_event && event.state.preview != 0) {
+            client[event.state.preview] = { false, true };
+            ++result.changes;
+        }
+        result.wrong += matches(client, truth) ? 0 : 1;
+    }
+    return result;
+}
+
+double time_engine(const Stream& stream, unsigned int rounds)
+{
+    std::vector<atem::TallyEngine::Change> changes;
+    changes.reserve(8);
+    uint64_t sink = 0;
+    const auto start = Clock::now();
+    for (unsigned int round = 0; round < rounds; ++round) {
+        atem::TallyEngine engine;
+        for (const auto& event : stream) {
+            changes.clear();
+            sink += apply(engine, event, changes);
+        }
+    }
+    const auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    if (sink == 0) {
+        std::printf("(no changes)\n");
+    }
+    return elapsed / static_cast<double>(stream.size() * rounds);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const std::size_t events = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    const unsigned int rounds = argc > 2 ? static_cast<unsigned int>(std::strtoul(argv[2], nullptr, 10)) : 20;
+    if (events == 0 || rounds == 0) {
+        std::fprintf(stderr, "Usage: %s [events] [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    struct Scenario {
+        const char* name;
+        std::size_t mix_effects;
+        unsigned int dissolve_percent;
+        unsigned int repeat_percent;
+        unsigned int key_percent;
+    };
+    const Scenario scenarios[] = { // NOLINT(cppcoreguidelines-avoid-c-arrays)
+        { "cuts", 1, 0, 0, 0 },
+        { "dissolves", 1, 100, 0, 0 },
+        { "repeats", 1, 30, 50, 0 },
+        { "4_me", 4, 30, 10, 0 },
+        { "keyers", 2, 30, 10, 25 },
+    };
+
+    bool ok = true;
+    for (const auto& scenario : scenarios) {
+        const auto stream = make_stream(events, scenario.mix_effects, scenario.dissolve_percent, scenario.repeat_percent,
+            scenario.key_percent, 42);
+        const auto engine = check_engine(stream);
+        const auto naive = check_naive(stream);
+        std::printf("%-10s events=%-8zu engine changes=%-8llu wrong=%-6llu ns_per_event=%-6.1f naive changes=%-8llu wrong=%llu\n",
+            scenario.name, stream.size(), static_cast<unsigned long long>(engine.changes), static_cast<unsigned long long>(engine.wrong),
+            time_engine(stream, rounds), static_cast<unsigned long long>(naive.changes), static_cast<unsigned long long>(naive.wrong));
+        ok = ok && engine.wrong == 0;
+    }
+    return ok ? 0 : 1;
+}
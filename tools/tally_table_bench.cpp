@@ -0,0 +1,193 @@
+// Compares the lock-free TallyTable with the mutex-guarded unordered_map it
+// replaced, under many concurrent readers.
+//
+// One writer applies tally changes as fast as it can, as a busy switcher's
+// SDK callback would, while reader threads either copy every input (what a
+// new /events client or a snapshot does) or look up single inputs. Input ids
+// are sparse, like an ATEM's: 1-40, then the colour bars, media players and
+// outputs in the thousands. Reports reads per second and how long the writer
+// took per change; with the mutex, readers delay the writer.
+//
+// Usage: tally_table_bench [readers] [milliseconds]
+
+#include "tally_table.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<atem::InputInfo> make_inputs()
+{
+    std::vector<atem::InputInfo> inputs;
+    for (uint16_t id = 1; id <= 40; ++id) {
+        inputs.push_back({ id, "CAM" + std::to_string(id), "Camera " + std::to_string(id) });
+    }
+    for (const uint16_t id : { 1000, 2001, 2002, 3010, 3011, 3020, 3021, 6000, 7001, 7002, 8001, 10010, 10011 }) {
+        inputs.push_back({ id, "S" + std::to_string(id), "Source " + std::to_string(id) });
+    }
+    return inputs;
+}
+
+// The previous design: one map behind one mutex, taken by readers and the
+// writer alike.
+class MutexTable {
+public:
+    void reset(const std::vector<atem::InputInfo>& inputs)
+    {
+        const std::scoped_lock lock(mutex_);
+        for (const auto& input : inputs) {
+            states_[input.id] = { input.id, input.short_name, false, false, std::chrono::system_clock::now() };
+        }
+    }
+
+    void update(const atem::TallyUpdate& update, uint64_t version)
+    {
+        const std::scoped_lock lock(mutex_);
+        const auto it = states_.find(update.input_id);
+        if (it != states_.end()) {
+            it->second.program = update.program;
+            it->second.preview = update.preview;
+            it->second.short_name = update.short_name;
+            it->second.last_updated = std::chrono::system_clock::now();
+            it->second.version = version;
+        }
+    }
+
+    atem::TallyState get(uint16_t input_id) const
+    {
+        const std::scoped_lock lock(mutex_);
+        const auto it = states_.find(input_id);
+        return it != states_.end() ? it->second : atem::TallyState {};
+    }
+
+    std::vector<atem::TallyState> get_all() const
+    {
+        std::vector<atem::TallyState> states;
+        {
+            const std::scoped_lock lock(mutex_);
+            states.reserve(states_.size());
+            for (const auto& [input_id, state] : states_) {
+                states.push_back(state);
+            }
+        }
+        std::sort(states.begin(), states.end(), [](const auto& a, const auto& b) { return a.input_id < b.input_id; });
+        return states;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::unordered_map<uint16_t, atem::TallyState> states_;
+};
+
+// The table under test: the same calls, without locks.
+class FlatTable {
+public:
+    void reset(const std::vector<atem::InputInfo>& inputs)
+    {
+        table_.reset(0, inputs, 1);
+    }
+
+    void update(const atem::TallyUpdate& update, uint64_t version)
+    {
+        table_.update(update, version);
+    }
+
+    atem::TallyState get(uint16_t input_id) const
+    {
+        return table_.get(0, input_id).value_or(atem::TallyState {});
+    }
+
+    std::vector<atem::TallyState> get_all() const
+    {
+        return table_.get_all();
+    }
+
+private:
+    atem::TallyTable table_;
+};
+
+enum class ReadKind { All, One };
+
+template <typename Table>
+void run(const char* name, ReadKind kind, unsigned int readers, std::chrono::milliseconds duration)
+{
+    const auto inputs = make_inputs();
+    Table table;
+    table.reset(inputs);
+
+    std::atomic<bool> stop { false };
+    std::atomic<uint64_t> reads { 0 };
+    std::atomic<uint64_t> checksum { 0 }; // Keeps the reads from being optimized away
+    std::vector<std::thread> threads;
+    threads.reserve(readers);
+    for (unsigned int r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r]() {
+            uint64_t count = 0;
+            uint64_t sum = 0;
+            std::size_t next = r;
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (kind == ReadKind::All) {
+                    sum += table.get_all().size();
+                } else {
+                    sum += table.get(inputs[next++ % inputs.size()].id).program ? 1 : 0;
+                }
+                ++count;
+            }
+            reads.fetch_add(count, std::memory_order_relaxed);
+            checksum.fetch_add(sum, std::memory_order_relaxed);
+        });
+    }
+
+    uint64_t updates = 0;
+    uint64_t max_update_ns = 0;
+    const auto started = Clock::now();
+    while (Clock::now() - started < duration) {
+        const auto& input = inputs[updates % inputs.size()];
+        const atem::TallyUpdate update(input.id, updates % 3 == 0, updates % 3 == 1, false, input.short_name);
+        const auto before = Clock::now();
+        table.update(update, updates + 2);
+        const auto update_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - before).count());
+        max_update_ns = std::max(max_update_ns, update_ns);
+        ++updates;
+    }
+    const auto elapsed = std::chrono::duration<double>(Clock::now() - started).count();
+    stop = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::printf("%-6s %-4s readers=%-3u reads/s=%-12.0f updates/s=%-11.0f ns/update=%-7.0f max_update_us=%-8.1f (checksum %llu)\n", name,
+        kind == ReadKind::All ? "all" : "one", readers, static_cast<double>(reads.load()) / elapsed, static_cast<double>(updates) / elapsed,
+        elapsed * 1e9 / static_cast<double>(updates), static_cast<double>(max_update_ns) / 1000.0,
+        static_cast<unsigned long long>(checksum.load()));
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const unsigned int readers = argc > 1 ? static_cast<unsigned int>(std::strtoul(argv[1], nullptr, 10)) : 8;
+    const unsigned int milliseconds = argc > 2 ? static_cast<unsigned int>(std::strtoul(argv[2], nullptr, 10)) : 1000;
+    if (readers == 0 || milliseconds == 0) {
+        std::fprintf(stderr, "Usage: %s [readers] [milliseconds]\n", argv[0]);
+        return 1;
+    }
+
+    const std::chrono::milliseconds duration(milliseconds);
+    for (const auto kind : { ReadKind::All, ReadKind::One }) {
+        run<MutexTable>("mutex", kind, readers, duration);
+        run<FlatTable>("flat", kind, readers, duration);
+    }
+    return 0;
+}
@@ -0,0 +1,204 @@
+// A stand-in for a TSL UMD v5.0 display or multiviewer (see src/tsl_umd.h).
+//
+// Listens for packets on a UDP and a TCP port and prints each display whose
+// tallies or text change, with the transport it arrived on. Point the
+// server's tsl.udp_destinations or tsl.tcp_destinations at it.
+//
+// Usage: tsl_listener [--port 8900]
+
+#include "tsl_umd.h"
+#include <array>
+#include <boost/asio.hpp>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+namespace net = boost::asio;
+using net::ip::tcp;
+using net::ip::udp;
+
+std::string_view tally_name(atem::TslTally tally)
+{
+    switch (tally) {
+    case atem::TslTally::Red:
+        return "red";
+    case atem::TslTally::Green:
+        return "green";
+    case atem::TslTally::Amber:
+        return "amber";
+    case atem::TslTally::Off:
+        break;
+    }
+    return "off";
+}
+
+// Last state shown for each display, shared by both transports.
+class Displays {
+public:
+    void apply(std::span<const uint8_t> packet, std::string_view transport)
+    {
+        uint16_t screen = 0;
+        std::vector<atem::TslDisplay> displays;
+        ++packets_;
+        if (!atem::decode_tsl_packet(packet, screen, displays)) {
+            std::cout << "[" << transport << "] malformed packet of " << packet.size() << " bytes\n";
+            return;
+        }
+        for (const auto& display : displays) {
+            const auto state = std::make_tuple(display.rh_tally, display.text_tally, display.lh_tally, display.brightness, display.text);
+            auto [it, inserted] = last_.try_emplace({ screen, display.index }, state);
+            if (!inserted && it->second == state) {
+                continue;
+            }
+            it->second = state;
+            std::cout << "[" << transport << "] screen " << screen << " index " << display.index << " \"" << display.text << "\" rh="
+                      << tally_name(display.rh_tally) << " text=" << tally_name(display.text_tally) << " lh=" << tally_name(display.lh_tally)
+                      << " brightness=" << static_cast<int>(display.brightness) << " (packet " << packets_ << ")\n";
+        }
+    }
+
+private:
+    using State = std::tuple<atem::TslTally, atem::TslTally, atem::TslTally, uint8_t, std::string>;
+    std::map<std::pair<uint16_t, uint16_t>, State> last_;
+    uint64_t packets_ = 0;
+};
+
+// Undoes the TCP framing: finds DLE/STX, collapses doubled DLEs, and cuts
+// packets at the length given by their PBC field.
+class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
+public:
+    TcpConnection(tcp::socket socket, Displays& displays)
+        : socket_(std::move(socket))
+        , displays_(displays)
+        , name_("tcp " + socket_.remote_endpoint().address().to_string())
+    {
+    }
+
+    void read()
+    {
+        socket_.async_read_some(net::buffer(buffer_), [self = shared_from_this()](const boost::system::error_code& ec, std::size_t size) {
+            if (ec) {
+                std::cout << "[" << self->name_ << "] closed\n";
+                return;
+            }
+            for (std::size_t i = 0; i < size; ++i) {
+                self->feed(self->buffer_[i]);
+            }
+            self->read();
+        });
+    }
+
+private:
+    void feed(uint8_t byte)
+    {
+        if (escape_) {
+            escape_ = false;
+            if (byte == atem::kTslStx) {
+                packet_.clear();
+                in_packet_ = true;
+                return;
+            }
+            if (byte != atem::kTslDle) {
+                in_packet_ = false; // Not valid framing; wait for the next DLE/STX
+                return;
+            }
+        } else if (byte == atem::kTslDle) {
+            escape_ = true;
+            return;
+        }
+        if (!in_packet_) {
+            return;
+        }
+        packet_.push_back(byte);
+        if (packet_.size() >= 2 && packet_.size() == 2 + std::size_t { static_cast<uint16_t>(packet_[0] | (packet_[1] << 8)) }) {
+            displays_.apply(packet_, name_);
+            in_packet_ = false;
+        }
+    }
+
+    tcp::socket socket_;
+    Displays& displays_;
+    const std::string name_;
+    std::array<uint8_t, 4096> buffer_ {};
+    std::vector<uint8_t> packet_;
+    bool escape_ = false;
+    bool in_packet_ = false;
+};
+
+class Listener {
+public:
+    Listener(net::io_context& ioc, unsigned short port)
+        : udp_socket_(ioc, udp::endpoint(udp::v4(), port))
+        , acceptor_(ioc, tcp::endpoint(tcp::v4(), port))
+    {
+        receive();
+        accept();
+    }
+
+private:
+    void receive()
+    {
+        udp_socket_.async_receive_from(net::buffer(buffer_), sender_, [this](const boost::system::error_code& ec, std::size_t size) {
+            if (ec == net::error::operation_aborted) {
+                return;
+            }
+            if (!ec) {
+                displays_.apply(std::span<const uint8_t>(buffer_.data(), size), "udp " + sender_.address().to_string());
+            }
+            receive();
+        });
+    }
+
+    void accept()
+    {
+        acceptor_.async_accept([this](const boost::system::error_code& ec, tcp::socket socket) {
+            if (ec == net::error::operation_aborted) {
+                return;
+            }
+            if (!ec) {
+                std::cout << "[tcp] connection from " << socket.remote_endpoint() << "\n";
+                std::make_shared<TcpConnection>(std::move(socket), displays_)->read();
+            }
+            accept();
+        });
+    }
+
+    Displays displays_;
+    udp::socket udp_socket_;
+    tcp::acceptor acceptor_;
+    std::array<uint8_t, atem::kMaxTslPacketSize> buffer_ {};
+    udp::endpoint sender_;
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    unsigned short port = 8900;
+    if (argc == 3 && std::string_view(argv[1]) == "--port") {
+        port = static_cast<unsigned short>(std::strtoul(argv[2], nullptr, 10));
+    } else if (argc != 1) {
+        std::cerr << "Usage: " << argv[0] << " [--port PORT]\n";
+        return 1;
+    }
+
+    try {
+        net::io_context ioc;
+        Listener listener(ioc, port);
+        std::cout << "Listening for TSL UMD v5.0 on UDP and TCP port " << port << "\n";
+        ioc.run();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,88 @@
+// Compares the /events (SSE + JSON) and /ws (WebSocket + CBOR) encodings of a
+// tally stream: bytes on the wire and encoding time per event.
+//
+// Each tally_update is built from a TallyUpdate the same way the server does.
+// The /ws figures include the binary frame header, once per event and once
+// per batch when several queued events share one message.
+//
+// Usage: ws_cbor_bench [events] [batch]
+
+#include "atem/tally_state.h"
+#include "cbor.h"
+#include "sse_payload.h"
+#include "websocket.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<atem::TallyUpdate> make_updates(unsigned int count)
+{
+    std::vector<atem::TallyUpdate> updates;
+    updates.reserve(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        const auto input = static_cast<uint16_t>(1 + (i * 7) % 40);
+        updates.emplace_back(input, i % 5 == 0, i % 3 == 0, false, "CAM" + std::to_string(input));
+    }
+    return updates;
+}
+
+template <typename Encode>
+void run(const char* name, const std::vector<atem::TallyUpdate>& updates, Encode&& encode)
+{
+    uint64_t bytes = 0;
+    const auto started = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < updates.size(); ++i) {
+        bytes += encode(updates[i], i + 1);
+    }
+    const auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count();
+    std::printf("%-22s bytes/event=%6.1f ns/event=%6.0f\n", name, static_cast<double>(bytes) / static_cast<double>(updates.size()),
+        static_cast<double>(elapsed_ns) / static_cast<double>(updates.size()));
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const unsigned int count = argc > 1 ? static_cast<unsigned int>(std::strtoul(argv[1], nullptr, 10)) : 100000;
+    const unsigned int batch = argc > 2 ? static_cast<unsigned int>(std::strtoul(argv[2], nullptr, 10)) : 8;
+    if (count == 0 || batch == 0) {
+        std::fprintf(stderr, "Usage: %s [events] [batch]\n", argv[0]);
+        return 1;
+    }
+    const auto updates = make_updates(count);
+    const uint64_t epoch = 1700000000000;
+
+    run("sse+json", updates, [epoch](const atem::TallyUpdate& update, uint64_t version) {
+        const auto payload = atem::make_sse_payload("tally_update", boost::json::serialize(boost::json::value_from(update)),
+            std::to_string(epoch) + "-" + std::to_string(version));
+        return payload->size();
+    });
+
+    run("ws+cbor", updates, [](const atem::TallyUpdate& update, uint64_t version) {
+        const auto item = atem::make_cbor_event("tally_update", boost::json::value_from(update), version);
+        std::array<uint8_t, atem::kMaxWebSocketHeader> header {};
+        return atem::encode_websocket_header(atem::WebSocketOpcode::Binary, item->size(), header) + item->size();
+    });
+
+    // Items written together share one frame header.
+    const std::string batched = "ws+cbor (batch " + std::to_string(batch) + ")";
+    run(batched.c_str(), updates, [batch, pending = std::size_t { 0 }, count = 0U](const atem::TallyUpdate& update, uint64_t version) mutable {
+        const auto item = atem::make_cbor_event("tally_update", boost::json::value_from(update), version);
+        pending += item->size();
+        if (++count < batch) {
+            return item->size();
+        }
+        std::array<uint8_t, atem::kMaxWebSocketHeader> header {};
+        const auto header_size = atem::encode_websocket_header(atem::WebSocketOpcode::Binary, pending, header);
+        pending = 0;
+        count = 0;
+        return header_size + item->size();
+    });
+    return 0;
+}